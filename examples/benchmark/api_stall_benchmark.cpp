@@ -0,0 +1,172 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/thread.h>
+
+#include "benchmark_util.h"
+#include "krtc/device/device_cache.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// The api thread kept busy the way SDP and stats work keep it: one task of
+// load_ms after the other, posted from a thread of its own.
+class LoadedApiThread {
+public:
+    explicit LoadedApiThread(int64_t load_ms) :
+        thread_(rtc::Thread::Create()),
+        load_ms_(load_ms)
+    {
+        thread_->Start();
+        loader_ = std::thread([this]() {
+            while (!stop_) {
+                std::promise<void> done;
+                std::future<void> finished = done.get_future();
+                thread_->PostTask(webrtc::ToQueuedTask([this, &done]() {
+                    auto until = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(load_ms_);
+                    while (std::chrono::steady_clock::now() < until) {
+                    }
+                    done.set_value();
+                }));
+                finished.wait();
+            }
+        });
+    }
+
+    ~LoadedApiThread() {
+        stop_ = true;
+        loader_.join();
+        thread_->Stop();
+    }
+
+    rtc::Thread* thread() { return thread_.get(); }
+
+private:
+    std::unique_ptr<rtc::Thread> thread_;
+    const int64_t load_ms_;
+    std::atomic<bool> stop_{ false };
+    std::thread loader_;
+};
+
+DeviceCache::Devices FakeDevices() {
+    DeviceCache::Devices devices;
+    devices.cameras.push_back({ "camera", "camera-0" });
+    devices.mics.push_back({ "mic", "mic-0" });
+    devices.screens = 1;
+    return devices;
+}
+
+// Times every call on the benchmark thread, which plays the ui thread.
+// max_stall_us is the longest the ui thread was held by one call.
+template <typename Call>
+void MeasureStalls(benchmark::State& state, Call call) {
+    int64_t max_stall_us = 0;
+    int64_t total_us = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        call();
+        int64_t stall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        max_stall_us = std::max(max_stall_us, stall_us);
+        total_us += stall_us;
+        // A ui frame between two calls.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    state.counters["max_stall_us"] = (double)max_stall_us;
+    state.counters["mean_stall_us"] = (double)total_us / state.iterations();
+}
+
+// Before: GetCameraCount and friends Invoke on the api thread and wait
+// behind whatever it is doing.
+void BM_DeviceQueryInvoke(benchmark::State& state) {
+    LoadedApiThread api(state.range(0));
+    DeviceCache::Devices devices = FakeDevices();
+
+    MeasureStalls(state, [&]() {
+        uint32_t count = api.thread()->Invoke<uint32_t>(RTC_FROM_HERE, [&]() {
+            return (uint32_t)devices.cameras.size();
+        });
+        benchmark::DoNotOptimize(count);
+    });
+}
+
+// After: the count comes from the cached list.
+void BM_DeviceQueryCached(benchmark::State& state) {
+    LoadedApiThread api(state.range(0));
+    DeviceCache cache(api.thread(), FakeDevices);
+    cache.Get();
+
+    MeasureStalls(state, [&]() {
+        uint32_t count = (uint32_t)cache.Get()->cameras.size();
+        benchmark::DoNotOptimize(count);
+    });
+}
+
+// Before: CreatePusher waits for the api thread to construct the pusher.
+void BM_CreateInvoke(benchmark::State& state) {
+    LoadedApiThread api(state.range(0));
+
+    MeasureStalls(state, [&]() {
+        int* handler = api.thread()->Invoke<int*>(RTC_FROM_HERE, []() { return new int(0); });
+        delete handler;
+    });
+}
+
+// After: CreatePusherAsync posts the construction and returns the future,
+// the handler is picked up later from the future or the callback.
+void BM_CreateAsync(benchmark::State& state) {
+    LoadedApiThread api(state.range(0));
+    std::vector<std::future<int*>> pending;
+
+    MeasureStalls(state, [&]() {
+        std::shared_ptr<std::promise<int*>> promise = std::make_shared<std::promise<int*>>();
+        pending.push_back(promise->get_future());
+        api.thread()->PostTask(webrtc::ToQueuedTask([promise]() {
+            promise->set_value(new int(0));
+        }));
+    });
+
+    for (std::future<int*>& handler : pending) {
+        delete handler.get();
+    }
+}
+
+BENCHMARK(BM_DeviceQueryInvoke)
+    ->ArgNames({ "load_ms" })
+    ->Arg(5)->Arg(50)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Iterations(200);
+BENCHMARK(BM_DeviceQueryCached)
+    ->ArgNames({ "load_ms" })
+    ->Arg(5)->Arg(50)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Iterations(200);
+BENCHMARK(BM_CreateInvoke)
+    ->ArgNames({ "load_ms" })
+    ->Arg(5)->Arg(50)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Iterations(200);
+BENCHMARK(BM_CreateAsync)
+    ->ArgNames({ "load_ms" })
+    ->Arg(5)->Arg(50)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime()
+    ->Iterations(200);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
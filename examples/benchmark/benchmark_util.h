@@ -0,0 +1,126 @@
+#ifndef KRTCSDK_EXAMPLES_BENCHMARK_BENCHMARK_UTIL_H_
+#define KRTCSDK_EXAMPLES_BENCHMARK_BENCHMARK_UTIL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <api/video/i420_buffer.h>
+#include <third_party/openh264/src/codec/api/svc/codec_api.h>
+#include <third_party/openh264/src/codec/api/svc/codec_app_def.h>
+
+namespace krtc {
+namespace bench {
+
+// 360p ~ 4K, the range the sdk captures and encodes at.
+inline void VideoResolutions(benchmark::internal::Benchmark* b) {
+    b->ArgNames({ "width", "height" });
+    b->Args({ 640, 360 });
+    b->Args({ 1280, 720 });
+    b->Args({ 1920, 1080 });
+    b->Args({ 2560, 1440 });
+    b->Args({ 3840, 2160 });
+}
+
+// 1 ~ N threads, each thread converts its own frames the way several
+// capturers / encoders would share the cpu.
+inline void VideoResolutionsAndThreads(benchmark::internal::Benchmark* b) {
+    VideoResolutions(b);
+    int max_threads = (int)std::thread::hardware_concurrency();
+    b->ThreadRange(1, max_threads > 1 ? max_threads : 1);
+    b->UseRealTime();
+}
+
+inline void FillPlane(uint8_t* data, int stride, int width, int height, uint32_t seed) {
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = data + y * stride;
+        for (int x = 0; x < width; ++x) {
+            seed = seed * 1664525 + 1013904223;
+            row[x] = (uint8_t)(seed >> 24);
+        }
+    }
+}
+
+inline rtc::scoped_refptr<webrtc::I420Buffer> CreateI420(int width, int height,
+    uint32_t seed = 1)
+{
+    rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+        webrtc::I420Buffer::Create(width, height);
+    FillPlane(buffer->MutableDataY(), buffer->StrideY(), width, height, seed);
+    FillPlane(buffer->MutableDataU(), buffer->StrideU(), buffer->ChromaWidth(),
+        buffer->ChromaHeight(), seed + 1);
+    FillPlane(buffer->MutableDataV(), buffer->StrideV(), buffer->ChromaWidth(),
+        buffer->ChromaHeight(), seed + 2);
+    return buffer;
+}
+
+// Annex B access units from OpenH264, an IDR and the P frame after it, with
+// an AUD in front like some hardware encoders emit.
+inline bool EncodeAccessUnits(int width, int height, std::vector<uint8_t>* idr, std::vector<uint8_t>* p) {
+    ISVCEncoder* encoder = nullptr;
+    if (WelsCreateSVCEncoder(&encoder) != 0 || !encoder) {
+        return false;
+    }
+
+    SEncParamBase param;
+    memset(&param, 0, sizeof(param));
+    param.iUsageType = CAMERA_VIDEO_REAL_TIME;
+    param.iPicWidth = width;
+    param.iPicHeight = height;
+    param.iTargetBitrate = width * height * 4;
+    param.fMaxFrameRate = 30.0f;
+
+    bool ok = encoder->Initialize(&param) == 0;
+    for (int i = 0; ok && i < 2; ++i) {
+        rtc::scoped_refptr<webrtc::I420Buffer> frame = CreateI420(width, height, i + 1);
+        SSourcePicture picture;
+        memset(&picture, 0, sizeof(picture));
+        picture.iPicWidth = width;
+        picture.iPicHeight = height;
+        picture.iColorFormat = videoFormatI420;
+        picture.iStride[0] = frame->StrideY();
+        picture.iStride[1] = frame->StrideU();
+        picture.iStride[2] = frame->StrideV();
+        picture.pData[0] = frame->MutableDataY();
+        picture.pData[1] = frame->MutableDataU();
+        picture.pData[2] = frame->MutableDataV();
+
+        SFrameBSInfo info;
+        memset(&info, 0, sizeof(info));
+        if (encoder->EncodeFrame(&picture, &info) != 0 || info.iFrameSizeInBytes <= 0) {
+            ok = false;
+            break;
+        }
+
+        std::vector<uint8_t>* au = i == 0 ? idr : p;
+        const uint8_t aud[] = { 0, 0, 0, 1, 0x09, 0xf0 };
+        au->assign(aud, aud + sizeof(aud));
+        for (int layer = 0; layer < info.iLayerNum; ++layer) {
+            const SLayerBSInfo& layer_info = info.sLayerInfo[layer];
+            size_t layer_size = 0;
+            for (int nal = 0; nal < layer_info.iNalCount; ++nal) {
+                layer_size += layer_info.pNalLengthInByte[nal];
+            }
+            au->insert(au->end(), layer_info.pBsBuf, layer_info.pBsBuf + layer_size);
+        }
+    }
+
+    encoder->Uninitialize();
+    WelsDestroySVCEncoder(encoder);
+    return ok;
+}
+
+inline void SetFrameCounters(benchmark::State& state, int64_t bytes_per_frame) {
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+    state.counters["fps"] = benchmark::Counter((double)state.iterations(),
+        benchmark::Counter::kIsRate);
+}
+
+} // namespace bench
+} // namespace krtc
+
+#endif // KRTCSDK_EXAMPLES_BENCHMARK_BENCHMARK_UTIL_H_
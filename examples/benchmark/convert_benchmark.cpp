@@ -0,0 +1,208 @@
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <common_video/libyuv/include/webrtc_libyuv.h>
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "benchmark_util.h"
+#include "krtc/media/media_frame.h"
+#include "krtc/render/video_frame_converter.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// DesktopCapturer::OnCaptureResult
+void BM_ARGBToI420(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    std::vector<uint8_t> argb(width * height * 4);
+    FillPlane(argb.data(), width * 4, width * 4, height, 7);
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer =
+        webrtc::I420Buffer::Create(width, height);
+
+    for (auto _ : state) {
+        libyuv::ConvertToI420(argb.data(), 0, i420_buffer->MutableDataY(),
+            i420_buffer->StrideY(), i420_buffer->MutableDataU(),
+            i420_buffer->StrideU(), i420_buffer->MutableDataV(),
+            i420_buffer->StrideV(), 0, 0, width, height,
+            i420_buffer->width(), i420_buffer->height(),
+            libyuv::kRotate0, libyuv::FOURCC_ARGB);
+        benchmark::DoNotOptimize(i420_buffer->MutableDataY());
+        benchmark::ClobberMemory();
+    }
+
+    SetFrameCounters(state, (int64_t)argb.size());
+}
+
+// NvEncoder::EncodeFrame
+void BM_I420ToARGB(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(i420_buffer)
+        .build();
+    std::unique_ptr<uint8_t[]> image_buffer(new uint8_t[width * height * 4]);
+
+    for (auto _ : state) {
+        webrtc::ConvertFromI420(frame, webrtc::VideoType::kARGB, 0, image_buffer.get());
+        benchmark::DoNotOptimize(image_buffer.get());
+        benchmark::ClobberMemory();
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 4);
+}
+
+// QsvEncoder::EncodeFrame
+void BM_I420ToNV12(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    std::unique_ptr<uint8_t[]> image_buffer(new uint8_t[width * height * 3 / 2]);
+
+    for (auto _ : state) {
+        libyuv::ConvertFromI420(
+            i420_buffer->DataY(), i420_buffer->StrideY(), i420_buffer->DataU(),
+            i420_buffer->StrideU(), i420_buffer->DataV(), i420_buffer->StrideV(),
+            image_buffer.get(), width, width, height,
+            libyuv::FOURCC_NV12);
+        benchmark::DoNotOptimize(image_buffer.get());
+        benchmark::ClobberMemory();
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 3 / 2);
+}
+
+// VideoCapturer::OnFrame, VideoAdapter asks for the next step down.
+void BM_I420Scale(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+    int out_width = width * 3 / 4 & ~1;
+    int out_height = height * 3 / 4 & ~1;
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+
+    for (auto _ : state) {
+        rtc::scoped_refptr<webrtc::I420Buffer> scaled_buffer =
+            webrtc::I420Buffer::Create(out_width, out_height);
+        scaled_buffer->ScaleFrom(*i420_buffer);
+        benchmark::DoNotOptimize(scaled_buffer->DataY());
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 3 / 2);
+}
+
+// KRTCPreview::OnFrame
+void BM_MediaFrameCopy(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    int strideY = i420_buffer->StrideY();
+    int strideU = i420_buffer->StrideU();
+    int strideV = i420_buffer->StrideV();
+    int size = strideY * height + (strideU + strideV) * ((height + 1) / 2);
+
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> media_frame = std::make_shared<MediaFrame>(size);
+        media_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
+        media_frame->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
+        media_frame->fmt.sub_fmt.video_fmt.width = width;
+        media_frame->fmt.sub_fmt.video_fmt.height = height;
+        media_frame->stride[0] = strideY;
+        media_frame->stride[1] = strideU;
+        media_frame->stride[2] = strideV;
+        media_frame->data_len[0] = strideY * height;
+        media_frame->data_len[1] = strideU * ((height + 1) / 2);
+        media_frame->data_len[2] = strideV * ((height + 1) / 2);
+
+        media_frame->data[0] = new char[media_frame->data_len[0]];
+        media_frame->data[1] = new char[media_frame->data_len[1]];
+        media_frame->data[2] = new char[media_frame->data_len[2]];
+        memcpy(media_frame->data[0], i420_buffer->DataY(), media_frame->data_len[0]);
+        memcpy(media_frame->data[1], i420_buffer->DataU(), media_frame->data_len[1]);
+        memcpy(media_frame->data[2], i420_buffer->DataV(), media_frame->data_len[2]);
+
+        benchmark::DoNotOptimize(media_frame->data[0]);
+    }
+
+    SetFrameCounters(state, size);
+}
+
+// What OnPullVideoFrame consumers did on their own: per pixel BT.601 to
+// RGBA, after the sdk had already copied the I420 frame.
+void BM_AppScalarI420ToRGBA(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    std::vector<uint8_t> rgba(width * height * 4);
+    auto clamp = [](int value) { return (uint8_t)std::min(255, std::max(0, value >> 8)); };
+
+    for (auto _ : state) {
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* row_y = i420_buffer->DataY() + y * i420_buffer->StrideY();
+            const uint8_t* row_u = i420_buffer->DataU() + (y / 2) * i420_buffer->StrideU();
+            const uint8_t* row_v = i420_buffer->DataV() + (y / 2) * i420_buffer->StrideV();
+            uint8_t* dst = rgba.data() + y * width * 4;
+            for (int x = 0; x < width; ++x) {
+                int c = 298 * (row_y[x] - 16);
+                int d = row_u[x / 2] - 128;
+                int e = row_v[x / 2] - 128;
+                dst[x * 4 + 0] = clamp(c + 409 * e + 128);
+                dst[x * 4 + 1] = clamp(c - 100 * d - 208 * e + 128);
+                dst[x * 4 + 2] = clamp(c + 516 * d + 128);
+                dst[x * 4 + 3] = 255;
+            }
+        }
+        benchmark::DoNotOptimize(rgba.data());
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 4);
+}
+
+// The puller's conversion: format 0 I420, 1 NV12, 2 ARGB, 3 RGBA, fitted
+// into max_width x max_height (0: stream size), pooled output.
+void BM_PullFrameConvert(benchmark::State& state) {
+    const SubMediaType kTypes[] = { SubMediaType::kSubTypeI420, SubMediaType::kSubTypeNV12,
+        SubMediaType::kSubTypeARGB, SubMediaType::kSubTypeRGBA };
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(CreateI420(width, height))
+        .build();
+    VideoFrameConverter converter;
+    converter.SetOutput(kTypes[state.range(2)], (int)state.range(3), (int)state.range(4));
+
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> media_frame = converter.Convert(frame);
+        bytes = media_frame->data_len[0] + media_frame->data_len[1] + media_frame->data_len[2];
+        benchmark::DoNotOptimize(media_frame->data[0]);
+    }
+
+    SetFrameCounters(state, bytes);
+}
+
+BENCHMARK(BM_ARGBToI420)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_I420ToARGB)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_I420ToNV12)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_I420Scale)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_MediaFrameCopy)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_AppScalarI420ToRGBA)->Apply(VideoResolutions);
+BENCHMARK(BM_PullFrameConvert)
+    ->ArgNames({ "width", "height", "format", "max_width", "max_height" })
+    ->ArgsProduct({ { 1920 }, { 1080 }, { 0, 1, 2, 3 }, { 0, 960 }, { 0, 540 } });
+
+} // namespace
+} // namespace bench
+} // namespace krtc
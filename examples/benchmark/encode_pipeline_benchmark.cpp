@@ -0,0 +1,118 @@
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <api/video/encoded_image.h>
+#include <api/video/i420_buffer.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/encode_pipeline.h"
+#include "krtc/codec/encoder/cpu_stub_encoder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// Time the stub "gpu" spends on one 1080p frame, about what a low power
+// encoder needs with TARGETUSAGE_BEST_SPEED.
+const int kEncodeLatencyUs = 12000;
+const int kWidth = 1920;
+const int kHeight = 1080;
+
+void AsyncDepths(benchmark::internal::Benchmark* b) {
+    b->ArgNames({ "depth" });
+    for (int depth = 1; depth <= 4; ++depth) {
+        b->Arg(depth);
+    }
+    b->UseRealTime();
+}
+
+xop::VideoImage ToImage(const webrtc::I420BufferInterface& buffer) {
+    xop::VideoImage image;
+    image.format = xop::VE_IMAGE_FORMAT_I420;
+    image.width = buffer.width();
+    image.height = buffer.height();
+    image.data[0] = buffer.DataY();
+    image.data[1] = buffer.DataU();
+    image.data[2] = buffer.DataV();
+    image.stride[0] = buffer.StrideY();
+    image.stride[1] = buffer.StrideU();
+    image.stride[2] = buffer.StrideV();
+    return image;
+}
+
+// Encode throughput against pipeline depth. Every delivered frame is checked
+// against the submit order and its rtp timestamp, which doubles as the
+// ordering test for EncodePipeline.
+void BM_EncodePipelineDepth(benchmark::State& state) {
+    int depth = (int)state.range(0);
+
+    xop::CpuStubEncoder encoder;
+    encoder.SetOption(xop::VE_OPT_WIDTH, kWidth);
+    encoder.SetOption(xop::VE_OPT_HEIGHT, kHeight);
+    encoder.SetOption(xop::VE_OPT_TEXTURE_FORMAT, xop::VE_OPT_FORMAT_NV12);
+    encoder.SetOption(xop::VE_OPT_ASYNC_DEPTH, depth);
+    encoder.SetLatency(kEncodeLatencyUs);
+    if (!encoder.Init()) {
+        state.SkipWithError("stub encoder init failed");
+        return;
+    }
+
+    uint32_t expected_timestamp = 0;
+    int64_t expected_capture_ms = 0;
+    std::string error;
+    EncodePipeline pipeline(&encoder, depth,
+        [&](const webrtc::EncodedImage& frame_info,
+            rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream) {
+        if (error.empty() && (frame_info.Timestamp() != expected_timestamp ||
+            frame_info.capture_time_ms_ != expected_capture_ms)) {
+            error = "frame " + std::to_string(frame_info.Timestamp()) +
+                " delivered out of order, expected " + std::to_string(expected_timestamp);
+        }
+        if (error.empty() && bitstream->bitstream().size() < 5) {
+            error = "empty access unit";
+        }
+        expected_timestamp += 3000;
+        expected_capture_ms += 33;
+    });
+    pipeline.Start();
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(kWidth, kHeight);
+    xop::VideoImage image = ToImage(*i420_buffer);
+    webrtc::EncodedImage frame_info;
+    uint32_t timestamp = 0;
+    int64_t capture_ms = 0;
+
+    for (auto _ : state) {
+        frame_info.SetTimestamp(timestamp);
+        frame_info.capture_time_ms_ = capture_ms;
+        if (pipeline.Encode(image, frame_info) < 0) {
+            state.SkipWithError("pipeline encode failed");
+            break;
+        }
+        timestamp += 3000;
+        capture_ms += 33;
+    }
+
+    pipeline.Stop();
+
+    if (!error.empty()) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    if (pipeline.frames_delivered() != (uint64_t)state.iterations()) {
+        state.SkipWithError("frames lost in the pipeline");
+        return;
+    }
+
+    SetFrameCounters(state, (int64_t)kWidth * kHeight * 3 / 2);
+    state.counters["in_flight"] = (double)pipeline.depth();
+}
+
+BENCHMARK(BM_EncodePipelineDepth)->Apply(AsyncDepths);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <api/video/encoded_image.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/encoded_buffer_pool.h"
+#include "krtc/media/encoded_frame_tap.h"
+#include "krtc/media/media_frame.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// Typical access unit sizes: p frame at 720p/2.5Mbps and an idr at 1080p.
+void EncodedFrameSizes(benchmark::internal::Benchmark* b) {
+    b->ArgNames({ "bytes" });
+    b->Arg(12 * 1024);
+    b->Arg(200 * 1024);
+}
+
+// The rtp sender keeps a few frames alive before they are packetized.
+const size_t kFramesInFlight = 3;
+
+void FakeEncode(std::vector<uint8_t>& out_frame, size_t size) {
+    out_frame.resize(size);
+    out_frame[0] = 0;
+    out_frame[size - 1] = 1;
+}
+
+// Old RtpFragmentize: fresh frame_packet vector, fresh EncodedImageBuffer, memcpy.
+void BM_EncodedOutputAllocCopy(benchmark::State& state) {
+    size_t size = (size_t)state.range(0);
+    webrtc::EncodedImage encoded_image;
+    std::deque<rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>> in_flight;
+
+    for (auto _ : state) {
+        std::vector<uint8_t> frame_packet;
+        FakeEncode(frame_packet, size);
+
+        auto buffer = webrtc::EncodedImageBuffer::Create(frame_packet.size());
+        memcpy(buffer->data(), &frame_packet[0], frame_packet.size());
+        encoded_image.SetEncodedData(buffer);
+
+        in_flight.push_back(buffer);
+        if (in_flight.size() > kFramesInFlight) {
+            in_flight.pop_front();
+        }
+        benchmark::DoNotOptimize(encoded_image.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Backend writes into a pooled buffer which is handed over by reference.
+void BM_EncodedOutputPooled(benchmark::State& state) {
+    size_t size = (size_t)state.range(0);
+    webrtc::EncodedImage encoded_image;
+    EncodedBufferPool pool;
+    std::deque<rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>> in_flight;
+
+    for (auto _ : state) {
+        rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream = pool.Acquire();
+        FakeEncode(bitstream->bitstream(), size);
+        encoded_image.SetEncodedData(bitstream);
+
+        in_flight.push_back(bitstream);
+        if (in_flight.size() > kFramesInFlight) {
+            in_flight.pop_front();
+        }
+        benchmark::DoNotOptimize(encoded_image.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["pooled"] = (double)pool.pooled_buffers();
+}
+
+// OnEncodedVideoFrame the way the other MediaFrame callbacks fill frames:
+// new[] and memcpy of the access unit.
+void BM_EncodedFrameCallbackCopy(benchmark::State& state) {
+    std::vector<uint8_t> access_unit;
+    FakeEncode(access_unit, (size_t)state.range(0));
+
+    for (auto _ : state) {
+        std::shared_ptr<MediaFrame> media_frame =
+            std::make_shared<MediaFrame>((int)access_unit.size());
+        media_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
+        media_frame->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+        media_frame->data[0] = new char[access_unit.size()];
+        memcpy(media_frame->data[0], access_unit.data(), access_unit.size());
+        media_frame->data_len[0] = (int)access_unit.size();
+        benchmark::DoNotOptimize(media_frame->data[0]);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// What the push taps hand out: WrapEncodedFrame referencing the encoder's
+// pooled buffer, the pool takes it back once the frame is released.
+void BM_EncodedFrameCallbackWrap(benchmark::State& state) {
+    size_t size = (size_t)state.range(0);
+    EncodedBufferPool pool;
+
+    for (auto _ : state) {
+        rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream = pool.Acquire();
+        FakeEncode(bitstream->bitstream(), size);
+
+        TappedFrame frame;
+        frame.video = true;
+        frame.data = rtc::ArrayView<const uint8_t>(bitstream->data(), bitstream->size());
+        frame.buffer = bitstream;
+        std::shared_ptr<MediaFrame> media_frame = WrapEncodedFrame(frame, 0);
+        benchmark::DoNotOptimize(media_frame->data[0]);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["pooled"] = (double)pool.pooled_buffers();
+}
+
+BENCHMARK(BM_EncodedOutputAllocCopy)->Apply(EncodedFrameSizes);
+BENCHMARK(BM_EncodedOutputPooled)->Apply(EncodedFrameSizes);
+BENCHMARK(BM_EncodedFrameCallbackCopy)->Apply(EncodedFrameSizes);
+BENCHMARK(BM_EncodedFrameCallbackWrap)->Apply(EncodedFrameSizes);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
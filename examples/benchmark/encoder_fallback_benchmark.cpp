@@ -0,0 +1,217 @@
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <api/video_codecs/video_encoder.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/fallback_video_encoder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// Stand-in backend: fails from a given frame on, or takes encode_time_us per frame.
+class FakeBackend : public webrtc::VideoEncoder {
+public:
+    FakeBackend(const std::string& name, int fail_from_frame, int encode_time_us) :
+        name_(name), fail_from_frame_(fail_from_frame), encode_time_us_(encode_time_us) {}
+
+    int32_t InitEncode(const webrtc::VideoCodec* codec_settings, int32_t number_of_cores,
+        size_t max_payload_size) override
+    {
+        frames_ = 0;
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override {
+        callback_ = callback;
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+
+    void SetRates(const RateControlParameters& parameters) override {}
+
+    int32_t Encode(const webrtc::VideoFrame& frame,
+        const std::vector<webrtc::VideoFrameType>* frame_types) override
+    {
+        if (fail_from_frame_ >= 0 && frames_ >= fail_from_frame_) {
+            return WEBRTC_VIDEO_CODEC_ERROR;
+        }
+        if (encode_time_us_ > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(encode_time_us_));
+        }
+
+        bool key = frames_ == 0 || (frame_types && !frame_types->empty() &&
+            (*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey);
+        frames_++;
+
+        webrtc::EncodedImage encoded_image;
+        encoded_image.SetTimestamp(frame.timestamp());
+        encoded_image._frameType = key ? webrtc::VideoFrameType::kVideoFrameKey
+            : webrtc::VideoFrameType::kVideoFrameDelta;
+        webrtc::CodecSpecificInfo codec_specific;
+        codec_specific.codecType = webrtc::kVideoCodecH264;
+        callback_->OnEncodedImage(encoded_image, &codec_specific);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    EncoderInfo GetEncoderInfo() const override {
+        EncoderInfo info;
+        info.implementation_name = name_;
+        return info;
+    }
+
+private:
+    std::string name_;
+    int fail_from_frame_;
+    int encode_time_us_;
+    int frames_ = 0;
+    webrtc::EncodedImageCallback* callback_ = nullptr;
+};
+
+// Records what reaches the rtp sender.
+class FrameRecorder : public webrtc::EncodedImageCallback {
+public:
+    Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+        const webrtc::CodecSpecificInfo* codec_specific_info) override
+    {
+        timestamps.push_back(encoded_image.Timestamp());
+        key_frames.push_back(encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey);
+        return Result(Result::OK);
+    }
+
+    std::vector<uint32_t> timestamps;
+    std::vector<bool> key_frames;
+};
+
+FallbackVideoEncoder::Backend MakeBackend(const std::string& name, int fail_from_frame,
+    int encode_time_us)
+{
+    return { name, [=]() {
+        return std::unique_ptr<webrtc::VideoEncoder>(
+            new FakeBackend(name, fail_from_frame, encode_time_us));
+    } };
+}
+
+webrtc::VideoCodec CreateCodec() {
+    webrtc::VideoCodec codec;
+    codec.codecType = webrtc::kVideoCodecH264;
+    codec.width = 320;
+    codec.height = 180;
+    codec.maxFramerate = 30;
+    return codec;
+}
+
+// Runs frames through a hardware -> software chain and checks the switch:
+// exactly one, every timestamp delivered once in order, idr right after it.
+void RunFallback(benchmark::State& state, std::vector<FallbackVideoEncoder::Backend> backends,
+    const EncoderHealthMonitor::Config& config, int frames, int64_t* frames_to_switch)
+{
+    webrtc::VideoCodec codec = CreateCodec();
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(webrtc::I420Buffer::Create(codec.width, codec.height))
+        .build();
+
+    FrameRecorder recorder;
+    std::string switched_to;
+    FallbackVideoEncoder encoder(std::move(backends),
+        [&](const std::string& from, const std::string& to, EncoderHealthMonitor::Verdict) {
+        switched_to = to;
+        *frames_to_switch = (int64_t)recorder.timestamps.size();
+    }, config);
+    encoder.RegisterEncodeCompleteCallback(&recorder);
+    encoder.InitEncode(&codec, 1, 1200);
+
+    for (int i = 0; i < frames; ++i) {
+        frame.set_timestamp(i * 3000);
+        if (encoder.Encode(frame, nullptr) < 0) {
+            state.SkipWithError("frame lost across the switch");
+            return;
+        }
+    }
+
+    if (encoder.switch_count() != 1 || switched_to != "software") {
+        state.SkipWithError("expected one switch to the software backend");
+        return;
+    }
+    for (size_t i = 0; i < recorder.timestamps.size(); ++i) {
+        if (recorder.timestamps[i] != i * 3000) {
+            state.SkipWithError("timestamps out of order after the switch");
+            return;
+        }
+    }
+    if ((int)recorder.timestamps.size() != frames ||
+        !recorder.key_frames[(size_t)*frames_to_switch]) {
+        state.SkipWithError("no idr after the switch");
+    }
+}
+
+void BM_EncoderFallbackOnErrors(benchmark::State& state) {
+    EncoderHealthMonitor::Config config;
+    config.max_errors = 1;
+    int64_t frames_to_switch = 0;
+
+    for (auto _ : state) {
+        RunFallback(state, { MakeBackend("hardware", 10, 0), MakeBackend("software", -1, 0) },
+            config, 30, &frames_to_switch);
+    }
+
+    state.counters["frames_to_switch"] = (double)frames_to_switch;
+}
+
+void BM_EncoderFallbackOnOverrun(benchmark::State& state) {
+    EncoderHealthMonitor::Config config;
+    config.window_frames = 10;
+    config.time_budget_us = 1000;
+    int64_t frames_to_switch = 0;
+
+    for (auto _ : state) {
+        RunFallback(state, { MakeBackend("hardware", -1, 2000), MakeBackend("software", -1, 0) },
+            config, 30, &frames_to_switch);
+    }
+
+    state.counters["frames_to_switch"] = (double)frames_to_switch;
+}
+
+// Per frame cost of the wrapper on a healthy backend.
+void BM_EncoderFallbackOverhead(benchmark::State& state) {
+    webrtc::VideoCodec codec = CreateCodec();
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(webrtc::I420Buffer::Create(codec.width, codec.height))
+        .build();
+
+    FrameRecorder recorder;
+    FallbackVideoEncoder encoder({ MakeBackend("hardware", -1, 0), MakeBackend("software", -1, 0) },
+        nullptr);
+    encoder.RegisterEncodeCompleteCallback(&recorder);
+    encoder.InitEncode(&codec, 1, 1200);
+
+    uint32_t timestamp = 0;
+    for (auto _ : state) {
+        frame.set_timestamp(timestamp += 3000);
+        encoder.Encode(frame, nullptr);
+        if (recorder.timestamps.size() > 1024) {
+            recorder.timestamps.clear();
+            recorder.key_frames.clear();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_EncoderFallbackOnErrors)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_EncoderFallbackOnOverrun)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncoderFallbackOverhead);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
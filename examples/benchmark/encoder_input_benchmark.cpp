@@ -0,0 +1,98 @@
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <common_video/libyuv/include/webrtc_libyuv.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/encoder/cpu_stub_encoder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+std::unique_ptr<xop::CpuStubEncoder> CreateStubEncoder(int width, int height, int format) {
+    std::unique_ptr<xop::CpuStubEncoder> encoder(new xop::CpuStubEncoder());
+    encoder->SetOption(xop::VE_OPT_WIDTH, width);
+    encoder->SetOption(xop::VE_OPT_HEIGHT, height);
+    encoder->SetOption(xop::VE_OPT_TEXTURE_FORMAT, format);
+    if (!encoder->Init()) {
+        return nullptr;
+    }
+    return encoder;
+}
+
+// Old NvEncoder::EncodeFrame: I420 -> ARGB image_buffer_, copy into a
+// temporary vector, backend copies the vector into its surface.
+void BM_EncodeInputArgbRoundTrip(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    std::unique_ptr<xop::CpuStubEncoder> encoder =
+        CreateStubEncoder(width, height, xop::VE_OPT_FORMAT_B8G8R8A8);
+    if (!encoder) {
+        state.SkipWithError("stub encoder init failed");
+        return;
+    }
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(i420_buffer)
+        .build();
+    int image_size = width * height * 4;
+    std::unique_ptr<uint8_t[]> image_buffer(new uint8_t[image_size]);
+    std::vector<uint8_t> frame_packet;
+
+    for (auto _ : state) {
+        webrtc::ConvertFromI420(frame, webrtc::VideoType::kARGB, 0, image_buffer.get());
+        encoder->Encode(std::vector<uint8_t>(image_buffer.get(), image_buffer.get() + image_size),
+            frame_packet);
+        benchmark::DoNotOptimize(frame_packet.data());
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 3 / 2);
+}
+
+// Current path: I420 planes handed over as is, converted to NV12 while
+// uploading into the backend surface.
+void BM_EncodeInputI420Direct(benchmark::State& state) {
+    int width = (int)state.range(0);
+    int height = (int)state.range(1);
+
+    std::unique_ptr<xop::CpuStubEncoder> encoder =
+        CreateStubEncoder(width, height, xop::VE_OPT_FORMAT_NV12);
+    if (!encoder) {
+        state.SkipWithError("stub encoder init failed");
+        return;
+    }
+
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = CreateI420(width, height);
+    xop::VideoImage image;
+    image.format = xop::VE_IMAGE_FORMAT_I420;
+    image.width = width;
+    image.height = height;
+    image.data[0] = i420_buffer->DataY();
+    image.data[1] = i420_buffer->DataU();
+    image.data[2] = i420_buffer->DataV();
+    image.stride[0] = i420_buffer->StrideY();
+    image.stride[1] = i420_buffer->StrideU();
+    image.stride[2] = i420_buffer->StrideV();
+    std::vector<uint8_t> frame_packet;
+
+    for (auto _ : state) {
+        if (encoder->Encode(image, frame_packet) < 0) {
+            state.SkipWithError("stub encode failed");
+            break;
+        }
+        benchmark::DoNotOptimize(frame_packet.data());
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 3 / 2);
+}
+
+BENCHMARK(BM_EncodeInputArgbRoundTrip)->Apply(VideoResolutionsAndThreads);
+BENCHMARK(BM_EncodeInputI420Direct)->Apply(VideoResolutionsAndThreads);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
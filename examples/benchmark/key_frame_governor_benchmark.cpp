@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "benchmark_util.h"
+#include "krtc/codec/key_frame_governor.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+const int64_t kFrameIntervalMs = 33;
+const int64_t kSessionMs = 60 * 1000;
+// Receivers lose the stream together (a loss burst on the uplink) and each
+// sends a PLI, repeated until the IDR arrives, like webrtc does.
+const int64_t kPliRetryMs = 100;
+const int64_t kIdrArrivalMs = 150;
+
+struct SessionResult {
+    KeyFrameGovernor::Stats stats;
+    int64_t min_idr_gap_ms = 0;
+    int64_t max_answer_ms = 0;
+};
+
+// One simulated session: frames at 30fps, a PLI storm every loss_interval_ms
+// from `receivers` receivers, the governor in front of an encoder that emits
+// the IDR on the frame it was forced on.
+SessionResult RunSession(int receivers, int64_t loss_interval_ms, bool intra_refresh) {
+    KeyFrameGovernor::Config config;
+    config.intra_refresh = intra_refresh;
+    KeyFrameGovernor governor(config);
+
+    SessionResult result;
+    result.min_idr_gap_ms = kSessionMs;
+
+    int64_t last_idr_ms = -1;
+    int64_t loss_ms = -1;
+    int64_t arrival_ms = -1;
+    uint32_t seed = 1;
+
+    for (int64_t now_ms = 0; now_ms < kSessionMs; now_ms += kFrameIntervalMs) {
+        if (now_ms > 0 && now_ms / loss_interval_ms != (now_ms - kFrameIntervalMs) / loss_interval_ms) {
+            loss_ms = now_ms;
+            arrival_ms = -1;
+        }
+
+        // Until the answer reaches them the receivers keep asking, spread
+        // over the retry interval.
+        if (loss_ms >= 0 && (arrival_ms < 0 || now_ms < arrival_ms)) {
+            for (int i = 0; i < receivers; ++i) {
+                seed = seed * 1664525 + 1013904223;
+                if ((int64_t)(seed >> 16) % kPliRetryMs < kFrameIntervalMs) {
+                    governor.RequestKeyFrame(now_ms);
+                }
+            }
+        }
+
+        KeyFrameGovernor::Decision decision = governor.OnFrame(now_ms, now_ms == 0);
+        if (decision == KeyFrameGovernor::kKeyFrame) {
+            governor.OnKeyFrameEncoded(now_ms, (uint32_t)(now_ms * 90));
+            if (last_idr_ms >= 0) {
+                result.min_idr_gap_ms = std::min(result.min_idr_gap_ms, now_ms - last_idr_ms);
+            }
+            last_idr_ms = now_ms;
+        }
+
+        if (loss_ms >= 0 && arrival_ms < 0 && decision != KeyFrameGovernor::kNone) {
+            arrival_ms = now_ms + kIdrArrivalMs;
+            result.max_answer_ms = std::max(result.max_answer_ms, arrival_ms - loss_ms);
+        }
+    }
+
+    result.stats = governor.stats();
+    return result;
+}
+
+void BM_KeyFrameGovernorPliStorm(benchmark::State& state) {
+    const int receivers = (int)state.range(0);
+    const int64_t loss_interval_ms = state.range(1);
+    const bool intra_refresh = state.range(2) != 0;
+
+    SessionResult result;
+    for (auto _ : state) {
+        result = RunSession(receivers, loss_interval_ms, intra_refresh);
+        benchmark::DoNotOptimize(result);
+    }
+
+    KeyFrameGovernor::Config config;
+    if (result.min_idr_gap_ms < config.min_interval_ms) {
+        state.SkipWithError("idr interval below min_interval_ms");
+        return;
+    }
+
+    // Without the governor every request is an IDR, `requested` of them.
+    state.counters["requested"] = (double)result.stats.requested;
+    state.counters["emitted"] = (double)result.stats.emitted;
+    state.counters["coalesced"] = (double)result.stats.coalesced;
+    state.counters["intra_refreshes"] = (double)result.stats.intra_refreshes;
+    state.counters["min_idr_gap_ms"] = (double)result.min_idr_gap_ms;
+    state.counters["max_answer_ms"] = (double)result.max_answer_ms;
+}
+
+// Per frame cost on the encode thread, no request pending.
+void BM_KeyFrameGovernorOnFrame(benchmark::State& state) {
+    KeyFrameGovernor governor;
+    int64_t now_ms = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(governor.OnFrame(now_ms += kFrameIntervalMs, false));
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_KeyFrameGovernorPliStorm)
+    ->ArgNames({ "receivers", "loss_interval_ms", "intra_refresh" })
+    ->ArgsProduct({ { 1, 4, 16, 64 }, { 400, 2000 }, { 0, 1 } })
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_KeyFrameGovernorOnFrame);
+
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,174 @@
+#include <stdint.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "krtc/media/fmp4_muxer.h"
+#include "krtc/media/media_recorder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+const int kVideoFps = 30;
+const int kAudioFps = 50;
+const int kKeyFrameIntervalS = 2;
+
+// One stream as the taps see it: a real IDR from OpenH264 every 2 seconds,
+// P slices sized for the bitrate and 20 ms stereo Opus packets.
+struct StreamFrames {
+    std::vector<uint8_t> idr;
+    std::vector<uint8_t> p;
+    std::vector<uint8_t> opus;
+
+    bool Create(int bitrate_bps) {
+        std::vector<uint8_t> unused;
+        if (!EncodeAccessUnits(640, 360, &idr, &unused)) {
+            return false;
+        }
+        const uint8_t slice[] = { 0, 0, 0, 1, 0x41 };
+        p.assign(slice, slice + sizeof(slice));
+        p.resize(bitrate_bps / 8 / kVideoFps, 0x5a);
+        opus.assign(120, 0x5a);
+        opus[0] = 0xfc;  // config 31, stereo, one frame
+        return true;
+    }
+};
+
+// Feeds media seconds of every stream in capture order, as fast as it
+// goes, into one recorder per stream. The writer thread keeps up or the
+// queues overflow and frames are dropped.
+void FeedStreams(const StreamFrames& frames, int seconds,
+    const std::vector<std::shared_ptr<MediaRecorder>>& recorders)
+{
+    int video_frames = seconds * kVideoFps;
+    int audio_frames = seconds * kAudioFps;
+    int video = 0;
+    int audio = 0;
+    while (video < video_frames || audio < audio_frames) {
+        bool next_video = video < video_frames &&
+            (audio >= audio_frames || video * kAudioFps <= audio * kVideoFps);
+
+        TappedFrame frame;
+        frame.video = next_video;
+        if (next_video) {
+            frame.key_frame = video % (kVideoFps * kKeyFrameIntervalS) == 0;
+            frame.rtp_timestamp = (uint32_t)(video * 90000 / kVideoFps);
+            frame.data = frame.key_frame ? frames.idr : frames.p;
+            video++;
+        }
+        else {
+            frame.key_frame = true;
+            frame.rtp_timestamp = (uint32_t)(audio * 48000 / kAudioFps);
+            frame.data = frames.opus;
+            audio++;
+        }
+
+        for (size_t i = 0; i < recorders.size(); ++i) {
+            frame.ssrc = (uint32_t)i;
+            recorders[i]->OnEncodedFrame(frame);
+        }
+    }
+}
+
+// Muxing alone, no IO.
+void BM_Fmp4Mux(benchmark::State& state) {
+    StreamFrames frames;
+    if (!frames.Create((int)state.range(0))) {
+        state.SkipWithError("openh264 encode failed");
+        return;
+    }
+
+    Fmp4Muxer muxer;
+    int64_t index = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        bool key_frame = index % (kVideoFps * kKeyFrameIntervalS) == 0;
+        const std::vector<uint8_t>& au = key_frame ? frames.idr : frames.p;
+        muxer.AddVideoFrame(au.data(), au.size(), (uint32_t)(index * 3000), key_frame,
+            index * 33);
+        muxer.AddAudioFrame(frames.opus.data(), frames.opus.size(), (uint32_t)(index * 1600),
+            index * 33);
+        muxer.AddAudioFrame(frames.opus.data(), frames.opus.size(),
+            (uint32_t)(index * 1600 + 960), index * 33 + 20);
+        bytes += au.size() + frames.opus.size() * 2;
+        muxer.output()->clear();
+        index++;
+    }
+
+    state.counters["fragments"] = (double)muxer.stats().fragments;
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(bytes);
+}
+
+// Concurrent recordings on one host: streams_realtime is how many streams
+// of this bitrate the recorder keeps up with in real time, from the media
+// seconds recorded per wall second. Should be well above 50.
+void BM_ConcurrentRecordings(benchmark::State& state) {
+    int stream_count = (int)state.range(0);
+    int seconds = (int)state.range(2);
+    StreamFrames frames;
+    if (!frames.Create((int)state.range(1))) {
+        state.SkipWithError("openh264 encode failed");
+        return;
+    }
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    int64_t dropped = 0;
+    int64_t bytes = 0;
+    double wall_s = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::shared_ptr<MediaRecorder>> recorders;
+        for (int i = 0; i < stream_count; ++i) {
+            std::string path = (dir / ("krtc_record_" + std::to_string(i) + ".mp4")).string();
+            std::shared_ptr<MediaRecorder> recorder = MediaRecorder::Create(path,
+                MediaRecorder::Config());
+            if (!recorder) {
+                state.SkipWithError("cannot create the recording");
+                return;
+            }
+            recorders.push_back(recorder);
+        }
+
+        FeedStreams(frames, seconds, recorders);
+        for (const auto& recorder : recorders) {
+            recorder->Stop();
+            MediaRecorder::Stats stats = recorder->stats();
+            dropped += stats.dropped_frames;
+            bytes += stats.bytes_written;
+        }
+
+        wall_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        state.PauseTiming();
+        for (const auto& recorder : recorders) {
+            std::filesystem::remove(recorder->file_path());
+        }
+        state.ResumeTiming();
+    }
+
+    state.counters["streams_realtime"] = wall_s > 0 ?
+        (double)stream_count * seconds * state.iterations() / wall_s : 0;
+    state.counters["dropped_frames"] = (double)dropped;
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_Fmp4Mux)
+    ->ArgNames({ "bps" })
+    ->Arg(2000000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ConcurrentRecordings)
+    ->ArgNames({ "streams", "bps", "seconds" })
+    ->ArgsProduct({ { 1, 16, 64 }, { 2000000 }, { 10 } })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,80 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include <common_video/h264/h264_bitstream_parser.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/nal_unit_index.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// What NvEncoder / QsvEncoder did per frame before: guess the type from
+// byte 4, parse the whole access unit for the QP.
+void BM_FrameInfoFullParse(benchmark::State& state) {
+    std::vector<uint8_t> idr, p;
+    if (!EncodeAccessUnits((int)state.range(0), (int)state.range(1), &idr, &p)) {
+        state.SkipWithError("openh264 encode failed");
+        return;
+    }
+    const std::vector<uint8_t>& au = state.range(2) ? idr : p;
+
+    webrtc::H264BitstreamParser parser;
+    parser.ParseBitstream(idr);
+    for (auto _ : state) {
+        bool key = (au[4] & 0x1f) == 0x07;
+        parser.ParseBitstream(au);
+        benchmark::DoNotOptimize(key);
+        benchmark::DoNotOptimize(parser.GetLastSliceQp());
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)au.size());
+}
+
+// One index pass, then only parameter sets and the first slice header.
+void BM_FrameInfoIndexed(benchmark::State& state) {
+    std::vector<uint8_t> idr, p;
+    if (!EncodeAccessUnits((int)state.range(0), (int)state.range(1), &idr, &p)) {
+        state.SkipWithError("openh264 encode failed");
+        return;
+    }
+    const std::vector<uint8_t>& au = state.range(2) ? idr : p;
+
+    webrtc::H264BitstreamParser full_parser;
+    full_parser.ParseBitstream(idr);
+    full_parser.ParseBitstream(au);
+
+    webrtc::H264BitstreamParser parser;
+    parser.ParseBitstream(idr);
+    NalUnitIndex index;
+    for (auto _ : state) {
+        index.Build(au.data(), au.size());
+        parser.ParseBitstream(rtc::ArrayView<const uint8_t>(au.data(), index.SliceHeaderEnd()));
+        benchmark::DoNotOptimize(index.is_idr());
+        benchmark::DoNotOptimize(parser.GetLastSliceQp());
+    }
+
+    if (index.is_idr() != (state.range(2) != 0) ||
+        parser.GetLastSliceQp() != full_parser.GetLastSliceQp()) {
+        state.SkipWithError("frame type or qp differs from the full parse");
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)au.size());
+}
+
+void AccessUnits(benchmark::internal::Benchmark* b) {
+    b->ArgNames({ "width", "height", "idr" });
+    for (int idr = 0; idr <= 1; ++idr) {
+        b->Args({ 640, 360, idr });
+        b->Args({ 1280, 720, idr });
+        b->Args({ 1920, 1080, idr });
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_FrameInfoFullParse)->Apply(AccessUnits)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FrameInfoIndexed)->Apply(AccessUnits)->Unit(benchmark::kMicrosecond);
+
+} // namespace bench
+} // namespace krtc
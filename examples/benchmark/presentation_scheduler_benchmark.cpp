@@ -0,0 +1,130 @@
+#include <math.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <api/video/video_frame.h>
+
+#include "benchmark_util.h"
+#include "krtc/render/presentation_scheduler.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+const int kRefreshHz = 60;
+const int kStreamFps = 30;
+const int kFrames = 300;
+
+struct Arrival {
+    uint32_t rtp;
+    int64_t arrival_ms;
+};
+
+// A 30 fps stream whose frames arrive up to jitter_ms late, the same
+// pseudo random jitter every run.
+std::vector<Arrival> JitteryStream(int jitter_ms) {
+    std::vector<Arrival> arrivals;
+    uint32_t seed = 12345;
+    for (int i = 0; i < kFrames; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int64_t capture_ms = (int64_t)i * 1000 / kStreamFps;
+        int64_t late_ms = jitter_ms > 0 ? (seed >> 16) % (jitter_ms + 1) : 0;
+        arrivals.push_back({ (uint32_t)(capture_ms * 90), 1000 + capture_ms + late_ms });
+    }
+    return arrivals;
+}
+
+double StdDev(const std::vector<int64_t>& values) {
+    if (values.size() < 2) {
+        return 0;
+    }
+    double mean = 0;
+    for (int64_t value : values) {
+        mean += (double)value;
+    }
+    mean /= values.size();
+    double variance = 0;
+    for (int64_t value : values) {
+        variance += (value - mean) * (value - mean);
+    }
+    return sqrt(variance / values.size());
+}
+
+// Before: every frame shown on the first refresh after it was decoded.
+void BM_PresentImmediate(benchmark::State& state) {
+    std::vector<Arrival> arrivals = JitteryStream((int)state.range(0));
+    const int64_t period_us = 1000000 / kRefreshHz;
+
+    double stddev_ms = 0;
+    for (auto _ : state) {
+        std::vector<int64_t> intervals;
+        int64_t last_us = -1;
+        for (const Arrival& arrival : arrivals) {
+            int64_t vsync_us = (arrival.arrival_ms * 1000 + period_us - 1) / period_us * period_us;
+            if (vsync_us == last_us) {
+                continue; // replaced before it was shown
+            }
+            if (last_us >= 0) {
+                intervals.push_back((vsync_us - last_us) / 1000);
+            }
+            last_us = vsync_us;
+        }
+        stddev_ms = StdDev(intervals);
+        benchmark::DoNotOptimize(stddev_ms);
+    }
+
+    state.counters["interval_stddev_ms"] = stddev_ms;
+    state.counters["delay_ms"] = 0;
+    state.SetItemsProcessed(state.iterations() * kFrames);
+}
+
+// The same arrivals through the scheduler, stepped on a simulated clock.
+// The time per iteration is the cost of buffering and releasing 300 frames.
+void BM_PresentScheduled(benchmark::State& state) {
+    std::vector<Arrival> arrivals = JitteryStream((int)state.range(0));
+    const int64_t period_us = 1000000 / kRefreshHz;
+    webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(CreateI420(64, 64))
+        .build();
+
+    PresentationScheduler::Stats stats;
+    for (auto _ : state) {
+        PresentationScheduler::Config config;
+        config.refresh_hz = kRefreshHz;
+        config.max_delay_ms = (int)state.range(1);
+        PresentationScheduler scheduler(nullptr, config, nullptr);
+
+        size_t next = 0;
+        int64_t end_us = (arrivals.back().arrival_ms + config.max_delay_ms + 100) * 1000;
+        for (int64_t vsync_us = 0; vsync_us < end_us; vsync_us += period_us) {
+            while (next < arrivals.size() && arrivals[next].arrival_ms * 1000 <= vsync_us) {
+                frame.set_timestamp(arrivals[next].rtp);
+                scheduler.Insert(frame, arrivals[next].arrival_ms);
+                ++next;
+            }
+            absl::optional<webrtc::VideoFrame> shown = scheduler.Take(vsync_us / 1000);
+            benchmark::DoNotOptimize(shown);
+        }
+        stats = scheduler.stats();
+    }
+
+    state.counters["interval_stddev_ms"] = stats.interval_stddev_ms;
+    state.counters["delay_ms"] = stats.delay_ms;
+    state.counters["dropped"] = (double)stats.dropped_frames;
+    state.SetItemsProcessed(state.iterations() * kFrames);
+}
+
+BENCHMARK(BM_PresentImmediate)
+    ->ArgNames({ "jitter_ms" })
+    ->Arg(0)->Arg(10)->Arg(30)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PresentScheduled)
+    ->ArgNames({ "jitter_ms", "max_delay_ms" })
+    ->ArgsProduct({ { 0, 10, 30 }, { 50 } })
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,82 @@
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <api/video/video_frame.h>
+#include <rtc_base/thread.h>
+
+#include "benchmark_util.h"
+#include "krtc/render/render_queue.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// An app's OnPullVideoFrame: copies the frame and spends app_us on it
+// (signal to the ui thread, upload, ...).
+void SlowApp(const webrtc::VideoFrame& frame, int64_t app_us) {
+    rtc::scoped_refptr<webrtc::I420Buffer> copy =
+        webrtc::I420Buffer::Copy(*frame.video_frame_buffer()->ToI420());
+    benchmark::DoNotOptimize(copy->DataY());
+    if (app_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(app_us));
+    }
+}
+
+webrtc::VideoFrame CreateFrame(int width, int height) {
+    return webrtc::VideoFrame::Builder()
+        .set_video_frame_buffer(CreateI420(width, height))
+        .build();
+}
+
+// Before: the decoder thread waits for the app on every frame.
+void BM_PullDeliverySync(benchmark::State& state) {
+    webrtc::VideoFrame frame = CreateFrame(1280, 720);
+    int64_t app_us = state.range(0);
+
+    for (auto _ : state) {
+        SlowApp(frame, app_us);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// The time per iteration is what the decoder thread spends per frame.
+void BM_PullDeliveryQueued(benchmark::State& state) {
+    webrtc::VideoFrame frame = CreateFrame(1280, 720);
+    int64_t app_us = state.range(0);
+
+    std::unique_ptr<rtc::Thread> render_thread = rtc::Thread::Create();
+    render_thread->Start();
+    std::shared_ptr<RenderQueue> queue = std::make_shared<RenderQueue>(render_thread.get(),
+        [app_us](const webrtc::VideoFrame& frame) { SlowApp(frame, app_us); });
+
+    for (auto _ : state) {
+        queue->Push(frame);
+    }
+
+    queue->Stop();
+    render_thread->Stop();
+
+    RenderQueue::Stats stats = queue->stats();
+    state.counters["delivered"] = (double)stats.delivered_frames;
+    state.counters["dropped"] = (double)stats.dropped_frames;
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_PullDeliverySync)
+    ->ArgNames({ "app_us" })
+    ->Arg(0)->Arg(5000)->Arg(40000)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_PullDeliveryQueued)
+    ->ArgNames({ "app_us" })
+    ->Arg(0)->Arg(5000)->Arg(40000)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace bench
+} // namespace krtc
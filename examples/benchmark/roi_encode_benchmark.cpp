@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <third_party/libyuv/include/libyuv.h>
+#include <third_party/openh264/src/codec/api/svc/codec_api.h>
+#include <third_party/openh264/src/codec/api/svc/codec_app_def.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/encoder_hint_buffer.h"
+#include "krtc/codec/roi_emulation_encoder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+const int kFrames = 60;
+const int kFrameRate = 30;
+// Fixed qp with rate control off: the face is untouched by the filter and
+// quantized the same way in both runs, so it comes out at equal quality and
+// the byte counts compare directly.
+const int kQp = 30;
+
+// Camera like clip: a panning textured background and a "face" in the middle
+// moving the other way.
+std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> CreateClip(int width, int height,
+    int face_x, int face_y, int face_width, int face_height)
+{
+    // Random at half resolution scaled up, detailed but not pure noise.
+    rtc::scoped_refptr<webrtc::I420Buffer> noise = CreateI420(width, height, 7);
+    rtc::scoped_refptr<webrtc::I420Buffer> canvas =
+        webrtc::I420Buffer::Create(width * 2, height * 2);
+    canvas->ScaleFrom(*noise);
+
+    std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> clip;
+    for (int i = 0; i < kFrames; ++i) {
+        rtc::scoped_refptr<webrtc::I420Buffer> frame = webrtc::I420Buffer::Create(width, height);
+        int bg_x = (i * 4) & ~1;
+        int bg_y = (i * 2) & ~1;
+        int face_src_x = (width - i * 2) & ~1;
+        int face_src_y = (height / 2) & ~1;
+
+        libyuv::I420Copy(
+            canvas->DataY() + bg_y * canvas->StrideY() + bg_x, canvas->StrideY(),
+            canvas->DataU() + bg_y / 2 * canvas->StrideU() + bg_x / 2, canvas->StrideU(),
+            canvas->DataV() + bg_y / 2 * canvas->StrideV() + bg_x / 2, canvas->StrideV(),
+            frame->MutableDataY(), frame->StrideY(),
+            frame->MutableDataU(), frame->StrideU(),
+            frame->MutableDataV(), frame->StrideV(), width, height);
+        libyuv::I420Copy(
+            canvas->DataY() + face_src_y * canvas->StrideY() + face_src_x, canvas->StrideY(),
+            canvas->DataU() + face_src_y / 2 * canvas->StrideU() + face_src_x / 2, canvas->StrideU(),
+            canvas->DataV() + face_src_y / 2 * canvas->StrideV() + face_src_x / 2, canvas->StrideV(),
+            frame->MutableDataY() + face_y * frame->StrideY() + face_x, frame->StrideY(),
+            frame->MutableDataU() + face_y / 2 * frame->StrideU() + face_x / 2, frame->StrideU(),
+            frame->MutableDataV() + face_y / 2 * frame->StrideV() + face_x / 2, frame->StrideV(),
+            face_width, face_height);
+        clip.push_back(frame);
+    }
+    return clip;
+}
+
+// background_delta outside the face, 0 on it.
+QpDeltaMap CreateFaceMap(int width, int height, int face_x, int face_y,
+    int face_width, int face_height, int background_delta)
+{
+    QpDeltaMap qp_map;
+    qp_map.width = (width + qp_map.block_size - 1) / qp_map.block_size;
+    qp_map.height = (height + qp_map.block_size - 1) / qp_map.block_size;
+    qp_map.deltas.assign(qp_map.width * qp_map.height, (int8_t)background_delta);
+    for (int by = face_y / qp_map.block_size;
+        by < (face_y + face_height + qp_map.block_size - 1) / qp_map.block_size; ++by) {
+        for (int bx = face_x / qp_map.block_size;
+            bx < (face_x + face_width + qp_map.block_size - 1) / qp_map.block_size; ++bx) {
+            qp_map.deltas[by * qp_map.width + bx] = 0;
+        }
+    }
+    return qp_map;
+}
+
+// Total bytes of the clip through OpenH264 at kQp.
+int64_t EncodeClip(const std::vector<rtc::scoped_refptr<webrtc::I420Buffer>>& clip) {
+    ISVCEncoder* encoder = nullptr;
+    if (WelsCreateSVCEncoder(&encoder) != 0 || !encoder) {
+        return -1;
+    }
+
+    int width = clip[0]->width();
+    int height = clip[0]->height();
+
+    SEncParamExt param;
+    encoder->GetDefaultParams(&param);
+    param.iUsageType = CAMERA_VIDEO_REAL_TIME;
+    param.iPicWidth = width;
+    param.iPicHeight = height;
+    param.fMaxFrameRate = (float)kFrameRate;
+    param.iRCMode = RC_OFF_MODE;
+    param.iTargetBitrate = 10 * 1000 * 1000;
+    param.iMinQp = kQp;
+    param.iMaxQp = kQp;
+    param.bEnableAdaptiveQuant = false;
+    param.bEnableFrameSkip = false;
+    param.uiIntraPeriod = kFrames;
+    param.iMultipleThreadIdc = 1;
+    param.iSpatialLayerNum = 1;
+    param.sSpatialLayers[0].iVideoWidth = width;
+    param.sSpatialLayers[0].iVideoHeight = height;
+    param.sSpatialLayers[0].fFrameRate = (float)kFrameRate;
+    param.sSpatialLayers[0].iSpatialBitrate = param.iTargetBitrate;
+    param.sSpatialLayers[0].iDLayerQp = kQp;
+    param.sSpatialLayers[0].sSliceArgument.uiSliceMode = SM_SINGLE_SLICE;
+
+    int64_t total_bytes = 0;
+    if (encoder->InitializeExt(&param) == 0) {
+        for (size_t i = 0; i < clip.size(); ++i) {
+            SSourcePicture picture;
+            memset(&picture, 0, sizeof(picture));
+            picture.iPicWidth = width;
+            picture.iPicHeight = height;
+            picture.iColorFormat = videoFormatI420;
+            picture.uiTimeStamp = (long long)(i * 1000 / kFrameRate);
+            picture.iStride[0] = clip[i]->StrideY();
+            picture.iStride[1] = clip[i]->StrideU();
+            picture.iStride[2] = clip[i]->StrideV();
+            picture.pData[0] = const_cast<uint8_t*>(clip[i]->DataY());
+            picture.pData[1] = const_cast<uint8_t*>(clip[i]->DataU());
+            picture.pData[2] = const_cast<uint8_t*>(clip[i]->DataV());
+
+            SFrameBSInfo info;
+            memset(&info, 0, sizeof(info));
+            if (encoder->EncodeFrame(&picture, &info) != 0) {
+                total_bytes = -1;
+                break;
+            }
+            total_bytes += info.iFrameSizeInBytes;
+        }
+        encoder->Uninitialize();
+    }
+    else {
+        total_bytes = -1;
+    }
+
+    WelsDestroySVCEncoder(encoder);
+    return total_bytes;
+}
+
+double ToKbps(int64_t bytes) {
+    return bytes * 8.0 * kFrameRate / kFrames / 1000.0;
+}
+
+// Bitrate of a 720p talking head clip with and without the software ROI
+// emulation, background_delta 3 halves the background resolution, 8 quarters it.
+void BM_RoiEmulationBitrate(benchmark::State& state) {
+    const int width = 1280;
+    const int height = 720;
+    const int face_width = 320;
+    const int face_height = 384;
+    const int face_x = (width - face_width) / 2 & ~15;
+    const int face_y = (height - face_height) / 2 & ~15;
+    int background_delta = (int)state.range(0);
+
+    auto clip = CreateClip(width, height, face_x, face_y, face_width, face_height);
+    QpDeltaMap qp_map = CreateFaceMap(width, height, face_x, face_y,
+        face_width, face_height, background_delta);
+
+    std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> roi_clip;
+    for (auto& frame : clip) {
+        roi_clip.push_back(RoiEmulationEncoder::ApplyQpMap(*frame, qp_map));
+    }
+
+    int64_t plain_bytes = 0;
+    int64_t roi_bytes = 0;
+    for (auto _ : state) {
+        plain_bytes = EncodeClip(clip);
+        roi_bytes = EncodeClip(roi_clip);
+    }
+
+    if (plain_bytes <= 0 || roi_bytes <= 0) {
+        state.SkipWithError("openh264 encode failed");
+        return;
+    }
+
+    state.counters["plain_kbps"] = ToKbps(plain_bytes);
+    state.counters["roi_kbps"] = ToKbps(roi_bytes);
+    state.counters["saved_pct"] = 100.0 * (plain_bytes - roi_bytes) / plain_bytes;
+}
+BENCHMARK(BM_RoiEmulationBitrate)
+    ->ArgName("background_delta")
+    ->Arg(3)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
+// Cost of the filter itself, per frame.
+void BM_RoiEmulationFilter(benchmark::State& state) {
+    const int width = (int)state.range(0);
+    const int height = (int)state.range(1);
+    rtc::scoped_refptr<webrtc::I420Buffer> frame = CreateI420(width, height);
+    QpDeltaMap qp_map = CreateFaceMap(width, height, width / 3 & ~15, height / 4 & ~15,
+        width / 3, height / 2, 8);
+
+    for (auto _ : state) {
+        rtc::scoped_refptr<webrtc::I420Buffer> filtered =
+            RoiEmulationEncoder::ApplyQpMap(*frame, qp_map);
+        benchmark::DoNotOptimize(filtered->DataY());
+    }
+
+    SetFrameCounters(state, (int64_t)width * height * 3 / 2);
+}
+BENCHMARK(BM_RoiEmulationFilter)->Apply(VideoResolutions);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
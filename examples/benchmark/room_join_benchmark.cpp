@@ -0,0 +1,104 @@
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "benchmark_util.h"
+#include "krtc/krtc.h"
+#include "krtc/tools/timer.h"
+#include "local_signaling_server.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// One step of the join, answered by the server after answer_ms. The answer
+// comes in on a thread of its own, like the websocket thread.
+void AnswerAfter(int64_t answer_ms, std::function<void()> answer) {
+    TimerService::Instance()->Schedule((unsigned int)answer_ms, false, std::move(answer));
+}
+
+// Before: a thread per step polls the status every 10 ms and is joined.
+void BM_JoinStepPolled(benchmark::State& state) {
+    int64_t answer_ms = state.range(0);
+
+    for (auto _ : state) {
+        std::atomic<bool> answered{ false };
+        std::thread poll_thread([&]() {
+            AnswerAfter(answer_ms, [&answered]() { answered = true; });
+            while (!answered) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+        poll_thread.join();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// After: the answer fulfills the caller's future directly.
+void BM_JoinStepSignaled(benchmark::State& state) {
+    int64_t answer_ms = state.range(0);
+
+    for (auto _ : state) {
+        std::promise<void> answered;
+        std::future<void> done = answered.get_future();
+        AnswerAfter(answer_ms, [&answered]() { answered.set_value(); });
+        done.get();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Connect and join against the local signaling stand-in, the time is the
+// join alone. Needs server.crt / server.key in the working directory,
+// trusted by the client side.
+void BM_RoomJoinLocal(benchmark::State& state) {
+    LocalSignalingServer::Options options;
+    options.http_port = 19860;
+    options.ws_port = 19890;
+    LocalSignalingServer server(options);
+    if (!server.Start()) {
+        state.SkipWithError("local signaling server did not start");
+        return;
+    }
+
+    std::string server_addr = "127.0.0.1:" + std::to_string(options.ws_port);
+    int round = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        bool joined = KRTCEngine::JoinRoom(server_addr, "bench", "uid" + std::to_string(round++));
+        state.SetIterationTime(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+        if (!joined) {
+            state.SkipWithError("join failed, is the certificate trusted?");
+            break;
+        }
+        KRTCEngine::LeaveRoom();
+    }
+
+    server.Stop();
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_JoinStepPolled)
+    ->ArgNames({ "answer_ms" })
+    ->Arg(1)->Arg(5)->Arg(20)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_JoinStepSignaled)
+    ->ArgNames({ "answer_ms" })
+    ->Arg(1)->Arg(5)->Arg(20)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_RoomJoinLocal)
+    ->Unit(benchmark::kMillisecond)
+    ->UseManualTime()
+    ->Iterations(20);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+
+#include "benchmark_util.h"
+#include "krtc/device/scene_change_detector.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// A few large flat boxes over a gradient, what a slide or a room looks like
+// after the detector's downscale. Each seed is a different scene.
+void DrawScene(webrtc::I420Buffer* buffer, uint32_t seed, int pan_x, int noise) {
+    const int width = buffer->width();
+    const int height = buffer->height();
+
+    struct Box { int x, y, w, h; uint8_t luma; };
+    std::vector<Box> boxes;
+    uint32_t s = seed * 2654435761u + 1;
+    auto next = [&s]() { s = s * 1664525 + 1013904223; return s >> 8; };
+    const int gradient = (int)(next() % 128);
+    for (int i = 0; i < 5; ++i) {
+        Box box;
+        box.w = width / 6 + (int)(next() % (width / 3));
+        box.h = height / 6 + (int)(next() % (height / 3));
+        box.x = (int)(next() % (width - box.w));
+        box.y = (int)(next() % (height - box.h));
+        box.luma = (uint8_t)(next() % 256);
+        boxes.push_back(box);
+    }
+
+    uint32_t n = seed;
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = buffer->MutableDataY() + y * buffer->StrideY();
+        for (int x = 0; x < width; ++x) {
+            int sx = (x + pan_x) % width;
+            int luma = gradient + sx * 96 / width;
+            for (const Box& box : boxes) {
+                if (sx >= box.x && sx < box.x + box.w && y >= box.y && y < box.y + box.h) {
+                    luma = box.luma;
+                }
+            }
+            if (noise > 0) {
+                n = n * 1664525 + 1013904223;
+                luma += (int)(n >> 24) % (2 * noise + 1) - noise;
+            }
+            row[x] = (uint8_t)(luma < 0 ? 0 : (luma > 255 ? 255 : luma));
+        }
+    }
+    memset(buffer->MutableDataU(), 128, buffer->StrideU() * buffer->ChromaHeight());
+    memset(buffer->MutableDataV(), 128, buffer->StrideV() * buffer->ChromaHeight());
+}
+
+struct Clip {
+    std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> frames;
+    std::vector<bool> cuts;
+};
+
+// camera: panning, sensor noise, a cut every 45 frames.
+// screen: static slides, a small blinking caret, a flip every 90 frames.
+Clip CreateClip(int width, int height, bool screen, int frames) {
+    Clip clip;
+    const int scene_length = screen ? 90 : 45;
+    for (int i = 0; i < frames; ++i) {
+        rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create(width, height);
+        int scene = i / scene_length;
+        DrawScene(buffer.get(), scene + 1, screen ? 0 : i * 4, screen ? 0 : 4);
+        if (screen && (i / 15) % 2) {
+            for (int y = height / 2; y < height / 2 + 16; ++y) {
+                memset(buffer->MutableDataY() + y * buffer->StrideY() + width / 2, 0, 2);
+            }
+        }
+        clip.frames.push_back(buffer);
+        clip.cuts.push_back(i > 0 && i % scene_length == 0);
+    }
+    return clip;
+}
+
+void BM_SceneChangeAccuracy(benchmark::State& state) {
+    const bool screen = state.range(0) != 0;
+    Clip clip = CreateClip(640, 360, screen, 450);
+
+    int detected = 0;
+    int missed = 0;
+    int false_cuts = 0;
+    for (auto _ : state) {
+        SceneChangeDetector detector;
+        detected = missed = false_cuts = 0;
+        for (size_t i = 0; i < clip.frames.size(); ++i) {
+            bool cut = detector.Detect(*clip.frames[i], (int64_t)i * 33);
+            if (cut && clip.cuts[i]) {
+                detected++;
+            }
+            else if (cut) {
+                false_cuts++;
+            }
+            else if (clip.cuts[i]) {
+                missed++;
+            }
+        }
+    }
+
+    if (missed > 0 || false_cuts > 0) {
+        state.SkipWithError("scene cuts missed or misplaced");
+    }
+    state.counters["detected"] = detected;
+    state.counters["missed"] = missed;
+    state.counters["false_cuts"] = false_cuts;
+}
+
+// Per frame cost on the capture thread.
+void BM_SceneChangeDetect(benchmark::State& state) {
+    const int width = (int)state.range(0);
+    const int height = (int)state.range(1);
+    rtc::scoped_refptr<webrtc::I420Buffer> frames[2] = {
+        CreateI420(width, height, 1), CreateI420(width, height, 2) };
+
+    SceneChangeDetector detector;
+    int64_t timestamp_ms = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(detector.Detect(*frames[timestamp_ms & 1], timestamp_ms));
+        timestamp_ms++;
+    }
+
+    SetFrameCounters(state, (int64_t)width * height);
+}
+
+} // namespace
+
+BENCHMARK(BM_SceneChangeAccuracy)->ArgName("screen")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SceneChangeDetect)->Apply(VideoResolutions)->Unit(benchmark::kMicrosecond);
+
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,253 @@
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <api/video_codecs/video_encoder.h>
+#include <media/base/codec.h>
+#include <media/base/media_constants.h>
+#include <modules/video_coding/codecs/h264/include/h264.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include "benchmark_util.h"
+#include "krtc/codec/shared_video_encoder.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// Counts what the shared encoder is asked to do.
+class CountingEncoder : public webrtc::VideoEncoder {
+public:
+    int32_t InitEncode(const webrtc::VideoCodec* codec_settings, int32_t number_of_cores,
+        size_t max_payload_size) override
+    {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override {
+        callback_ = callback;
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+
+    void SetRates(const RateControlParameters& parameters) override {
+        target_bps = parameters.bitrate.get_sum_bps();
+    }
+
+    int32_t Encode(const webrtc::VideoFrame& frame,
+        const std::vector<webrtc::VideoFrameType>* frame_types) override
+    {
+        bool key = frame_types && !frame_types->empty() &&
+            (*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey;
+        frames++;
+        key_frames += key ? 1 : 0;
+
+        webrtc::EncodedImage encoded_image;
+        encoded_image.SetTimestamp(frame.timestamp());
+        encoded_image._frameType = key ? webrtc::VideoFrameType::kVideoFrameKey
+            : webrtc::VideoFrameType::kVideoFrameDelta;
+        webrtc::CodecSpecificInfo codec_specific;
+        codec_specific.codecType = webrtc::kVideoCodecH264;
+        callback_->OnEncodedImage(encoded_image, &codec_specific);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    EncoderInfo GetEncoderInfo() const override { return EncoderInfo(); }
+
+    int frames = 0;
+    int key_frames = 0;
+    uint32_t target_bps = 0;
+
+private:
+    webrtc::EncodedImageCallback* callback_ = nullptr;
+};
+
+// One PeerConnection's VideoStreamEncoder: stamps rtp from the render time
+// plus its own ntp offset and checks what comes back carries it.
+class Destination : public webrtc::EncodedImageCallback {
+public:
+    Destination(std::unique_ptr<webrtc::VideoEncoder> encoder, int64_t ntp_offset_ms) :
+        encoder_(std::move(encoder)), ntp_offset_ms_(ntp_offset_ms)
+    {
+        encoder_->RegisterEncodeCompleteCallback(this);
+    }
+
+    ~Destination() override { encoder_->Release(); }
+
+    webrtc::VideoEncoder* encoder() { return encoder_.get(); }
+
+    int32_t Encode(webrtc::VideoFrame frame, bool key_frame) {
+        frame.set_timestamp(RtpTimestamp(frame.render_time_ms()));
+        std::vector<webrtc::VideoFrameType> frame_types(1, key_frame ?
+            webrtc::VideoFrameType::kVideoFrameKey : webrtc::VideoFrameType::kVideoFrameDelta);
+        return encoder_->Encode(frame, &frame_types);
+    }
+
+    uint32_t RtpTimestamp(int64_t render_time_ms) const {
+        return (uint32_t)((render_time_ms + ntp_offset_ms_) * 90);
+    }
+
+    Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+        const webrtc::CodecSpecificInfo* codec_specific_info) override
+    {
+        timestamps.push_back(encoded_image.Timestamp());
+        return Result(Result::OK);
+    }
+
+    std::vector<uint32_t> timestamps;
+
+private:
+    std::unique_ptr<webrtc::VideoEncoder> encoder_;
+    int64_t ntp_offset_ms_;
+};
+
+webrtc::VideoCodec CreateCodec(int width, int height) {
+    webrtc::VideoCodec codec;
+    codec.codecType = webrtc::kVideoCodecH264;
+    codec.width = width;
+    codec.height = height;
+    codec.maxFramerate = 30;
+    codec.startBitrate = 2000;
+    codec.maxBitrate = 4000;
+    codec.numberOfSimulcastStreams = 0;
+    return codec;
+}
+
+webrtc::VideoEncoder::RateControlParameters CreateRates(uint32_t bps) {
+    webrtc::VideoBitrateAllocation allocation;
+    allocation.SetBitrate(0, 0, bps);
+    return webrtc::VideoEncoder::RateControlParameters(allocation, 30.0);
+}
+
+// Arbitration with a counting encoder: three destinations at 2 Mbps,
+// 800 kbps and paused run the encoder at 800 kbps, a key frame request from
+// all three in the same frame is one idr, every destination gets every frame
+// once under its own rtp timestamps. Frame 0 is encoded before the second and
+// third destination first hand a frame in, they start at frame 1 with an
+// idr of their own.
+void BM_SharedEncoderArbitration(benchmark::State& state) {
+    const int kDestinations = 3;
+    const int kFrames = 90;
+    webrtc::VideoCodec codec = CreateCodec(320, 180);
+    rtc::scoped_refptr<webrtc::I420Buffer> buffer = CreateI420(codec.width, codec.height);
+
+    for (auto _ : state) {
+        CountingEncoder* counting = nullptr;
+        auto group = std::make_shared<SharedEncoderGroup>([&counting]() {
+            auto encoder = std::unique_ptr<CountingEncoder>(new CountingEncoder());
+            counting = encoder.get();
+            return std::unique_ptr<webrtc::VideoEncoder>(std::move(encoder));
+        });
+
+        std::vector<std::unique_ptr<Destination>> destinations;
+        const uint32_t rates[kDestinations] = { 2000000, 800000, 0 };
+        for (int i = 0; i < kDestinations; ++i) {
+            destinations.emplace_back(new Destination(group->CreateOutput(), i * 7));
+            destinations[i]->encoder()->InitEncode(&codec, 1, 1200);
+            destinations[i]->encoder()->SetRates(CreateRates(rates[i]));
+        }
+        if (!counting || counting->target_bps != 800000) {
+            state.SkipWithError("encoder not at the lowest active target");
+            return;
+        }
+
+        for (int f = 0; f < kFrames; ++f) {
+            webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                .set_video_frame_buffer(buffer)
+                .set_timestamp_us((1000 + f * 33) * 1000)
+                .build();
+            // Everybody wants an idr to start with and after a loss at 45.
+            bool key_frame = f == 0 || f == 45;
+            for (auto& destination : destinations) {
+                destination->Encode(frame, key_frame);
+            }
+        }
+
+        if (counting->frames != kFrames || counting->key_frames != 3) {
+            state.SkipWithError("frames or key frames encoded more than once");
+            return;
+        }
+        for (int i = 0; i < kDestinations; ++i) {
+            const Destination& destination = *destinations[i];
+            int first = i == 0 ? 0 : 1;
+            if ((int)destination.timestamps.size() != kFrames - first) {
+                state.SkipWithError("destination missed frames");
+                return;
+            }
+            for (int f = first; f < kFrames; ++f) {
+                if (destination.timestamps[f - first] != destination.RtpTimestamp(1000 + f * 33)) {
+                    state.SkipWithError("rtp timestamp not in the destination's clock");
+                    return;
+                }
+            }
+        }
+
+        SharedEncoderGroup::Stats stats = group->stats();
+        state.counters["encoded"] = (double)stats.encoded;
+        state.counters["deduplicated"] = (double)stats.deduplicated;
+        state.counters["key_frame_requests"] = (double)stats.key_frame_requests;
+    }
+}
+
+// The same camera to N destinations through OpenH264, one encoder each
+// against one shared encoder. Per source frame, so the cpu cost per frame
+// should stay flat with N when shared.
+void BM_MultiDestinationEncode(benchmark::State& state) {
+    const int destination_count = (int)state.range(2);
+    const bool shared = state.range(3) != 0;
+    webrtc::VideoCodec codec = CreateCodec((int)state.range(0), (int)state.range(1));
+    rtc::scoped_refptr<webrtc::I420Buffer> buffer = CreateI420(codec.width, codec.height);
+
+    cricket::VideoCodec h264(cricket::kH264CodecName);
+    auto group = std::make_shared<SharedEncoderGroup>([h264]() {
+        return std::unique_ptr<webrtc::VideoEncoder>(webrtc::H264Encoder::Create(h264));
+    });
+
+    std::vector<std::unique_ptr<Destination>> destinations;
+    for (int i = 0; i < destination_count; ++i) {
+        std::unique_ptr<webrtc::VideoEncoder> encoder = shared ? group->CreateOutput()
+            : std::unique_ptr<webrtc::VideoEncoder>(webrtc::H264Encoder::Create(h264));
+        destinations.emplace_back(new Destination(std::move(encoder), i * 7));
+        if (destinations[i]->encoder()->InitEncode(&codec, 1, 1200) != WEBRTC_VIDEO_CODEC_OK) {
+            state.SkipWithError("openh264 init failed");
+            return;
+        }
+        destinations[i]->encoder()->SetRates(CreateRates(2000000));
+    }
+
+    int64_t render_time_ms = 1000;
+    int64_t frames = 0;
+    for (auto _ : state) {
+        webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+            .set_video_frame_buffer(buffer)
+            .set_timestamp_us(render_time_ms * 1000)
+            .build();
+        render_time_ms += 33;
+        for (auto& destination : destinations) {
+            destination->Encode(frame, frames == 0);
+            if (destination->timestamps.size() > 1024) {
+                destination->timestamps.clear();
+            }
+        }
+        frames++;
+    }
+
+    state.counters["encodes_per_frame"] = shared ?
+        (double)group->stats().encoded / (double)frames : (double)destination_count;
+    SetFrameCounters(state, (int64_t)buffer->width() * buffer->height() * 3 / 2);
+}
+
+BENCHMARK(BM_SharedEncoderArbitration)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MultiDestinationEncode)
+    ->ArgNames({ "width", "height", "destinations", "shared" })
+    ->ArgsProduct({ { 1280 }, { 720 }, { 1, 2, 4 }, { 0, 1 } })
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "krtc/tools/timer.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// Before: every timer a thread sleeping on its own condition variable, the
+// way CTimer ran one per pusher.
+void BM_ThreadPerTimer(benchmark::State& state) {
+    int timers = (int)state.range(0);
+
+    for (auto _ : state) {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool exit = false;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < timers; ++i) {
+            threads.emplace_back([&]() {
+                std::unique_lock<std::mutex> locker(mutex);
+                while (!exit) {
+                    cond.wait_for(locker, std::chrono::milliseconds(1000));
+                }
+            });
+        }
+        {
+            std::lock_guard<std::mutex> locker(mutex);
+            exit = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    state.counters["threads"] = timers;
+    state.SetItemsProcessed(state.iterations() * timers);
+}
+
+// Starting and stopping the same timers on the shared service.
+void BM_TimerServiceSchedule(benchmark::State& state) {
+    int timers = (int)state.range(0);
+    std::vector<TimerService::TimerId> ids(timers);
+
+    for (auto _ : state) {
+        for (int i = 0; i < timers; ++i) {
+            ids[i] = TimerService::Instance()->Schedule(1000, true, []() {});
+        }
+        for (int i = 0; i < timers; ++i) {
+            TimerService::Instance()->Cancel(ids[i]);
+        }
+    }
+
+    state.counters["threads"] = 1;
+    state.SetItemsProcessed(state.iterations() * timers);
+}
+
+// timers 20 ms timers for 200 ms: with the periods aligned the service
+// wakes up once per period for all of them.
+void BM_TimerServiceCoalescing(benchmark::State& state) {
+    int timers = (int)state.range(0);
+    const unsigned int kPeriodMs = 20;
+    std::atomic<int> runs{ 0 };
+
+    TimerService::Stats before = TimerService::Instance()->stats();
+    for (auto _ : state) {
+        std::vector<TimerService::TimerId> ids;
+        for (int i = 0; i < timers; ++i) {
+            ids.push_back(TimerService::Instance()->Schedule(kPeriodMs, true, [&runs]() { ++runs; }));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10 * kPeriodMs));
+        for (TimerService::TimerId id : ids) {
+            TimerService::Instance()->Cancel(id);
+        }
+    }
+    TimerService::Stats after = TimerService::Instance()->stats();
+
+    state.counters["runs"] = (double)runs.load() / state.iterations();
+    state.counters["wakeups"] = (double)(after.wakeups - before.wakeups) / state.iterations();
+}
+
+BENCHMARK(BM_ThreadPerTimer)
+    ->ArgNames({ "timers" })
+    ->Arg(8)->Arg(64)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_TimerServiceSchedule)
+    ->ArgNames({ "timers" })
+    ->Arg(8)->Arg(64)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(BM_TimerServiceCoalescing)
+    ->ArgNames({ "timers" })
+    ->Arg(8)->Arg(64)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->Iterations(5);
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+
+#include "benchmark_util.h"
+#include "krtc/render/video_compositor.h"
+
+namespace krtc {
+namespace bench {
+namespace {
+
+// What the app does per stream without a gallery: a callback with the full
+// decoded frame and a texture upload of all of it, modelled as one copy.
+void BM_GalleryPerStreamUpload(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    rtc::scoped_refptr<webrtc::I420Buffer> frame = CreateI420(1280, 720);
+    size_t frame_size = (size_t)1280 * 720 * 3 / 2;
+    std::vector<uint8_t> texture(frame_size);
+
+    for (auto _ : state) {
+        for (int i = 0; i < streams; ++i) {
+            memcpy(texture.data(), frame->DataY(), (size_t)1280 * 720);
+            memcpy(texture.data() + 1280 * 720, frame->DataU(), (size_t)640 * 360);
+            memcpy(texture.data() + 1280 * 720 + 640 * 360, frame->DataV(), (size_t)640 * 360);
+            benchmark::DoNotOptimize(texture.data());
+            benchmark::ClobberMemory();
+        }
+    }
+
+    state.counters["upload_bytes"] = (double)frame_size * streams;
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Every stream new in every canvas, the worst case. The app uploads one
+// canvas however many streams there are.
+void BM_GalleryCompose(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    int width = (int)state.range(1);
+    int height = (int)state.range(2);
+
+    VideoCompositor compositor(width, height);
+    std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> frames;
+    for (int i = 0; i < streams; ++i) {
+        compositor.AddStream(i);
+        frames.push_back(CreateI420(1280, 720, i + 1));
+    }
+
+    for (auto _ : state) {
+        for (int i = 0; i < streams; ++i) {
+            compositor.UpdateFrame(i, frames[i]);
+        }
+        rtc::scoped_refptr<webrtc::I420Buffer> canvas = compositor.Compose();
+        benchmark::DoNotOptimize(canvas.get());
+    }
+
+    state.counters["upload_bytes"] = (double)width * height * 3 / 2;
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Server side mixing: 720p streams into a 1080p canvas with a watermark, the
+// tiles spread over threads. mixes_per_core is how many such 1080p30
+// mixes one core keeps up with, from the wall time of the composes.
+void BM_CompositorMix(benchmark::State& state) {
+    int streams = (int)state.range(0);
+    int threads = (int)state.range(1);
+    const int kWidth = 1920;
+    const int kHeight = 1080;
+    const int kFps = 30;
+
+    VideoCompositor compositor(kWidth, kHeight, threads);
+    std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> frames;
+    for (int i = 0; i < streams; ++i) {
+        compositor.AddStream(i);
+        frames.push_back(CreateI420(1280, 720, i + 1));
+    }
+
+    // A 320x90 half transparent caption in the bottom right corner.
+    std::vector<uint8_t> watermark(320 * 90 * 4);
+    FillPlane(watermark.data(), 320 * 4, 320 * 4, 90, 7);
+    for (size_t i = 3; i < watermark.size(); i += 4) {
+        watermark[i] = 128;
+    }
+    compositor.SetOverlay(watermark.data(), 320 * 4, 320, 90, kWidth - 340, kHeight - 110);
+
+    double wall_s = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < streams; ++i) {
+            compositor.UpdateFrame(i, frames[i]);
+        }
+        rtc::scoped_refptr<webrtc::I420Buffer> canvas = compositor.Compose();
+        benchmark::DoNotOptimize(canvas.get());
+        wall_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double fps = wall_s > 0 ? state.iterations() / wall_s : 0;
+    state.counters["fps"] = fps;
+    state.counters["mixes_per_core"] = fps / kFps / threads;
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_GalleryPerStreamUpload)
+    ->ArgNames({ "streams" })
+    ->Arg(4)->Arg(9)->Arg(16)->Arg(25)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GalleryCompose)
+    ->ArgNames({ "streams", "width", "height" })
+    ->ArgsProduct({ { 4, 9, 16, 25 }, { 1920 }, { 1080 } })
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CompositorMix)
+    ->ArgNames({ "streams", "threads" })
+    ->ArgsProduct({ { 9, 16 }, { 1, 2, 4 } })
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace bench
+} // namespace krtc
@@ -0,0 +1,356 @@
+#include "local_media_relay.h"
+
+#include <vector>
+
+#include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <api/audio_codecs/builtin_audio_encoder_factory.h>
+#include <api/create_peerconnection_factory.h>
+#include <api/video_codecs/builtin_video_decoder_factory.h>
+#include <api/video_codecs/builtin_video_encoder_factory.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+
+#include "krtc/media/default.h"
+
+namespace krtc {
+
+namespace {
+
+// SRS answers with candidates embedded, so wait for gathering before replying,
+// but never longer than this.
+const uint32_t kIceGatheringTimeoutMs = 1000;
+
+const int kCodeOk = 0;
+const int kCodeStreamNotFound = 404;
+const int kCodeNegotiateFailed = 500;
+
+} // namespace
+
+class LocalMediaRelay::Session : public webrtc::PeerConnectionObserver,
+                                 public webrtc::CreateSessionDescriptionObserver
+{
+public:
+    Session(LocalMediaRelay* relay, bool publish, const std::string& key,
+        AnswerCallback callback) :
+        relay_(relay),
+        publish_(publish),
+        key_(key),
+        callback_(callback) {}
+
+    bool Init(webrtc::PeerConnectionFactoryInterface* factory,
+        const std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>>& forward_tracks)
+    {
+        webrtc::PeerConnectionInterface::RTCConfiguration config;
+        config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+        config.enable_dtls_srtp = true;
+
+        peer_connection_ = factory->CreatePeerConnection(config, nullptr, nullptr, this);
+        if (!peer_connection_) {
+            return false;
+        }
+
+        // Tracks added before the remote offer is applied are bound to the
+        // offer's recvonly m-lines, which turns them into sendonly in the answer.
+        for (auto& track : forward_tracks) {
+            auto result = peer_connection_->AddTrack(track, { "relay" });
+            if (!result.ok()) {
+                RTC_LOG(LS_WARNING) << "relay add track failed: " << result.error().message();
+            }
+        }
+        return true;
+    }
+
+    void Negotiate(const std::string& sdp_offer) {
+        webrtc::SdpParseError error;
+        std::unique_ptr<webrtc::SessionDescriptionInterface> offer =
+            webrtc::CreateSessionDescription(webrtc::SdpType::kOffer, sdp_offer, &error);
+        if (!offer) {
+            RTC_LOG(LS_WARNING) << "relay parse offer failed: " << error.description;
+            Answer(kCodeNegotiateFailed);
+            return;
+        }
+
+        peer_connection_->SetRemoteDescription(
+            DummySetSessionDescriptionObserver::Create(), offer.release());
+        peer_connection_->CreateAnswer(
+            this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    }
+
+    void Close() {
+        if (peer_connection_) {
+            peer_connection_->Close();
+            peer_connection_ = nullptr;
+        }
+        tracks_.clear();
+    }
+
+    bool publish() const { return publish_; }
+    const std::string& key() const { return key_; }
+
+    const std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>>& tracks() const {
+        return tracks_;
+    }
+
+private:
+    // PeerConnectionObserver implementation.
+    void OnSignalingChange(
+        webrtc::PeerConnectionInterface::SignalingState new_state) override {}
+
+    void OnDataChannel(
+        rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
+
+    void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override {}
+
+    void OnTrack(rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) override {
+        if (publish_) {
+            tracks_.push_back(transceiver->receiver()->track());
+        }
+    }
+
+    void OnIceGatheringChange(
+        webrtc::PeerConnectionInterface::IceGatheringState new_state) override
+    {
+        if (new_state == webrtc::PeerConnectionInterface::kIceGatheringComplete) {
+            Answer(kCodeOk);
+        }
+    }
+
+    void OnConnectionChange(
+        webrtc::PeerConnectionInterface::PeerConnectionState new_state) override
+    {
+        if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kFailed ||
+            new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kClosed)
+        {
+            RTC_LOG(LS_INFO) << "relay session closed, stream: " << key_;
+            relay_->RemoveSession(this);
+        }
+    }
+
+    // CreateSessionDescriptionObserver implementation.
+    void OnSuccess(webrtc::SessionDescriptionInterface* desc) override {
+        peer_connection_->SetLocalDescription(
+            DummySetSessionDescriptionObserver::Create(), desc);
+
+        rtc::scoped_refptr<Session> self(this);
+        rtc::Thread::Current()->PostDelayedTask(webrtc::ToQueuedTask([self]() {
+            self->Answer(kCodeOk);
+        }), kIceGatheringTimeoutMs);
+    }
+
+    void OnFailure(webrtc::RTCError error) override {
+        RTC_LOG(LS_WARNING) << "relay create answer failed: " << error.message();
+        Answer(kCodeNegotiateFailed);
+    }
+
+    void Answer(int code) {
+        if (answered_) {
+            return;
+        }
+        answered_ = true;
+
+        std::string sdp;
+        if (code == kCodeOk) {
+            const webrtc::SessionDescriptionInterface* local =
+                peer_connection_ ? peer_connection_->local_description() : nullptr;
+            if (!local || !local->ToString(&sdp)) {
+                code = kCodeNegotiateFailed;
+            }
+        }
+
+        if (callback_) {
+            callback_(code, sdp);
+            callback_ = nullptr;
+        }
+
+        if (code != kCodeOk) {
+            relay_->RemoveSession(this);
+        }
+    }
+
+private:
+    LocalMediaRelay* relay_;
+    bool publish_;
+    std::string key_;
+    AnswerCallback callback_;
+    bool answered_ = false;
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+    std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>> tracks_;
+};
+
+LocalMediaRelay::LocalMediaRelay() :
+    signaling_thread_(rtc::Thread::Create()),
+    worker_thread_(rtc::Thread::Create()),
+    network_thread_(rtc::Thread::CreateWithSocketServer())
+{
+    signaling_thread_->SetName("relay_signaling_thread", nullptr);
+    worker_thread_->SetName("relay_worker_thread", nullptr);
+    network_thread_->SetName("relay_network_thread", nullptr);
+}
+
+LocalMediaRelay::~LocalMediaRelay() {
+    Stop();
+}
+
+bool LocalMediaRelay::Start() {
+    if (peer_connection_factory_) {
+        return true;
+    }
+
+    signaling_thread_->Start();
+    worker_thread_->Start();
+    network_thread_->Start();
+
+    peer_connection_factory_ = webrtc::CreatePeerConnectionFactory(
+        network_thread_.get() /* network_thread */,
+        worker_thread_.get() /* worker_thread */,
+        signaling_thread_.get() /* signaling_thread */,
+        nullptr /* default_adm */,
+        webrtc::CreateBuiltinAudioEncoderFactory(),
+        webrtc::CreateBuiltinAudioDecoderFactory(),
+        webrtc::CreateBuiltinVideoEncoderFactory(),
+        webrtc::CreateBuiltinVideoDecoderFactory(), nullptr /* audio_mixer */,
+        nullptr /* audio_processing */);
+    if (!peer_connection_factory_) {
+        RTC_LOG(LS_ERROR) << "relay create peer connection factory failed";
+        return false;
+    }
+
+    // Both ends usually live on the same host, keep loopback candidates.
+    webrtc::PeerConnectionFactoryInterface::Options options;
+    options.network_ignore_mask = 0;
+    peer_connection_factory_->SetOptions(options);
+
+    std::lock_guard<std::mutex> lock(running_mutex_);
+    running_ = true;
+    return true;
+}
+
+void LocalMediaRelay::Stop() {
+    if (!peer_connection_factory_) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(running_mutex_);
+        running_ = false;
+    }
+
+    signaling_thread_->Invoke<void>(RTC_FROM_HERE, [this]() {
+        for (auto& iter : publishers_) {
+            iter.second->Close();
+        }
+        for (auto& iter : players_) {
+            iter.second->Close();
+        }
+        publishers_.clear();
+        players_.clear();
+        peer_connection_factory_ = nullptr;
+    });
+
+    signaling_thread_->Stop();
+    worker_thread_->Stop();
+    network_thread_->Stop();
+}
+
+void LocalMediaRelay::Publish(const std::string& stream_url,
+    const std::string& sdp_offer, AnswerCallback callback)
+{
+    CreateSession(true, stream_url, sdp_offer, callback);
+}
+
+void LocalMediaRelay::Play(const std::string& stream_url,
+    const std::string& sdp_offer, AnswerCallback callback)
+{
+    CreateSession(false, stream_url, sdp_offer, callback);
+}
+
+std::string LocalMediaRelay::StreamKey(const std::string& stream_url) {
+    // "webrtc://1.14.148.67/55555/1c2582f" -> "/55555/1c2582f"
+    std::string::size_type pos = stream_url.find("://");
+    pos = (pos == std::string::npos) ? 0 : pos + 3;
+    pos = stream_url.find('/', pos);
+    return pos == std::string::npos ? stream_url : stream_url.substr(pos);
+}
+
+void LocalMediaRelay::CreateSession(bool publish, const std::string& stream_url,
+    const std::string& sdp_offer, AnswerCallback callback)
+{
+    std::string key = StreamKey(stream_url);
+    std::unique_lock<std::mutex> lock(running_mutex_);
+    if (!running_) {
+        lock.unlock();
+        callback(kCodeNegotiateFailed, "");
+        return;
+    }
+
+    // Tasks posted before Stop() run ahead of its teardown, the factory is
+    // only read there.
+    signaling_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        if (!peer_connection_factory_) {
+            callback(kCodeNegotiateFailed, "");
+            return;
+        }
+
+        std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>> forward_tracks;
+        if (!publish) {
+            auto iter = publishers_.find(key);
+            if (iter == publishers_.end() || iter->second->tracks().empty()) {
+                RTC_LOG(LS_WARNING) << "relay play stream not found: " << key;
+                callback(kCodeStreamNotFound, "");
+                return;
+            }
+            forward_tracks = iter->second->tracks();
+        }
+
+        rtc::scoped_refptr<Session> session(
+            new rtc::RefCountedObject<Session>(this, publish, key, callback));
+        if (!session->Init(peer_connection_factory_.get(), forward_tracks)) {
+            callback(kCodeNegotiateFailed, "");
+            return;
+        }
+
+        if (publish) {
+            auto iter = publishers_.find(key);
+            if (iter != publishers_.end()) {
+                RTC_LOG(LS_INFO) << "relay republish stream: " << key;
+                iter->second->Close();
+            }
+            publishers_[key] = session;
+        }
+        else {
+            players_[session.get()] = session;
+        }
+
+        session->Negotiate(sdp_offer);
+    }));
+}
+
+void LocalMediaRelay::RemoveSession(Session* session) {
+    // Called from the session's own callbacks, release it on a later task.
+    rtc::scoped_refptr<Session> self(session);
+    signaling_thread_->PostTask(webrtc::ToQueuedTask([this, self]() {
+        Session* session = self.get();
+        rtc::scoped_refptr<Session> removed;
+        if (session->publish()) {
+            auto iter = publishers_.find(session->key());
+            if (iter != publishers_.end() && iter->second.get() == session) {
+                removed = iter->second;
+                publishers_.erase(iter);
+            }
+        }
+        else {
+            auto iter = players_.find(session);
+            if (iter != players_.end()) {
+                removed = iter->second;
+                players_.erase(iter);
+            }
+        }
+
+        if (removed) {
+            removed->Close();
+        }
+    }));
+}
+
+} // namespace krtc
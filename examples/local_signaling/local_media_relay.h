@@ -0,0 +1,61 @@
+#ifndef KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_MEDIA_RELAY_H_
+#define KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_MEDIA_RELAY_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <functional>
+
+#include <rtc_base/thread.h>
+#include <api/peer_connection_interface.h>
+
+namespace krtc {
+
+// Answers the SRS /rtc/v1/publish/ and /rtc/v1/play/ SDP offers with local
+// PeerConnections and forwards every published track to the players of the
+// same stream, so a push/pull session can run without a real SRS.
+class LocalMediaRelay {
+public:
+    // code 0 means success, same as the SRS http api.
+    typedef std::function<void(int code, const std::string& sdp)> AnswerCallback;
+
+    LocalMediaRelay();
+    ~LocalMediaRelay();
+
+    bool Start();
+    void Stop();
+
+    // stream_url: "webrtc://host/room/uid"
+    void Publish(const std::string& stream_url, const std::string& sdp_offer,
+        AnswerCallback callback);
+    void Play(const std::string& stream_url, const std::string& sdp_offer,
+        AnswerCallback callback);
+
+    class Session;
+
+private:
+    static std::string StreamKey(const std::string& stream_url);
+
+    void CreateSession(bool publish, const std::string& stream_url,
+        const std::string& sdp_offer, AnswerCallback callback);
+    void RemoveSession(Session* session);
+
+    std::unique_ptr<rtc::Thread> signaling_thread_;
+    std::unique_ptr<rtc::Thread> worker_thread_;
+    std::unique_ptr<rtc::Thread> network_thread_;
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> peer_connection_factory_;
+
+    // Sessions are created from the lws service thread, no task is posted
+    // to signaling_thread_ once Stop() cleared this.
+    std::mutex running_mutex_;
+    bool running_ = false;
+
+    // Accessed on signaling_thread_ only.
+    std::map<std::string, rtc::scoped_refptr<Session>> publishers_;
+    std::map<Session*, rtc::scoped_refptr<Session>> players_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_MEDIA_RELAY_H_
@@ -0,0 +1,535 @@
+#include "local_signaling_server.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include <rtc_base/strings/json.h>
+#include <rtc_base/logging.h>
+
+namespace krtc {
+
+namespace {
+
+const char* kPublishUri = "/rtc/v1/publish/";
+const char* kPlayUri = "/rtc/v1/play/";
+
+// Same limit SRS applies to the sdp exchange body.
+const size_t kMaxHttpBodySize = 64 * 1024;
+
+std::string ToJsonString(const Json::Value& value) {
+    Json::StreamWriterBuilder write_builder;
+    write_builder.settings_["indentation"] = "";
+    return Json::writeString(write_builder, value);
+}
+
+LocalSignalingServer* GetServer(struct lws* wsi) {
+    return (LocalSignalingServer*)lws_context_user(lws_get_context(wsi));
+}
+
+int HttpCallback(struct lws* wsi, enum lws_callback_reasons reason,
+    void* user, void* in, size_t len)
+{
+    LocalSignalingServer* server = GetServer(wsi);
+    if (!server) {
+        return 0;
+    }
+    return server->OnHttpCallback(wsi, reason, in, len);
+}
+
+int WebsocketCallback(struct lws* wsi, enum lws_callback_reasons reason,
+    void* user, void* in, size_t len)
+{
+    LocalSignalingServer* server = GetServer(wsi);
+    if (!server) {
+        return 0;
+    }
+    return server->OnWebsocketCallback(wsi, reason, in, len);
+}
+
+struct lws_protocols http_protocols[] = {
+    { "http", HttpCallback, 0, 0, 0, NULL, 0 },
+    { NULL, NULL, 0, 0, 0, NULL, 0 }
+};
+
+// KRTCClient connects with protocol name "wss".
+struct lws_protocols ws_protocols[] = {
+    { "wss", WebsocketCallback, 0, 4096, 0, NULL, 0 },
+    { NULL, NULL, 0, 0, 0, NULL, 0 }
+};
+
+} // namespace
+
+LocalSignalingServer::LocalSignalingServer() :
+    options_(Options())
+{
+}
+
+LocalSignalingServer::LocalSignalingServer(const Options& options) :
+    options_(options)
+{
+}
+
+LocalSignalingServer::~LocalSignalingServer() {
+    Stop();
+}
+
+bool LocalSignalingServer::Start() {
+    if (lws_context_) {
+        return true;
+    }
+
+    if (!relay_.Start()) {
+        return false;
+    }
+
+    struct lws_context_creation_info context_info = {};
+    context_info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS |
+        LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+    context_info.user = this;
+    lws_context_ = lws_create_context(&context_info);
+    if (!lws_context_) {
+        RTC_LOG(LS_ERROR) << "local signaling create lws context failed";
+        relay_.Stop();
+        return false;
+    }
+
+    struct lws_context_creation_info vhost_info = {};
+    vhost_info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT |
+        LWS_SERVER_OPTION_VALIDATE_UTF8;
+    vhost_info.ssl_cert_filepath = options_.ssl_cert_path.c_str();
+    vhost_info.ssl_private_key_filepath = options_.ssl_private_key_path.c_str();
+
+    vhost_info.vhost_name = "http";
+    vhost_info.port = options_.http_port;
+    vhost_info.protocols = http_protocols;
+    struct lws_vhost* http_vhost = lws_create_vhost(lws_context_, &vhost_info);
+
+    vhost_info.vhost_name = "ws";
+    vhost_info.port = options_.ws_port;
+    vhost_info.protocols = ws_protocols;
+    struct lws_vhost* ws_vhost = lws_create_vhost(lws_context_, &vhost_info);
+
+    if (!http_vhost || !ws_vhost) {
+        RTC_LOG(LS_ERROR) << "local signaling listen failed, http port: "
+            << options_.http_port << ", ws port: " << options_.ws_port;
+        lws_context_destroy(lws_context_);
+        lws_context_ = nullptr;
+        relay_.Stop();
+        return false;
+    }
+
+    RTC_LOG(LS_INFO) << "local signaling listen on http port: " << options_.http_port
+        << ", ws port: " << options_.ws_port;
+
+    interrupted_ = false;
+    service_thread_ = std::make_unique<std::thread>([this]() {
+        int n = 0;
+        while (n >= 0 && !interrupted_) {
+            n = lws_service(lws_context_, 1000);
+        }
+    });
+
+    return true;
+}
+
+void LocalSignalingServer::Stop() {
+    interrupted_ = true;
+
+    if (lws_context_) {
+        lws_cancel_service(lws_context_);
+    }
+
+    if (service_thread_ && service_thread_->joinable()) {
+        service_thread_->join();
+        service_thread_ = nullptr;
+    }
+
+    // Pending answers must not land on a destroyed context.
+    relay_.Stop();
+
+    if (lws_context_) {
+        lws_context_destroy(lws_context_);
+        lws_context_ = nullptr;
+    }
+
+    http_sessions_.clear();
+    http_session_ids_.clear();
+    peers_.clear();
+}
+
+int LocalSignalingServer::OnHttpCallback(struct lws* wsi,
+    enum lws_callback_reasons reason, void* in, size_t len)
+{
+    switch (reason) {
+    case LWS_CALLBACK_HTTP: {
+        if (lws_hdr_total_length(wsi, WSI_TOKEN_POST_URI) <= 0) {
+            lws_return_http_status(wsi, HTTP_STATUS_METHOD_NOT_ALLOWED, NULL);
+            return -1;
+        }
+
+        uint64_t session_id = next_session_id_++;
+        HttpSession& session = http_sessions_[session_id];
+        session.wsi = wsi;
+        session.uri = (const char*)in;
+        http_session_ids_[wsi] = session_id;
+        return 0;
+    }
+
+    case LWS_CALLBACK_HTTP_BODY: {
+        auto iter = http_session_ids_.find(wsi);
+        if (iter == http_session_ids_.end()) {
+            return -1;
+        }
+        HttpSession& session = http_sessions_[iter->second];
+        if (session.body.size() + len > kMaxHttpBodySize) {
+            lws_return_http_status(wsi, HTTP_STATUS_REQ_ENTITY_TOO_LARGE, NULL);
+            return -1;
+        }
+        session.body.append((const char*)in, len);
+        return 0;
+    }
+
+    case LWS_CALLBACK_HTTP_BODY_COMPLETION: {
+        auto iter = http_session_ids_.find(wsi);
+        if (iter == http_session_ids_.end()) {
+            return -1;
+        }
+        HttpSession& session = http_sessions_[iter->second];
+        HandleHttpRequest(iter->second, session.uri, session.body);
+        return 0;
+    }
+
+    case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+        FlushCompletedHttpRequests();
+        return 0;
+
+    case LWS_CALLBACK_HTTP_WRITEABLE:
+        return WriteHttpResponse(wsi);
+
+    case LWS_CALLBACK_CLOSED_HTTP: {
+        auto iter = http_session_ids_.find(wsi);
+        if (iter != http_session_ids_.end()) {
+            http_sessions_.erase(iter->second);
+            http_session_ids_.erase(iter);
+        }
+        return 0;
+    }
+
+    default:
+        break;
+    }
+
+    return lws_callback_http_dummy(wsi, reason, nullptr, in, len);
+}
+
+void LocalSignalingServer::HandleHttpRequest(uint64_t session_id,
+    const std::string& uri, const std::string& body)
+{
+    // {"api":"https://ip:1986/rtc/v1/publish/","streamurl":"webrtc://ip/room/uid","sdp":"v=0...","tid":"..."}
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    JSONCPP_STRING err;
+    if (!reader->parse(body.data(), body.data() + body.size(), &root, &err) ||
+        !root.isObject() || !root["streamurl"].isString() || !root["sdp"].isString())
+    {
+        RTC_LOG(LS_WARNING) << "local signaling invalid request: " << uri << ", " << err;
+        CompleteHttpRequest(session_id, 400, "");
+        return;
+    }
+
+    std::string stream_url = root["streamurl"].asString();
+    std::string sdp = root["sdp"].asString();
+    RTC_LOG(LS_INFO) << "local signaling request: " << uri << ", stream: " << stream_url;
+
+    auto callback = [this, session_id](int code, const std::string& answer) {
+        CompleteHttpRequest(session_id, code, answer);
+    };
+
+    if (uri == kPublishUri) {
+        relay_.Publish(stream_url, sdp, callback);
+    }
+    else if (uri == kPlayUri) {
+        relay_.Play(stream_url, sdp, callback);
+    }
+    else {
+        CompleteHttpRequest(session_id, 404, "");
+    }
+}
+
+void LocalSignalingServer::CompleteHttpRequest(uint64_t session_id, int code,
+    const std::string& sdp)
+{
+    // {"code":0,"server":"local","sdp":"v=0..."}
+    Json::Value response;
+    response["code"] = code;
+    response["server"] = "local";
+    response["sdp"] = sdp;
+
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex_);
+        completed_responses_[session_id] = ToJsonString(response);
+    }
+
+    // Runs on the relay or the service thread, wake lws_service() either way.
+    if (lws_context_) {
+        lws_cancel_service(lws_context_);
+    }
+}
+
+void LocalSignalingServer::FlushCompletedHttpRequests() {
+    std::map<uint64_t, std::string> completed;
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex_);
+        completed.swap(completed_responses_);
+    }
+
+    for (auto& iter : completed) {
+        auto session = http_sessions_.find(iter.first);
+        if (session == http_sessions_.end()) {
+            // Client went away before the answer was ready.
+            continue;
+        }
+        session->second.response = iter.second;
+        lws_callback_on_writable(session->second.wsi);
+    }
+}
+
+int LocalSignalingServer::WriteHttpResponse(struct lws* wsi) {
+    auto iter = http_session_ids_.find(wsi);
+    if (iter == http_session_ids_.end()) {
+        return -1;
+    }
+    HttpSession& session = http_sessions_[iter->second];
+    if (session.response.empty()) {
+        return 0;
+    }
+
+    if (!session.headers_sent) {
+        unsigned char headers[LWS_PRE + 512];
+        unsigned char* start = headers + LWS_PRE;
+        unsigned char* p = start;
+        unsigned char* end = headers + sizeof(headers) - 1;
+        if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK, "application/json",
+                session.response.size(), &p, end) ||
+            lws_add_http_header_by_name(wsi,
+                (const unsigned char*)"Access-Control-Allow-Origin:",
+                (const unsigned char*)"*", 1, &p, end) ||
+            lws_finalize_write_http_header(wsi, start, &p, end))
+        {
+            return -1;
+        }
+        session.headers_sent = true;
+        lws_callback_on_writable(wsi);
+        return 0;
+    }
+
+    std::vector<unsigned char> body(LWS_PRE + session.response.size());
+    memcpy(body.data() + LWS_PRE, session.response.data(), session.response.size());
+    if (lws_write(wsi, body.data() + LWS_PRE, session.response.size(),
+            LWS_WRITE_HTTP_FINAL) != (int)session.response.size())
+    {
+        return -1;
+    }
+
+    if (lws_http_transaction_completed(wsi)) {
+        return -1;
+    }
+    return 0;
+}
+
+int LocalSignalingServer::OnWebsocketCallback(struct lws* wsi,
+    enum lws_callback_reasons reason, void* in, size_t len)
+{
+    switch (reason) {
+    case LWS_CALLBACK_HTTP:
+        // Plain http on the websocket port.
+        lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+        return -1;
+
+    case LWS_CALLBACK_ESTABLISHED:
+        peers_[wsi] = Peer();
+        return 0;
+
+    case LWS_CALLBACK_RECEIVE: {
+        std::string message((const char*)in, len);
+        if (!lws_is_final_fragment(wsi) || lws_remaining_packet_payload(wsi) > 0) {
+            RTC_LOG(LS_WARNING) << "local signaling fragmented message dropped";
+            return 0;
+        }
+        HandleRoomMessage(wsi, message);
+        return 0;
+    }
+
+    case LWS_CALLBACK_SERVER_WRITEABLE:
+        return WriteWebsocketMessage(wsi);
+
+    case LWS_CALLBACK_CLOSED:
+        LeaveRoom(wsi);
+        peers_.erase(wsi);
+        return 0;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*
+* KRTCClient 发送:
+{"tid":"398d320","msg":{"action":"join","room":"5dd66a5","display":"50b8507"}}
+*/
+void LocalSignalingServer::HandleRoomMessage(struct lws* wsi, const std::string& message) {
+    auto peer_iter = peers_.find(wsi);
+    if (peer_iter == peers_.end()) {
+        return;
+    }
+    Peer& self = peer_iter->second;
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    JSONCPP_STRING err;
+    if (!reader->parse(message.data(), message.data() + message.size(), &root, &err) ||
+        !root.isObject() || !root["msg"].isObject())
+    {
+        RTC_LOG(LS_WARNING) << "local signaling unknown message: " << message;
+        return;
+    }
+
+    std::string tid = root["tid"].asString();
+    const Json::Value& msg = root["msg"];
+    std::string action = msg["action"].asString();
+
+    if (action == "join") {
+        if (self.joined) {
+            LeaveRoom(wsi);
+        }
+        self.room = msg["room"].asString();
+        self.display = msg["display"].asString();
+        self.joined = true;
+        self.publishing = false;
+
+        SendToPeer(wsi, BuildRoomMessage(tid, "join", "", self, nullptr));
+        NotifyRoom(wsi, self, "join");
+    }
+    else if (action == "publish") {
+        if (!self.joined) {
+            return;
+        }
+        self.publishing = true;
+
+        SendToPeer(wsi, BuildRoomMessage(tid, "publish", "", self, nullptr));
+        NotifyRoom(wsi, self, "publish");
+    }
+    else if (action == "leave") {
+        LeaveRoom(wsi);
+    }
+    else {
+        RTC_LOG(LS_WARNING) << "local signaling unknown action: " << action;
+    }
+}
+
+void LocalSignalingServer::LeaveRoom(struct lws* wsi) {
+    auto peer_iter = peers_.find(wsi);
+    if (peer_iter == peers_.end() || !peer_iter->second.joined) {
+        return;
+    }
+
+    // Participants of the leave notify must not list the leaving peer.
+    Peer leaving = peer_iter->second;
+    peer_iter->second.joined = false;
+    peer_iter->second.publishing = false;
+    NotifyRoom(wsi, leaving, "leave");
+}
+
+void LocalSignalingServer::NotifyRoom(struct lws* wsi, const Peer& peer,
+    const std::string& event)
+{
+    for (auto& iter : peers_) {
+        if (iter.first == wsi || !iter.second.joined || iter.second.room != peer.room) {
+            continue;
+        }
+        SendToPeer(iter.first, BuildRoomMessage("", "notify", event, iter.second, &peer));
+    }
+}
+
+/*
+{"tid":"jRxAiWF","msg":{"action":"join","room":"55555","self":{"display":"111","publishing":false},"participants":[...]}}
+{"msg":{"action":"notify","event":"publish","room":"5dd66a5","self":{...},"peer":{"display":"226e9a4","publishing":true},"participants":[...]}}
+*/
+std::string LocalSignalingServer::BuildRoomMessage(const std::string& tid,
+    const std::string& action, const std::string& event, const Peer& self,
+    const Peer* peer)
+{
+    auto to_json = [](const Peer& p) {
+        Json::Value value;
+        value["display"] = p.display;
+        value["publishing"] = p.publishing;
+        return value;
+    };
+
+    Json::Value msg;
+    msg["action"] = action;
+    if (!event.empty()) {
+        msg["event"] = event;
+    }
+    msg["room"] = self.room;
+    msg["self"] = to_json(self);
+    if (peer) {
+        msg["peer"] = to_json(*peer);
+    }
+
+    Json::Value participants(Json::arrayValue);
+    for (auto& iter : peers_) {
+        const Peer& p = iter.second;
+        if (p.joined && p.room == self.room) {
+            participants.append(to_json(p));
+        }
+    }
+    msg["participants"] = participants;
+
+    Json::Value root;
+    if (!tid.empty()) {
+        root["tid"] = tid;
+    }
+    root["msg"] = msg;
+    return ToJsonString(root);
+}
+
+void LocalSignalingServer::SendToPeer(struct lws* wsi, const std::string& message) {
+    auto iter = peers_.find(wsi);
+    if (iter == peers_.end()) {
+        return;
+    }
+    iter->second.outbox.push_back(message);
+    lws_callback_on_writable(wsi);
+}
+
+int LocalSignalingServer::WriteWebsocketMessage(struct lws* wsi) {
+    auto iter = peers_.find(wsi);
+    if (iter == peers_.end() || iter->second.outbox.empty()) {
+        return 0;
+    }
+
+    std::string message = std::move(iter->second.outbox.front());
+    iter->second.outbox.pop_front();
+
+    std::vector<unsigned char> buffer(LWS_PRE + message.size());
+    memcpy(buffer.data() + LWS_PRE, message.data(), message.size());
+    if (lws_write(wsi, buffer.data() + LWS_PRE, message.size(), LWS_WRITE_TEXT) <
+        (int)message.size())
+    {
+        RTC_LOG(LS_ERROR) << "local signaling write failed, connection is closed!";
+        return -1;
+    }
+
+    if (!iter->second.outbox.empty()) {
+        lws_callback_on_writable(wsi);
+    }
+    return 0;
+}
+
+} // namespace krtc
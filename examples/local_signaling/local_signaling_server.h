@@ -0,0 +1,96 @@
+#ifndef KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_SIGNALING_SERVER_H_
+#define KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_SIGNALING_SERVER_H_
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <libwebsockets.h>
+
+#include "local_media_relay.h"
+
+namespace krtc {
+
+// Embeddable stand-in for the SRS deployment the sdk talks to:
+//   https://host:1986/rtc/v1/publish/  and  /rtc/v1/play/  (KRTCPushImpl / KRTCPullImpl)
+//   wss://host:1989/sig/v1/rtc         room service       (KRTCClient)
+// Media is relayed between local PeerConnections by LocalMediaRelay.
+// The certificate has to be trusted by the client side, the sdk does not
+// accept self-signed certificates on the websocket connection.
+class LocalSignalingServer {
+public:
+    struct Options {
+        uint16_t http_port = 1986;
+        uint16_t ws_port = 1989;
+        std::string ssl_cert_path = "server.crt";
+        std::string ssl_private_key_path = "server.key";
+    };
+
+    LocalSignalingServer();
+    explicit LocalSignalingServer(const Options& options);
+    ~LocalSignalingServer();
+
+    bool Start();
+    void Stop();
+
+    int OnHttpCallback(struct lws* wsi, enum lws_callback_reasons reason,
+        void* in, size_t len);
+    int OnWebsocketCallback(struct lws* wsi, enum lws_callback_reasons reason,
+        void* in, size_t len);
+
+private:
+    struct HttpSession {
+        struct lws* wsi = nullptr;
+        std::string uri;
+        std::string body;
+        std::string response;
+        bool headers_sent = false;
+    };
+
+    struct Peer {
+        std::string room;
+        std::string display;
+        bool joined = false;
+        bool publishing = false;
+        std::deque<std::string> outbox;
+    };
+
+    void HandleHttpRequest(uint64_t session_id, const std::string& uri,
+        const std::string& body);
+    void CompleteHttpRequest(uint64_t session_id, int code, const std::string& sdp);
+    void FlushCompletedHttpRequests();
+    int WriteHttpResponse(struct lws* wsi);
+
+    void HandleRoomMessage(struct lws* wsi, const std::string& message);
+    void LeaveRoom(struct lws* wsi);
+    void NotifyRoom(struct lws* wsi, const Peer& peer, const std::string& event);
+    std::string BuildRoomMessage(const std::string& tid, const std::string& action,
+        const std::string& event, const Peer& self, const Peer* peer);
+    void SendToPeer(struct lws* wsi, const std::string& message);
+    int WriteWebsocketMessage(struct lws* wsi);
+
+    Options options_;
+    LocalMediaRelay relay_;
+
+    struct lws_context* lws_context_ = nullptr;
+    std::unique_ptr<std::thread> service_thread_;
+    std::atomic<bool> interrupted_{ false };
+
+    // Owned by service_thread_.
+    uint64_t next_session_id_ = 1;
+    std::map<uint64_t, HttpSession> http_sessions_;
+    std::map<struct lws*, uint64_t> http_session_ids_;
+    std::map<struct lws*, Peer> peers_;
+
+    // Answers produced on the relay thread, picked up by service_thread_.
+    std::mutex completed_mutex_;
+    std::map<uint64_t, std::string> completed_responses_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_EXAMPLES_LOCAL_SIGNALING_LOCAL_SIGNALING_SERVER_H_
@@ -0,0 +1,73 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <rtc_base/logging.h>
+
+#include "local_signaling_server.h"
+
+namespace {
+
+std::atomic<bool> g_interrupted{ false };
+
+void OnSignal(int sig) {
+    g_interrupted = true;
+}
+
+void Usage(const char* name) {
+    printf("usage: %s [--http-port 1986] [--ws-port 1989] [--cert server.crt] [--key server.key]\n", name);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    krtc::LocalSignalingServer::Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(arg, "--http-port") == 0) {
+            options.http_port = (uint16_t)atoi(value);
+        }
+        else if (strcmp(arg, "--ws-port") == 0) {
+            options.ws_port = (uint16_t)atoi(value);
+        }
+        else if (strcmp(arg, "--cert") == 0) {
+            options.ssl_cert_path = value;
+        }
+        else if (strcmp(arg, "--key") == 0) {
+            options.ssl_private_key_path = value;
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+        ++i;
+    }
+
+    rtc::LogMessage::LogToDebug(rtc::LS_INFO);
+
+    krtc::LocalSignalingServer server(options);
+    if (!server.Start()) {
+        fprintf(stderr, "start local signaling server failed\n");
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    while (!g_interrupted) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    server.Stop();
+    return 0;
+}
@@ -2,6 +2,9 @@
 #include <QOpenGLTexture>
 #include <QOpenGLBuffer>
 
+#include <stdint.h>
+#include <string.h>
+
 YUVOpenGLWidget::YUVOpenGLWidget(QWidget* parent) : QOpenGLWidget(parent)
 {
     textureUniformY = 0;
@@ -16,55 +19,31 @@ YUVOpenGLWidget::YUVOpenGLWidget(QWidget* parent) : QOpenGLWidget(parent)
     m_pTextureY = NULL;
     m_pTextureU = NULL;
     m_pTextureV = NULL;
+    for (int i = 0; i < kPixelBufferCount; ++i) {
+        m_pPixelBuffers[i] = NULL;
+    }
+    m_nPixelBufferIndex = 0;
+    m_nTextureWidth = 0;
+    m_nTextureHeight = 0;
 }
 
 YUVOpenGLWidget::~YUVOpenGLWidget()
 {
+    // 纹理和缓冲要在它们所属的上下文里释放
+    makeCurrent();
     releaseMemory();
+    doneCurrent();
 }
 
 void YUVOpenGLWidget::updateFrame(MediaFrameSharedPointer frame)
 {
-#if 1
-    int src_width = frame->fmt.sub_fmt.video_fmt.width;
-    int src_height = frame->fmt.sub_fmt.video_fmt.height;
-    int stridey = frame->stride[0];
-    int strideu = frame->stride[1];
-    int stridev = frame->stride[2];
-    int size = stridey * src_height + (strideu + stridev) * ((src_height + 1) / 2);
-
-    m_videoFrame.reset(new krtc::MediaFrame(size));
-    m_videoFrame->fmt.sub_fmt.video_fmt.type = krtc::SubMediaType::kSubTypeI420;
-    m_videoFrame->fmt.sub_fmt.video_fmt.width = src_width;
-    m_videoFrame->fmt.sub_fmt.video_fmt.height = src_height;
-    m_videoFrame->stride[0] = stridey;
-    m_videoFrame->stride[1] = strideu;
-    m_videoFrame->stride[2] = stridev;
-    m_videoFrame->data_len[0] = stridey * src_height;
-    m_videoFrame->data_len[1] = strideu * ((src_height + 1) / 2);
-    m_videoFrame->data_len[2] = stridev * ((src_height + 1) / 2);
-    m_videoFrame->data[0] = new char[m_videoFrame->data_len[0]];
-    m_videoFrame->data[1] = new char[m_videoFrame->data_len[1]];
-    m_videoFrame->data[2] = new char[m_videoFrame->data_len[2]];
-    memcpy(m_videoFrame->data[0], frame->data[0], frame->data_len[0]);
-    memcpy(m_videoFrame->data[1], frame->data[1], frame->data_len[1]);
-    memcpy(m_videoFrame->data[2], frame->data[2], frame->data_len[2]);
-
-    update();
-
-#else
-    static FILE* fp = fopen("f://save_preview.yuv", "wb+");
-    if (fp != NULL) {
-        int width = frame->fmt.sub_fmt.video_fmt.width;
-        int height = frame->fmt.sub_fmt.video_fmt.height;
-
-        fwrite(frame->data[0], 1, width * height, fp);
-        fwrite(frame->data[1], 1, width * height / 4, fp);
-        fwrite(frame->data[2], 1, width * height / 4, fp);
-        fflush(fp);
+    if (frame->fmt.sub_fmt.video_fmt.type != krtc::SubMediaType::kSubTypeI420) {
+        return;
     }
-#endif
 
+    // 只保存引用，不拷贝。绘制之前来的新帧直接替换还没上传的旧帧
+    m_videoFrame = frame;
+    update();
 }
 
 void YUVOpenGLWidget::initializeGL()
@@ -160,20 +139,12 @@ void YUVOpenGLWidget::initializeGL()
     // 启用ATTRIB_TEXTURE属性的数据,默认是关闭的
     glEnableVertexAttribArray(ATTRIB_TEXTURE);
 
-    // 分别创建y,u,v纹理对象
-    m_pTextureY = new QOpenGLTexture(QOpenGLTexture::Target2D);
-    m_pTextureU = new QOpenGLTexture(QOpenGLTexture::Target2D);
-    m_pTextureV = new QOpenGLTexture(QOpenGLTexture::Target2D);
-    m_pTextureY->create();
-    m_pTextureU->create();
-    m_pTextureV->create();
-
-    // 获取返回y分量的纹理索引值
-    id_y = m_pTextureY->textureId();
-    // 获取返回u分量的纹理索引值
-    id_u = m_pTextureU->textureId();
-    // 获取返回v分量的纹理索引值
-    id_v = m_pTextureV->textureId();
+    // y,u,v纹理对象等到知道视频尺寸时再分配，见allocateTextures
+    for (int i = 0; i < kPixelBufferCount; ++i) {
+        m_pPixelBuffers[i] = new QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+        m_pPixelBuffers[i]->setUsagePattern(QOpenGLBuffer::StreamDraw);
+        m_pPixelBuffers[i]->create();
+    }
 
     // 设置背景色
     glClearColor(0.3, 0.3, 0.3, 0.0);
@@ -195,46 +166,22 @@ void YUVOpenGLWidget::resizeGL(int w, int h)
 
 void YUVOpenGLWidget::paintGL()
 {
-    if ( nullptr == m_videoFrame) {
-        return;
+    // 只有新帧到来时才上传，窗口重绘直接用纹理里已有的内容
+    if (m_videoFrame) {
+        uploadFrame();
     }
 
-    int width = m_videoFrame->fmt.sub_fmt.video_fmt.width;
-    int height = m_videoFrame->fmt.sub_fmt.video_fmt.height;
+    if (0 == m_nTextureWidth) {
+        return;
+    }
 
-    // 加载y数据纹理
-    // 激活纹理单元GL_TEXTURE0
+    // 激活纹理单元GL_TEXTURE0, GL_TEXTURE1, GL_TEXTURE2, 分别绑定y,u,v纹理
     glActiveTexture(GL_TEXTURE0);
-    // 使用来自y数据生成纹理
     glBindTexture(GL_TEXTURE_2D, id_y);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED,
-        GL_UNSIGNED_BYTE, m_videoFrame->data[0]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // 加载u数据纹理
-    // 激活纹理单元GL_TEXTURE1
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, id_u);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width / 2, height / 2, 0, GL_RED,
-        GL_UNSIGNED_BYTE, m_videoFrame->data[1]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // 加载v数据纹理
-    // 激活纹理单元GL_TEXTURE2
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, id_v);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width / 2, height / 2, 0, GL_RED,
-        GL_UNSIGNED_BYTE, m_videoFrame->data[2]);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     // 指定y纹理要使用新值 只能用0,1,2等表示纹理单元的索引，这是opengl不人性化的地方
     // 0对应纹理单元GL_TEXTURE0 1对应纹理单元GL_TEXTURE1 2对应纹理的单元
@@ -248,27 +195,142 @@ void YUVOpenGLWidget::paintGL()
 
 }
 
+void YUVOpenGLWidget::allocateTextures(int width, int height)
+{
+    QOpenGLTexture** textures[] = { &m_pTextureY, &m_pTextureU, &m_pTextureV };
+    for (int i = 0; i < 3; ++i) {
+        delete *textures[i];
+
+        // 不可变存储(glTexStorage2D)：尺寸和格式一次定好，之后只用
+        // glTexSubImage2D更新内容，驱动不用每帧重新分配和校验纹理
+        QOpenGLTexture* texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        texture->setFormat(QOpenGLTexture::R8_UNorm);
+        if (0 == i) {
+            texture->setSize(width, height);
+        }
+        else {
+            texture->setSize((width + 1) / 2, (height + 1) / 2);
+        }
+        texture->setMipLevels(1);
+        texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::UInt8);
+        texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        *textures[i] = texture;
+    }
+
+    id_y = m_pTextureY->textureId();
+    id_u = m_pTextureU->textureId();
+    id_v = m_pTextureV->textureId();
+    m_nTextureWidth = width;
+    m_nTextureHeight = height;
+}
+
+void YUVOpenGLWidget::uploadFrame()
+{
+    MediaFrameSharedPointer frame = m_videoFrame;
+    m_videoFrame.reset();
+
+    int width = frame->fmt.sub_fmt.video_fmt.width;
+    int height = frame->fmt.sub_fmt.video_fmt.height;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (width != m_nTextureWidth || height != m_nTextureHeight) {
+        allocateTextures(width, height);
+    }
+
+    int plane_width[3] = { width, (width + 1) / 2, (width + 1) / 2 };
+    int plane_height[3] = { height, (height + 1) / 2, (height + 1) / 2 };
+    QOpenGLTexture* textures[3] = { m_pTextureY, m_pTextureU, m_pTextureV };
+
+    // 每个平面按原来的stride整块拷贝，行尾的填充也一起拷贝，由
+    // GL_UNPACK_ROW_LENGTH告诉gl一行的实际长度，不用逐行重新排列
+    int size = 0;
+    for (int i = 0; i < 3; ++i) {
+        size += frame->data_len[i];
+    }
+
+    QOpenGLBuffer* buffer = m_pPixelBuffers[m_nPixelBufferIndex];
+    m_nPixelBufferIndex = (m_nPixelBufferIndex + 1) % kPixelBufferCount;
+
+    char* mapped = nullptr;
+    if (buffer->bind()) {
+        if (buffer->size() < size) {
+            buffer->allocate(size);
+        }
+        // 整个缓冲作废，驱动不用等gpu读完这个缓冲里的上一帧
+        mapped = (char*)buffer->mapRange(0, size,
+            QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (mapped) {
+        int offset[3];
+        int pos = 0;
+        for (int i = 0; i < 3; ++i) {
+            memcpy(mapped + pos, frame->data[i], frame->data_len[i]);
+            offset[i] = pos;
+            pos += frame->data_len[i];
+        }
+        buffer->unmap();
+
+        // 绑定了像素缓冲时，glTexSubImage2D的数据指针是缓冲里的偏移，
+        // 调用立即返回，拷贝到纹理由gpu异步完成
+        for (int i = 0; i < 3; ++i) {
+            uploadPlane(textures[i], plane_width[i], plane_height[i], frame->stride[i],
+                (const void*)(intptr_t)offset[i]);
+        }
+        buffer->release();
+    }
+    else {
+        // 拿不到像素缓冲时直接从内存上传
+        buffer->release();
+        for (int i = 0; i < 3; ++i) {
+            uploadPlane(textures[i], plane_width[i], plane_height[i], frame->stride[i],
+                frame->data[i]);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void YUVOpenGLWidget::uploadPlane(QOpenGLTexture* texture, int width, int height, int stride,
+    const void* pixels)
+{
+    glBindTexture(GL_TEXTURE_2D, texture->textureId());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels);
+}
+
 void YUVOpenGLWidget::releaseMemory()
 {
     if (m_pTextureY) {
-        m_pTextureY->destroy();
+        delete m_pTextureY;
         m_pTextureY = nullptr;
     }
 
     if (m_pTextureU) {
-        m_pTextureU->destroy();
+        delete m_pTextureU;
         m_pTextureU = nullptr;
     }
 
     if (m_pTextureV) {
-        m_pTextureV->destroy();
+        delete m_pTextureV;
         m_pTextureV = nullptr;
     }
 
+    for (int i = 0; i < kPixelBufferCount; ++i) {
+        if (m_pPixelBuffers[i]) {
+            m_pPixelBuffers[i]->destroy();
+            delete m_pPixelBuffers[i];
+            m_pPixelBuffers[i] = nullptr;
+        }
+    }
+    m_nTextureWidth = 0;
+    m_nTextureHeight = 0;
+
     if (m_pShaderProgram) {
         m_pShaderProgram->removeAllShaders();
         m_pShaderProgram->release();
         m_pShaderProgram = nullptr;
     }
 }
-
@@ -3,15 +3,16 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLShaderProgram>
-#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLTexture>
+#include <QOpenGLBuffer>
 
 #include "defs.h"
 
 #define ATTRIB_VERTEX 3
 #define ATTRIB_TEXTURE 4
 
-class YUVOpenGLWidget : public QOpenGLWidget, protected QOpenGLFunctions
+class YUVOpenGLWidget : public QOpenGLWidget, protected QOpenGLExtraFunctions
 {
     Q_OBJECT
 
@@ -29,6 +30,13 @@ private:
 
     void releaseMemory();
 
+    // 视频尺寸变化时重新分配纹理，平时只更新纹理内容
+    void allocateTextures(int width, int height);
+    // 把m_videoFrame拷贝到下一个像素缓冲，再由gpu异步更新到纹理
+    void uploadFrame();
+    void uploadPlane(QOpenGLTexture* texture, int width, int height, int stride,
+        const void* pixels);
+
 private:
     /**
      * 纹理是一个2D图片，它可以用来添加物体的细节（贴图），纹理可以各种变形后
@@ -48,7 +56,17 @@ private:
     QOpenGLShader* m_pFSHader;  // 片段着色器对象
     QOpenGLShaderProgram* m_pShaderProgram; // 着色器程序容器
 
-    MediaFrameSharedPointer m_videoFrame;
+    /**
+     * 三个像素缓冲(PBO)轮流使用：cpu往一个缓冲里写新帧的时候，gpu还可以
+     * 从另外两个缓冲往纹理里拷贝，上传不用等上一帧
+     */
+    static const int kPixelBufferCount = 3;
+    QOpenGLBuffer* m_pPixelBuffers[kPixelBufferCount];
+    int m_nPixelBufferIndex;
+    int m_nTextureWidth;   // 纹理当前的视频宽度，0表示还没有分配
+    int m_nTextureHeight;  // 纹理当前的视频高度
+
+    MediaFrameSharedPointer m_videoFrame; // 还没有上传的最新一帧
 };
 
 #endif // YUVOPENGLWIDGET_H
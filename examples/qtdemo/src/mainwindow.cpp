@@ -395,7 +395,7 @@ bool MainWindow::startDevice() {
 			cam_source_->Start();
 		}
 		else if (ui->desktopRadioButton->isChecked()) {
-			desktop_source_ = krtc::KRTCEngine::CreateScreenSource();
+			desktop_source_ = krtc::KRTCEngine::CreateScreenSource(0, true);
 			desktop_source_->Start();
 		}
 		
@@ -577,30 +577,8 @@ void MainWindow::OnPullFailed(krtc::KRTCError err) {
 
 void MainWindow::OnCapturePureVideoFrame(std::shared_ptr<krtc::MediaFrame> frame)
 {
-	int src_width = frame->fmt.sub_fmt.video_fmt.width;
-	int src_height = frame->fmt.sub_fmt.video_fmt.height;
-	int stridey = frame->stride[0];
-	int strideu = frame->stride[1];
-	int stridev = frame->stride[2];
-	int size = stridey * src_height + (strideu + stridev) * ((src_height + 1) / 2);
-
-	MediaFrameSharedPointer video_frame(new krtc::MediaFrame(size));
-	video_frame->fmt.sub_fmt.video_fmt.type = krtc::SubMediaType::kSubTypeI420;
-	video_frame->fmt.sub_fmt.video_fmt.width = src_width;
-	video_frame->fmt.sub_fmt.video_fmt.height = src_height;
-	video_frame->stride[0] = stridey;
-	video_frame->stride[1] = strideu;
-	video_frame->stride[2] = stridev;
-	video_frame->data_len[0] = stridey * src_height;
-	video_frame->data_len[1] = strideu * ((src_height + 1) / 2);
-	video_frame->data_len[2] = stridev * ((src_height + 1) / 2);
-	video_frame->data[0] = new char[video_frame->data_len[0]];
-	video_frame->data[1] = new char[video_frame->data_len[1]];
-	video_frame->data[2] = new char[video_frame->data_len[2]];
-	memcpy(video_frame->data[0], frame->data[0], frame->data_len[0]);
-	memcpy(video_frame->data[1], frame->data[1], frame->data_len[1]);
-	memcpy(video_frame->data[2], frame->data[2], frame->data_len[2]);
-
+	// 预览帧的数据归这个MediaFrame所有，直接把引用交给ui线程，不再拷贝
+	MediaFrameSharedPointer video_frame(frame.get(), [frame](krtc::MediaFrame*) {});
 	emit pureVideoFrameSignal(video_frame);
 }
 
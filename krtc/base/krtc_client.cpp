@@ -1,5 +1,7 @@
 #include "krtc/base/krtc_client.h"
 
+#include <future>
+
 #include <rtc_base/strings/json.h>
 #include <rtc_base/logging.h>
 #include <rtc_base/helpers.h>
@@ -10,6 +12,8 @@
 namespace krtc {
 
 constexpr uint16_t DEFAULT_WS_PORT = 1989;
+// Longest wait for the server's answer to a request.
+constexpr unsigned int kRequestTimeoutMs = 5000;
 
 KRTCClient* KRTCClient::Instance() {
 	static KRTCClient* const instance = new KRTCClient();
@@ -18,11 +22,26 @@ KRTCClient* KRTCClient::Instance() {
 
 bool KRTCClient::JoinRoom(const std::string& server_addr, const std::string& room_id, 
 	const std::string& uid)
+{
+	std::promise<bool> join_promise;
+	std::future<bool> joined = join_promise.get_future();
+	JoinRoomAsync(server_addr, room_id, uid, [&join_promise](bool success) {
+		join_promise.set_value(success);
+	});
+	return joined.get();
+}
+
+void KRTCClient::JoinRoomAsync(const std::string& server_addr, const std::string& room_id, 
+	const std::string& uid, CompletionCallback done)
 {
 	RTC_LOG(LS_INFO) << "client join room! ";
 
+	if (!done) {
+		done = [](bool success) {};
+	}
 	if (room_id.empty() || uid.empty()) {
-		return false;
+		done(false);
+		return;
 	}
 
 	room_id_ = room_id;
@@ -42,6 +61,16 @@ bool KRTCClient::JoinRoom(const std::string& server_addr, const std::string& roo
 	path += "?room=" + room_id_;
 	path += "&display=" + uid_;
 
+	// A join still connecting fails, and its client goes first so that its
+	// status callbacks are over before the new one starts.
+	CompletionCallback pending = TakeConnectDone();
+	if (websocket_client_) {
+		websocket_client_->disconnect();
+	}
+	if (pending) {
+		pending(false);
+	}
+
 	websocket_client_.reset(new WebsocketClient(server_ip, ws_port, path));
 	websocket_client_->setMessageCallback([this](const std::string& message) {
 		// assert(); Ƿǵǰ߳
@@ -51,66 +80,40 @@ bool KRTCClient::JoinRoom(const std::string& server_addr, const std::string& roo
 		HandleWebsocketConnectStatus(status);
 	});
 
-	current_status_ = WEBSOCKET_STATUS::CONNECTING;
-	bool success = false;
-
-	std::promise<bool> connect_promise;
-	std::thread connect_thread([this, &connect_promise] {
-		websocket_client_->connect();
-		while (1) {
-			if (current_status_ == WEBSOCKET_STATUS::CONNECT_SUCCESS) {
-				connect_promise.set_value(true);
-				return;
-			}
-			else if (current_status_ == WEBSOCKET_STATUS::CONNECT_FAILED 
-					|| current_status_ == WEBSOCKET_STATUS::CONNECT_CLOSE) {
-				connect_promise.set_value(false);
+	// Runs from the status callback, the join goes out as soon as the
+	// connection is up.
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		connect_done_ = [this, done](bool success) {
+			if (!success) {
+				RTC_LOG(LS_INFO) << "websocket connect failed! ";
+				if (KRTCGlobal::Instance()->engine_observer()) {
+					KRTCGlobal::Instance()->engine_observer()->OnPushFailed(krtc::KRTCError::kConnectWebsocketErr);
+				}
+				done(false);
 				return;
 			}
-			else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			}
-		}
-	});
-	connect_thread.join();
-	success = connect_promise.get_future().get();
-	if (!success) {
-		RTC_LOG(LS_INFO) << "websocket connect failed! ";
-		if (KRTCGlobal::Instance()->engine_observer()) {
-			KRTCGlobal::Instance()->engine_observer()->OnPushFailed(krtc::KRTCError::kConnectWebsocketErr);
-		}
-		return false;
-	}
 
-	success = false;
-	std::promise<bool> msg_promise;
-	std::thread msg_thread([this, &msg_promise] {
-		current_status_ = WEBSOCKET_STATUS::MESSAGE_SEND;
-		SendAction(MSG_ACTION::JOIN);
-		while (1) {
-			if (current_status_ == WEBSOCKET_STATUS::MESSAGE_SEND_SUCCESS) {
-				msg_promise.set_value(true);
-				return;
-			}
-			else if (current_status_ == WEBSOCKET_STATUS::MESSAGE_SEND_FAILED) {
-				msg_promise.set_value(false);
-				return;
-			}
-			else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			SendAction(MSG_ACTION::JOIN, [this, done](bool success) {
+				if (!success) {
+					RTC_LOG(LS_ERROR) << "websocket send join msg failed! ";
+				}
+				is_joined_ = success;
+				done(success);
+			});
+		};
+		// A server that never answers the handshake fails the join too.
+		connect_timer_id_ = TimerService::Instance()->Schedule(kRequestTimeoutMs, false, [this]() {
+			CompletionCallback connect_done = TakeConnectDone();
+			if (connect_done) {
+				RTC_LOG(LS_WARNING) << "websocket connect timed out! ";
+				connect_done(false);
 			}
-		}
-	});
-	msg_thread.join();
-	success = msg_promise.get_future().get();
-	if (!success) {
-		RTC_LOG(LS_ERROR) << "websocket send join msg failed! ";
-		return false;
+		});
 	}
 
-	is_joined_ = true;
-
-	return true;
+	current_status_ = WEBSOCKET_STATUS::CONNECTING;
+	websocket_client_->connect();
 }
 
 void KRTCClient::LeaveRoom()
@@ -129,6 +132,11 @@ void KRTCClient::LeaveRoom()
 	is_joined_ = false;
 }
 
+// An error reply carries an error or a non zero code instead of the answer.
+static bool IsErrorReply(JsonObject& object) {
+	return object.Has("error") || object["code"].ToInt(0) != 0;
+}
+
 /*
 * ¸ʽ
 {"tid":"jRxAiWF","msg":{"action":"join","room":"55555","self":{"display":"111","publishing":false},"participants":[{"display":"8a38581","publishing":true},{"display":"111","publishing":false}]}}
@@ -138,10 +146,6 @@ void KRTCClient::HandleWebsocketMessage(const std::string& json_msg)
 {
 	RTC_LOG(LS_INFO) << "websocket recv server msg: " << json_msg;
 
-	if (current_status_ == WEBSOCKET_STATUS::MESSAGE_SEND) {
-		current_status_ = WEBSOCKET_STATUS::MESSAGE_SEND_SUCCESS;
-	}
-
 	JsonValue root;
 	bool success = root.FromJson(json_msg);
 	if (!success) {
@@ -153,6 +157,16 @@ void KRTCClient::HandleWebsocketMessage(const std::string& json_msg)
 	JsonObject msgObject = jobject["msg"].ToObject();
 	std::string action = msgObject["action"].ToString();
 
+	// The answer to a request carries its tid.
+	std::string tid = jobject["tid"].ToString();
+	if (!tid.empty()) {
+		bool error = IsErrorReply(jobject) || IsErrorReply(msgObject);
+		AnswerRequest(tid, action, error);
+		if (error) {
+			return;
+		}
+	}
+
 	if (action == "join") {
 		std::map<std::string, bool> parcicipantsInfo;
 		JsonArray participantsArray = msgObject["participants"].ToArray();
@@ -207,36 +221,86 @@ void KRTCClient::HandleWebsocketMessage(const std::string& json_msg)
 void KRTCClient::HandleWebsocketConnectStatus(const WEBSOCKET_STATUS& status)
 {
 	current_status_ = status;
+
+	CompletionCallback connect_done;
+	if (status == WEBSOCKET_STATUS::CONNECT_SUCCESS ||
+		status == WEBSOCKET_STATUS::CONNECT_FAILED ||
+		status == WEBSOCKET_STATUS::CONNECT_CLOSE)
+	{
+		connect_done = TakeConnectDone();
+	}
+	if (connect_done) {
+		connect_done(status == WEBSOCKET_STATUS::CONNECT_SUCCESS);
+	}
+
+	if (status == WEBSOCKET_STATUS::CONNECT_FAILED ||
+		status == WEBSOCKET_STATUS::CONNECT_CLOSE ||
+		status == WEBSOCKET_STATUS::MESSAGE_SEND_FAILED)
+	{
+		FailRequests();
+	}
 }
 
-void KRTCClient::SendPublishMsg()
+void KRTCClient::SendPublishMsg(CompletionCallback done)
 {
-	bool success = false;
-	std::promise<bool> msg_promise;
-	std::thread msg_thread([this, &msg_promise] {
-		current_status_ = WEBSOCKET_STATUS::MESSAGE_SEND;
-		SendAction(MSG_ACTION::PUBLISH);
-		while (1) {
-			if (current_status_ == WEBSOCKET_STATUS::MESSAGE_SEND_SUCCESS) {
-				msg_promise.set_value(true);
-				return;
-			}
-			else if (current_status_ == WEBSOCKET_STATUS::MESSAGE_SEND_FAILED) {
-				msg_promise.set_value(false);
-				return;
-			}
-			else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			}
+	SendAction(MSG_ACTION::PUBLISH, [done](bool success) {
+		if (!success) {
+			RTC_LOG(LS_ERROR) << "websocket send publish msg failed! ";
+		}
+		if (done) {
+			done(success);
 		}
 	});
-	msg_thread.join();
-	success = msg_promise.get_future().get();
+}
 
-	if (!success) {
-		RTC_LOG(LS_ERROR) << "websocket send publish msg failed! ";
+KRTCClient::CompletionCallback KRTCClient::TakeConnectDone()
+{
+	CompletionCallback connect_done;
+	TimerService::TimerId timer_id = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		connect_done.swap(connect_done_);
+		std::swap(timer_id, connect_timer_id_);
+	}
+
+	// Not under mutex_, a timeout in progress takes it.
+	if (timer_id) {
+		TimerService::Instance()->Cancel(timer_id);
+	}
+	return connect_done;
+}
+
+void KRTCClient::CompleteRequest(const std::string& tid, bool success)
+{
+	Request request;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = requests_.find(tid);
+		if (iter == requests_.end()) {
+			return;
+		}
+		request = std::move(iter->second);
+		requests_.erase(iter);
 	}
 
+	// Not under mutex_, a timeout in progress takes it.
+	TimerService::Instance()->Cancel(request.timer_id);
+	request.done(success);
+}
+
+void KRTCClient::FailRequests()
+{
+	std::vector<std::string> tids;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& iter : requests_) {
+			tids.push_back(iter.first);
+		}
+	}
+
+	for (const std::string& tid : tids) {
+		CompleteRequest(tid, false);
+	}
 }
 
 static std::string GetActionString(const MSG_ACTION& action) {
@@ -257,11 +321,32 @@ static std::string GetActionString(const MSG_ACTION& action) {
 	return std::move(strAction);
 }
 
-void KRTCClient::SendAction(const MSG_ACTION& action)
+void KRTCClient::AnswerRequest(const std::string& tid, const std::string& action, bool error)
+{
+	bool success = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = requests_.find(tid);
+		if (iter == requests_.end()) {
+			return;
+		}
+		success = !error && action == GetActionString(iter->second.action);
+	}
+
+	if (!success) {
+		RTC_LOG(LS_WARNING) << "websocket request " << tid << " answered with an error";
+	}
+	CompleteRequest(tid, success);
+}
+
+void KRTCClient::SendAction(const MSG_ACTION& action, CompletionCallback done)
 {
 	// {"tid":"398d320","msg":{"action":"join","room":"5dd66a5","display":"50b8507"}}
 	std::string strAction = GetActionString(action);
-	if (strAction.empty()) {
+	if (strAction.empty() || !websocket_client_) {
+		if (done) {
+			done(false);
+		}
 		return;
 	}
 	
@@ -270,13 +355,30 @@ void KRTCClient::SendAction(const MSG_ACTION& action)
 	reqMsg["action"] = strAction;
 	reqMsg["room"] = room_id_;
 	reqMsg["display"] = uid_;
-	rootMsg["tid"] = rtc::CreateRandomString(7);
+	std::string tid = rtc::CreateRandomString(7);
+	rootMsg["tid"] = tid;
 	rootMsg["msg"] = reqMsg;
 	Json::StreamWriterBuilder write_builder;
 	write_builder.settings_["indentation"] = "";
 	std::string json_data = Json::writeString(write_builder, rootMsg);
 	RTC_LOG(LS_INFO) << "websocket client send msg: " << json_data;
-	websocket_client_->send(json_data);
+
+	// Registered before sending, a failed send completes it right away.
+	if (done) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		Request& request = requests_[tid];
+		request.action = action;
+		request.done = std::move(done);
+		request.timer_id = TimerService::Instance()->Schedule(kRequestTimeoutMs, false, [this, tid]() {
+			CompleteRequest(tid, false);
+		});
+	}
+	if (!websocket_client_->send(json_data)) {
+		// Not connected, or the queue is full because the server stopped reading.
+		RTC_LOG(LS_WARNING) << "websocket client send msg rejected, queued bytes: "
+			<< websocket_client_->queued_bytes();
+		CompleteRequest(tid, false);
+	}
 }
 
 }
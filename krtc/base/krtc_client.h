@@ -1,13 +1,16 @@
 #ifndef KRTCSDK_KRTC_BASE_KRTC_CLIENT_H_
 #define KRTCSDK_KRTC_BASE_KRTC_CLIENT_H_
 
+#include <atomic>
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
-#include <thread>
-#include <future>
+#include <mutex>
+#include <functional>
 
 #include "krtc/base/krtc_websocket.h"
+#include "krtc/tools/timer.h"
 
 namespace krtc {
 
@@ -19,22 +22,48 @@ enum MSG_ACTION {
 
 class KRTCClient {
 public:
+    typedef std::function<void(bool success)> CompletionCallback;
+
     static KRTCClient* Instance();
 
+    // Waits for JoinRoomAsync.
     bool JoinRoom(const std::string& server_addr,
         const std::string& room_id,
         const std::string& uid);
 
+    // Returns right away. done runs once, on the websocket thread, with the
+    // server's answer to the join, or with false when the connection or the
+    // send failed or no answer came in time. A later join fails this one
+    // if it is still connecting.
+    void JoinRoomAsync(const std::string& server_addr,
+        const std::string& room_id,
+        const std::string& uid,
+        CompletionCallback done);
+
     void LeaveRoom();
 
     void HandleWebsocketMessage(const std::string& json_msg);
 
     void HandleWebsocketConnectStatus(const WEBSOCKET_STATUS& status);
 
-    void SendPublishMsg();
+    // Does not wait, done (optional) as for JoinRoomAsync.
+    void SendPublishMsg(CompletionCallback done = nullptr);
 
 private:
-    void SendAction(const MSG_ACTION& action);
+    struct Request {
+        MSG_ACTION action = JOIN;
+        CompletionCallback done;
+        TimerService::TimerId timer_id = 0;
+    };
+
+    // Takes the pending connect completion and stops its timeout.
+    CompletionCallback TakeConnectDone();
+    void SendAction(const MSG_ACTION& action, CompletionCallback done = nullptr);
+    // Succeeds on an answer to the request's own action without an error.
+    void AnswerRequest(const std::string& tid, const std::string& action, bool error);
+    void CompleteRequest(const std::string& tid, bool success);
+    // The status callback does not tell which message failed.
+    void FailRequests();
 
 private:
     std::unique_ptr<WebsocketClient> websocket_client_;
@@ -42,7 +71,13 @@ private:
     std::string uid_;
 
     std::atomic<WEBSOCKET_STATUS> current_status_ = WEBSOCKET_STATUS::NO_STATUS;
-    bool is_joined_ = false;
+    std::atomic<bool> is_joined_{ false };
+
+    // Completed from the websocket callbacks and the request timeouts.
+    std::mutex mutex_;
+    CompletionCallback connect_done_;
+    TimerService::TimerId connect_timer_id_ = 0;
+    std::map<std::string, Request> requests_;    // by tid
 };
 
 }
@@ -9,6 +9,7 @@
 
 #include "krtc/base/krtc_global.h"
 #include "krtc/base/krtc_http.h"
+#include "krtc/render/gallery_renderer.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "krtc/codec/external_video_encoder_factory.h"
@@ -25,6 +26,7 @@ KRTCGlobal::KRTCGlobal() :
     signaling_thread_(rtc::Thread::Create()),
     worker_thread_(rtc::Thread::Create()),
     network_thread_(rtc::Thread::CreateWithSocketServer()),
+    render_thread_(rtc::Thread::Create()),
     video_device_info_(webrtc::VideoCaptureFactory::CreateDeviceInfo()),
     task_queue_factory_(webrtc::CreateDefaultTaskQueueFactory())
 {
@@ -37,21 +39,68 @@ KRTCGlobal::KRTCGlobal() :
     network_thread_->SetName("network_thread", nullptr);
     network_thread_->Start();
 
+    render_thread_->SetName("render_thread", nullptr);
+    render_thread_->Start();
+    gallery_.reset(new GalleryRenderer(render_thread_.get()));
+
     http_manager_ = new HttpManager();
     http_manager_->Start();
 
+#if (defined(_WIN32) || defined(_WIN64)) && USE_EXTERNAL_ENCOER
+    encoder_capabilities_.reset(new EncoderCapabilityCache(ProbeExternalVideoEncoders));
+#else
+    encoder_capabilities_.reset(new EncoderCapabilityCache(
+        EncoderCapabilityCache::ProbeSoftwareEncoders));
+#endif
+
+    DesktopCapturer::GetScreenSourceList(screen_source_list_);
+
+    device_cache_.reset(new DeviceCache(signaling_thread_.get(), [this]() {
+        return EnumerateDevices();
+    }));
+
     worker_thread_->PostTask(webrtc::ToQueuedTask([=]() {
         audio_device_ = webrtc::AudioDeviceModule::Create(
             webrtc::AudioDeviceModule::kPlatformDefaultAudio,
             task_queue_factory_.get());
         audio_device_->Init();
+        // The microphones are known from here on.
+        device_cache_->Refresh();
     }));
-
-    DesktopCapturer::GetScreenSourceList(screen_source_list_);
 }
 
 KRTCGlobal::~KRTCGlobal() {}
 
+DeviceCache::Devices KRTCGlobal::EnumerateDevices()
+{
+    DeviceCache::Devices devices;
+
+    // Kept in index order even when a name cannot be read, the app selects
+    // devices by index.
+    if (video_device_info_) {
+        uint32_t count = video_device_info_->NumberOfDevices();
+        for (uint32_t i = 0; i < count; ++i) {
+            char name[128] = { 0 };
+            char id[128] = { 0 };
+            video_device_info_->GetDeviceName(i, name, sizeof(name), id, sizeof(id));
+            devices.cameras.push_back({ name, id });
+        }
+    }
+
+    if (audio_device_) {
+        int16_t count = audio_device_->RecordingDevices();
+        for (int16_t i = 0; i < count; ++i) {
+            char name[webrtc::kAdmMaxDeviceNameSize] = { 0 };
+            char guid[webrtc::kAdmMaxGuidSize] = { 0 };
+            audio_device_->RecordingDeviceName(i, name, guid);
+            devices.mics.push_back({ name, guid });
+        }
+    }
+
+    devices.screens = (uint32_t)screen_source_list_.size();
+    return devices;
+}
+
 webrtc::PeerConnectionFactoryInterface* KRTCGlobal::push_peer_connection_factory()
 {
 #if defined(_WIN32) || defined(_WIN64)
@@ -128,10 +177,12 @@ void KRTCGlobal::StopVcmCapturerSource()
     }));
 }
 
-void KRTCGlobal::CreateDesktopCapturerSource(uint16_t screen_index, uint16_t target_fps)
+void KRTCGlobal::CreateDesktopCapturerSource(uint16_t screen_index, uint16_t target_fps,
+    bool screen_content)
 {
     signaling_thread_->PostTask(webrtc::ToQueuedTask([=]() {
-        desktop_capturer_source_ = DesktopCapturerTrackSource::Create(screen_index, target_fps);
+        desktop_capturer_source_ = DesktopCapturerTrackSource::Create(screen_index, target_fps,
+            screen_content);
         if (!desktop_capturer_source_) {
             if (KRTCGlobal::Instance()->engine_observer()) {
                 KRTCGlobal::Instance()->engine_observer()->OnPreviewFailed(KRTCError::kVideoCreateCaptureErr);     
@@ -165,6 +216,36 @@ void KRTCGlobal::StopDesktopCapturerSource()
     }));
 }
 
+void KRTCGlobal::CreateGalleryCapturerSource()
+{
+    signaling_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        gallery_capturer_source_ = GalleryCapturerTrackSource::Create();
+        SetCurrentCaptureType(CAPTURE_TYPE::GALLERY);
+    }));
+}
+
+void KRTCGlobal::StartGalleryCapturerSource()
+{
+    signaling_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        if (gallery_capturer_source_) {
+            gallery_capturer_source_->Start();
+
+            if (KRTCGlobal::Instance()->engine_observer()) {
+                KRTCGlobal::Instance()->engine_observer()->OnPreviewSuccess();
+            }
+        }
+    }));
+}
+
+void KRTCGlobal::StopGalleryCapturerSource()
+{
+    signaling_thread_->PostTask(webrtc::ToQueuedTask([=]() {
+        if (gallery_capturer_source_) {
+            gallery_capturer_source_->Stop();
+        }
+    }));
+}
+
 webrtc::VideoTrackSource* KRTCGlobal::current_video_source()
 {
     switch (current_capture_type_) {
@@ -172,6 +253,8 @@ webrtc::VideoTrackSource* KRTCGlobal::current_video_source()
         return camera_capturer_source_.get();
     case CAPTURE_TYPE::SCREEN:
         return desktop_capturer_source_.get();
+    case CAPTURE_TYPE::GALLERY:
+        return gallery_capturer_source_.get();
     default:
         return nullptr;
     }
@@ -1,6 +1,7 @@
 #ifndef KRTCSDK_KRTC_BASE_KRTC_GLOBAL_H_
 #define KRTCSDK_KRTC_BASE_KRTC_GLOBAL_H_
 
+#include <atomic>
 #include <memory>
 
 #include <rtc_base/thread.h>
@@ -12,15 +13,20 @@
 
 #include "krtc/device/vcm_capturer.h"
 #include "krtc/device/desktop_capturer.h"
+#include "krtc/device/gallery_capturer.h"
+#include "krtc/device/device_cache.h"
+#include "krtc/codec/encoder_capability_cache.h"
 
 namespace krtc {
 
 	class KRTCEngineObserver;
 	class HttpManager;
+	class GalleryRenderer;
 
     enum class CAPTURE_TYPE {
 		CAMERA,	// 摄像头采集
-		SCREEN  // 桌面采集
+		SCREEN, // 桌面采集
+		GALLERY // 拉流合成画面
 	};
 
 	// 全局管理类，单例模式
@@ -36,16 +42,35 @@ namespace krtc {
 		rtc::Thread* api_thread() { return signaling_thread_.get(); }
 		rtc::Thread* worker_thread() { return worker_thread_.get(); }
 		rtc::Thread* network_thread() { return network_thread_.get(); }
+		// 拉流画面回调给应用的线程，解码线程不等应用
+		rtc::Thread* render_thread() { return render_thread_.get(); }
+		// 所有拉流画面合成一路
+		GalleryRenderer* gallery() { return gallery_.get(); }
 		
 		webrtc::VideoCaptureModule::DeviceInfo* video_device_info() {
 			return video_device_info_.get();
 		}
 
+		// 硬件编码同时在途的帧数，1 为同步编码
+		void SetEncoderAsyncDepth(int depth) { encoder_async_depth_ = depth; }
+		int encoder_async_depth() const { return encoder_async_depth_; }
+
+		// 多路推流共用一个视频编码器
+		void SetShareVideoEncoder(bool share) { share_video_encoder_ = share; }
+		bool share_video_encoder() const { return share_video_encoder_; }
+
+		// 推流编码后的帧回调给OnEncodedVideoFrame/OnEncodedAudioFrame
+		void SetEncodedFrameCallback(bool enable) { encoded_frame_callback_ = enable; }
+		bool encoded_frame_callback() const { return encoded_frame_callback_; }
+
 		void SetPreview(bool preview) { is_preview_ = preview; }
 		bool is_preview() const { return is_preview_;  }
 
 		size_t GetScreenCount() const { return screen_source_list_.size(); }
 
+		// 设备列表缓存，应用查询不用等 api 线程
+		DeviceCache* devices() { return device_cache_.get(); }
+
 		KRTCEngineObserver* engine_observer() { return engine_observer_; }
 		void RegisterEngineObserver(KRTCEngineObserver* observer) {
 			engine_observer_ = observer;
@@ -57,6 +82,8 @@ namespace krtc {
 		}
 
 		HttpManager* http_manager() { return http_manager_; }
+
+		EncoderCapabilityCache* encoder_capabilities() { return encoder_capabilities_.get(); }
 	
 		webrtc::AudioDeviceModule* audio_device() { return audio_device_.get(); }
 
@@ -78,14 +105,25 @@ namespace krtc {
 		void StartVcmCapturerSource();
 		void StopVcmCapturerSource();
 
-		void CreateDesktopCapturerSource(uint16_t screen_index, uint16_t target_fps);
+		void CreateDesktopCapturerSource(uint16_t screen_index, uint16_t target_fps,
+			bool screen_content);
 		void StartDesktopCapturerSource();
 		void StopDesktopCapturerSource();
 
+		void CreateGalleryCapturerSource();
+		void StartGalleryCapturerSource();
+		void StopGalleryCapturerSource();
+
+	private:
+		// 在 api 线程上枚举
+		DeviceCache::Devices EnumerateDevices();
+
 	private:
 		std::unique_ptr<rtc::Thread> signaling_thread_;
 		std::unique_ptr<rtc::Thread> worker_thread_;
 		std::unique_ptr<rtc::Thread> network_thread_;
+		std::unique_ptr<rtc::Thread> render_thread_;
+		std::unique_ptr<GalleryRenderer> gallery_;
 		std::unique_ptr<webrtc::VideoCaptureModule::DeviceInfo> video_device_info_;
 		std::unique_ptr<webrtc::TaskQueueFactory> task_queue_factory_;
 		rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device_;
@@ -93,10 +131,16 @@ namespace krtc {
 		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> push_peer_connection_factory_;
 		rtc::scoped_refptr<VcmCapturerTrackSource> camera_capturer_source_;
 		rtc::scoped_refptr<DesktopCapturerTrackSource> desktop_capturer_source_;
+		rtc::scoped_refptr<GalleryCapturerTrackSource> gallery_capturer_source_;
 		webrtc::DesktopCapturer::SourceList screen_source_list_;
 		CAPTURE_TYPE current_capture_type_ = CAPTURE_TYPE::CAMERA;
 		HttpManager* http_manager_ = nullptr;
+		std::unique_ptr<EncoderCapabilityCache> encoder_capabilities_;
+		std::unique_ptr<DeviceCache> device_cache_;
 		bool is_preview_ = false;
+		std::atomic<int> encoder_async_depth_{ 1 };
+		std::atomic<bool> share_video_encoder_{ false };
+		std::atomic<bool> encoded_frame_callback_{ false };
 
 		KRTCMsgObserver* msg_observer_ = nullptr;
 	};
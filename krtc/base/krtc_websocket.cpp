@@ -1,4 +1,7 @@
 #include <assert.h>
+#include <string.h>
+
+#include <chrono>
 
 #include <rtc_base/logging.h>
 
@@ -10,6 +13,14 @@ namespace {
     const char* SSL_CERT_FILE_PATH = "server.crt";
     const char* SSL_PRIVATE_KEY_PATH = "server.key";
 
+    // Room messages are a few hundred bytes, a full queue means the server
+    // stopped reading.
+    const size_t kMaxQueuedMessages = 64;
+    const size_t kMaxQueuedBytes = 256 * 1024;
+    // How long disconnect() waits for the queued messages, the leave among
+    // them, to go out.
+    const int kDrainTimeoutMs = 1000;
+
     static int wscallback(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len)
     {
         printf("call reason: %d \n", reason);
@@ -41,9 +52,14 @@ void WebsocketClient::OnCallback(lws* wsi, lws_callback_reasons reason, void* us
 {
     switch (reason) {
     case LWS_CALLBACK_CLIENT_ESTABLISHED: // 3
+        connected_ = true;
         if (statusCallback_) {
             statusCallback_(WEBSOCKET_STATUS::CONNECT_SUCCESS);
         }
+        // Sent before the connection was up.
+        if (queued_bytes() > 0) {
+            lws_callback_on_writable(wsi);
+        }
         break;
 
     case LWS_CALLBACK_CLIENT_RECEIVE: // 8
@@ -54,13 +70,24 @@ void WebsocketClient::OnCallback(lws* wsi, lws_callback_reasons reason, void* us
         OnSendMessage();
         break;
 
+    case LWS_CALLBACK_EVENT_WAIT_CANCELLED: // 71 send() woke lws_service()
+        if (connected_ && lws_websocket_ && queued_bytes() > 0) {
+            lws_callback_on_writable(lws_websocket_);
+        }
+        break;
+
     case LWS_CALLBACK_CLOSED: // 4
+        connected_ = false;
+        NotifySendDone();
         if (statusCallback_) {
             statusCallback_(WEBSOCKET_STATUS::CONNECT_CLOSE);
         }
         break;
     case LWS_CALLBACK_CLIENT_CONNECTION_ERROR: // 1
-        disconnect();
+        // Ends the service loop, the context goes with the owner's disconnect().
+        connected_ = false;
+        interrupted_ = true;
+        NotifySendDone();
         if (statusCallback_) {
             statusCallback_(WEBSOCKET_STATUS::CONNECT_FAILED);
         }
@@ -68,6 +95,8 @@ void WebsocketClient::OnCallback(lws* wsi, lws_callback_reasons reason, void* us
 
     case LWS_CALLBACK_CLOSED_CLIENT_HTTP: // 45
     case LWS_CALLBACK_WSI_DESTROY: // 30
+        connected_ = false;
+        NotifySendDone();
         if (statusCallback_) {
             statusCallback_(WEBSOCKET_STATUS::CONNECT_CLOSE);
         }
@@ -115,7 +144,10 @@ void WebsocketClient::connect()
     context_info.ka_probes = 3;   // ̽windowsϵͳЧģWindowsϵͳʱ̶Ϊ10Σ޸
     context_info.options =  LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT |
         LWS_SERVER_OPTION_VALIDATE_UTF8 | LWS_SERVER_OPTION_DISABLE_IPV6;
-    lws_context_ = lws_create_context(&context_info);
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        lws_context_ = lws_create_context(&context_info);
+    }
     assert(lws_context_ != nullptr);
 
     struct lws_client_connect_info connect_info = {};
@@ -142,10 +174,12 @@ void WebsocketClient::connect()
     }
 
     interrupted_ = false;
-    websocket_thread_ = std::make_unique<std::thread>([this]() {
+    // disconnect() takes lws_context_ away while the loop runs.
+    struct lws_context* context = lws_context_;
+    websocket_thread_ = std::make_unique<std::thread>([this, context]() {
         int n = 0;
         while (n >= 0 && !interrupted_) {
-            n = lws_service(lws_context_, 1000);    
+            n = lws_service(context, 1000);    
         }
     });
 
@@ -153,65 +187,144 @@ void WebsocketClient::connect()
 
 void WebsocketClient::disconnect()
 {
+    // From a callback the loop ends when it returns, the context stays for
+    // the next disconnect() or the destructor.
+    if (websocket_thread_ && websocket_thread_->get_id() == std::this_thread::get_id()) {
+        interrupted_ = true;
+        connected_ = false;
+        return;
+    }
+
+    // What was sent before, the leave message for one, goes out first.
+    if (websocket_thread_ && connected_) {
+        std::unique_lock<std::mutex> lock(send_mutex_);
+        bool drained = send_drained_.wait_for(lock, std::chrono::milliseconds(kDrainTimeoutMs), [this]() {
+            return (send_queue_.empty() && !writing_) || !connected_;
+        });
+        if (!drained) {
+            RTC_LOG(LS_WARNING) << "websocket disconnect with unsent messages: " << send_queue_.size();
+        }
+    }
+
     interrupted_ = true;
+    connected_ = false;
 
-    if (lws_context_) {
-        lws_cancel_service(lws_context_);
-        lws_context_destroy(lws_context_);
+    struct lws_context* context = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        context = lws_context_;
         lws_context_ = nullptr;
-        lws_websocket_ = nullptr;
+    }
+
+    if (context) {
+        lws_cancel_service(context);
     }
 
     if (websocket_thread_ && websocket_thread_->joinable()) {
         websocket_thread_->join();
         websocket_thread_ = nullptr;
     }
+
+    if (context) {
+        lws_context_destroy(context);
+        lws_websocket_ = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    send_queue_.clear();
+    queued_bytes_ = 0;
 }
 
-void WebsocketClient::send(const std::string& message)
+bool WebsocketClient::send(const std::string& message)
 {
-    wait_send_message_ = message;
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (!lws_context_ || interrupted_ || message.empty()) {
+        return false;
+    }
+
+    if (send_queue_.size() >= kMaxQueuedMessages ||
+        queued_bytes_ + message.size() > kMaxQueuedBytes)
+    {
+        RTC_LOG(LS_WARNING) << "websocket send queue full, messages:" << send_queue_.size()
+            << ", bytes:" << queued_bytes_;
+        return false;
+    }
 
-    OnSendMessage();
+    Frame frame;
+    if (!free_frames_.empty()) {
+        frame = std::move(free_frames_.back());
+        free_frames_.pop_back();
+    }
+    frame.resize(LWS_PRE + message.size());
+    memcpy(frame.data() + LWS_PRE, message.data(), message.size());
+    send_queue_.push_back(std::move(frame));
+    queued_bytes_ += message.size();
+
+    // lws_callback_on_writable() only on the websocket thread, wake it up.
+    lws_cancel_service(lws_context_);
+    return true;
+}
+
+size_t WebsocketClient::queued_bytes() const
+{
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    return queued_bytes_;
 }
 
 void WebsocketClient::OnSendMessage()
 {
-    if (!lws_websocket_ || wait_send_message_.empty()) {
-        if (statusCallback_) {
-            statusCallback_(WEBSOCKET_STATUS::MESSAGE_SEND_FAILED);
+    // One json message per websocket message in the room protocol, they are
+    // not merged. As many go out per writeable callback as the socket takes.
+    while (lws_websocket_ && !lws_send_pipe_choked(lws_websocket_)) {
+        Frame frame;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (send_queue_.empty()) {
+                return;
+            }
+            frame = std::move(send_queue_.front());
+            send_queue_.pop_front();
+            queued_bytes_ -= frame.size() - LWS_PRE;
+            writing_ = true;
         }
-        return;
-    }
 
-    size_t totalSize = wait_send_message_.length();
-    unsigned char* sendBuf = new unsigned char[LWS_PRE + totalSize];
-    memcpy(sendBuf + LWS_PRE, wait_send_message_.data(), wait_send_message_.size());
+        size_t size = frame.size() - LWS_PRE;
+        int writeSize = lws_write(lws_websocket_, frame.data() + LWS_PRE, size, LWS_WRITE_TEXT);
+        if (writeSize < (int)size) {
+            RTC_LOG(LS_ERROR) << "write failed, connection is closed! ";
+            connected_ = false;
+            NotifySendDone();
+            if (statusCallback_) {
+                statusCallback_(WEBSOCKET_STATUS::MESSAGE_SEND_FAILED);
+            }
+            return;
+        }
 
-    int writeSize = lws_write(lws_websocket_, sendBuf + LWS_PRE, wait_send_message_.length(), LWS_WRITE_TEXT);
-    delete[] sendBuf;
-    if (writeSize == -1) {
-        RTC_LOG(LS_ERROR) << "write failed, connection is closed! ";
-        if (statusCallback_) {
-            statusCallback_(WEBSOCKET_STATUS::MESSAGE_SEND_FAILED);
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (free_frames_.size() < kMaxQueuedMessages) {
+                free_frames_.push_back(std::move(frame));
+            }
+            writing_ = false;
+            if (send_queue_.empty()) {
+                send_drained_.notify_all();
+            }
         }
-        return;
-    }
-    if (writeSize == totalSize) {
-        wait_send_message_.clear();
         if (statusCallback_) {
             statusCallback_(WEBSOCKET_STATUS::MESSAGE_SEND_SUCCESS);
         }
     }
-    else if (writeSize < totalSize) {
-        wait_send_message_ = wait_send_message_.substr(writeSize);
-        RTC_LOG(LS_WARNING) << " totalSize:" <<  totalSize <<  ", writeSize:" << writeSize
-                        << " remainSize:" << totalSize - writeSize;
-    }
 
-    if (!wait_send_message_.empty()) {
+    if (lws_websocket_ && queued_bytes() > 0) {
         lws_callback_on_writable(lws_websocket_);
     }
 }
 
+void WebsocketClient::NotifySendDone()
+{
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    writing_ = false;
+    send_drained_.notify_all();
+}
+
 } // namespace krtc
@@ -1,10 +1,15 @@
 #ifndef KRTC_BASE_KRTC_WEBSOCKET_H_
 #define KRTC_BASE_KRTC_WEBSOCKET_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <string>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <libwebsockets.h>
 
@@ -31,11 +36,17 @@ public:
 
     void OnCallback(struct lws* wsi, enum lws_callback_reasons reason, 
         void* user, void* in, size_t len);
+    // On the websocket thread, writes the queued messages.
     void OnSendMessage();
 
     void connect();
+    // Waits a little for the queued messages to be written, then closes.
     void disconnect();
-    void send(const std::string& message);
+
+    // Any thread. Queued for the websocket thread, false when the queue is
+    // full because the server does not keep up, or when not connected.
+    bool send(const std::string& message);
+    size_t queued_bytes() const;
 
     typedef std::function<void(const std::string&)> MessageCallback;
     void setMessageCallback(MessageCallback callback) {
@@ -50,6 +61,9 @@ public:
     void callbackMessage(const char* msg, int len);
 
 private:
+    // The queue will not drain further, wakes disconnect().
+    void NotifySendDone();
+
     std::string server_addr_;
     uint16_t server_port_;
     std::string url_path_;
@@ -60,8 +74,21 @@ private:
 
     std::unique_ptr<std::thread> websocket_thread_;
     std::atomic_bool interrupted_ = false;
+    std::atomic_bool connected_ = false;
+
+    // A message with LWS_PRE bytes in front of it, as lws_write wants it.
+    typedef std::vector<unsigned char> Frame;
 
-    std::string wait_send_message_;
+    // Also guards lws_context_ for send().
+    mutable std::mutex send_mutex_;
+    std::deque<Frame> send_queue_;
+    size_t queued_bytes_ = 0;
+    // A frame taken from the queue and not written yet.
+    bool writing_ = false;
+    // Signaled when the queue is written out or can no longer be.
+    std::condition_variable send_drained_;
+    // Written frames, reused by send().
+    std::vector<Frame> free_frames_;
 };
 
 } // namespace krtc
@@ -0,0 +1,62 @@
+#include "capture_time_encoder.h"
+
+#include "krtc/media/encoded_frame_tap.h"
+
+namespace krtc {
+
+CaptureTimeEncoder::CaptureTimeEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder)
+	: encoder_(std::move(encoder))
+{
+}
+
+CaptureTimeEncoder::~CaptureTimeEncoder() = default;
+
+int32_t CaptureTimeEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores, size_t max_payload_size)
+{
+	return encoder_->InitEncode(codec_settings, number_of_cores, max_payload_size);
+}
+
+int32_t CaptureTimeEncoder::Release()
+{
+	return encoder_->Release();
+}
+
+int32_t CaptureTimeEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback)
+{
+	callback_ = callback;
+	return encoder_->RegisterEncodeCompleteCallback(callback ? this : nullptr);
+}
+
+void CaptureTimeEncoder::SetRates(const RateControlParameters& parameters)
+{
+	encoder_->SetRates(parameters);
+}
+
+int32_t CaptureTimeEncoder::Encode(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	return encoder_->Encode(frame, frame_types);
+}
+
+webrtc::VideoEncoder::EncoderInfo CaptureTimeEncoder::GetEncoderInfo() const
+{
+	return encoder_->GetEncoderInfo();
+}
+
+webrtc::EncodedImageCallback::Result CaptureTimeEncoder::OnEncodedImage(
+	const webrtc::EncodedImage& encoded_image,
+	const webrtc::CodecSpecificInfo* codec_specific_info)
+{
+	// capture_time_ms_ is the input frame's render time, the capture time on
+	// the rtc clock. The tap also takes a reference to the encoded buffer.
+	ScopedEncodedImage scoped_image(encoded_image);
+	return callback_->OnEncodedImage(encoded_image, codec_specific_info);
+}
+
+void CaptureTimeEncoder::OnDroppedFrame(DropReason reason)
+{
+	callback_->OnDroppedFrame(reason);
+}
+
+} // namespace krtc
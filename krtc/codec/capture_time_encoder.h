@@ -0,0 +1,44 @@
+#ifndef KRTCSDK_KRTC_CODEC_CAPTURE_TIME_ENCODER_H_
+#define KRTCSDK_KRTC_CODEC_CAPTURE_TIME_ENCODER_H_
+
+#include <memory>
+#include <vector>
+
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+
+namespace krtc {
+
+// Outermost wrapper of the factory's encoders. Hands each encoded image on
+// inside a ScopedEncodedImage, so the EncodedFrameTap behind the packetizer
+// learns the frame's capture time and can keep its buffer.
+class CaptureTimeEncoder : public webrtc::VideoEncoder,
+						   public webrtc::EncodedImageCallback {
+public:
+	explicit CaptureTimeEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder);
+	~CaptureTimeEncoder() override;
+
+	// webrtc::VideoEncoder
+	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
+					   int32_t number_of_cores,
+					   size_t max_payload_size) override;
+	int32_t Release() override;
+	int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override;
+	void SetRates(const RateControlParameters& parameters) override;
+	int32_t Encode(const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+	// webrtc::EncodedImageCallback
+	Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+						  const webrtc::CodecSpecificInfo* codec_specific_info) override;
+	void OnDroppedFrame(DropReason reason) override;
+
+private:
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	webrtc::EncodedImageCallback* callback_ = nullptr;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_CAPTURE_TIME_ENCODER_H_
@@ -1,7 +1,13 @@
 #ifndef KRTCSDK_KRTC_CODEC_COMMON_ENCODER_H_
 #define KRTCSDK_KRTC_CODEC_COMMON_ENCODER_H_
 
+#include <algorithm>
+
 #include "third_party/openh264/src/codec/api/svc/codec_app_def.h"
+#include "encoder/video_encoder.h"
+#include "encoded_buffer_pool.h"
+#include "key_frame_governor.h"
+#include "encoder_hint_buffer.h"
 
 namespace krtc{
 
@@ -33,17 +39,145 @@ static webrtc::VideoFrameType ConvertToVideoFrameType(EVideoFrameType type) {
 	return webrtc::VideoFrameType::kEmptyFrame;
 }
 
-static void RtpFragmentize(webrtc::EncodedImage* encoded_image,
-	std::vector<uint8_t>& frame_packet)
+// Hand the I420 planes to the backend as they are, it converts while uploading.
+static xop::VideoImage ToVideoImage(const webrtc::I420BufferInterface& buffer)
+{
+	xop::VideoImage image;
+	image.format = xop::VE_IMAGE_FORMAT_I420;
+	image.width = buffer.width();
+	image.height = buffer.height();
+	image.data[0] = buffer.DataY();
+	image.data[1] = buffer.DataU();
+	image.data[2] = buffer.DataV();
+	image.stride[0] = buffer.StrideY();
+	image.stride[1] = buffer.StrideU();
+	image.stride[2] = buffer.StrideV();
+	return image;
+}
+
+// Feed the key frame requests of this frame to the governor: a layer that
+// starts sending needs one, frame_types carries the receivers' PLI/FIR, the
+// capturer tags scene cuts on the buffer.
+template <typename LayerConfig>
+static KeyFrameGovernor::Decision GovernKeyFrame(KeyFrameGovernor* governor,
+	const std::vector<LayerConfig>& configurations, const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types, int64_t now_ms)
+{
+	bool required = false;
+	for (size_t i = 0; i < configurations.size(); ++i) {
+		if (configurations[i].key_frame_request && configurations[i].sending) {
+			required = true;
+			break;
+		}
+	}
+
+	if (!required && frame_types) {
+		for (size_t i = 0; i < configurations.size(); ++i) {
+			const size_t simulcast_idx =
+				static_cast<size_t>(configurations[i].simulcast_idx);
+			if (configurations[i].sending && simulcast_idx < frame_types->size() &&
+				(*frame_types)[simulcast_idx] == webrtc::VideoFrameType::kVideoFrameKey) {
+				governor->RequestKeyFrame(now_ms);
+				break;
+			}
+		}
+	}
+
+	bool scene_cut = EncoderHintBuffer::Find(frame.video_frame_buffer().get()).scene_cut;
+	return governor->OnFrame(now_ms, required, scene_cut);
+}
+
+// The encoder's periodic IDRs are placed by the governor, the backend runs
+// with an open gop.
+static int64_t PeriodicKeyFrameIntervalMs(const webrtc::VideoCodec& codec)
 {
-	size_t required_capacity = 0;
-	encoded_image->set_size(0);
+	if (codec.H264().keyFrameInterval <= 0 || codec.maxFramerate == 0) {
+		return 0;
+	}
+	return static_cast<int64_t>(codec.H264().keyFrameInterval) * 1000 / codec.maxFramerate;
+}
 
-	required_capacity = frame_packet.size();
-	auto buffer = webrtc::EncodedImageBuffer::Create(required_capacity);
-	encoded_image->SetEncodedData(buffer);
+static void ApplyKeyFrameDecision(xop::VideoEncoder* encoder,
+	KeyFrameGovernor::Decision decision, float frame_rate)
+{
+	if (decision == KeyFrameGovernor::kKeyFrame) {
+		encoder->SetEvent(xop::VE_EVENT_FORCE_IDR, 1);
+	}
+	else if (decision == KeyFrameGovernor::kIntraRefresh) {
+		// Spread the refresh over half a second.
+		encoder->SetEvent(xop::VE_EVENT_INTRA_REFRESH, std::max(1, static_cast<int>(frame_rate / 2)));
+	}
+}
 
-	memcpy(buffer->data(), &frame_packet[0], frame_packet.size());
+static void LogKeyFrameStats(const char* name, const KeyFrameGovernor& governor)
+{
+	KeyFrameGovernor::Stats stats = governor.stats();
+	if (stats.requested == 0 && stats.emitted == 0) {
+		return;
+	}
+	RTC_LOG(LS_INFO) << name << " key frames requested: " << stats.requested
+		<< ", coalesced: " << stats.coalesced
+		<< ", forced: " << stats.forced
+		<< ", intra refreshes: " << stats.intra_refreshes
+		<< ", scene cuts: " << stats.scene_cuts
+		<< ", periodic: " << stats.periodic
+		<< ", emitted: " << stats.emitted;
+}
+
+// Pass the frame's update_rect on, see VideoImage::update_rect. Only valid
+// when the backend saw the previous frame of the source.
+static void SetUpdateRect(const webrtc::VideoFrame& frame, xop::VideoImage* image)
+{
+	if (!frame.has_update_rect()) {
+		return;
+	}
+
+	const webrtc::VideoFrame::UpdateRect& rect = frame.update_rect();
+	image->has_update_rect = true;
+	image->update_rect.x = rect.offset_x;
+	image->update_rect.y = rect.offset_y;
+	image->update_rect.width = rect.width;
+	image->update_rect.height = rect.height;
+}
+
+// Point image at the frame's QpDeltaMap, if the preprocess hook attached one.
+// Keep the returned map alive until the backend took the image.
+static std::shared_ptr<const QpDeltaMap> SetQpDeltaMap(const webrtc::VideoFrame& frame,
+	xop::VideoImage* image)
+{
+	std::shared_ptr<const QpDeltaMap> qp_map = EncoderHintBuffer::Find(frame.video_frame_buffer().get()).qp_map;
+	if (qp_map && !qp_map->deltas.empty()) {
+		image->qp_delta_map = qp_map->deltas.data();
+		image->qp_map_width = qp_map->width;
+		image->qp_map_height = qp_map->height;
+		image->qp_map_block = qp_map->block_size;
+	}
+	return qp_map;
+}
+
+// Frame type and QP of an indexed access unit. The QP parser only sees the
+// parameter sets and the first slice header, not the whole frame. Returns
+// false when the access unit holds no picture.
+static bool ReadFrameInfo(const EncodedBitstreamBuffer& bitstream,
+	webrtc::H264BitstreamParser* parser, EVideoFrameType* frame_type, int* qp)
+{
+	const NalUnitIndex& nal_units = bitstream.nal_units();
+	if (!nal_units.has_picture()) {
+		return false;
+	}
+
+	*frame_type = nal_units.is_idr() ? videoFrameTypeIDR : videoFrameTypeP;
+	parser->ParseBitstream(rtc::ArrayView<const uint8_t>(bitstream.data(), nal_units.SliceHeaderEnd()));
+	*qp = parser->GetLastSliceQp().value_or(-1);
+	return true;
+}
+
+// The backend already wrote the access unit into the pooled buffer, hand it
+// over by reference.
+static void RtpFragmentize(webrtc::EncodedImage* encoded_image,
+	rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream)
+{
+	encoded_image->SetEncodedData(bitstream);
 }
 
 } // namespace krtc
@@ -0,0 +1,183 @@
+#include "encode_pipeline.h"
+
+#include <chrono>
+
+#include "rtc_base/logging.h"
+
+namespace krtc {
+
+namespace {
+
+// Collect() wakes up this often to look at stop_.
+const int kCollectTimeoutMs = 100;
+// Stop() waits this long for the frames in flight, a stuck encoder job
+// must not hold up Release().
+const int kStopDrainTimeoutMs = 2000;
+
+} // namespace
+
+EncodePipeline::EncodePipeline(xop::VideoEncoder* encoder, int depth, DeliverCallback callback)
+	: encoder_(encoder),
+	depth_(depth),
+	async_(depth > 1 && encoder->SupportsAsync()),
+	callback_(callback),
+	// Frames in flight plus the ones still held by the rtp sender.
+	bitstream_pool_(depth > 1 ? depth * 2 + 4 : 8)
+{
+}
+
+EncodePipeline::~EncodePipeline()
+{
+	Stop();
+}
+
+bool EncodePipeline::Start()
+{
+	if (!async_ || collect_thread_) {
+		return true;
+	}
+
+	stop_ = false;
+	failed_ = false;
+	collect_thread_.reset(new std::thread([this] {
+		Run();
+	}));
+	return true;
+}
+
+void EncodePipeline::Stop()
+{
+	if (!collect_thread_) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+
+	collect_thread_->join();
+	collect_thread_.reset();
+}
+
+int EncodePipeline::Encode(const xop::VideoImage& image, const webrtc::EncodedImage& frame_info)
+{
+	if (!async_) {
+		rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream = bitstream_pool_.Acquire();
+		int frame_size = encoder_->Encode(image, bitstream->bitstream());
+		if (frame_size < 0) {
+			return frame_size;
+		}
+		if (frame_size > 0) {
+			bitstream->IndexNalUnits();
+			callback_(frame_info, bitstream);
+			frames_delivered_++;
+		}
+		return 0;
+	}
+
+	uint64_t frame_id = 0;
+	{
+		std::unique_lock<std::mutex> locker(mutex_);
+		cond_.wait(locker, [this] {
+			return failed_ || (int)pending_frames_.size() < depth_;
+		});
+		if (failed_) {
+			return -1;
+		}
+
+		// Queued before Submit() so the collector never sees an unknown id.
+		frame_id = next_frame_id_++;
+		PendingFrame frame;
+		frame.frame_id = frame_id;
+		frame.frame_info = frame_info;
+		pending_frames_.push_back(frame);
+	}
+	cond_.notify_all();
+
+	int ret = encoder_->Submit(image, frame_id);
+	if (ret < 0) {
+		std::lock_guard<std::mutex> locker(mutex_);
+		if (!pending_frames_.empty() && pending_frames_.back().frame_id == frame_id) {
+			pending_frames_.pop_back();
+		}
+		return ret;
+	}
+
+	return 0;
+}
+
+void EncodePipeline::Run()
+{
+	bool stopping = false;
+	std::chrono::steady_clock::time_point stop_deadline;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> locker(mutex_);
+			cond_.wait(locker, [this] {
+				return stop_ || !pending_frames_.empty();
+			});
+			if (pending_frames_.empty()) {
+				break;
+			}
+		}
+
+		rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream = bitstream_pool_.Acquire();
+		uint64_t frame_id = 0;
+		int ret = encoder_->Collect(bitstream->bitstream(), frame_id, kCollectTimeoutMs);
+		if (ret == 0) {
+			bool give_up = false;
+			{
+				std::lock_guard<std::mutex> locker(mutex_);
+				auto now = std::chrono::steady_clock::now();
+				if (stop_ && !stopping) {
+					stopping = true;
+					stop_deadline = now + std::chrono::milliseconds(kStopDrainTimeoutMs);
+				}
+				if (stopping && now >= stop_deadline) {
+					RTC_LOG(LS_ERROR) << "encode pipeline stopped with " << pending_frames_.size()
+						<< " frames still in the encoder, dropped";
+					failed_ = give_up = true;
+					pending_frames_.clear();
+				}
+			}
+			if (give_up) {
+				cond_.notify_all();
+				break;
+			}
+			continue;
+		}
+
+		PendingFrame frame;
+		bool failed = false;
+		{
+			std::lock_guard<std::mutex> locker(mutex_);
+			if (ret < 0 || pending_frames_.empty() || pending_frames_.front().frame_id != frame_id) {
+				RTC_LOG(LS_ERROR) << "encode pipeline collect failed, ret: " << ret
+					<< ", frame id: " << frame_id;
+				failed_ = failed = true;
+				pending_frames_.clear();
+			}
+			else {
+				frame = pending_frames_.front();
+				pending_frames_.pop_front();
+			}
+		}
+		cond_.notify_all();
+
+		if (failed) {
+			break;
+		}
+
+		// Encoder can skip frames, nothing to deliver then.
+		if (!bitstream->bitstream().empty()) {
+			bitstream->IndexNalUnits();
+			callback_(frame.frame_info, bitstream);
+			frames_delivered_++;
+		}
+	}
+}
+
+} // namespace krtc
@@ -0,0 +1,80 @@
+#ifndef KRTCSDK_KRTC_CODEC_ENCODE_PIPELINE_H_
+#define KRTCSDK_KRTC_CODEC_ENCODE_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <api/video/encoded_image.h>
+
+#include "encoded_buffer_pool.h"
+#include "encoder/video_encoder.h"
+
+namespace krtc {
+
+// Keeps up to depth frames in flight on an xop::VideoEncoder backend.
+// Encode() uploads and submits the frame and returns, a collector thread
+// waits for the bitstreams and delivers them in submit order together with
+// the metadata (timestamp, rotation, ...) captured at Encode() time.
+// depth 1 (or a backend without SupportsAsync()) encodes and delivers
+// inline on the caller's thread, same as before.
+class EncodePipeline {
+public:
+	// frame_info carries the input frame's metadata, bitstream is the access unit.
+	typedef std::function<void(const webrtc::EncodedImage& frame_info,
+		rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream)> DeliverCallback;
+
+	EncodePipeline(xop::VideoEncoder* encoder, int depth, DeliverCallback callback);
+	~EncodePipeline();
+
+	bool Start();
+
+	// Delivers the frames still in flight, then stops the collector. Frames
+	// the encoder does not return within a bounded time are dropped.
+	void Stop();
+
+	// Blocks while depth frames are in flight. return 0 on success, < 0 when
+	// the backend failed.
+	int Encode(const xop::VideoImage& image, const webrtc::EncodedImage& frame_info);
+
+	bool is_async() const { return async_; }
+	int depth() const { return async_ ? depth_ : 1; }
+
+	// Any thread.
+	uint64_t frames_delivered() const { return frames_delivered_; }
+
+private:
+	struct PendingFrame {
+		uint64_t frame_id = 0;
+		webrtc::EncodedImage frame_info;
+	};
+
+	void Run();
+
+	xop::VideoEncoder* encoder_;
+	int depth_;
+	bool async_;
+	DeliverCallback callback_;
+
+	std::unique_ptr<std::thread> collect_thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<PendingFrame> pending_frames_;
+	uint64_t next_frame_id_ = 0;
+	bool stop_ = false;
+	bool failed_ = false;
+
+	// Owned by the collector thread (the caller's thread when not async).
+	EncodedBufferPool bitstream_pool_;
+	std::atomic<uint64_t> frames_delivered_{ 0 };
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ENCODE_PIPELINE_H_
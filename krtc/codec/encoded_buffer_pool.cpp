@@ -0,0 +1,46 @@
+#include "encoded_buffer_pool.h"
+
+#include "rtc_base/logging.h"
+
+namespace krtc {
+
+EncodedBufferPool::EncodedBufferPool(size_t max_buffers)
+	: max_buffers_(max_buffers)
+{
+}
+
+EncodedBufferPool::~EncodedBufferPool() = default;
+
+rtc::scoped_refptr<EncodedBitstreamBuffer> EncodedBufferPool::Acquire()
+{
+	for (auto& buffer : buffers_) {
+		// Only the pool holds it, nobody downstream can touch it anymore.
+		if (buffer->HasOneRef()) {
+			buffer->Clear();
+			return buffer;
+		}
+	}
+
+	rtc::scoped_refptr<rtc::RefCountedObject<EncodedBitstreamBuffer>> buffer = CreateBuffer();
+	if (buffers_.size() < max_buffers_) {
+		buffers_.push_back(buffer);
+	}
+	else {
+		RTC_LOG(LS_VERBOSE) << "encoded buffer pool exhausted, size: " << buffers_.size();
+	}
+	return buffer;
+}
+
+void EncodedBufferPool::Release()
+{
+	buffers_.clear();
+}
+
+rtc::scoped_refptr<rtc::RefCountedObject<EncodedBitstreamBuffer>> EncodedBufferPool::CreateBuffer()
+{
+	rtc::scoped_refptr<rtc::RefCountedObject<EncodedBitstreamBuffer>> buffer(
+		new rtc::RefCountedObject<EncodedBitstreamBuffer>());
+	return buffer;
+}
+
+} // namespace krtc
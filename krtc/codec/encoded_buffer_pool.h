@@ -0,0 +1,69 @@
+#ifndef KRTCSDK_KRTC_CODEC_ENCODED_BUFFER_POOL_H_
+#define KRTCSDK_KRTC_CODEC_ENCODED_BUFFER_POOL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <api/scoped_refptr.h>
+#include <api/video/encoded_image.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include "nal_unit_index.h"
+
+namespace krtc {
+
+// Growable bitstream storage the backend encodes into, handed to
+// webrtc::EncodedImage by reference instead of being copied.
+class EncodedBitstreamBuffer : public webrtc::EncodedImageBufferInterface {
+public:
+	const uint8_t* data() const override { return bitstream_.data(); }
+	uint8_t* data() override { return bitstream_.data(); }
+	size_t size() const override { return bitstream_.size(); }
+
+	// Backends write the access unit here, capacity survives between frames.
+	std::vector<uint8_t>& bitstream() { return bitstream_; }
+
+	// Call once the backend is done writing, while the access unit is still
+	// in cache.
+	void IndexNalUnits() { nal_units_.Build(bitstream_.data(), bitstream_.size()); }
+	const NalUnitIndex& nal_units() const { return nal_units_; }
+
+	void Clear() {
+		bitstream_.clear();
+		nal_units_.Clear();
+	}
+
+private:
+	std::vector<uint8_t> bitstream_;
+	NalUnitIndex nal_units_;
+};
+
+// Recycles EncodedBitstreamBuffer once the rtp sender (and any frame
+// transformer) has dropped its reference. Same idea as
+// webrtc::VideoFrameBufferPool, only used from the encoder thread.
+class EncodedBufferPool {
+public:
+	explicit EncodedBufferPool(size_t max_buffers = kDefaultMaxBuffers);
+	~EncodedBufferPool();
+
+	// Returns an empty buffer. Falls back to a non pooled one when all
+	// max_buffers are still in flight.
+	rtc::scoped_refptr<EncodedBitstreamBuffer> Acquire();
+
+	void Release();
+
+	size_t pooled_buffers() const { return buffers_.size(); }
+
+private:
+	static const size_t kDefaultMaxBuffers = 8;
+
+	rtc::scoped_refptr<rtc::RefCountedObject<EncodedBitstreamBuffer>> CreateBuffer();
+
+	size_t max_buffers_;
+	std::vector<rtc::scoped_refptr<rtc::RefCountedObject<EncodedBitstreamBuffer>>> buffers_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ENCODED_BUFFER_POOL_H_
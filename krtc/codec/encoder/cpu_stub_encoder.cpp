@@ -0,0 +1,281 @@
+#include "cpu_stub_encoder.h"
+#include "video_image.h"
+#include <thread>
+
+namespace xop
+{
+
+namespace {
+
+const uint8_t kStartCode[4] = { 0, 0, 0, 1 };
+
+// Constant parameter sets, only the nal types matter to the consumers.
+const uint8_t kSps[] = { 0x67, 0x42, 0xc0, 0x1f, 0x8c, 0x8d, 0x40 };
+const uint8_t kPps[] = { 0x68, 0xce, 0x3c, 0x80 };
+
+void AppendNal(std::vector<uint8_t>& out_frame, const uint8_t* nal, size_t size)
+{
+	out_frame.insert(out_frame.end(), kStartCode, kStartCode + sizeof(kStartCode));
+	out_frame.insert(out_frame.end(), nal, nal + size);
+}
+
+}
+
+CpuStubEncoder::CpuStubEncoder()
+{
+
+}
+
+CpuStubEncoder::~CpuStubEncoder()
+{
+	Destroy();
+}
+
+bool CpuStubEncoder::IsSupported()
+{
+	return true;
+}
+
+bool CpuStubEncoder::Init()
+{
+	if (initialized_) {
+		return false;
+	}
+
+	if (!UpdateOption()) {
+		return false;
+	}
+
+	// One upload surface per frame in flight.
+	size_t surface_size = (dxgi_format_ == VE_OPT_FORMAT_NV12) ? width_ * height_ * 3 / 2 : width_ * height_ * 4;
+	surfaces_.assign(async_depth_, std::vector<uint8_t>(surface_size));
+	last_surface_ = 0;
+	tasks_.clear();
+
+	frames_encoded_ = 0;
+	idr_frames_ = 0;
+	frames_since_idr_ = 0;
+	force_idr_ = true;
+	initialized_ = true;
+	return true;
+}
+
+void CpuStubEncoder::Destroy()
+{
+	initialized_ = false;
+	surfaces_.clear();
+	surfaces_.shrink_to_fit();
+
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	tasks_.clear();
+}
+
+int CpuStubEncoder::Encode(const VideoImage& image, std::vector<uint8_t>& out_frame)
+{
+	if (!initialized_) {
+		return -1;
+	}
+
+	if (image.width != width_ || image.height != height_) {
+		return -4;
+	}
+
+	UpdateEvent();
+	out_frame.clear();
+
+	if (CopyImage(image, 0) < 0) {
+		return -3;
+	}
+
+	if (latency_us_ > 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds(latency_us_));
+	}
+
+	uint64_t frame_number = frames_encoded_;
+	bool idr = NextFrameIsIdr();
+	WriteAccessUnit(idr, frame_number, surfaces_[0], out_frame);
+	return (int)out_frame.size();
+}
+
+int CpuStubEncoder::Encode(const std::vector<uint8_t>& in_image, std::vector<uint8_t>& out_frame)
+{
+	return Encode(PackedImage(in_image.data(), dxgi_format_, width_, height_), out_frame);
+}
+
+int CpuStubEncoder::Submit(const VideoImage& image, uint64_t frame_id)
+{
+	if (!initialized_) {
+		return -1;
+	}
+
+	if (image.width != width_ || image.height != height_) {
+		return -4;
+	}
+
+	Task task;
+	{
+		std::lock_guard<std::mutex> locker(task_mutex_);
+		if ((int)tasks_.size() >= async_depth_) {
+			return VE_ERR_BUSY;
+		}
+
+		// Surfaces are handed out in submit order and collected in the same
+		// order, so the one after the newest task is free.
+		task.surface_index = tasks_.empty()
+			? (last_surface_ + 1) % async_depth_
+			: (tasks_.back().surface_index + 1) % async_depth_;
+	}
+
+	UpdateEvent();
+
+	if (CopyImage(image, task.surface_index) < 0) {
+		return -3;
+	}
+
+	task.frame_id = frame_id;
+	task.frame_number = frames_encoded_;
+	task.idr = NextFrameIsIdr();
+	task.ready_time = std::chrono::steady_clock::now() + std::chrono::microseconds(latency_us_);
+
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	tasks_.push_back(task);
+	task_cond_.notify_one();
+	return 0;
+}
+
+int CpuStubEncoder::Collect(std::vector<uint8_t>& out_frame, uint64_t& frame_id, int timeout_ms)
+{
+	if (!initialized_) {
+		return -1;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	Task task;
+	{
+		std::unique_lock<std::mutex> locker(task_mutex_);
+		if (!task_cond_.wait_until(locker, deadline, [this] { return !tasks_.empty(); })) {
+			return 0;
+		}
+		task = tasks_.front();
+	}
+
+	// The "hardware" finishes the frame at ready_time.
+	if (task.ready_time > deadline) {
+		std::this_thread::sleep_until(deadline);
+		return 0;
+	}
+	std::this_thread::sleep_until(task.ready_time);
+
+	out_frame.clear();
+	WriteAccessUnit(task.idr, task.frame_number, surfaces_[task.surface_index], out_frame);
+	frame_id = task.frame_id;
+
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	last_surface_ = task.surface_index;
+	tasks_.pop_front();
+	return 1;
+}
+
+int CpuStubEncoder::CopyImage(const VideoImage& image, int surface_index)
+{
+	bool copied = false;
+	std::vector<uint8_t>& surface = surfaces_[surface_index];
+
+	if (dxgi_format_ == VE_OPT_FORMAT_NV12) {
+		uint8_t* y_plane = surface.data();
+		copied = CopyImageToNV12(image, y_plane, width_, y_plane + width_ * height_, width_);
+	}
+	else if (dxgi_format_ == VE_OPT_FORMAT_B8G8R8A8) {
+		copied = CopyImageToBGRA(image, surface.data(), width_ * 4);
+	}
+
+	return copied ? surface_index : -1;
+}
+
+bool CpuStubEncoder::NextFrameIsIdr()
+{
+	bool idr = force_idr_ || (gop_ > 0 && frames_since_idr_ >= gop_);
+
+	force_idr_ = false;
+	frames_since_idr_ = idr ? 1 : frames_since_idr_ + 1;
+	frames_encoded_++;
+	if (idr) {
+		idr_frames_++;
+	}
+	return idr;
+}
+
+void CpuStubEncoder::WriteAccessUnit(bool idr, uint64_t frame_number, const std::vector<uint8_t>& surface,
+									 std::vector<uint8_t>& out_frame)
+{
+	if (idr) {
+		AppendNal(out_frame, kSps, sizeof(kSps));
+		AppendNal(out_frame, kPps, sizeof(kPps));
+	}
+
+	// Slice payload: frame number and a sample of the uploaded surface, with
+	// the high bit set so no start code emulation can appear.
+	uint8_t slice[16];
+	slice[0] = idr ? 0x65 : 0x41;
+	for (int i = 0; i < 4; i++) {
+		slice[1 + i] = (uint8_t)((frame_number >> (i * 7)) | 0x80);
+	}
+	size_t step = surface.size() / 11;
+	for (int i = 0; i < 11; i++) {
+		slice[5 + i] = surface[step * i] | 0x80;
+	}
+	AppendNal(out_frame, slice, sizeof(slice));
+}
+
+bool CpuStubEncoder::UpdateOption()
+{
+	width_        = GetOption(VE_OPT_WIDTH, 1920);
+	height_       = GetOption(VE_OPT_HEIGHT, 1080);
+	bitrate_kbps_ = GetOption(VE_OPT_BITRATE_KBPS, 8000);
+	frame_rate_   = GetOption(VE_OPT_FRAME_RATE, 30);
+	gop_          = GetOption(VE_OPT_GOP, 300);
+	dxgi_format_  = GetOption(VE_OPT_TEXTURE_FORMAT, 87);
+	codec_        = GetOption(VE_OPT_CODEC, VE_OPT_CODEC_H264);
+	async_depth_  = GetOption(VE_OPT_ASYNC_DEPTH, 1);
+
+	if (async_depth_ < 1) {
+		async_depth_ = 1;
+	}
+
+	if (width_ <= 0 || height_ <= 0) {
+		return false;
+	}
+
+	if (dxgi_format_ != VE_OPT_FORMAT_NV12 && dxgi_format_ != VE_OPT_FORMAT_B8G8R8A8) {
+		return false;
+	}
+
+	return codec_ == VE_OPT_CODEC_H264;
+}
+
+void CpuStubEncoder::UpdateEvent()
+{
+	std::map<int, int> encoder_events = GetEvent();
+	for (auto iter : encoder_events) {
+		switch (iter.first)
+		{
+		case VE_EVENT_FORCE_IDR:
+			force_idr_ = true;
+			break;
+
+		case VE_EVENT_RESET_BITRATE_KBPS:
+			bitrate_kbps_ = iter.second;
+			break;
+
+		case VE_EVENT_RESET_FRAME_RATE:
+			frame_rate_ = iter.second;
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+}
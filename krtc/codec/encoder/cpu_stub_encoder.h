@@ -0,0 +1,88 @@
+#pragma once
+
+#include "video_encoder.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace xop {
+
+// Software stand-in for the hardware backends, builds on every platform.
+// It uploads the input into a NV12/B8G8R8A8 surface exactly like the d3d
+// backends do and emits a minimal Annex-B access unit (sps/pps/idr or p
+// slice) per frame, so the encode path can be run and measured without a gpu.
+// With VE_OPT_ASYNC_DEPTH > 1 it also acts as an asynchronous backend, every
+// submitted frame completes latency_us after its Submit() and frames in
+// flight overlap like they do on the hardware engines.
+class CpuStubEncoder : public VideoEncoder
+{
+public:
+	CpuStubEncoder();
+	virtual ~CpuStubEncoder();
+
+	static bool IsSupported();
+
+	virtual bool Init() override;
+	virtual void Destroy() override;
+
+	virtual int  Encode(const VideoImage& image, std::vector<uint8_t>& out_frame) override;
+
+	virtual int  Encode(const std::vector<uint8_t>& in_image, std::vector<uint8_t>& out_frame);
+
+	virtual bool SupportsAsync() override { return true; }
+	virtual int  Submit(const VideoImage& image, uint64_t frame_id) override;
+	virtual int  Collect(std::vector<uint8_t>& out_frame, uint64_t& frame_id, int timeout_ms) override;
+
+	// Simulated encode latency of one frame, set before Init().
+	void SetLatency(int latency_us) { latency_us_ = latency_us; }
+
+	// Upload surface of the last frame.
+	const std::vector<uint8_t>& surface() const { return surfaces_[last_surface_]; }
+
+	uint64_t frames_encoded() const { return frames_encoded_; }
+	uint64_t idr_frames() const { return idr_frames_; }
+
+private:
+	struct Task
+	{
+		uint64_t frame_id = 0;
+		uint64_t frame_number = 0;
+		int  surface_index = 0;
+		bool idr = false;
+		std::chrono::steady_clock::time_point ready_time;
+	};
+
+	bool UpdateOption();
+	void UpdateEvent();
+	int  CopyImage(const VideoImage& image, int surface_index);
+	bool NextFrameIsIdr();
+	void WriteAccessUnit(bool idr, uint64_t frame_number, const std::vector<uint8_t>& surface,
+						 std::vector<uint8_t>& out_frame);
+
+	bool initialized_  = false;
+	bool force_idr_    = false;
+
+	int width_         = 1920;
+	int height_        = 1080;
+	int bitrate_kbps_  = 8000;
+	int frame_rate_    = 30;
+	int gop_           = 300;
+	int dxgi_format_   = 87;
+	int codec_         = 1;
+	int async_depth_   = 1;
+	int latency_us_    = 0;
+
+	std::vector<std::vector<uint8_t>> surfaces_;
+	int last_surface_  = 0;
+
+	std::mutex task_mutex_;
+	std::condition_variable task_cond_;
+	std::deque<Task> tasks_;
+	uint64_t frames_encoded_ = 0;
+	uint64_t idr_frames_     = 0;
+	int frames_since_idr_    = 0;
+};
+
+}
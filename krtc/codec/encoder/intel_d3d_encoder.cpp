@@ -1,6 +1,7 @@
 #include "intel_d3d_encoder.h"
+#include "video_image.h"
+#include "qp_map.h"
 #include "common_utils.h"
-#include "libyuv.h"
 #include <Windows.h>
 #include <versionhelpers.h>
 
@@ -67,6 +68,65 @@ bool IntelD3DEncoder::IsSupported()
 	return sts == MFX_ERR_NONE;
 }
 
+bool IntelD3DEncoder::QueryCapability(EncoderCapability& capability)
+{
+	capability = EncoderCapability();
+
+	mfxVersion mfx_ver = { {0, 1} };
+	mfxIMPL mfx_impl = MFX_IMPL_AUTO_ANY;
+	mfx_impl |= IsWindows8OrGreater() ? MFX_IMPL_VIA_D3D11 : MFX_IMPL_VIA_D3D9;
+
+	MFXVideoSession mfx_session;
+	if (mfx_session.Init(mfx_impl, &mfx_ver) != MFX_ERR_NONE) {
+		return false;
+	}
+
+	// Query() accepts or rejects a configuration, walk down from 4k to find
+	// the largest one the driver takes.
+	static const mfxU16 kResolutions[][2] = {
+		{ 4096, 2304 }, { 3840, 2160 }, { 2560, 1440 }, { 1920, 1088 }, { 1280, 720 }
+	};
+
+	auto query = [&mfx_session](mfxU32 codec_id, mfxU16 width, mfxU16 height) {
+		MFXVideoENCODE mfx_encoder(mfx_session);
+		mfxVideoParam in_params, out_params;
+		memset(&in_params, 0, sizeof(mfxVideoParam));
+		in_params.mfx.CodecId = codec_id;
+		in_params.mfx.TargetUsage = MFX_TARGETUSAGE_BEST_SPEED;
+		in_params.mfx.RateControlMethod = MFX_RATECONTROL_CBR;
+		in_params.mfx.TargetKbps = 4000;
+		in_params.mfx.FrameInfo.FourCC = MFX_FOURCC_NV12;
+		in_params.mfx.FrameInfo.ChromaFormat = MFX_CHROMAFORMAT_YUV420;
+		in_params.mfx.FrameInfo.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+		in_params.mfx.FrameInfo.FrameRateExtN = 30;
+		in_params.mfx.FrameInfo.FrameRateExtD = 1;
+		in_params.mfx.FrameInfo.Width = width;
+		in_params.mfx.FrameInfo.Height = height;
+		in_params.mfx.FrameInfo.CropW = width;
+		in_params.mfx.FrameInfo.CropH = height;
+		in_params.IOPattern = MFX_IOPATTERN_IN_SYSTEM_MEMORY;
+		out_params = in_params;
+		mfxStatus sts = mfx_encoder.Query(&in_params, &out_params);
+		// A corrected (smaller) resolution means this one is not supported.
+		return (sts == MFX_ERR_NONE || sts == MFX_WRN_INCOMPATIBLE_VIDEO_PARAM) &&
+			out_params.mfx.FrameInfo.Width == width && out_params.mfx.FrameInfo.Height == height;
+	};
+
+	for (auto& resolution : kResolutions) {
+		if (query(MFX_CODEC_AVC, resolution[0], resolution[1])) {
+			capability.h264 = true;
+			capability.max_width = resolution[0];
+			capability.max_height = resolution[1];
+			break;
+		}
+	}
+	capability.hevc = query(MFX_CODEC_HEVC, 1920, 1088);
+	capability.supported = capability.h264 || capability.hevc;
+
+	mfx_session.Close();
+	return capability.supported;
+}
+
 bool IntelD3DEncoder::Init()
 {
 	if (mfx_encoder_) {
@@ -135,22 +195,27 @@ void IntelD3DEncoder::Destroy()
 	}
 }
 
-int IntelD3DEncoder::Encode(std::vector<uint8_t> in_image, std::vector<uint8_t>& out_frame)
+int IntelD3DEncoder::Encode(const VideoImage& image, std::vector<uint8_t>& out_frame)
 {
 	if (!mfx_encoder_) {
 		return -1;
 	}
 
+	if (image.width != width_ || image.height != height_) {
+		return -4;
+	}
+
 	if (!UpdateEvent()) {
 		return -2;
 	}
 
-	int frame_index = CopyImage(in_image);
+	int frame_index = CopyImage(image);
 	if (frame_index < 0) {
 		return -3;
 	}
 
-	int frame_size = EncodeFrame(frame_index, out_frame);
+	FrameControl* control = SetFrameControl(image, frame_control_.get()) ? frame_control_.get() : nullptr;
+	int frame_size = EncodeFrame(frame_index, control, out_frame);
 	if (frame_size < 0) {
 		LOG("Encode frame failed.");
 	}
@@ -158,7 +223,103 @@ int IntelD3DEncoder::Encode(std::vector<uint8_t> in_image, std::vector<uint8_t>&
 	return frame_size;
 }
 
-int IntelD3DEncoder::CopyImage(std::vector<uint8_t>& in_image)
+int IntelD3DEncoder::Encode(const std::vector<uint8_t>& in_image, std::vector<uint8_t>& out_frame)
+{
+	return Encode(PackedImage(in_image.data(), dxgi_format_, width_, height_), out_frame);
+}
+
+int IntelD3DEncoder::Submit(const VideoImage& image, uint64_t frame_id)
+{
+	if (!mfx_encoder_ || async_tasks_.empty()) {
+		return -1;
+	}
+
+	if (image.width != width_ || image.height != height_) {
+		return -4;
+	}
+
+	{
+		std::lock_guard<std::mutex> locker(task_mutex_);
+		if (busy_tasks_.size() >= async_tasks_.size()) {
+			return VE_ERR_BUSY;
+		}
+	}
+
+	if (!UpdateEvent()) {
+		return -2;
+	}
+
+	int frame_index = CopyImage(image);
+	if (frame_index < 0) {
+		return -3;
+	}
+
+	// Tasks are collected in submit order, so this one is free.
+	int task_index = (int)(submitted_frames_ % async_tasks_.size());
+	AsyncTask& task = async_tasks_[task_index];
+	task.syncp = nullptr;
+	task.frame_id = frame_id;
+
+	FrameControl* control = SetFrameControl(image, task.control.get()) ? task.control.get() : nullptr;
+	mfxStatus sts = SubmitFrame(frame_index, &task.bitstream, &task.syncp, control);
+	if (sts != MFX_ERR_NONE && sts != MFX_ERR_MORE_DATA) {
+		LOG("Submit frame failed.");
+		return -5;
+	}
+
+	submitted_frames_++;
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	busy_tasks_.push_back(task_index);
+	task_cond_.notify_all();
+	return 0;
+}
+
+int IntelD3DEncoder::Collect(std::vector<uint8_t>& out_frame, uint64_t& frame_id, int timeout_ms)
+{
+	if (!mfx_encoder_) {
+		return -1;
+	}
+
+	int task_index = 0;
+	{
+		std::unique_lock<std::mutex> locker(task_mutex_);
+		if (!task_cond_.wait_for(locker, std::chrono::milliseconds(timeout_ms),
+								 [this] { return !busy_tasks_.empty(); })) {
+			return 0;
+		}
+		task_index = busy_tasks_.front();
+	}
+
+	AsyncTask& task = async_tasks_[task_index];
+	out_frame.clear();
+
+	// No syncp: the frame was buffered without output, deliver nothing.
+	if (task.syncp) {
+		mfxStatus sts = mfx_session_.SyncOperation(task.syncp, timeout_ms);
+		if (sts == MFX_WRN_IN_EXECUTION) {
+			return 0;
+		}
+		if (sts != MFX_ERR_NONE) {
+			LOG("Sync frame failed.");
+			return -2;
+		}
+
+		out_frame.insert(out_frame.end(), task.bitstream.Data + task.bitstream.DataOffset,
+						 task.bitstream.Data + task.bitstream.DataOffset + task.bitstream.DataLength);
+		task.bitstream.DataOffset = 0;
+		task.bitstream.DataLength = 0;
+	}
+
+	frame_id = task.frame_id;
+
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	busy_tasks_.pop_front();
+	// A rate change in Submit() may wait for the queue to drain.
+	task_cond_.notify_all();
+	return 1;
+}
+
+int IntelD3DEncoder::CopyImage(const VideoImage& image)
 {
 	mfxStatus sts = MFX_ERR_NONE;
 
@@ -169,86 +330,77 @@ int IntelD3DEncoder::CopyImage(std::vector<uint8_t>& in_image)
 	sts = mfx_allocator_.Lock(mfx_allocator_.pthis, mfx_surfaces_[index].Data.MemId, &(mfx_surfaces_[index].Data));
 	MSDK_CHECK_ERROR(MFX_ERR_NOT_FOUND, index, MFX_ERR_LOCK_MEMORY);
 
-	// load nv12 
-	mfxU16 w, h, i, pitch;
-	mfxU8* ptr = nullptr;
+	// Convert (or copy) straight into the locked surface.
+	bool copied = false;
 	mfxFrameInfo* info = &mfx_surfaces_[index].Info;
 	mfxFrameData* data = &mfx_surfaces_[index].Data;
-
-	pitch = data->Pitch;
-
-	if (info->CropH > 0 && info->CropW > 0) {
-		w = info->CropW;
-		h = info->CropH;
-	}
-	else {
-		w = info->Width;
-		h = info->Height;
-	}
+	mfxU16 pitch = data->Pitch;
 
 	if (dxgi_format_ == VE_OPT_FORMAT_NV12) {
-		ptr = data->Y + info->CropX + info->CropY * data->Pitch;
-		uint8_t* data_y = in_image.data();
-		uint8_t* data_uv = in_image.data() + width_ * height_;
-		int stride_y = w;
-		int stride_uv = w; // (width + 1) / 2;
-
-		for (i = 0; i < h; i++) {
-			memcpy(ptr + i * pitch, data_y + i * stride_y, w);
-		}
-
-		h /= 2;
-		ptr = data->UV + info->CropX + (info->CropY / 2) * pitch;
-		for (i = 0; i < h; i++) {
-			memcpy(ptr + i * pitch, data_uv + i * stride_uv, w);
-		}
+		copied = CopyImageToNV12(image,
+								 data->Y + info->CropX + info->CropY * pitch, pitch,
+								 data->UV + info->CropX + (info->CropY / 2) * pitch, pitch);
 	}
 	else if (dxgi_format_ == VE_OPT_FORMAT_B8G8R8A8) {
-		ptr = data->B + info->CropX + info->CropY * data->Pitch;
-		uint8_t* data_bgra = in_image.data();
-		for (int y = 0; y < h; y++) {
-			memcpy(ptr + y * pitch, data_bgra + y * w * 4, w * 4);
-		}
+		copied = CopyImageToBGRA(image, data->B + info->CropX * 4 + info->CropY * pitch, pitch);
 	}
 
 	sts = mfx_allocator_.Unlock(mfx_allocator_.pthis, mfx_surfaces_[index].Data.MemId, &(mfx_surfaces_[index].Data));
 	MSDK_CHECK_ERROR(MFX_ERR_NOT_FOUND, index, MFX_ERR_UNKNOWN);
 
+	if (!copied) {
+		return -1;
+	}
+
 	return index;
 }
 
-int IntelD3DEncoder::EncodeFrame(int suface_index, std::vector<uint8_t>& out_frame)
+bool IntelD3DEncoder::SetFrameControl(const VideoImage& image, FrameControl* control)
 {
-	mfxSyncPoint syncp;
-	mfxStatus sts = MFX_ERR_NONE;
-	uint32_t frame_size = 0;
+	// Hardware usually takes a handful of ROI rectangles only.
+	static const size_t kMaxRoiRects = 8;
 
-	for (;;) {
-		// Encode a frame asychronously (returns immediately)
-		mfxEncodeCtrl* enc_ctrl = nullptr;
-		if (enc_ctrl_.FrameType) {
-			enc_ctrl = &enc_ctrl_;
-		}
-		sts = mfx_encoder_->EncodeFrameAsync(enc_ctrl, &mfx_surfaces_[suface_index], &mfx_enc_bs_, &syncp);
-		enc_ctrl_.FrameType = 0;
+	if (!control || !roi_supported_ || !image.qp_delta_map) {
+		return false;
+	}
 
-		if (MFX_ERR_NONE < sts && !syncp) {  // Repeat the call if warning and no output
-			if (MFX_WRN_DEVICE_BUSY == sts)
-				MSDK_SLEEP(1);  // Wait if device is busy, then repeat the same call
-		}
-		else if (MFX_ERR_NONE < sts && syncp) {
-			sts = MFX_ERR_NONE;     // Ignore warnings if output is available
-			break;
-		}
-		else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts) {
-			// Allocate more bitstream buffer memory here if needed...
-			break;
-		}
-		else {
-			break;
-		}
+	std::vector<QpRect> rects;
+	QpMapToRects(image, kMaxRoiRects, rects);
+	if (rects.empty()) {
+		return false;
 	}
 
+	memset(control, 0, sizeof(FrameControl));
+	control->roi.Header.BufferId = MFX_EXTBUFF_ENCODER_ROI;
+	control->roi.Header.BufferSz = sizeof(mfxExtEncoderROI);
+	control->roi.ROIMode = MFX_ROI_MODE_QP_DELTA;
+	control->ext_buffers[0] = (mfxExtBuffer*)(&control->roi);
+	control->ctrl.ExtParam = control->ext_buffers;
+	control->ctrl.NumExtParam = 1;
+
+	// Rectangles are aligned to the MB (CTB for HEVC) grid.
+	mfxU32 align = (codec_ == VE_OPT_CODEC_HEVC) ? 32 : 16;
+	mfxU32 max_right = mfx_enc_params_.mfx.FrameInfo.Width;
+	mfxU32 max_bottom = mfx_enc_params_.mfx.FrameInfo.Height;
+	for (auto& r : rects) {
+		auto& roi = control->roi.ROI[control->roi.NumROI++];
+		roi.Left = r.rect.x / align * align;
+		roi.Top = r.rect.y / align * align;
+		roi.Right = (std::min)((r.rect.x + r.rect.width + align - 1) / align * align, max_right);
+		roi.Bottom = (std::min)((r.rect.y + r.rect.height + align - 1) / align * align, max_bottom);
+		roi.DeltaQP = (mfxI16)(std::max)(-51, (std::min)(51, r.delta_qp));
+	}
+
+	return true;
+}
+
+int IntelD3DEncoder::EncodeFrame(int suface_index, FrameControl* control, std::vector<uint8_t>& out_frame)
+{
+	mfxSyncPoint syncp = nullptr;
+	uint32_t frame_size = 0;
+
+	mfxStatus sts = SubmitFrame(suface_index, &mfx_enc_bs_, &syncp, control);
+
 	if (MFX_ERR_NONE == sts) {
 		sts = mfx_session_.SyncOperation(syncp, 60000);   // Synchronize. Wait until encoded frame is ready
 		MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
@@ -276,6 +428,53 @@ int IntelD3DEncoder::EncodeFrame(int suface_index, std::vector<uint8_t>& out_fra
 	return frame_size;
 }
 
+mfxStatus IntelD3DEncoder::SubmitFrame(int suface_index, mfxBitstream* bitstream, mfxSyncPoint* syncp,
+									   FrameControl* control)
+{
+	mfxStatus sts = MFX_ERR_NONE;
+	mfxU16 frame_type = enc_ctrl_.FrameType;
+
+	for (;;) {
+		// Encode a frame asychronously (returns immediately)
+		mfxEncodeCtrl* enc_ctrl = nullptr;
+		if (control) {
+			control->ctrl.FrameType = frame_type;
+			enc_ctrl = &control->ctrl;
+		}
+		else if (frame_type) {
+			enc_ctrl = &enc_ctrl_;
+		}
+		sts = mfx_encoder_->EncodeFrameAsync(enc_ctrl, &mfx_surfaces_[suface_index], bitstream, syncp);
+
+		if (MFX_ERR_NONE < sts && !*syncp) {  // Repeat the call if warning and no output
+			if (MFX_WRN_DEVICE_BUSY == sts)
+				MSDK_SLEEP(1);  // Wait if device is busy, then repeat the same call
+		}
+		else if (MFX_ERR_NONE < sts && *syncp) {
+			sts = MFX_ERR_NONE;     // Ignore warnings if output is available
+			break;
+		}
+		else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts) {
+			// Allocate more bitstream buffer memory here if needed...
+			break;
+		}
+		else {
+			break;
+		}
+	}
+
+	// Runtimes without QP delta ROI reject the control, go on without it.
+	if (control && sts < MFX_ERR_NONE && sts != MFX_ERR_MORE_DATA && sts != MFX_ERR_NOT_ENOUGH_BUFFER) {
+		LOG("ROI encoding is not supported (%d).", sts);
+		roi_supported_ = false;
+		return SubmitFrame(suface_index, bitstream, syncp, nullptr);
+	}
+
+	enc_ctrl_.FrameType = 0;
+
+	return sts;
+}
+
 bool IntelD3DEncoder::UpdateOption()
 {
 	gpu_index_ = GetOption(VE_OPT_GPU_INDEX, 0);
@@ -286,6 +485,10 @@ bool IntelD3DEncoder::UpdateOption()
 	gop_ = GetOption(VE_OPT_GOP, 300);
 	dxgi_format_ = GetOption(VE_OPT_TEXTURE_FORMAT, 87);
 	codec_ = GetOption(VE_OPT_CODEC, VE_OPT_CODEC_H264);
+	async_depth_ = GetOption(VE_OPT_ASYNC_DEPTH, 1);
+	if (async_depth_ < 1) {
+		async_depth_ = 1;
+	}
 
 	memset(&mfx_enc_params_, 0, sizeof(mfx_enc_params_));
 
@@ -327,8 +530,9 @@ bool IntelD3DEncoder::UpdateOption()
 	mfx_enc_params_.mfx.FrameInfo.CropH = height_;
 	mfx_enc_params_.mfx.RateControlMethod = MFX_RATECONTROL_CBR;
 	mfx_enc_params_.mfx.TargetKbps = bitrate_kbps_;
-	mfx_enc_params_.mfx.GopPicSize = static_cast<mfxU16>(gop_); 
-	mfx_enc_params_.mfx.IdrInterval = static_cast<mfxU16>(gop_);
+	// gop_ 0: no periodic IDR, the caller forces them.
+	mfx_enc_params_.mfx.GopPicSize = gop_ > 0 ? static_cast<mfxU16>(gop_) : 0xFFFF;
+	mfx_enc_params_.mfx.IdrInterval = gop_ > 0 ? static_cast<mfxU16>(gop_) : 0;
 
 	// Width must be a multiple of 16
 	// Height must be a multiple of 16 in case of frame picture and a
@@ -342,7 +546,8 @@ bool IntelD3DEncoder::UpdateOption()
 	mfx_enc_params_.IOPattern = MFX_IOPATTERN_IN_VIDEO_MEMORY;
 
 	// Configuration for low latency
-	mfx_enc_params_.AsyncDepth = 1;  //1 is best for low latency
+	// 1 is best for low latency, > 1 keeps several frames in flight (Submit/Collect)
+	mfx_enc_params_.AsyncDepth = static_cast<mfxU16>(async_depth_);
 	mfx_enc_params_.mfx.GopRefDist = 1; //1 is best for low latency, I and P frames only
 
 	memset(&extended_coding_options_, 0, sizeof(mfxExtCodingOption));
@@ -374,19 +579,6 @@ bool IntelD3DEncoder::UpdateEvent()
 	}
 
 	std::map<int, int> encoder_events = GetEvent();
-	if (encoder_events.empty()) {
-		return true;
-	}
-
-	bool config_updated = false;
-	mfxVideoParam video_param;
-	memset(&video_param, 0, sizeof(mfxVideoParam));
-	mfxStatus status = mfx_encoder_->GetVideoParam(&video_param);
-	MSDK_IGNORE_MFX_STS(status, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
-	if (status != MFX_ERR_NONE) {
-		return false;
-	}
-
 	for (auto iter : encoder_events) {
 		int event = iter.first;
 		int value = iter.second;
@@ -398,13 +590,11 @@ bool IntelD3DEncoder::UpdateEvent()
 			break;
 
 		case VE_EVENT_RESET_BITRATE_KBPS:
-			config_updated = true;
-			video_param.mfx.TargetKbps= value;
+			pending_bitrate_kbps_ = value;
 			break;
 
 		case VE_EVENT_RESET_FRAME_RATE:
-			config_updated = true;
-			video_param.mfx.FrameInfo.FrameRateExtN = value;
+			pending_frame_rate_ = value;
 			break;
 
 		default:
@@ -412,13 +602,63 @@ bool IntelD3DEncoder::UpdateEvent()
 		}
 	}
 
+	return ApplyRates();
+}
+
+bool IntelD3DEncoder::ApplyRates()
+{
+	// Submits that may pass before the pipeline is drained for a rate change.
+	static const int kMaxDeferredSubmits = 8;
+	static const int kDrainTimeoutMs = 1000;
+
+	if (pending_bitrate_kbps_ <= 0 && pending_frame_rate_ <= 0) {
+		return true;
+	}
+
+	// Reset() with frames queued in the SDK invalidates their syncps, and it
+	// must not run next to Collect()'s SyncOperation(). Collect() only syncs
+	// a task in busy_tasks_, so an empty queue under task_mutex_ covers both.
+	std::unique_lock<std::mutex> locker(task_mutex_);
+	if (!busy_tasks_.empty()) {
+		if (++deferred_submits_ < kMaxDeferredSubmits) {
+			return true;
+		}
+		if (!task_cond_.wait_for(locker, std::chrono::milliseconds(kDrainTimeoutMs),
+								 [this] { return busy_tasks_.empty(); })) {
+			LOG("Frames still in flight, rates not changed.");
+			return false;
+		}
+	}
+	deferred_submits_ = 0;
+
+	mfxVideoParam video_param;
+	memset(&video_param, 0, sizeof(mfxVideoParam));
+	mfxStatus status = mfx_encoder_->GetVideoParam(&video_param);
+	MSDK_IGNORE_MFX_STS(status, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
+	if (status != MFX_ERR_NONE) {
+		return false;
+	}
+
+	// SetRates() repeats unchanged rates, those cost no Reset().
+	bool config_updated = false;
+	if (pending_bitrate_kbps_ > 0 && video_param.mfx.TargetKbps != pending_bitrate_kbps_) {
+		config_updated = true;
+		video_param.mfx.TargetKbps = static_cast<mfxU16>(pending_bitrate_kbps_);
+	}
+	if (pending_frame_rate_ > 0 && (video_param.mfx.FrameInfo.FrameRateExtN != (mfxU32)pending_frame_rate_ ||
+									video_param.mfx.FrameInfo.FrameRateExtD != 1)) {
+		config_updated = true;
+		video_param.mfx.FrameInfo.FrameRateExtN = pending_frame_rate_;
+		video_param.mfx.FrameInfo.FrameRateExtD = 1;
+	}
+	pending_bitrate_kbps_ = 0;
+	pending_frame_rate_ = 0;
+
 	if (config_updated) {
-		if (status == MFX_ERR_NONE) {
-			status = mfx_encoder_->Reset(&video_param);
-			MSDK_IGNORE_MFX_STS(status, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
-			if (status != MFX_ERR_NONE) {
-				return false;
-			}
+		status = mfx_encoder_->Reset(&video_param);
+		MSDK_IGNORE_MFX_STS(status, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
+		if (status != MFX_ERR_NONE) {
+			return false;
 		}
 	}
 
@@ -482,6 +722,20 @@ bool IntelD3DEncoder::AllocateBuffer()
 	mfx_enc_bs_.MaxLength = param.mfx.BufferSizeInKB * 1000;
 	bst_enc_data_.resize(mfx_enc_bs_.MaxLength);
 	mfx_enc_bs_.Data = bst_enc_data_.data();
+
+	if (async_depth_ > 1) {
+		async_tasks_.resize(async_depth_);
+		for (auto& task : async_tasks_) {
+			memset(&task.bitstream, 0, sizeof(mfxBitstream));
+			task.bitstream.MaxLength = mfx_enc_bs_.MaxLength;
+			task.data.resize(task.bitstream.MaxLength);
+			task.bitstream.Data = task.data.data();
+			task.syncp = nullptr;
+			task.control.reset(new FrameControl);
+		}
+	}
+	frame_control_.reset(new FrameControl);
+	submitted_frames_ = 0;
 	return true;
 }
 
@@ -489,6 +743,10 @@ void IntelD3DEncoder::FreeBuffer()
 {
 	memset(&mfx_enc_bs_, 0, sizeof(mfxBitstream));
 	bst_enc_data_.clear();
+
+	std::lock_guard<std::mutex> locker(task_mutex_);
+	busy_tasks_.clear();
+	async_tasks_.clear();
 }
 
 bool IntelD3DEncoder::GetVideoParam()
@@ -2,7 +2,9 @@
 
 #include "video_encoder.h"
 #include "mfxvideo++.h"
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <string>
 #include <memory>
 #include <vector>
@@ -17,21 +19,52 @@ public:
 
 	static bool IsSupported();
 
+	// Loads the driver and opens a session, slow. Probed once at startup.
+	static bool QueryCapability(EncoderCapability& capability);
+
 	virtual bool Init() override;
 	virtual void Destroy()override;
 
-	virtual int  Encode(std::vector<uint8_t> image, std::vector<uint8_t>& out_frame);
+	virtual int  Encode(const VideoImage& image, std::vector<uint8_t>& out_frame) override;
+
+	virtual int  Encode(const std::vector<uint8_t>& image, std::vector<uint8_t>& out_frame);
+
+	virtual bool SupportsAsync() override { return true; }
+	virtual int  Submit(const VideoImage& image, uint64_t frame_id) override;
+	virtual int  Collect(std::vector<uint8_t>& out_frame, uint64_t& frame_id, int timeout_ms) override;
 
 private:
+	// Per frame ROI from VideoImage::qp_delta_map, has to stay valid until
+	// the frame is synced.
+	struct FrameControl
+	{
+		mfxEncodeCtrl    ctrl;
+		mfxExtEncoderROI roi;
+		mfxExtBuffer*    ext_buffers[1];
+	};
+
+	// One bitstream per frame in flight (VE_OPT_ASYNC_DEPTH).
+	struct AsyncTask
+	{
+		mfxBitstream bitstream;
+		std::vector<mfxU8> data;
+		mfxSyncPoint syncp = nullptr;
+		uint64_t frame_id = 0;
+		std::unique_ptr<FrameControl> control;
+	};
+
 	bool UpdateOption();
 	bool UpdateEvent();
+	bool ApplyRates();
 	bool AllocateSurfaces();
 	void FreeSurface();
 	bool AllocateBuffer();
 	void FreeBuffer();
 	bool GetVideoParam();
-	int  CopyImage(std::vector<uint8_t>& in_image);
-	int  EncodeFrame(int suface_index, std::vector<uint8_t>& out_frame);
+	int  CopyImage(const VideoImage& image);
+	bool SetFrameControl(const VideoImage& image, FrameControl* control);
+	int  EncodeFrame(int suface_index, FrameControl* control, std::vector<uint8_t>& out_frame);
+	mfxStatus SubmitFrame(int suface_index, mfxBitstream* bitstream, mfxSyncPoint* syncp, FrameControl* control);
 
 	bool use_d3d11_ = false;
 	bool use_d3d9_ = false;
@@ -44,6 +77,7 @@ private:
 	int gop_ = 300;
 	int codec_ = 1;
 	int dxgi_format_ = 87;
+	int async_depth_ = 1;
 
 	mfxIMPL                mfx_impl_;
 	mfxVersion             mfx_ver_;
@@ -56,6 +90,8 @@ private:
 	mfxExtCodingOption2    extended_coding_options2_;
 	mfxExtBuffer* extended_buffers_[2];
 	mfxEncodeCtrl          enc_ctrl_;
+	std::unique_ptr<FrameControl> frame_control_;  // synchronous Encode()
+	bool                   roi_supported_ = true;
 
 	std::unique_ptr<MFXVideoENCODE> mfx_encoder_;
 
@@ -63,6 +99,16 @@ private:
 	std::vector<mfxU8>     bst_enc_data_;
 	std::vector<mfxFrameSurface1> mfx_surfaces_;
 
+	std::vector<AsyncTask> async_tasks_;
+	std::deque<int>        busy_tasks_;
+	uint64_t               submitted_frames_ = 0;
+	// Rate changes from UpdateEvent(), applied once no frame is in flight.
+	int                    pending_bitrate_kbps_ = 0;
+	int                    pending_frame_rate_ = 0;
+	int                    deferred_submits_ = 0;
+	std::mutex             task_mutex_;
+	std::condition_variable task_cond_;
+
 	mfxU16 sps_size_ = 0;
 	mfxU16 pps_size_ = 0;
 	std::unique_ptr<mfxU8[]> sps_buffer_;
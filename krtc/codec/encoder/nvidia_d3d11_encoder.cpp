@@ -1,4 +1,6 @@
 #include "nvidia_d3d11_encoder.h"
+#include "video_image.h"
+#include "qp_map.h"
 
 #ifdef WIN32
 #include <Windows.h>
@@ -83,6 +85,41 @@ bool NvidiaD3D11Encoder::IsSupported()
 #endif
 }
 
+bool NvidiaD3D11Encoder::QueryCapability(EncoderCapability& capability)
+{
+	capability = EncoderCapability();
+	if (!IsSupported()) {
+		return false;
+	}
+
+	NvidiaD3D11Encoder encoder;
+	if (!encoder.UpdateOption() || !encoder.InitD3D11()) {
+		return false;
+	}
+
+	// An open session is enough to read the caps, no encoder is created.
+	NvEncoderD3D11* nv_encoder = nullptr;
+	try {
+		nv_encoder = new NvEncoderD3D11(encoder.d3d11_device_, encoder.width_, encoder.height_,
+										encoder.nv_buffer_format_, 0);
+	}
+	catch (const NVENCException& e) {
+		LOG("Failed to open nvidia encode session, %s", e.what());
+		return false;
+	}
+
+	capability.h264 = nv_encoder->GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_WIDTH_MAX) > 0;
+	capability.hevc = nv_encoder->GetCapabilityValue(NV_ENC_CODEC_HEVC_GUID, NV_ENC_CAPS_WIDTH_MAX) > 0;
+	if (capability.h264) {
+		capability.max_width = nv_encoder->GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_WIDTH_MAX);
+		capability.max_height = nv_encoder->GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_HEIGHT_MAX);
+	}
+	capability.supported = capability.h264 || capability.hevc;
+
+	delete nv_encoder;
+	return capability.supported;
+}
+
 bool NvidiaD3D11Encoder::Init()
 {
 	if (nv_encoder_) {
@@ -118,14 +155,18 @@ bool NvidiaD3D11Encoder::Init()
 	initialize_params.maxEncodeWidth = width_;
 	initialize_params.maxEncodeHeight = height_;
 	initialize_params.frameRateNum = frame_rate_;
-	initialize_params.encodeConfig->gopLength = gop_;
+	// gop_ 0: no periodic IDR, the caller forces them.
+	initialize_params.encodeConfig->gopLength = gop_ > 0 ? gop_ : NVENC_INFINITE_GOPLENGTH;
 	initialize_params.encodeConfig->rcParams.averageBitRate = bitrate_kbps_ * 1000;
 	initialize_params.encodeConfig->rcParams.maxBitRate = bitrate_kbps_ * 1000;
 	initialize_params.encodeConfig->rcParams.rateControlMode = NV_ENC_PARAMS_RC_CBR;
+	// VideoImage::qp_delta_map is applied on top of the rate control QP.
+	initialize_params.encodeConfig->rcParams.qpMapMode = NV_ENC_QP_MAP_DELTA;
 
 	try {
 		nv_encoder_->CreateEncoder(&initialize_params);
 		nv_encoder_->ForceIDR();
+		intra_refresh_supported_ = nv_encoder_->GetCapabilityValue(nv_codec_id_, NV_ENC_CAPS_SUPPORT_INTRA_REFRESH) != 0;
 	}
 	catch (const NVENCException& e) {
 		LOG("Failed to init nvidia encoder, %s", e.what());
@@ -144,61 +185,89 @@ void NvidiaD3D11Encoder::Destroy()
 		delete nv_encoder_;
 		nv_encoder_ = nullptr;
 	}
+	intra_refresh_supported_ = false;
 
 	ClearD3D11();
 }
 
-int NvidiaD3D11Encoder::Encode(std::vector<uint8_t> in_image, std::vector<uint8_t>& out_frame)
+int NvidiaD3D11Encoder::Encode(const VideoImage& image, std::vector<uint8_t>& out_frame)
 {
 	if (!nv_encoder_) {
 		return -1;
 	}
 
+	if (image.width != width_ || image.height != height_) {
+		return -4;
+	}
+
 	UpdateEvent();
 	out_frame.clear();
 
-	D3D11_MAPPED_SUBRESOURCE dsec = { 0 };
-	HRESULT hr = d3d11_context_->Map(d3d11_copy_texture_, D3D11CalcSubresource(0, 0, 0), D3D11_MAP_WRITE, 0, &dsec);
-
-	if (FAILED(hr)) {
-		return -2;
+	// The staging texture keeps the previous image, only the changed part
+	// has to be written. Nothing at all when the image did not change.
+	VideoRect rect;
+	rect.width = width_;
+	rect.height = height_;
+	if (texture_valid_) {
+		rect = UpdateRegion(image);
 	}
 
-	if (dxgi_format_ == VE_OPT_FORMAT_NV12) {
-		uint8_t* y_plane_ = in_image.data();
-		for (int i = 0; i < height_; i++) {
-			memcpy((uint8_t*)dsec.pData + dsec.RowPitch * i, y_plane_ + width_ * i, width_);
+	if (rect.width > 0 && rect.height > 0) {
+		D3D11_MAPPED_SUBRESOURCE dsec = { 0 };
+		HRESULT hr = d3d11_context_->Map(d3d11_copy_texture_, D3D11CalcSubresource(0, 0, 0), D3D11_MAP_WRITE, 0, &dsec);
+
+		if (FAILED(hr)) {
+			return -2;
 		}
-		uint8_t* uv_plane_ = &in_image[0] + width_ * height_;
-		int h = height_ / 2;
-		for (int i = 0; i < h; i++) {
-			memcpy((uint8_t*)dsec.pData + dsec.RowPitch * (height_ + i), uv_plane_ + width_ * i, width_);
+
+		// Convert (or copy) straight into the mapped staging texture.
+		bool copied = false;
+		VideoImage sub_image = SubImage(image, rect);
+		uint8_t* texture_data = (uint8_t*)dsec.pData;
+		if (dxgi_format_ == VE_OPT_FORMAT_NV12) {
+			uint8_t* texture_uv = texture_data + dsec.RowPitch * height_;
+			copied = CopyImageToNV12(sub_image,
+									 texture_data + rect.y * dsec.RowPitch + rect.x, dsec.RowPitch,
+									 texture_uv + rect.y / 2 * dsec.RowPitch + rect.x, dsec.RowPitch);
 		}
-	}
-	else if (dxgi_format_ == VE_OPT_FORMAT_B8G8R8A8) {
-		for (int y = 0; y < height_; y++) {
-			memcpy((uint8_t*)dsec.pData + y * dsec.RowPitch,
-					in_image.data() + y * width_ * 4, width_ * 4);
+		else if (dxgi_format_ == VE_OPT_FORMAT_B8G8R8A8) {
+			copied = CopyImageToBGRA(sub_image, texture_data + rect.y * dsec.RowPitch + rect.x * 4, dsec.RowPitch);
+		}
+
+		d3d11_context_->Unmap(d3d11_copy_texture_, D3D11CalcSubresource(0, 0, 0));
+		texture_valid_ = copied;
+		if (!copied) {
+			return -3;
 		}
 	}
+
+	// One entry per MB for H264, per 32x32 CTB for HEVC.
+	int block_size = (codec_ == VE_OPT_CODEC_HEVC) ? 32 : 16;
+	if (ResampleQpMap(image, block_size, width_, height_, qp_delta_map_)) {
+		nv_encoder_->SetQpDeltaMap(qp_delta_map_.data(), (uint32_t)qp_delta_map_.size());
+	}
 	else {
-		return -3;
+		nv_encoder_->SetQpDeltaMap(nullptr, 0);
 	}
 
+	return EncodeTexture(d3d11_copy_texture_, out_frame);
+}
+
+int NvidiaD3D11Encoder::Encode(const std::vector<uint8_t>& in_image, std::vector<uint8_t>& out_frame)
+{
+	return Encode(PackedImage(in_image.data(), dxgi_format_, width_, height_), out_frame);
+}
+
+int NvidiaD3D11Encoder::EncodeTexture(ID3D11Texture2D* texture, std::vector<uint8_t>& out_frame)
+{
 	const NvEncInputFrame* input_frame = nv_encoder_->GetNextInputFrame();
 	ID3D11Texture2D* input_texture = reinterpret_cast<ID3D11Texture2D*>(input_frame->inputPtr);
-	d3d11_context_->CopyResource(input_texture, d3d11_copy_texture_);
-
-	std::vector<std::vector<uint8_t>> packets;
-	nv_encoder_->EncodeFrame(packets);
+	d3d11_context_->CopyResource(input_texture, texture);
 
-	int frame_size = 0;
-	for (std::vector<uint8_t>& packet : packets) {
-		out_frame.insert(out_frame.end(), packet.begin(), packet.end());
-		frame_size += (int)packet.size();
-	}
+	// Packets go straight into out_frame, it keeps its capacity between frames.
+	nv_encoder_->EncodeFrame(out_frame);
 
-	return frame_size;
+	return (int)out_frame.size();
 }
 
 int NvidiaD3D11Encoder::Encode(HANDLE shared_handle, std::vector<uint8_t>& out_frame)
@@ -219,23 +288,12 @@ int NvidiaD3D11Encoder::Encode(HANDLE shared_handle, std::vector<uint8_t>& out_f
 		return -2;
 	}
 
-	const NvEncInputFrame* input_frame = nv_encoder_->GetNextInputFrame();
-	ID3D11Texture2D* input_texture = reinterpret_cast<ID3D11Texture2D*>(input_frame->inputPtr);
-	d3d11_context_->CopyResource(input_texture, shared_texture);
-
-	std::vector<std::vector<uint8_t>> packets;
-	nv_encoder_->EncodeFrame(packets);
+	int frame_size = EncodeTexture(shared_texture, out_frame);
 
 	if (shared_texture) {
 		shared_texture->Release();
 	}
 
-	int frame_size = 0;
-	for (std::vector<uint8_t>& packet : packets) {
-		out_frame.insert(out_frame.end(), packet.begin(), packet.end());
-		frame_size += (int)packet.size();
-	}
-
 	return frame_size;
 }
 
@@ -328,6 +386,7 @@ void NvidiaD3D11Encoder::ClearD3D11()
 	if (d3d11_copy_texture_) {
 		d3d11_copy_texture_->Release();
 		d3d11_copy_texture_ = nullptr;
+		texture_valid_ = false;
 	}
 
 	if (d3d11_device_) {
@@ -392,7 +451,8 @@ void NvidiaD3D11Encoder::UpdateEvent()
 	NV_ENC_RECONFIGURE_PARAMS reconfigure_params;
 	NV_ENC_CONFIG encode_config = { NV_ENC_CONFIG_VER };
 	reconfigure_params.version = NV_ENC_RECONFIGURE_PARAMS_VER;
-	reconfigure_params.forceIDR = true;
+	// Rate changes do not need an IDR, key frames are left to VE_EVENT_FORCE_IDR.
+	reconfigure_params.forceIDR = false;
 	reconfigure_params.reInitEncodeParams = { NV_ENC_INITIALIZE_PARAMS_VER };
 	reconfigure_params.reInitEncodeParams.encodeConfig = &encode_config;
 	nv_encoder_->GetInitializeParams(&reconfigure_params.reInitEncodeParams);
@@ -407,6 +467,12 @@ void NvidiaD3D11Encoder::UpdateEvent()
 			nv_encoder_->ForceIDR();
 			break;
 
+		case VE_EVENT_INTRA_REFRESH:
+			if (intra_refresh_supported_) {
+				nv_encoder_->ForceIntraRefresh(value);
+			}
+			break;
+
 		case VE_EVENT_RESET_BITRATE_KBPS: 
 			{
 				int new_bitrate = value * 1000;
@@ -15,22 +15,33 @@ public:
 
 	static bool IsSupported();
 
+	// Loads the driver and opens a session, slow. Probed once at startup.
+	static bool QueryCapability(EncoderCapability& capability);
+
 	virtual bool Init() override;
 	virtual void Destroy()override;
 
-	virtual int  Encode(std::vector<uint8_t> in_image, std::vector<uint8_t>& out_frame);
+	virtual int  Encode(const VideoImage& image, std::vector<uint8_t>& out_frame) override;
+
+	virtual int  Encode(const std::vector<uint8_t>& in_image, std::vector<uint8_t>& out_frame);
 
 	virtual int  Encode(HANDLE shared_handle, std::vector<uint8_t>& out_frame);
 
+	virtual bool SupportsIntraRefresh() override { return intra_refresh_supported_; }
+
 private:
 	bool UpdateOption();
 	void UpdateEvent();
+	int  EncodeTexture(ID3D11Texture2D* texture, std::vector<uint8_t>& out_frame);
 	bool InitD3D11();
 	void ClearD3D11();
 
 	ID3D11Device* d3d11_device_              = nullptr;
 	ID3D11DeviceContext* d3d11_context_      = nullptr;
 	ID3D11Texture2D* d3d11_copy_texture_     = nullptr;
+	bool texture_valid_                      = false;  // d3d11_copy_texture_ holds the last image
+	std::vector<int8_t> qp_delta_map_;
+	bool intra_refresh_supported_            = false;
 	IDXGIAdapter* d3d11_adapter_             = nullptr;
 	IDXGIFactory1* d3d11_factory_            = nullptr;
 
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "video_encoder.h"
+
+namespace xop
+{
+
+struct QpRect
+{
+	VideoRect rect;     // pixels
+	int delta_qp = 0;
+};
+
+// Resample image.qp_delta_map onto the encoder's grid of block_size blocks.
+// A block takes the lowest delta it covers, an important area never loses
+// quality when the grid is coarser than the map.
+static inline bool ResampleQpMap(const VideoImage& image, int block_size, int width, int height,
+								 std::vector<int8_t>& out)
+{
+	out.clear();
+	if (!image.qp_delta_map || image.qp_map_width <= 0 || image.qp_map_height <= 0 ||
+		image.qp_map_block <= 0 || block_size <= 0) {
+		return false;
+	}
+
+	int cols = (width + block_size - 1) / block_size;
+	int rows = (height + block_size - 1) / block_size;
+	out.resize(cols * rows);
+
+	for (int by = 0; by < rows; by++) {
+		int sy0 = (std::min)(by * block_size / image.qp_map_block, image.qp_map_height - 1);
+		int sy1 = (std::min)(((std::min)((by + 1) * block_size, height) - 1) / image.qp_map_block,
+							 image.qp_map_height - 1);
+		for (int bx = 0; bx < cols; bx++) {
+			int sx0 = (std::min)(bx * block_size / image.qp_map_block, image.qp_map_width - 1);
+			int sx1 = (std::min)(((std::min)((bx + 1) * block_size, width) - 1) / image.qp_map_block,
+								 image.qp_map_width - 1);
+			int8_t delta = image.qp_delta_map[sy0 * image.qp_map_width + sx0];
+			for (int sy = sy0; sy <= sy1; sy++) {
+				for (int sx = sx0; sx <= sx1; sx++) {
+					delta = (std::min)(delta, image.qp_delta_map[sy * image.qp_map_width + sx]);
+				}
+			}
+			out[by * cols + bx] = delta;
+		}
+	}
+
+	return true;
+}
+
+// For encoders that only take a few ROI rectangles. Runs of the same non-zero
+// delta are merged down the rows, when that needs more than max_rects each
+// delta gets its bounding box, most important (lowest) delta first.
+static inline void QpMapToRects(const VideoImage& image, size_t max_rects, std::vector<QpRect>& rects)
+{
+	rects.clear();
+	if (!image.qp_delta_map || image.qp_map_width <= 0 || image.qp_map_height <= 0 ||
+		image.qp_map_block <= 0 || max_rects == 0) {
+		return;
+	}
+
+	// In blocks until the end.
+	for (int y = 0; y < image.qp_map_height; y++) {
+		const int8_t* row = image.qp_delta_map + y * image.qp_map_width;
+		for (int x = 0; x < image.qp_map_width; ) {
+			int delta = row[x];
+			int x0 = x;
+			while (x < image.qp_map_width && row[x] == delta) {
+				x++;
+			}
+			if (delta == 0) {
+				continue;
+			}
+
+			bool merged = false;
+			for (auto& r : rects) {
+				if (r.delta_qp == delta && r.rect.x == x0 && r.rect.width == x - x0 &&
+					r.rect.y + r.rect.height == y) {
+					r.rect.height++;
+					merged = true;
+					break;
+				}
+			}
+			if (!merged) {
+				QpRect r;
+				r.rect.x = x0;
+				r.rect.y = y;
+				r.rect.width = x - x0;
+				r.rect.height = 1;
+				r.delta_qp = delta;
+				rects.push_back(r);
+			}
+		}
+	}
+
+	if (rects.size() > max_rects) {
+		std::vector<QpRect> bounds;
+		for (auto& r : rects) {
+			auto iter = std::find_if(bounds.begin(), bounds.end(),
+									 [&r](const QpRect& b) { return b.delta_qp == r.delta_qp; });
+			if (iter == bounds.end()) {
+				bounds.push_back(r);
+				continue;
+			}
+
+			int right = (std::max)(iter->rect.x + iter->rect.width, r.rect.x + r.rect.width);
+			int bottom = (std::max)(iter->rect.y + iter->rect.height, r.rect.y + r.rect.height);
+			iter->rect.x = (std::min)(iter->rect.x, r.rect.x);
+			iter->rect.y = (std::min)(iter->rect.y, r.rect.y);
+			iter->rect.width = right - iter->rect.x;
+			iter->rect.height = bottom - iter->rect.y;
+		}
+
+		std::sort(bounds.begin(), bounds.end(),
+				  [](const QpRect& a, const QpRect& b) { return a.delta_qp < b.delta_qp; });
+		if (bounds.size() > max_rects) {
+			bounds.resize(max_rects);
+		}
+		rects.swap(bounds);
+	}
+
+	for (auto& r : rects) {
+		int right = (std::min)((r.rect.x + r.rect.width) * image.qp_map_block, image.width);
+		int bottom = (std::min)((r.rect.y + r.rect.height) * image.qp_map_block, image.height);
+		r.rect.x *= image.qp_map_block;
+		r.rect.y *= image.qp_map_block;
+		r.rect.width = right - r.rect.x;
+		r.rect.height = bottom - r.rect.y;
+	}
+
+	// A map larger than the image.
+	rects.erase(std::remove_if(rects.begin(), rects.end(),
+							   [](const QpRect& r) { return r.rect.width <= 0 || r.rect.height <= 0; }),
+				rects.end());
+}
+
+}
@@ -20,6 +20,55 @@ enum VIDEO_ENCODER_OPTION_TEXTURE_FORMAT_VALUE
 	VE_OPT_FORMAT_NV12     = 103,
 };
 
+enum VIDEO_ENCODER_IMAGE_FORMAT
+{
+	VE_IMAGE_FORMAT_I420 = 1,
+	VE_IMAGE_FORMAT_NV12,
+	VE_IMAGE_FORMAT_B8G8R8A8,
+};
+
+struct VideoRect
+{
+	int x      = 0;
+	int y      = 0;
+	int width  = 0;
+	int height = 0;
+};
+
+// Raw input image, planes are not owned. The backends copy (or convert) it
+// straight into their upload surface, so this is the only copy on the path.
+struct VideoImage
+{
+	int format = VE_IMAGE_FORMAT_I420;
+	int width  = 0;
+	int height = 0;
+	const uint8_t* data[3] = { nullptr, nullptr, nullptr };
+	int stride[3] = { 0, 0, 0 };
+
+	// Part that changed since the previous image, empty when nothing did.
+	// Backends that keep their upload surface may copy only this part.
+	bool has_update_rect = false;
+	VideoRect update_rect;
+
+	// Optional delta QP for each qp_map_block x qp_map_block block, row major,
+	// qp_map_width x qp_map_height entries. Negative spends more bits there.
+	const int8_t* qp_delta_map = nullptr;
+	int qp_map_width  = 0;
+	int qp_map_height = 0;
+	int qp_map_block  = 16;
+};
+
+// What a backend can do on this machine, filled by the backends'
+// static QueryCapability().
+struct EncoderCapability
+{
+	bool supported   = false;
+	bool h264        = false;
+	bool hevc        = false;
+	int  max_width   = 0;
+	int  max_height  = 0;
+};
+
 enum VIDEO_ENCODER_OPTION
 {
 	VE_OPT_UNKNOW = 0,
@@ -28,9 +77,10 @@ enum VIDEO_ENCODER_OPTION
 	VE_OPT_HEIGHT,
 	VE_OPT_FRAME_RATE,
 	VE_OPT_BITRATE_KBPS,
-	VE_OPT_GOP,
+	VE_OPT_GOP,             // 0: no periodic IDR, only VE_EVENT_FORCE_IDR
 	VE_OPT_CODEC,
 	VE_OPT_TEXTURE_FORMAT,
+	VE_OPT_ASYNC_DEPTH,     // frames in flight for Submit()/Collect(), 1 = synchronous
 };
 
 enum VIDEO_ENCODER_EVENT
@@ -38,7 +88,13 @@ enum VIDEO_ENCODER_EVENT
 	VE_EVENT_UNKNOW = 0,
 	VE_EVENT_FORCE_IDR,
 	VE_EVENT_RESET_BITRATE_KBPS,
-	VE_EVENT_RESET_FRAME_RATE
+	VE_EVENT_RESET_FRAME_RATE,
+	VE_EVENT_INTRA_REFRESH,     // value: number of frames to spread the refresh over
+};
+
+enum VIDEO_ENCODER_ERROR
+{
+	VE_ERR_BUSY = -5,
 };
 
 class VideoEncoder
@@ -84,6 +140,23 @@ public:
 	virtual bool Init()     = 0;
 	virtual void Destroy()  = 0;
 
+	//  return the size of out_frame, < 0 on error
+	virtual int  Encode(const VideoImage& image, std::vector<uint8_t>& out_frame) = 0;
+
+	//  pipelined mode, only when SupportsAsync() and VE_OPT_ASYNC_DEPTH > 1.
+	//  Submit() uploads the image and returns without waiting for the bitstream,
+	//  it fails with VE_ERR_BUSY when VE_OPT_ASYNC_DEPTH frames are in flight.
+	//  Collect() returns the oldest submitted frame, frames come out in submit
+	//  order. return 1 when a frame was collected, 0 on timeout, < 0 on error.
+	//  Submit() and Collect() may be called from two threads, do not mix them
+	//  with Encode().
+	virtual bool SupportsAsync() { return false; }
+	virtual int  Submit(const VideoImage& image, uint64_t frame_id) { return -1; }
+	virtual int  Collect(std::vector<uint8_t>& out_frame, uint64_t& frame_id, int timeout_ms) { return -1; }
+
+	//  VE_EVENT_INTRA_REFRESH is honoured, valid after Init().
+	virtual bool SupportsIntraRefresh() { return false; }
+
 protected:
 	std::mutex option_mutex_;
 	std::map<int, int> encoder_options_;
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+
+#include "video_encoder.h"
+#include "libyuv.h"
+
+namespace xop
+{
+
+// Copy image into a NV12 surface (y plane + interleaved uv plane).
+static inline bool CopyImageToNV12(const VideoImage& image, uint8_t* dst_y, int dst_stride_y,
+								   uint8_t* dst_uv, int dst_stride_uv)
+{
+	switch (image.format)
+	{
+	case VE_IMAGE_FORMAT_I420:
+		return libyuv::I420ToNV12(image.data[0], image.stride[0],
+								  image.data[1], image.stride[1],
+								  image.data[2], image.stride[2],
+								  dst_y, dst_stride_y, dst_uv, dst_stride_uv,
+								  image.width, image.height) == 0;
+
+	case VE_IMAGE_FORMAT_NV12:
+		libyuv::CopyPlane(image.data[0], image.stride[0], dst_y, dst_stride_y,
+						  image.width, image.height);
+		libyuv::CopyPlane(image.data[1], image.stride[1], dst_uv, dst_stride_uv,
+						  (image.width + 1) & ~1, (image.height + 1) / 2);
+		return true;
+
+	case VE_IMAGE_FORMAT_B8G8R8A8:
+		return libyuv::ARGBToNV12(image.data[0], image.stride[0],
+								  dst_y, dst_stride_y, dst_uv, dst_stride_uv,
+								  image.width, image.height) == 0;
+
+	default:
+		return false;
+	}
+}
+
+// Copy image into a B8G8R8A8 surface, libyuv calls this byte order ARGB.
+static inline bool CopyImageToBGRA(const VideoImage& image, uint8_t* dst, int dst_stride)
+{
+	switch (image.format)
+	{
+	case VE_IMAGE_FORMAT_I420:
+		return libyuv::I420ToARGB(image.data[0], image.stride[0],
+								  image.data[1], image.stride[1],
+								  image.data[2], image.stride[2],
+								  dst, dst_stride, image.width, image.height) == 0;
+
+	case VE_IMAGE_FORMAT_NV12:
+		return libyuv::NV12ToARGB(image.data[0], image.stride[0],
+								  image.data[1], image.stride[1],
+								  dst, dst_stride, image.width, image.height) == 0;
+
+	case VE_IMAGE_FORMAT_B8G8R8A8:
+		return libyuv::ARGBCopy(image.data[0], image.stride[0], dst, dst_stride,
+								image.width, image.height) == 0;
+
+	default:
+		return false;
+	}
+}
+
+// update_rect grown to even coordinates (chroma is subsampled) and clipped
+// to the image, the whole image when there is no update_rect.
+static inline VideoRect UpdateRegion(const VideoImage& image)
+{
+	VideoRect rect;
+	if (!image.has_update_rect) {
+		rect.width = image.width;
+		rect.height = image.height;
+		return rect;
+	}
+
+	const VideoRect& update = image.update_rect;
+	if (update.width <= 0 || update.height <= 0) {
+		return rect;
+	}
+
+	int left = (std::max)(update.x, 0) & ~1;
+	int top = (std::max)(update.y, 0) & ~1;
+	int right = (std::min)((update.x + update.width + 1) & ~1, image.width);
+	int bottom = (std::min)((update.y + update.height + 1) & ~1, image.height);
+	if (right > left && bottom > top) {
+		rect.x = left;
+		rect.y = top;
+		rect.width = right - left;
+		rect.height = bottom - top;
+	}
+	return rect;
+}
+
+// View of a part of image, rect must be even aligned (see UpdateRegion()).
+static inline VideoImage SubImage(const VideoImage& image, const VideoRect& rect)
+{
+	VideoImage sub = image;
+	sub.width = rect.width;
+	sub.height = rect.height;
+	sub.has_update_rect = false;
+
+	switch (image.format)
+	{
+	case VE_IMAGE_FORMAT_I420:
+		sub.data[0] = image.data[0] + rect.y * image.stride[0] + rect.x;
+		sub.data[1] = image.data[1] + rect.y / 2 * image.stride[1] + rect.x / 2;
+		sub.data[2] = image.data[2] + rect.y / 2 * image.stride[2] + rect.x / 2;
+		break;
+
+	case VE_IMAGE_FORMAT_NV12:
+		sub.data[0] = image.data[0] + rect.y * image.stride[0] + rect.x;
+		sub.data[1] = image.data[1] + rect.y / 2 * image.stride[1] + rect.x;
+		break;
+
+	case VE_IMAGE_FORMAT_B8G8R8A8:
+		sub.data[0] = image.data[0] + rect.y * image.stride[0] + rect.x * 4;
+		break;
+	}
+	return sub;
+}
+
+// Describe a packed buffer in texture format (VE_OPT_TEXTURE_FORMAT) as a VideoImage,
+// used by the legacy vector based Encode().
+static inline VideoImage PackedImage(const uint8_t* data, int texture_format, int width, int height)
+{
+	VideoImage image;
+	image.width = width;
+	image.height = height;
+	if (texture_format == VE_OPT_FORMAT_NV12) {
+		image.format = VE_IMAGE_FORMAT_NV12;
+		image.data[0] = data;
+		image.data[1] = data + width * height;
+		image.stride[0] = width;
+		image.stride[1] = width;
+	}
+	else {
+		image.format = VE_IMAGE_FORMAT_B8G8R8A8;
+		image.data[0] = data;
+		image.stride[0] = width * 4;
+	}
+	return image;
+}
+
+}
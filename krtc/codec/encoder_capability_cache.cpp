@@ -0,0 +1,114 @@
+#include "encoder_capability_cache.h"
+
+#include <string.h>
+
+#include "modules/video_coding/codecs/h264/include/h264.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace krtc {
+
+EncoderCapabilityCache::EncoderCapabilityCache(ProbeFunction probe)
+	: probe_(probe)
+{
+}
+
+EncoderCapabilityCache::~EncoderCapabilityCache()
+{
+	if (probe_thread_) {
+		probe_thread_->join();
+	}
+}
+
+void EncoderCapabilityCache::StartProbe()
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (started_) {
+		return;
+	}
+
+	started_ = true;
+	probe_thread_.reset(new std::thread([this] {
+		Probe();
+	}));
+}
+
+std::vector<KRTCEncoderCapability> EncoderCapabilityCache::Get()
+{
+	bool probe_here = false;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		if (!started_) {
+			started_ = true;
+			probe_here = true;
+		}
+	}
+
+	if (probe_here) {
+		Probe();
+	}
+
+	std::unique_lock<std::mutex> locker(mutex_);
+	cond_.wait(locker, [this] { return done_; });
+	return capabilities_;
+}
+
+bool EncoderCapabilityCache::TryGet(std::vector<KRTCEncoderCapability>* capabilities)
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (!done_) {
+		return false;
+	}
+
+	*capabilities = capabilities_;
+	return true;
+}
+
+bool EncoderCapabilityCache::Find(const std::string& name, KRTCEncoderCapability* capability)
+{
+	for (const KRTCEncoderCapability& item : Get()) {
+		if (name == item.name) {
+			if (capability) {
+				*capability = item;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<KRTCEncoderCapability> EncoderCapabilityCache::ProbeSoftwareEncoders()
+{
+	std::vector<KRTCEncoderCapability> capabilities;
+	if (webrtc::H264Encoder::IsSupported()) {
+		KRTCEncoderCapability capability;
+		memset(&capability, 0, sizeof(capability));
+		strncpy(capability.name, "OpenH264", sizeof(capability.name) - 1);
+		capability.h264 = true;
+		capabilities.push_back(capability);
+	}
+	return capabilities;
+}
+
+void EncoderCapabilityCache::Probe()
+{
+	int64_t start_ms = rtc::TimeMillis();
+	std::vector<KRTCEncoderCapability> capabilities = probe_();
+
+	for (const KRTCEncoderCapability& item : capabilities) {
+		RTC_LOG(LS_INFO) << "video encoder " << item.name
+			<< ", hardware: " << item.hardware
+			<< ", h264: " << item.h264 << ", h265: " << item.h265
+			<< ", max: " << item.max_width << "x" << item.max_height;
+	}
+	RTC_LOG(LS_INFO) << "video encoder probe took " << rtc::TimeMillis() - start_ms << " ms";
+
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		capabilities_ = capabilities;
+		done_ = true;
+	}
+	cond_.notify_all();
+}
+
+} // namespace krtc
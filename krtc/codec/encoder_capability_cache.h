@@ -0,0 +1,55 @@
+#ifndef KRTCSDK_KRTC_CODEC_ENCODER_CAPABILITY_CACHE_H_
+#define KRTCSDK_KRTC_CODEC_ENCODER_CAPABILITY_CACHE_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "krtc/krtc.h"
+
+namespace krtc {
+
+// Probing a hardware encoder loads its driver and opens a device, hundreds of
+// ms each time. The probe runs once on its own thread and everybody after
+// that (encoder factory, app queries) reads the cached result.
+class EncoderCapabilityCache {
+public:
+	typedef std::function<std::vector<KRTCEncoderCapability>()> ProbeFunction;
+
+	explicit EncoderCapabilityCache(ProbeFunction probe);
+	~EncoderCapabilityCache();
+
+	// Starts the probe in the background, later calls do nothing.
+	void StartProbe();
+
+	// Waits for the probe, runs it on the caller's thread if nobody started it.
+	std::vector<KRTCEncoderCapability> Get();
+
+	// Does not wait, false while the probe has not finished.
+	bool TryGet(std::vector<KRTCEncoderCapability>* capabilities);
+
+	// Cached entry by KRTCEncoderCapability::name, false when not found.
+	bool Find(const std::string& name, KRTCEncoderCapability* capability);
+
+	// The encoders built into webrtc, available everywhere.
+	static std::vector<KRTCEncoderCapability> ProbeSoftwareEncoders();
+
+private:
+	void Probe();
+
+	ProbeFunction probe_;
+	std::unique_ptr<std::thread> probe_thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	bool started_ = false;
+	bool done_ = false;
+	std::vector<KRTCEncoderCapability> capabilities_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ENCODER_CAPABILITY_CACHE_H_
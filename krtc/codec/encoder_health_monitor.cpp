@@ -0,0 +1,90 @@
+#include "encoder_health_monitor.h"
+
+namespace krtc {
+
+EncoderHealthMonitor::EncoderHealthMonitor()
+	: EncoderHealthMonitor(Config())
+{
+}
+
+EncoderHealthMonitor::EncoderHealthMonitor(const Config& config)
+	: config_(config),
+	time_budget_us_(config.time_budget_us)
+{
+	Reset(30);
+}
+
+void EncoderHealthMonitor::Reset(int frame_rate)
+{
+	if (config_.time_budget_us > 0) {
+		time_budget_us_ = config_.time_budget_us;
+	}
+	else {
+		time_budget_us_ = 1000 * 1000 / (frame_rate > 0 ? frame_rate : 30);
+	}
+
+	window_.clear();
+	errors_ = 0;
+	slow_frames_ = 0;
+}
+
+EncoderHealthMonitor::Verdict EncoderHealthMonitor::OnFrameEncoded(int64_t encode_time_us, bool failed)
+{
+	uint8_t flags = 0;
+	if (failed) {
+		flags |= kFrameFailed;
+		errors_++;
+	}
+	if (encode_time_us > time_budget_us_) {
+		flags |= kFrameSlow;
+		slow_frames_++;
+	}
+
+	window_.push_back(flags);
+	if ((int)window_.size() > config_.window_frames) {
+		uint8_t oldest = window_.front();
+		window_.pop_front();
+		if (oldest & kFrameFailed) {
+			errors_--;
+		}
+		if (oldest & kFrameSlow) {
+			slow_frames_--;
+		}
+	}
+
+	if (encode_time_us >= config_.stall_time_us) {
+		return kStalled;
+	}
+
+	if (errors_ >= config_.max_errors) {
+		return kTooManyErrors;
+	}
+
+	// Judge the speed on a full window only, the first frames include the
+	// backend warming up.
+	if ((int)window_.size() >= config_.window_frames &&
+		slow_frames_ > config_.window_frames * config_.max_slow_ratio) {
+		return kTooSlow;
+	}
+
+	return kHealthy;
+}
+
+const char* EncoderHealthMonitor::VerdictName(Verdict verdict)
+{
+	switch (verdict)
+	{
+	case kHealthy:
+		return "healthy";
+	case kTooManyErrors:
+		return "too many errors";
+	case kTooSlow:
+		return "too slow";
+	case kStalled:
+		return "stalled";
+	default:
+		return "unknown";
+	}
+}
+
+} // namespace krtc
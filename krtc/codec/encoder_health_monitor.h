@@ -0,0 +1,61 @@
+#ifndef KRTCSDK_KRTC_CODEC_ENCODER_HEALTH_MONITOR_H_
+#define KRTCSDK_KRTC_CODEC_ENCODER_HEALTH_MONITOR_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+namespace krtc {
+
+// Per frame encode time / error bookkeeping over a sliding window. Decides
+// when an encoder backend is no longer fit for real time use.
+class EncoderHealthMonitor {
+public:
+	enum Verdict {
+		kHealthy = 0,
+		kTooManyErrors,  // max_errors failed frames within the window
+		kTooSlow,        // more than max_slow_ratio frames over the time budget
+		kStalled,        // one frame took longer than stall_time_us
+	};
+
+	struct Config {
+		int window_frames = 60;
+		int max_errors = 3;
+		double max_slow_ratio = 0.3;
+		// 0: one frame interval at the configured frame rate.
+		int64_t time_budget_us = 0;
+		int64_t stall_time_us = 1000 * 1000;
+	};
+
+	EncoderHealthMonitor();
+	explicit EncoderHealthMonitor(const Config& config);
+
+	// Starts a new observation, e.g. after a backend switch.
+	void Reset(int frame_rate);
+
+	// Returns the verdict for the encoder after this frame, anything but
+	// kHealthy means it should be replaced.
+	Verdict OnFrameEncoded(int64_t encode_time_us, bool failed);
+
+	static const char* VerdictName(Verdict verdict);
+
+	int64_t time_budget_us() const { return time_budget_us_; }
+	int errors_in_window() const { return errors_; }
+	int slow_frames_in_window() const { return slow_frames_; }
+
+private:
+	enum FrameFlag {
+		kFrameFailed = 1,
+		kFrameSlow = 2,
+	};
+
+	Config config_;
+	int64_t time_budget_us_;
+	std::deque<uint8_t> window_;
+	int errors_ = 0;
+	int slow_frames_ = 0;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ENCODER_HEALTH_MONITOR_H_
@@ -0,0 +1,96 @@
+#include "encoder_hint_buffer.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+#include <rtc_base/ref_counted_object.h>
+
+namespace krtc {
+
+namespace {
+
+std::mutex& LiveBuffersMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+std::set<const webrtc::VideoFrameBuffer*>& LiveBuffers()
+{
+	static std::set<const webrtc::VideoFrameBuffer*> buffers;
+	return buffers;
+}
+
+} // namespace
+
+std::shared_ptr<const QpDeltaMap> QpDeltaMap::Scale(int src_width, int src_height,
+	int dst_width, int dst_height) const
+{
+	auto scaled = std::make_shared<QpDeltaMap>();
+	scaled->block_size = block_size;
+	scaled->width = (dst_width + block_size - 1) / block_size;
+	scaled->height = (dst_height + block_size - 1) / block_size;
+	scaled->deltas.resize(scaled->width * scaled->height);
+	if (width <= 0 || height <= 0 || dst_width <= 0 || dst_height <= 0 ||
+		(int)deltas.size() < width * height) {
+		return scaled;
+	}
+
+	for (int by = 0; by < scaled->height; by++) {
+		// Source pixel rows covered by this block, then source blocks.
+		int y0 = by * block_size * src_height / dst_height;
+		int y1 = (std::min((by + 1) * block_size, dst_height) * src_height - 1) / dst_height;
+		int sy0 = std::min(y0 / block_size, height - 1);
+		int sy1 = std::min(y1 / block_size, height - 1);
+		for (int bx = 0; bx < scaled->width; bx++) {
+			int x0 = bx * block_size * src_width / dst_width;
+			int x1 = (std::min((bx + 1) * block_size, dst_width) * src_width - 1) / dst_width;
+			int sx0 = std::min(x0 / block_size, width - 1);
+			int sx1 = std::min(x1 / block_size, width - 1);
+
+			int8_t delta = deltas[sy0 * width + sx0];
+			for (int sy = sy0; sy <= sy1; sy++) {
+				for (int sx = sx0; sx <= sx1; sx++) {
+					delta = std::min(delta, deltas[sy * width + sx]);
+				}
+			}
+			scaled->deltas[by * scaled->width + bx] = delta;
+		}
+	}
+
+	return scaled;
+}
+
+rtc::scoped_refptr<EncoderHintBuffer> EncoderHintBuffer::Create(
+	rtc::scoped_refptr<webrtc::I420BufferInterface> buffer,
+	const EncoderHints& hints)
+{
+	return new rtc::RefCountedObject<EncoderHintBuffer>(buffer, hints);
+}
+
+EncoderHints EncoderHintBuffer::Find(const webrtc::VideoFrameBuffer* buffer)
+{
+	std::lock_guard<std::mutex> locker(LiveBuffersMutex());
+	if (!buffer || LiveBuffers().count(buffer) == 0) {
+		return EncoderHints();
+	}
+	return static_cast<const EncoderHintBuffer*>(buffer)->hints();
+}
+
+EncoderHintBuffer::EncoderHintBuffer(rtc::scoped_refptr<webrtc::I420BufferInterface> buffer,
+	const EncoderHints& hints)
+	: buffer_(buffer),
+	hints_(hints)
+{
+	std::lock_guard<std::mutex> locker(LiveBuffersMutex());
+	LiveBuffers().insert(this);
+}
+
+EncoderHintBuffer::~EncoderHintBuffer()
+{
+	std::lock_guard<std::mutex> locker(LiveBuffersMutex());
+	LiveBuffers().erase(this);
+}
+
+} // namespace krtc
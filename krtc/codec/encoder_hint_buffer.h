@@ -0,0 +1,72 @@
+#ifndef KRTCSDK_KRTC_CODEC_ENCODER_HINT_BUFFER_H_
+#define KRTCSDK_KRTC_CODEC_ENCODER_HINT_BUFFER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <api/scoped_refptr.h>
+#include <api/video/video_frame_buffer.h>
+
+namespace krtc {
+
+// Delta QP per block_size x block_size block of a frame, row major. Negative
+// values spend more bits on a block (a face, a shared window), positive less.
+struct QpDeltaMap {
+	int block_size = 16;
+	int width = 0;   // blocks per row
+	int height = 0;  // block rows
+	std::vector<int8_t> deltas;
+
+	// The map of the same frame scaled from src to dst size, a block keeps
+	// the lowest delta it covers.
+	std::shared_ptr<const QpDeltaMap> Scale(int src_width, int src_height,
+		int dst_width, int dst_height) const;
+};
+
+// What the capture side knows about a frame that the encoders can use.
+struct EncoderHints {
+	std::shared_ptr<const QpDeltaMap> qp_map;
+	// The content changed completely (slide flip, camera switch), better
+	// coded as a key frame than as a huge P frame.
+	bool scene_cut = false;
+};
+
+// I420 buffer that carries EncoderHints from the capturer to the encoders,
+// everything else is forwarded to the wrapped buffer.
+class EncoderHintBuffer : public webrtc::I420BufferInterface {
+public:
+	static rtc::scoped_refptr<EncoderHintBuffer> Create(
+		rtc::scoped_refptr<webrtc::I420BufferInterface> buffer,
+		const EncoderHints& hints);
+
+	// The hints attached to buffer, empty ones for any other buffer. webrtc is
+	// built without rtti, so live EncoderHintBuffers are looked up by address.
+	static EncoderHints Find(const webrtc::VideoFrameBuffer* buffer);
+
+	const EncoderHints& hints() const { return hints_; }
+
+	// webrtc::I420BufferInterface
+	int width() const override { return buffer_->width(); }
+	int height() const override { return buffer_->height(); }
+	const uint8_t* DataY() const override { return buffer_->DataY(); }
+	const uint8_t* DataU() const override { return buffer_->DataU(); }
+	const uint8_t* DataV() const override { return buffer_->DataV(); }
+	int StrideY() const override { return buffer_->StrideY(); }
+	int StrideU() const override { return buffer_->StrideU(); }
+	int StrideV() const override { return buffer_->StrideV(); }
+
+protected:
+	EncoderHintBuffer(rtc::scoped_refptr<webrtc::I420BufferInterface> buffer,
+		const EncoderHints& hints);
+	~EncoderHintBuffer() override;
+
+private:
+	rtc::scoped_refptr<webrtc::I420BufferInterface> buffer_;
+	EncoderHints hints_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ENCODER_HINT_BUFFER_H_
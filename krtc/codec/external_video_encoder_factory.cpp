@@ -1,4 +1,10 @@
 #include "external_video_encoder_factory.h"
+
+#include <string.h>
+
+#include <map>
+#include <mutex>
+
 #include "absl/memory/memory.h"
 #include "media/engine/internal_decoder_factory.h"
 #include "rtc_base/logging.h"
@@ -11,6 +17,14 @@
 
 #include "nv_encoder.h"
 #include "qsv_encoder.h"
+#include "fallback_video_encoder.h"
+#include "roi_emulation_encoder.h"
+#include "key_frame_governed_encoder.h"
+#include "capture_time_encoder.h"
+#include "shared_video_encoder.h"
+#include "encoder_capability_cache.h"
+#include "krtc/krtc.h"
+#include "krtc/base/krtc_global.h"
 
 namespace krtc {
 
@@ -18,9 +32,22 @@ namespace krtc {
 	public:
 		std::vector<webrtc::SdpVideoFormat> GetSupportedFormats()
 			const override {
+			// Called during negotiation on the signaling thread, the
+			// software encoders decide while the hardware probe runs.
+			std::vector<KRTCEncoderCapability> capabilities;
+			if (!KRTCGlobal::Instance()->encoder_capabilities()->TryGet(&capabilities)) {
+				capabilities = EncoderCapabilityCache::ProbeSoftwareEncoders();
+			}
+
 			std::vector<webrtc::SdpVideoFormat> video_formats;
-			for (const webrtc::SdpVideoFormat& h264_format : webrtc::SupportedH264Codecs())
-				video_formats.push_back(h264_format);
+			bool h264 = false;
+			for (const KRTCEncoderCapability& capability : capabilities) {
+				h264 |= capability.h264;
+			}
+			if (h264) {
+				for (const webrtc::SdpVideoFormat& h264_format : webrtc::SupportedH264Codecs())
+					video_formats.push_back(h264_format);
+			}
 			return video_formats;
 		}
 
@@ -35,26 +62,119 @@ namespace krtc {
 
 		std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(
 			const webrtc::SdpVideoFormat& format) override {
+			std::unique_ptr<webrtc::VideoEncoder> encoder = CreateSharedOrOwnEncoder(format);
+			if (!encoder) {
+				return nullptr;
+			}
+			return absl::make_unique<CaptureTimeEncoder>(std::move(encoder));
+		}
+
+	private:
+		std::unique_ptr<webrtc::VideoEncoder> CreateSharedOrOwnEncoder(
+			const webrtc::SdpVideoFormat& format) {
+			if (!KRTCGlobal::Instance()->share_video_encoder() ||
+				!absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName) ||
+				!webrtc::H264Encoder::IsSupported()) {
+				return CreateH264Encoder(format);
+			}
+
+			// Every pusher sends the same video source, one encoder per
+			// format serves all of them.
+			std::lock_guard<std::mutex> lock(shared_groups_mutex_);
+			std::shared_ptr<SharedEncoderGroup> group = shared_groups_[format.ToString()].lock();
+			if (!group) {
+				group = std::make_shared<SharedEncoderGroup>([this, format]() {
+					return CreateH264Encoder(format);
+				});
+				shared_groups_[format.ToString()] = group;
+			}
+			return group->CreateOutput();
+		}
+
+		std::unique_ptr<webrtc::VideoEncoder> CreateH264Encoder(
+			const webrtc::SdpVideoFormat& format) {
 			if (absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName)) {
 				if (webrtc::H264Encoder::IsSupported()) {
-					if (xop::NvidiaD3D11Encoder::IsSupported()) {
-						return absl::make_unique<krtc::NvEncoder>(cricket::VideoCodec(format));
+					// Best first, FallbackVideoEncoder moves down the list when
+					// a backend fails or cannot keep up.
+					cricket::VideoCodec codec(format);
+					int async_depth = KRTCGlobal::Instance()->encoder_async_depth();
+					EncoderCapabilityCache* capabilities = KRTCGlobal::Instance()->encoder_capabilities();
+					std::vector<FallbackVideoEncoder::Backend> backends;
+					if (capabilities->Find("NvEncoder", nullptr)) {
+						backends.push_back({ "NvEncoder", [codec]() {
+							return std::unique_ptr<webrtc::VideoEncoder>(
+								absl::make_unique<krtc::NvEncoder>(codec));
+						} });
 					}
-					else if (xop::IntelD3DEncoder::IsSupported()) {
-						return absl::make_unique<krtc::QsvEncoder>(cricket::VideoCodec(format));
+					if (capabilities->Find("QsvEncoder", nullptr)) {
+						backends.push_back({ "QsvEncoder", [codec, async_depth]() {
+							return std::unique_ptr<webrtc::VideoEncoder>(
+								absl::make_unique<krtc::QsvEncoder>(codec, async_depth));
+						} });
 					}
-					else {
-						return webrtc::H264Encoder::Create(cricket::VideoCodec(format));
+					// Key frame requests go through a governor on every backend,
+					// the hardware ones have it built in.
+					backends.push_back({ "OpenH264", [codec]() {
+						return std::unique_ptr<webrtc::VideoEncoder>(
+							absl::make_unique<KeyFrameGovernedEncoder>(
+								absl::make_unique<RoiEmulationEncoder>(webrtc::H264Encoder::Create(codec))));
+					} });
+
+					if (backends.size() == 1) {
+						return backends[0].create();
 					}
+
+					return absl::make_unique<FallbackVideoEncoder>(std::move(backends),
+						[](const std::string& from, const std::string& to,
+							EncoderHealthMonitor::Verdict verdict) {
+						RTC_LOG(LS_WARNING) << "video encoder switched from " << from << " to " << to;
+						if (KRTCGlobal::Instance()->engine_observer()) {
+							KRTCGlobal::Instance()->engine_observer()->OnVideoEncoderSwitched(
+								from.c_str(), to.c_str(), EncoderHealthMonitor::VerdictName(verdict));
+						}
+					});
 				}
 			}
 
 			return nullptr;
 		}
+
+		std::mutex shared_groups_mutex_;
+		std::map<std::string, std::weak_ptr<SharedEncoderGroup>> shared_groups_;
 	};
 
 	std::unique_ptr<webrtc::VideoEncoderFactory> CreateBuiltinExternalVideoEncoderFactory() {
 		return absl::make_unique<ExternalEncoderFactory>();
 	}
 
+	static KRTCEncoderCapability ToKRTCEncoderCapability(const char* name,
+		const xop::EncoderCapability& capability) {
+		KRTCEncoderCapability result;
+		memset(&result, 0, sizeof(result));
+		strncpy(result.name, name, sizeof(result.name) - 1);
+		result.hardware = true;
+		result.h264 = capability.h264;
+		result.h265 = capability.hevc;
+		result.max_width = capability.max_width;
+		result.max_height = capability.max_height;
+		return result;
+	}
+
+	std::vector<KRTCEncoderCapability> ProbeExternalVideoEncoders() {
+		std::vector<KRTCEncoderCapability> capabilities;
+		xop::EncoderCapability capability;
+		if (xop::NvidiaD3D11Encoder::QueryCapability(capability) && capability.h264) {
+			capabilities.push_back(ToKRTCEncoderCapability("NvEncoder", capability));
+		}
+		if (xop::IntelD3DEncoder::QueryCapability(capability) && capability.h264) {
+			capabilities.push_back(ToKRTCEncoderCapability("QsvEncoder", capability));
+		}
+
+		for (const KRTCEncoderCapability& software : EncoderCapabilityCache::ProbeSoftwareEncoders()) {
+			capabilities.push_back(software);
+		}
+		return capabilities;
+	}
+
 }
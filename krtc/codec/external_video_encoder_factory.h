@@ -2,15 +2,21 @@
 #define KRTCSDK_KRTC_CODEC_EXTERNAL_BUILTIN_VIDEO_ENCODER_FACTORY_H_
 
 #include <memory>
+#include <vector>
 
 #include "rtc_base/system/rtc_export.h"
 #include "api/video_codecs/video_encoder_factory.h"
+#include "krtc/krtc.h"
 
 namespace krtc {
 
 	// Creates a new factory that can create the built-in types of video decoders.
 	std::unique_ptr<webrtc::VideoEncoderFactory> CreateBuiltinExternalVideoEncoderFactory();
 
+	// nvenc / qsv / openh264 as found on this machine, best first. Slow, meant
+	// for EncoderCapabilityCache.
+	std::vector<KRTCEncoderCapability> ProbeExternalVideoEncoders();
+
 } // namespace krtc
 
 #endif  // KRTCSDK_KRTC_CODEC_EXTERNAL_BUILTIN_VIDEO_ENCODER_FACTORY_H_
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "fallback_video_encoder.h"
+
+#include <algorithm>
+
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace krtc {
+
+namespace {
+
+// The backends read one frame type per simulcast layer, whatever size
+// frame_types had.
+size_t FrameTypeCount(const webrtc::VideoCodec& codec,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	return std::max<size_t>({ frame_types ? frame_types->size() : 0,
+		(size_t)codec.numberOfSimulcastStreams, 1 });
+}
+
+} // namespace
+
+FallbackVideoEncoder::FallbackVideoEncoder(std::vector<Backend> backends,
+	SwitchCallback on_switch, const EncoderHealthMonitor::Config& config)
+	: backends_(std::move(backends)),
+	on_switch_(on_switch),
+	monitor_(config)
+{
+}
+
+FallbackVideoEncoder::~FallbackVideoEncoder()
+{
+	Release();
+}
+
+int32_t FallbackVideoEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores,
+	size_t max_payload_size)
+{
+	if (!codec_settings) {
+		return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+	}
+
+	codec_ = *codec_settings;
+	number_of_cores_ = number_of_cores;
+	max_payload_size_ = max_payload_size;
+	initialized_ = true;
+
+	// A backend demoted earlier stays demoted across reconfigurations.
+	if (!StartBackend(current_)) {
+		initialized_ = false;
+		return WEBRTC_VIDEO_CODEC_ERROR;
+	}
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t FallbackVideoEncoder::Release()
+{
+	initialized_ = false;
+	rates_.reset();
+	if (encoder_) {
+		encoder_->Release();
+		encoder_.reset();
+	}
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t FallbackVideoEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback)
+{
+	callback_ = callback;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void FallbackVideoEncoder::SetRates(const RateControlParameters& parameters)
+{
+	rates_ = parameters;
+	if (encoder_) {
+		encoder_->SetRates(parameters);
+	}
+}
+
+int32_t FallbackVideoEncoder::Encode(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	if (!encoder_) {
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+	}
+
+	std::vector<webrtc::VideoFrameType> key_frames;
+	if (force_key_frame_) {
+		key_frames.assign(FrameTypeCount(codec_, frame_types),
+			webrtc::VideoFrameType::kVideoFrameKey);
+		frame_types = &key_frames;
+		force_key_frame_ = false;
+	}
+
+	int64_t start_us = rtc::TimeMicros();
+	int32_t ret = encoder_->Encode(frame, frame_types);
+	int64_t encode_time_us = rtc::TimeMicros() - start_us;
+
+	EncoderHealthMonitor::Verdict verdict = monitor_.OnFrameEncoded(encode_time_us, ret < 0);
+	if (verdict == EncoderHealthMonitor::kHealthy) {
+		return ret;
+	}
+
+	if (!SwitchBackend(verdict)) {
+		// Nothing left to fall back to, keep going with what we have.
+		monitor_.Reset(codec_.maxFramerate);
+		return ret;
+	}
+
+	if (ret < 0) {
+		// The frame never came out of the old backend, retry it on the new one.
+		key_frames.assign(FrameTypeCount(codec_, frame_types),
+			webrtc::VideoFrameType::kVideoFrameKey);
+		force_key_frame_ = false;
+		return encoder_->Encode(frame, &key_frames);
+	}
+
+	return ret;
+}
+
+webrtc::VideoEncoder::EncoderInfo FallbackVideoEncoder::GetEncoderInfo() const
+{
+	if (encoder_) {
+		return encoder_->GetEncoderInfo();
+	}
+
+	EncoderInfo info;
+	info.implementation_name = "FallbackVideoEncoder";
+	return info;
+}
+
+webrtc::EncodedImageCallback::Result FallbackVideoEncoder::OnEncodedImage(
+	const webrtc::EncodedImage& encoded_image,
+	const webrtc::CodecSpecificInfo* codec_specific_info)
+{
+	if (!callback_) {
+		return Result(Result::ERROR_SEND_FAILED);
+	}
+	return callback_->OnEncodedImage(encoded_image, codec_specific_info);
+}
+
+void FallbackVideoEncoder::OnDroppedFrame(DropReason reason)
+{
+	if (callback_) {
+		callback_->OnDroppedFrame(reason);
+	}
+}
+
+const std::string& FallbackVideoEncoder::current_backend() const
+{
+	static const std::string kNone;
+	return current_ < backends_.size() ? backends_[current_].name : kNone;
+}
+
+bool FallbackVideoEncoder::StartBackend(size_t index)
+{
+	for (; index < backends_.size(); ++index) {
+		std::unique_ptr<webrtc::VideoEncoder> encoder = backends_[index].create();
+		if (!encoder) {
+			continue;
+		}
+
+		encoder->RegisterEncodeCompleteCallback(this);
+		if (encoder->InitEncode(&codec_, number_of_cores_, max_payload_size_) != WEBRTC_VIDEO_CODEC_OK) {
+			RTC_LOG(LS_WARNING) << "encoder " << backends_[index].name << " init failed";
+			encoder->Release();
+			continue;
+		}
+
+		if (rates_) {
+			encoder->SetRates(*rates_);
+		}
+
+		current_ = index;
+		encoder_ = std::move(encoder);
+		monitor_.Reset(codec_.maxFramerate);
+		return true;
+	}
+
+	return false;
+}
+
+bool FallbackVideoEncoder::SwitchBackend(EncoderHealthMonitor::Verdict verdict)
+{
+	if (current_ + 1 >= backends_.size()) {
+		return false;
+	}
+
+	size_t previous = current_;
+	std::string from = backends_[previous].name;
+	RTC_LOG(LS_WARNING) << "encoder " << from << " "
+		<< EncoderHealthMonitor::VerdictName(verdict) << ", falling back";
+
+	// Hardware sessions are limited, let the old one go first. Frames still
+	// in flight are delivered from Release().
+	encoder_->Release();
+	encoder_.reset();
+	force_key_frame_ = true;
+
+	if (!StartBackend(previous + 1)) {
+		RTC_LOG(LS_ERROR) << "no encoder left to fall back to, restarting " << from;
+		StartBackend(previous);
+		return false;
+	}
+
+	switch_count_++;
+	if (on_switch_) {
+		on_switch_(from, backends_[current_].name, verdict);
+	}
+	return true;
+}
+
+} // namespace krtc
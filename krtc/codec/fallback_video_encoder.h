@@ -0,0 +1,80 @@
+#ifndef KRTCSDK_KRTC_CODEC_FALLBACK_VIDEO_ENCODER_H_
+#define KRTCSDK_KRTC_CODEC_FALLBACK_VIDEO_ENCODER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+#include "encoder_health_monitor.h"
+
+namespace krtc {
+
+// Runs the first healthy backend of a list (nvenc, qsv, openh264, ...) and
+// watches its per frame encode time and error rate. When the monitor gives
+// up on it the next backend takes over mid stream, starting with an idr.
+class FallbackVideoEncoder : public webrtc::VideoEncoder,
+							 public webrtc::EncodedImageCallback {
+public:
+	struct Backend {
+		std::string name;
+		std::function<std::unique_ptr<webrtc::VideoEncoder>()> create;
+	};
+
+	// from, to, why.
+	typedef std::function<void(const std::string&, const std::string&,
+		EncoderHealthMonitor::Verdict)> SwitchCallback;
+
+	FallbackVideoEncoder(std::vector<Backend> backends, SwitchCallback on_switch,
+		const EncoderHealthMonitor::Config& config = EncoderHealthMonitor::Config());
+	~FallbackVideoEncoder() override;
+
+	// webrtc::VideoEncoder
+	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
+					   int32_t number_of_cores,
+					   size_t max_payload_size) override;
+	int32_t Release() override;
+	int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override;
+	void SetRates(const RateControlParameters& parameters) override;
+	int32_t Encode(const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+	// webrtc::EncodedImageCallback
+	Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+						  const webrtc::CodecSpecificInfo* codec_specific_info) override;
+	void OnDroppedFrame(DropReason reason) override;
+
+	const std::string& current_backend() const;
+	int switch_count() const { return switch_count_; }
+
+private:
+	// Creates and initializes backends_[index], then the ones after it until
+	// one works. Returns false when none is left.
+	bool StartBackend(size_t index);
+	bool SwitchBackend(EncoderHealthMonitor::Verdict verdict);
+
+	std::vector<Backend> backends_;
+	SwitchCallback on_switch_;
+	EncoderHealthMonitor monitor_;
+
+	size_t current_ = 0;
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	webrtc::EncodedImageCallback* callback_ = nullptr;
+
+	bool initialized_ = false;
+	webrtc::VideoCodec codec_;
+	int32_t number_of_cores_ = 1;
+	size_t max_payload_size_ = 0;
+	absl::optional<RateControlParameters> rates_;
+
+	bool force_key_frame_ = false;
+	int switch_count_ = 0;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_FALLBACK_VIDEO_ENCODER_H_
@@ -0,0 +1,117 @@
+#include "key_frame_governed_encoder.h"
+
+#include <algorithm>
+
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+#include "common_encoder.h"
+#include "encoder_hint_buffer.h"
+
+namespace krtc {
+
+KeyFrameGovernedEncoder::KeyFrameGovernedEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder)
+	: encoder_(std::move(encoder))
+{
+}
+
+KeyFrameGovernedEncoder::~KeyFrameGovernedEncoder() = default;
+
+int32_t KeyFrameGovernedEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores, size_t max_payload_size)
+{
+	// No intra refresh in OpenH264, early requests wait for the interval.
+	KeyFrameGovernor::Config governor_config;
+	governor_config.periodic_interval_ms = PeriodicKeyFrameIntervalMs(*codec_settings);
+	key_frame_governor_.reset(new KeyFrameGovernor(governor_config));
+	number_of_streams_ = std::max<size_t>(codec_settings->numberOfSimulcastStreams, 1);
+
+	webrtc::VideoCodec codec = *codec_settings;
+	if (codec.codecType == webrtc::kVideoCodecH264) {
+		codec.H264()->keyFrameInterval = 0;
+	}
+	return encoder_->InitEncode(&codec, number_of_cores, max_payload_size);
+}
+
+int32_t KeyFrameGovernedEncoder::Release()
+{
+	if (key_frame_governor_) {
+		LogKeyFrameStats("OpenH264", *key_frame_governor_);
+		key_frame_governor_.reset();
+	}
+	return encoder_->Release();
+}
+
+int32_t KeyFrameGovernedEncoder::RegisterEncodeCompleteCallback(
+	webrtc::EncodedImageCallback* callback)
+{
+	callback_ = callback;
+	return encoder_->RegisterEncodeCompleteCallback(callback ? this : nullptr);
+}
+
+void KeyFrameGovernedEncoder::SetRates(const RateControlParameters& parameters)
+{
+	encoder_->SetRates(parameters);
+}
+
+int32_t KeyFrameGovernedEncoder::Encode(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	if (!key_frame_governor_) {
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+	}
+
+	int64_t now_ms = rtc::TimeMillis();
+	bool requested = false;
+	if (frame_types) {
+		requested = std::find(frame_types->begin(), frame_types->end(),
+			webrtc::VideoFrameType::kVideoFrameKey) != frame_types->end();
+	}
+	if (requested) {
+		key_frame_governor_->RequestKeyFrame(now_ms);
+	}
+
+	bool scene_cut = EncoderHintBuffer::Find(frame.video_frame_buffer().get()).scene_cut;
+	KeyFrameGovernor::Decision decision = key_frame_governor_->OnFrame(now_ms, false, scene_cut);
+
+	// The encoder sees a key frame only when the governor decided on one,
+	// skipped layers stay skipped.
+	std::vector<webrtc::VideoFrameType> governed_types(
+		std::max(frame_types ? frame_types->size() : 0, number_of_streams_),
+		webrtc::VideoFrameType::kVideoFrameDelta);
+	for (size_t i = 0; i < governed_types.size(); ++i) {
+		if (frame_types && i < frame_types->size() &&
+			(*frame_types)[i] == webrtc::VideoFrameType::kEmptyFrame) {
+			governed_types[i] = webrtc::VideoFrameType::kEmptyFrame;
+		}
+		else if (decision == KeyFrameGovernor::kKeyFrame) {
+			governed_types[i] = webrtc::VideoFrameType::kVideoFrameKey;
+		}
+	}
+
+	return encoder_->Encode(frame, &governed_types);
+}
+
+webrtc::VideoEncoder::EncoderInfo KeyFrameGovernedEncoder::GetEncoderInfo() const
+{
+	return encoder_->GetEncoderInfo();
+}
+
+webrtc::EncodedImageCallback::Result KeyFrameGovernedEncoder::OnEncodedImage(
+	const webrtc::EncodedImage& encoded_image,
+	const webrtc::CodecSpecificInfo* codec_specific_info)
+{
+	// Also the IDRs the encoder placed itself, for a layer that starts.
+	if (encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey &&
+		key_frame_governor_) {
+		key_frame_governor_->OnKeyFrameEncoded(rtc::TimeMillis(), encoded_image.Timestamp());
+	}
+	return callback_->OnEncodedImage(encoded_image, codec_specific_info);
+}
+
+void KeyFrameGovernedEncoder::OnDroppedFrame(DropReason reason)
+{
+	callback_->OnDroppedFrame(reason);
+}
+
+} // namespace krtc
@@ -0,0 +1,50 @@
+#ifndef KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNED_ENCODER_H_
+#define KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNED_ENCODER_H_
+
+#include <memory>
+#include <vector>
+
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+#include "key_frame_governor.h"
+
+namespace krtc {
+
+// Puts a KeyFrameGovernor in front of an encoder that has none of its own
+// (OpenH264): the receivers' key frame requests in frame_types only turn
+// into an IDR when the governor says so, scene cuts tagged by the capturer
+// get one, and the periodic IDRs are placed by the governor with the
+// encoder's own gop turned off. Layers that start sending are left to the
+// encoder.
+class KeyFrameGovernedEncoder : public webrtc::VideoEncoder,
+								public webrtc::EncodedImageCallback {
+public:
+	explicit KeyFrameGovernedEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder);
+	~KeyFrameGovernedEncoder() override;
+
+	// webrtc::VideoEncoder
+	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
+					   int32_t number_of_cores,
+					   size_t max_payload_size) override;
+	int32_t Release() override;
+	int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override;
+	void SetRates(const RateControlParameters& parameters) override;
+	int32_t Encode(const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+	// webrtc::EncodedImageCallback
+	Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+						  const webrtc::CodecSpecificInfo* codec_specific_info) override;
+	void OnDroppedFrame(DropReason reason) override;
+
+private:
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	webrtc::EncodedImageCallback* callback_ = nullptr;
+	std::unique_ptr<KeyFrameGovernor> key_frame_governor_;
+	size_t number_of_streams_ = 1;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNED_ENCODER_H_
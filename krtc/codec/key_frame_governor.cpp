@@ -0,0 +1,124 @@
+#include "key_frame_governor.h"
+
+namespace krtc {
+
+KeyFrameGovernor::KeyFrameGovernor()
+	: KeyFrameGovernor(Config())
+{
+}
+
+KeyFrameGovernor::KeyFrameGovernor(const Config& config)
+	: config_(config)
+{
+}
+
+void KeyFrameGovernor::Reset()
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	pending_ = false;
+	last_key_frame_ms_ = -1;
+	last_answer_ms_ = -1;
+	has_key_frame_timestamp_ = false;
+	stats_ = Stats();
+}
+
+void KeyFrameGovernor::RequestKeyFrame(int64_t now_ms)
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	stats_.requested++;
+
+	if (pending_) {
+		stats_.coalesced++;
+		return;
+	}
+
+	if (last_answer_ms_ >= 0 && now_ms - last_answer_ms_ < config_.coalesce_window_ms) {
+		stats_.coalesced++;
+		return;
+	}
+
+	pending_ = true;
+}
+
+KeyFrameGovernor::Decision KeyFrameGovernor::OnFrame(int64_t now_ms, bool required, bool scene_cut)
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+
+	if (required || scene_cut) {
+		if (scene_cut && !required) {
+			stats_.scene_cuts++;
+		}
+		else {
+			stats_.forced++;
+		}
+		return KeyFrame(now_ms);
+	}
+
+	if (pending_) {
+		if (last_key_frame_ms_ < 0 || now_ms - last_key_frame_ms_ >= config_.min_interval_ms) {
+			stats_.forced++;
+			return KeyFrame(now_ms);
+		}
+
+		if (config_.intra_refresh) {
+			pending_ = false;
+			last_answer_ms_ = now_ms;
+			stats_.intra_refreshes++;
+			return kIntraRefresh;
+		}
+
+		// Too early, keep it pending for a later frame.
+	}
+
+	if (config_.periodic_interval_ms > 0 && last_key_frame_ms_ >= 0 &&
+		now_ms - last_key_frame_ms_ >= config_.periodic_interval_ms) {
+		stats_.periodic++;
+		return KeyFrame(now_ms);
+	}
+
+	return kNone;
+}
+
+KeyFrameGovernor::Decision KeyFrameGovernor::KeyFrame(int64_t now_ms)
+{
+	pending_ = false;
+	last_answer_ms_ = now_ms;
+	// Hold off the next forced IDR until this one is out, the frame may
+	// still be in flight in the backend.
+	last_key_frame_ms_ = now_ms;
+	return kKeyFrame;
+}
+
+void KeyFrameGovernor::OnKeyFrameEncoded(int64_t now_ms, uint32_t rtp_timestamp)
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (has_key_frame_timestamp_ && rtp_timestamp == last_key_frame_timestamp_) {
+		return;
+	}
+	has_key_frame_timestamp_ = true;
+	last_key_frame_timestamp_ = rtp_timestamp;
+	stats_.emitted++;
+
+	// A periodic IDR answers the pending request as well.
+	pending_ = false;
+	if (now_ms > last_key_frame_ms_) {
+		last_key_frame_ms_ = now_ms;
+	}
+	if (now_ms > last_answer_ms_) {
+		last_answer_ms_ = now_ms;
+	}
+}
+
+bool KeyFrameGovernor::pending() const
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	return pending_;
+}
+
+KeyFrameGovernor::Stats KeyFrameGovernor::stats() const
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	return stats_;
+}
+
+} // namespace krtc
@@ -0,0 +1,85 @@
+#ifndef KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNOR_H_
+#define KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNOR_H_
+
+#include <stdint.h>
+
+#include <mutex>
+
+namespace krtc {
+
+// Decides when a key frame request (PLI/FIR, a new simulcast layer) really
+// turns into an IDR. A burst of requests from several receivers is answered
+// once, and IDRs are spaced at least min_interval_ms apart; a request that
+// comes too early waits, or is answered with an intra refresh when the
+// backend has one.
+// Scene cuts always get an IDR, it costs no more than the P frame would.
+// Periodic IDRs are placed here too, counted from the last IDR of any kind,
+// so none follows shortly after a cut.
+// Requests may come from any thread, the encoded frame callback may run on
+// the backend's collector thread.
+class KeyFrameGovernor {
+public:
+	enum Decision {
+		kNone = 0,
+		kKeyFrame,      // force an IDR on this frame
+		kIntraRefresh,  // start a gradual intra refresh instead
+	};
+
+	struct Config {
+		// Requests within this time after a key frame (or intra refresh) was
+		// started are considered answered by it, the receiver asked before
+		// it arrived.
+		int64_t coalesce_window_ms = 300;
+		// Minimum time between two requested IDRs.
+		int64_t min_interval_ms = 1000;
+		// Answer requests that come before min_interval_ms with an intra refresh.
+		bool intra_refresh = false;
+		// 0: no periodic IDR from here, the backend's gop decides.
+		int64_t periodic_interval_ms = 0;
+	};
+
+	struct Stats {
+		uint64_t requested = 0;        // RequestKeyFrame() calls
+		uint64_t coalesced = 0;        // requests merged into another one
+		uint64_t forced = 0;           // IDRs forced by OnFrame()
+		uint64_t intra_refreshes = 0;  // intra refreshes started by OnFrame()
+		uint64_t scene_cuts = 0;       // IDRs placed on scene cuts
+		uint64_t periodic = 0;         // periodic IDRs
+		uint64_t emitted = 0;          // IDRs out of the encoder, periodic ones included
+	};
+
+	KeyFrameGovernor();
+	explicit KeyFrameGovernor(const Config& config);
+
+	void Reset();
+
+	void RequestKeyFrame(int64_t now_ms);
+
+	// Called before a frame is encoded. required is set when the stream can not
+	// be decoded without a key frame (a layer that starts sending), it bypasses
+	// the interval, and so does a scene cut.
+	Decision OnFrame(int64_t now_ms, bool required, bool scene_cut = false);
+
+	// Called for every IDR the encoder produced, the simulcast layers of one
+	// frame share the rtp timestamp and count once.
+	void OnKeyFrameEncoded(int64_t now_ms, uint32_t rtp_timestamp);
+
+	bool pending() const;
+	Stats stats() const;
+
+private:
+	Decision KeyFrame(int64_t now_ms);
+
+	Config config_;
+	mutable std::mutex mutex_;
+	bool pending_ = false;
+	int64_t last_key_frame_ms_ = -1;  // last IDR out of the encoder
+	int64_t last_answer_ms_ = -1;     // last IDR or intra refresh started
+	bool has_key_frame_timestamp_ = false;
+	uint32_t last_key_frame_timestamp_ = 0;
+	Stats stats_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_KEY_FRAME_GOVERNOR_H_
@@ -0,0 +1,87 @@
+#include "nal_unit_index.h"
+
+#include <algorithm>
+
+namespace krtc {
+
+namespace {
+
+// Slice headers of the low latency profiles the backends produce are a few
+// dozen bytes, leave room for ref list modification / pred weight tables.
+const size_t kMaxSliceHeaderSize = 256;
+
+} // namespace
+
+void NalUnitIndex::Clear()
+{
+	units_.clear();
+	first_slice_ = -1;
+	idr_ = false;
+	max_payload_size_ = 0;
+}
+
+void NalUnitIndex::Build(const uint8_t* data, size_t size)
+{
+	Clear();
+	if (!data || size < 3) {
+		return;
+	}
+
+	// Same skipping as webrtc::H264::FindNaluIndices: a start code needs
+	// data[i + 2] == 1 and two zeros before it, so any byte > 1 at i + 2
+	// moves the window by 3.
+	const size_t end = size - 2;
+	size_t i = 0;
+	while (i < end) {
+		if (data[i + 2] > 1) {
+			i += 3;
+		}
+		else if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0) {
+			NalUnit unit;
+			unit.start_code_offset = (i > 0 && data[i - 1] == 0) ? i - 1 : i;
+			unit.payload_offset = i + 3;
+			if (!units_.empty()) {
+				NalUnit& last = units_.back();
+				last.payload_size = unit.start_code_offset - last.payload_offset;
+			}
+			units_.push_back(unit);
+			i += 3;
+		}
+		else {
+			i++;
+		}
+	}
+
+	if (units_.empty()) {
+		return;
+	}
+	units_.back().payload_size = size - units_.back().payload_offset;
+
+	for (size_t n = 0; n < units_.size(); n++) {
+		NalUnit& unit = units_[n];
+		if (unit.payload_size == 0) {
+			continue;
+		}
+		unit.type = data[unit.payload_offset] & 0x1f;
+		max_payload_size_ = std::max(max_payload_size_, unit.payload_size);
+		if (unit.type == kSlice || unit.type == kIdrSlice) {
+			if (first_slice_ < 0) {
+				first_slice_ = (int)n;
+			}
+			if (unit.type == kIdrSlice) {
+				idr_ = true;
+			}
+		}
+	}
+}
+
+size_t NalUnitIndex::SliceHeaderEnd() const
+{
+	if (first_slice_ < 0) {
+		return 0;
+	}
+	const NalUnit& slice = units_[first_slice_];
+	return slice.payload_offset + std::min(slice.payload_size, kMaxSliceHeaderSize);
+}
+
+} // namespace krtc
@@ -0,0 +1,59 @@
+#ifndef KRTCSDK_KRTC_CODEC_NAL_UNIT_INDEX_H_
+#define KRTCSDK_KRTC_CODEC_NAL_UNIT_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace krtc {
+
+// Offsets and types of the NAL units of one H.264 Annex B access unit,
+// built in a single pass right after the backend wrote it. Answers the
+// frame type without guessing from the first byte (AUD / SEI may come
+// first), and bounds what the slice QP parser has to look at.
+class NalUnitIndex {
+public:
+	enum NalType {
+		kSlice = 1,
+		kIdrSlice = 5,
+		kSei = 6,
+		kSps = 7,
+		kPps = 8,
+		kAud = 9,
+		kFiller = 12,
+	};
+
+	struct NalUnit {
+		size_t start_code_offset = 0;
+		size_t payload_offset = 0;  // nal header byte
+		size_t payload_size = 0;
+		uint8_t type = 0;
+	};
+
+	void Build(const uint8_t* data, size_t size);
+	void Clear();
+
+	const std::vector<NalUnit>& units() const { return units_; }
+
+	bool has_picture() const { return first_slice_ >= 0; }
+	bool is_idr() const { return idr_; }
+
+	// Bytes from the start of the access unit to past the first slice header,
+	// parameter sets included: all webrtc::H264BitstreamParser needs for
+	// the QP. 0 when there is no slice.
+	size_t SliceHeaderEnd() const;
+
+	// Largest NAL unit, what single nal unit packetization has to fit.
+	size_t max_payload_size() const { return max_payload_size_; }
+
+private:
+	std::vector<NalUnit> units_;
+	int first_slice_ = -1;
+	bool idr_ = false;
+	size_t max_payload_size_ = 0;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_NAL_UNIT_INDEX_H_
@@ -38,7 +38,6 @@ NvEncoder::NvEncoder(const cricket::VideoCodec& codec)
 	encoded_images_.reserve(webrtc::kMaxSimulcastStreams);
 	nv_encoders_.reserve(webrtc::kMaxSimulcastStreams);
 	configurations_.reserve(webrtc::kMaxSimulcastStreams);
-	image_buffer_ = nullptr;
 }
 
 NvEncoder::~NvEncoder() 
@@ -120,30 +119,33 @@ int32_t NvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 		nv_encoder->SetOption(xop::VE_OPT_WIDTH, configurations_[i].width);
 		nv_encoder->SetOption(xop::VE_OPT_HEIGHT, configurations_[i].height);
 		nv_encoder->SetOption(xop::VE_OPT_FRAME_RATE, static_cast<int>(configurations_[i].max_frame_rate));
-		nv_encoder->SetOption(xop::VE_OPT_GOP, configurations_[i].key_frame_interval);
+		nv_encoder->SetOption(xop::VE_OPT_GOP, 0);
 		nv_encoder->SetOption(xop::VE_OPT_CODEC, xop::VE_OPT_CODEC_H264);
 		nv_encoder->SetOption(xop::VE_OPT_BITRATE_KBPS, configurations_[i].target_bps / 1000);
-		nv_encoder->SetOption(xop::VE_OPT_TEXTURE_FORMAT, xop::VE_OPT_FORMAT_B8G8R8A8);
+		nv_encoder->SetOption(xop::VE_OPT_TEXTURE_FORMAT, xop::VE_OPT_FORMAT_NV12);
 		if (!nv_encoder->Init()) {
 			Release();
 			ReportError();
 			return WEBRTC_VIDEO_CODEC_ERROR;
 		}
 		
-		image_buffer_.reset(new uint8_t[configurations_[i].width * configurations_[i].height * 10]);
-
-		// TODO(pbos): Base init params on these values before submitting.
-		video_format_ = EVideoFormatType::videoFormatI420;
-
-		// Initialize encoded image. Default buffer size: size of unencoded data.
-		const size_t new_capacity = webrtc::CalcBufferSize(webrtc::VideoType::kI420,
-			codec_.simulcastStream[idx].width, codec_.simulcastStream[idx].height);
-		encoded_images_[i].SetEncodedData(webrtc::EncodedImageBuffer::Create(new_capacity));
+		// Initialize encoded image. The bitstream comes from bitstream_pool_ per frame.
 		encoded_images_[i]._encodedWidth = codec_.simulcastStream[idx].width;
 		encoded_images_[i]._encodedHeight = codec_.simulcastStream[idx].height;
 		encoded_images_[i].set_size(0);
 	}
 
+	// Answer early PLIs with an intra refresh on camera content, a refresh
+	// of a mostly static screen costs about as much as the IDR.
+	KeyFrameGovernor::Config governor_config;
+	governor_config.periodic_interval_ms = PeriodicKeyFrameIntervalMs(codec_);
+	governor_config.intra_refresh = codec_.mode == webrtc::VideoCodecMode::kRealtimeVideo;
+	for (size_t i = 0; i < nv_encoders_.size(); ++i) {
+		xop::NvidiaD3D11Encoder* nv_encoder = reinterpret_cast<xop::NvidiaD3D11Encoder*>(nv_encoders_[i]);
+		governor_config.intra_refresh &= nv_encoder->SupportsIntraRefresh();
+	}
+	key_frame_governor_.reset(new KeyFrameGovernor(governor_config));
+
 	webrtc::SimulcastRateAllocator init_allocator(codec_);
 	webrtc::VideoBitrateAllocation allocation = init_allocator.GetAllocation(
 		codec_.maxBitrate * 1000 / 2, codec_.maxFramerate);
@@ -153,6 +155,11 @@ int32_t NvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 
 int32_t NvEncoder::Release() 
 {
+	if (key_frame_governor_) {
+		LogKeyFrameStats("NvEncoder", *key_frame_governor_);
+		key_frame_governor_.reset();
+	}
+
 	while (!nv_encoders_.empty()) {		
 		xop::NvidiaD3D11Encoder* nv_encoder = reinterpret_cast<xop::NvidiaD3D11Encoder*>(nv_encoders_.back());
 		if (nv_encoder) {
@@ -164,6 +171,7 @@ int32_t NvEncoder::Release()
 
 	configurations_.clear();
 	encoded_images_.clear();
+	bitstream_pool_.Release();
 
 	return WEBRTC_VIDEO_CODEC_OK;
 }
@@ -239,89 +247,71 @@ int32_t NvEncoder::Encode(const webrtc::VideoFrame& input_frame,
 	RTC_CHECK(frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kI420 ||
 		frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kI420A);
 
-	bool send_key_frame = false;
-	for (size_t i = 0; i < configurations_.size(); ++i) {
-		if (configurations_[i].key_frame_request && configurations_[i].sending) {
-			send_key_frame = true;
-			break;
-		}
-	}
-	if (!send_key_frame && frame_types) {
-		for (size_t i = 0; i < frame_types->size() && i < configurations_.size(); ++i) {
-			if ((*frame_types)[i] == webrtc::VideoFrameType::kVideoFrameKey && configurations_[i].sending) {
-				send_key_frame = true;
-				break;
-			}
-		}
-	}
-	
+	KeyFrameGovernor::Decision key_frame = GovernKeyFrame(key_frame_governor_.get(),
+		configurations_, input_frame, frame_types, rtc::TimeMillis());
+
 	RTC_DCHECK_EQ(configurations_[0].width, frame_buffer->width());
 	RTC_DCHECK_EQ(configurations_[0].height, frame_buffer->height());
 
 	// Encode image for each layer.
 	for (size_t i = 0; i < nv_encoders_.size(); ++i) {
 		if (!configurations_[i].sending) {
+			configurations_[i].skipped_frame = true;
 			continue;
 		}
 
 		if (frame_types != nullptr) {
 			// Skip frame?
 			if ((*frame_types)[i] == webrtc::VideoFrameType::kEmptyFrame) {
+				configurations_[i].skipped_frame = true;
 				continue;
 			}
 		}
 
-		if (send_key_frame) {			
-			if (!nv_encoders_.empty() && nv_encoders_[i]) {
-				xop::NvidiaD3D11Encoder* nv_encoder = reinterpret_cast<xop::NvidiaD3D11Encoder*>(nv_encoders_[i]);
-				nv_encoder->SetEvent(xop::VE_EVENT_FORCE_IDR, 1);
-			}
-
+		if (nv_encoders_[i]) {
+			xop::NvidiaD3D11Encoder* nv_encoder = reinterpret_cast<xop::NvidiaD3D11Encoder*>(nv_encoders_[i]);
+			ApplyKeyFrameDecision(nv_encoder, key_frame, configurations_[i].max_frame_rate);
+		}
+		if (key_frame == KeyFrameGovernor::kKeyFrame) {
 			configurations_[i].key_frame_request = false;
 		}
 
 		// EncodeFrame output.
 		SFrameBSInfo info;
 		memset(&info, 0, sizeof(SFrameBSInfo));
-		std::vector<uint8_t> frame_packet;
+		rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream = bitstream_pool_.Acquire();
+		std::vector<uint8_t>& frame_packet = bitstream->bitstream();
 
-		bool success = EncodeFrame((int)i, input_frame, frame_packet);
+		bool success = EncodeFrame((int)i, input_frame, !configurations_[i].skipped_frame, frame_packet);
+		configurations_[i].skipped_frame = !success;
 		if (!success) {
 			return WEBRTC_VIDEO_CODEC_ERROR;
 		}
 
-		if (frame_packet.size() == 0) {
+		bitstream->IndexNalUnits();
+		int qp = -1;
+		if (!ReadFrameInfo(*bitstream, &h264_bitstream_parser_, &info.eFrameType, &qp)) {
 			return WEBRTC_VIDEO_CODEC_OK;
 		}
-		else {
-			if ((frame_packet[4] & 0x1f) == 0x07) {
-				info.eFrameType = videoFrameTypeIDR; 
-			}
-			else if ((frame_packet[4] & 0x1f) == 0x01) {
-				info.eFrameType = videoFrameTypeP;
-			}
-			else {
-				return WEBRTC_VIDEO_CODEC_OK;
-			}
+		if (info.eFrameType == videoFrameTypeIDR) {
+			key_frame_governor_->OnKeyFrameEncoded(rtc::TimeMillis(), input_frame.timestamp());
 		}
 
 		encoded_images_[i]._encodedWidth = configurations_[i].width;
 		encoded_images_[i]._encodedHeight = configurations_[i].height;
 		encoded_images_[i].SetTimestamp(input_frame.timestamp());
+		encoded_images_[i].capture_time_ms_ = input_frame.render_time_ms();
 		encoded_images_[i]._frameType = ConvertToVideoFrameType(info.eFrameType);
 		encoded_images_[i].SetSpatialIndex(configurations_[i].simulcast_idx);
 
 		// Split encoded image up into fragments. This also updates
 		// |encoded_image_|.
-		RtpFragmentize(&encoded_images_[i], frame_packet);
+		RtpFragmentize(&encoded_images_[i], bitstream);
 
 		// Encoder can skip frames to save bandwidth in which case
 		// |encoded_images_[i]._length| == 0.
 		if (encoded_images_[i].size() > 0) {
-			// Parse QP.
-			h264_bitstream_parser_.ParseBitstream(encoded_images_[i]);
-			encoded_images_[i].qp_ =
-				h264_bitstream_parser_.GetLastSliceQp().value_or(-1);
+			encoded_images_[i].qp_ = qp;
 
 			// Deliver encoded image.
 			webrtc::CodecSpecificInfo codec_specific;
@@ -379,7 +369,7 @@ void NvEncoder::LayerConfig::SetStreamState(bool send_stream)
 }
 
 bool NvEncoder::EncodeFrame(int index, const webrtc::VideoFrame& input_frame,
-							std::vector<uint8_t>& frame_packet) 
+							bool use_update_rect, std::vector<uint8_t>& frame_packet) 
 {
 	frame_packet.clear();
 
@@ -387,30 +377,26 @@ bool NvEncoder::EncodeFrame(int index, const webrtc::VideoFrame& input_frame,
 		return false;
 	}
 
-	if (video_format_ == EVideoFormatType::videoFormatI420) {
-		if (image_buffer_ != nullptr) {
-			if (webrtc::ConvertFromI420(input_frame, webrtc::VideoType::kARGB, 0,
-										image_buffer_.get()) < 0) {
-				return false;
-			}
-		} 
-		else {
-			return false;
-		}
+	rtc::scoped_refptr<webrtc::I420BufferInterface> i420_buffer =
+		input_frame.video_frame_buffer()->ToI420();
+	if (!i420_buffer) {
+		return false;
 	}
 
-	int width = input_frame.width();
-	int height = input_frame.height();
-	int image_size = width * height * 4; // argb
-
 	xop::NvidiaD3D11Encoder* nv_encoder = reinterpret_cast<xop::NvidiaD3D11Encoder*>(nv_encoders_[index]);
 	if (nv_encoder) {
-		int frame_size = nv_encoder->Encode(std::vector<uint8_t>(image_buffer_.get(), image_buffer_.get() + image_size) ,frame_packet);
+		xop::VideoImage image = ToVideoImage(*i420_buffer);
+		if (use_update_rect) {
+			SetUpdateRect(input_frame, &image);
+		}
+		std::shared_ptr<const QpDeltaMap> qp_map = SetQpDeltaMap(input_frame, &image);
+
+		int frame_size = nv_encoder->Encode(image, frame_packet);
 		if (frame_size < 0) {
 			return false;
 		}
 	}
-	
+
 	return true;
 }
 
@@ -14,6 +14,8 @@
 #include "modules/video_coding/codecs/h264/include/h264.h"
 #include "modules/video_coding/utility/quality_scaler.h"
 #include "third_party/openh264/src/codec/api/svc/codec_app_def.h"
+#include "encoded_buffer_pool.h"
+#include "key_frame_governor.h"
 #include "encoder/nvidia_d3d11_encoder.h"
 
 namespace krtc {
@@ -27,6 +29,7 @@ public:
 		int height = -1;
 		bool sending = true;
 		bool key_frame_request = false;
+		bool skipped_frame = true;  // the backend missed a frame, upload the next one whole
 		float max_frame_rate = 0;
 		uint32_t target_bps = 0;
 		uint32_t max_bps = 0;
@@ -70,11 +73,13 @@ private:
 	void ReportError();
 
 	bool EncodeFrame(int index,const webrtc::VideoFrame& input_frame,
-					std::vector<uint8_t>& frame_packet);
+					bool use_update_rect, std::vector<uint8_t>& frame_packet);
 
 	std::vector<void*> nv_encoders_;
 	std::vector<LayerConfig> configurations_;
 	std::vector<webrtc::EncodedImage> encoded_images_;
+	EncodedBufferPool bitstream_pool_;
+	std::unique_ptr<KeyFrameGovernor> key_frame_governor_;
 
 	webrtc::VideoCodec codec_;
 	webrtc::H264PacketizationMode packetization_mode_;
@@ -84,11 +89,8 @@ private:
 
 	bool has_reported_init_;
 	bool has_reported_error_;
-	int video_format_;
 	int num_temporal_layers_;
 	uint8_t tl0sync_limit_;
-
-	std::unique_ptr<uint8_t[]> image_buffer_;
 };
 
 }  // namespace krtc
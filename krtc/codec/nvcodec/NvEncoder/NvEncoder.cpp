@@ -392,6 +392,20 @@ const NvEncInputFrame* NvEncoder::GetNextReferenceFrame()
 void NvEncoder::EncodeFrame(std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams)
 {
     vPacket.clear();
+    DoEncode(MapNextInputBuffer(), vPacket, pPicParams);
+}
+
+void NvEncoder::EncodeFrame(std::vector<uint8_t> &bitstream, NV_ENC_PIC_PARAMS *pPicParams)
+{
+    bitstream.clear();
+    SubmitPicture(MapNextInputBuffer(), pPicParams);
+    DrainEncodedPackets(m_vBitstreamOutputBuffer, true, [&bitstream](const uint8_t *pData, uint32_t nSize) {
+        bitstream.insert(bitstream.end(), pData, pData + nSize);
+    });
+}
+
+NV_ENC_INPUT_PTR NvEncoder::MapNextInputBuffer()
+{
     if (!IsHWEncoderInitialized())
     {
         NVENC_THROW_ERROR("Encoder device not found", NV_ENC_ERR_NO_ENCODE_DEVICE);
@@ -401,7 +415,7 @@ void NvEncoder::EncodeFrame(std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_P
     mapInputResource.registeredResource = m_vRegisteredResources[i];
     NVENC_API_CALL(m_nvenc.nvEncMapInputResource(m_hEncoder, &mapInputResource));
     m_vMappedInputBuffers[i] = mapInputResource.mappedResource;
-    DoEncode(m_vMappedInputBuffers[i], vPacket, pPicParams);
+    return m_vMappedInputBuffers[i];
 }
 
 void NvEncoder::RunMotionEstimation(std::vector<uint8_t> &mvData)
@@ -478,7 +492,28 @@ void NvEncoder::SetROI(int pos_x, int pos_y, int region_width, int region_height
     }
 }
 
+void NvEncoder::SetQpDeltaMap(const int8_t* qp_delta_map, uint32_t size)
+{
+    if (!qp_delta_map || size == 0) {
+        m_qpDeltaMap.reset();
+        m_qpDeltaMapSize = 0;
+        return;
+    }
+
+    if (size != m_qpDeltaMapSize) {
+        m_qpDeltaMap.reset(new int8_t[size]);
+        m_qpDeltaMapSize = size;
+    }
+    memcpy(m_qpDeltaMap.get(), qp_delta_map, size);
+}
+
 void NvEncoder::DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams)
+{
+    SubmitPicture(inputBuffer, pPicParams);
+    GetEncodedPacket(m_vBitstreamOutputBuffer, vPacket, true);
+}
+
+void NvEncoder::SubmitPicture(NV_ENC_INPUT_PTR inputBuffer, NV_ENC_PIC_PARAMS *pPicParams)
 {
     NV_ENC_PIC_PARAMS picParams = {};
     if (pPicParams)
@@ -500,13 +535,22 @@ void NvEncoder::DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<u
 	if (m_forceIDR) {
 		picParams.pictureType = NV_ENC_PIC_TYPE_IDR;
 		m_forceIDR = false;
+		m_intraRefreshCnt = 0;
+	}
+	else if (m_intraRefreshCnt > 0) {
+		if (m_initializeParams.encodeGUID == NV_ENC_CODEC_H264_GUID) {
+			picParams.codecPicParams.h264PicParams.forceIntraRefreshWithFrameCnt = m_intraRefreshCnt;
+		}
+		else if (m_initializeParams.encodeGUID == NV_ENC_CODEC_HEVC_GUID) {
+			picParams.codecPicParams.hevcPicParams.forceIntraRefreshWithFrameCnt = m_intraRefreshCnt;
+		}
+		m_intraRefreshCnt = 0;
 	}
 
     NVENCSTATUS nvStatus = m_nvenc.nvEncEncodePicture(m_hEncoder, &picParams);
     if (nvStatus == NV_ENC_SUCCESS || nvStatus == NV_ENC_ERR_NEED_MORE_INPUT)
     {
         m_iToSend++;
-        GetEncodedPacket(m_vBitstreamOutputBuffer, vPacket, true);
     }
     else
     {
@@ -532,6 +576,20 @@ void NvEncoder::EndEncode(std::vector<std::vector<uint8_t>> &vPacket)
 void NvEncoder::GetEncodedPacket(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, std::vector<std::vector<uint8_t>> &vPacket, bool bOutputDelay)
 {
     unsigned i = 0;
+    DrainEncodedPackets(vOutputBuffer, bOutputDelay, [&vPacket, &i](const uint8_t *pData, uint32_t nSize) {
+        if (vPacket.size() < i + 1)
+        {
+            vPacket.push_back(std::vector<uint8_t>());
+        }
+        vPacket[i].clear();
+        vPacket[i].insert(vPacket[i].end(), pData, pData + nSize);
+        i++;
+    });
+}
+
+template <typename PacketSink>
+void NvEncoder::DrainEncodedPackets(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, bool bOutputDelay, PacketSink sink)
+{
     int iEnd = bOutputDelay ? m_iToSend - m_nOutputDelay : m_iToSend;
     for (; m_iGot < iEnd; m_iGot++)
     {
@@ -541,14 +599,7 @@ void NvEncoder::GetEncodedPacket(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer,
         lockBitstreamData.doNotWait = false;
         NVENC_API_CALL(m_nvenc.nvEncLockBitstream(m_hEncoder, &lockBitstreamData));
   
-        uint8_t *pData = (uint8_t *)lockBitstreamData.bitstreamBufferPtr;
-        if (vPacket.size() < i + 1)
-        {
-            vPacket.push_back(std::vector<uint8_t>());
-        }
-        vPacket[i].clear();
-        vPacket[i].insert(vPacket[i].end(), &pData[0], &pData[lockBitstreamData.bitstreamSizeInBytes]);
-        i++;
+        sink((const uint8_t *)lockBitstreamData.bitstreamBufferPtr, lockBitstreamData.bitstreamSizeInBytes);
 
         NVENC_API_CALL(m_nvenc.nvEncUnlockBitstream(m_hEncoder, lockBitstreamData.outputBitstream));
 
@@ -863,7 +914,7 @@ int NvEncoder::GetCapabilityValue(GUID guidCodec, NV_ENC_CAPS capsToQuery)
     }
     NV_ENC_CAPS_PARAM capsParam = { NV_ENC_CAPS_PARAM_VER };
     capsParam.capsToQuery = capsToQuery;
-    int v;
+    int v = 0;
     m_nvenc.nvEncGetEncodeCaps(m_hEncoder, guidCodec, &capsParam, &v);
     return v;
 }
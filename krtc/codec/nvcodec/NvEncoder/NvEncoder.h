@@ -125,6 +125,12 @@ public:
     */
     void EncodeFrame(std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams = nullptr);
 
+    /**
+    *  @brief  Same as above, but all output packets are appended to one caller
+    *  owned buffer, so its capacity is reused from frame to frame.
+    */
+    void EncodeFrame(std::vector<uint8_t> &bitstream, NV_ENC_PIC_PARAMS *pPicParams = nullptr);
+
     /**
     *  @brief  This function to flush the encoder queue.
     *  The encoder might be queuing frames for B picture encoding or lookahead;
@@ -216,11 +222,21 @@ public:
 	*/
 	void ForceIDR() { m_forceIDR = true; }
 
+	/**
+	*  @brief refresh the picture with intra coded slices over frame_cnt frames, H.264/HEVC P frames only
+	*/
+	void ForceIntraRefresh(uint32_t frame_cnt) { m_intraRefreshCnt = frame_cnt; }
+
     /**
     *  @brief set region of interest
     */
     void SetROI(int pos_x, int pos_y, int region_width, int region_height, int delta_qp);
 
+    /**
+    *  @brief set a delta QP per MB (CTB for HEVC) for the next frames, nullptr clears it
+    */
+    void SetQpDeltaMap(const int8_t* qp_delta_map, uint32_t size);
+
     /**
     *  @brief  NvEncoder class virtual destructor.
     */
@@ -328,6 +344,17 @@ private:
     */
     void DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams);
 
+    /**
+    *  @brief This is a private function which maps the next input buffer for encoding.
+    */
+    NV_ENC_INPUT_PTR MapNextInputBuffer();
+
+    /**
+    *  @brief This is a private function which submits one picture to the
+    *         NVENC hardware without collecting the output.
+    */
+    void SubmitPicture(NV_ENC_INPUT_PTR inputBuffer, NV_ENC_PIC_PARAMS *pPicParams);
+
     /**
     *  @brief This is a private function which is used to submit the encode
     *         commands to the NVENC hardware for ME only mode.
@@ -342,6 +369,13 @@ private:
     */
     void GetEncodedPacket(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, std::vector<std::vector<uint8_t>> &vPacket, bool bOutputDelay);
 
+    /**
+    *  @brief This is a private function which hands every finished packet
+    *         to sink(const uint8_t *pData, uint32_t nSize) while it is locked.
+    */
+    template <typename PacketSink>
+    void DrainEncodedPackets(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, bool bOutputDelay, PacketSink sink);
+
     /**
     *  @brief This is a private function which is used to initialize the bitstream buffers.
     *  This is only used in the encoding mode.
@@ -415,7 +449,8 @@ private:
     int32_t m_nEncoderBuffer = 0;
     int32_t m_nOutputDelay = 0;
 	bool m_forceIDR = false;
+	uint32_t m_intraRefreshCnt = 0;
 
-    std::unique_ptr<int8_t> m_qpDeltaMap;
+    std::unique_ptr<int8_t[]> m_qpDeltaMap;
     uint32_t m_qpDeltaMapSize = 0;
 };
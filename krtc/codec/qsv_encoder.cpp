@@ -19,8 +19,9 @@
 
 namespace krtc {
 
-QsvEncoder::QsvEncoder(const cricket::VideoCodec& codec)
-	: packetization_mode_(webrtc::H264PacketizationMode::SingleNalUnit),
+QsvEncoder::QsvEncoder(const cricket::VideoCodec& codec, int async_depth)
+	: async_depth_(async_depth),
+	packetization_mode_(webrtc::H264PacketizationMode::SingleNalUnit),
 	max_payload_size_(0),
 	number_of_cores_(0),
 	encoded_image_callback_(nullptr),
@@ -37,9 +38,9 @@ QsvEncoder::QsvEncoder(const cricket::VideoCodec& codec)
 
 	encoded_images_.reserve(webrtc::kMaxSimulcastStreams);
 	qsv_encoders_.reserve(webrtc::kMaxSimulcastStreams);
+	encode_pipelines_.reserve(webrtc::kMaxSimulcastStreams);
 	configurations_.reserve(webrtc::kMaxSimulcastStreams);
 	tl0sync_limit_.reserve(webrtc::kMaxSimulcastStreams);
-	image_buffer_ = nullptr;
 }
 
 QsvEncoder::~QsvEncoder()
@@ -81,7 +82,9 @@ int32_t QsvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 	assert(number_of_streams == 1);
 
 	encoded_images_.resize(number_of_streams);
+	h264_bitstream_parsers_.resize(number_of_streams);
 	qsv_encoders_.resize(number_of_streams);
+	encode_pipelines_.resize(number_of_streams);
 	configurations_.resize(number_of_streams);
 	tl0sync_limit_.resize(number_of_streams);
 
@@ -98,10 +101,16 @@ int32_t QsvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 
 	num_temporal_layers_ = codec_.H264()->numberOfTemporalLayers;
 
+	// No intra refresh on the qsv backend, early requests wait for the interval.
+	KeyFrameGovernor::Config governor_config;
+	governor_config.periodic_interval_ms = PeriodicKeyFrameIntervalMs(codec_);
+	key_frame_governor_.reset(new KeyFrameGovernor(governor_config));
+
 	for (int i = 0, idx = number_of_streams - 1; i < number_of_streams; ++i, --idx) {
 		// Store nvidia encoder.
 		xop::IntelD3DEncoder* qsv_encoder = new xop::IntelD3DEncoder();
 		qsv_encoders_[i] = qsv_encoder;
+		h264_bitstream_parsers_[i].reset(new webrtc::H264BitstreamParser());
 
 		// Set internal settings from codec_settings
 		configurations_[i].simulcast_idx = idx;
@@ -122,25 +131,26 @@ int32_t QsvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 		qsv_encoder->SetOption(xop::VE_OPT_WIDTH, configurations_[i].width);
 		qsv_encoder->SetOption(xop::VE_OPT_HEIGHT, configurations_[i].height);
 		qsv_encoder->SetOption(xop::VE_OPT_FRAME_RATE, static_cast<int>(configurations_[i].max_frame_rate));
-		qsv_encoder->SetOption(xop::VE_OPT_GOP, configurations_[i].key_frame_interval);
+		qsv_encoder->SetOption(xop::VE_OPT_GOP, 0);
 		qsv_encoder->SetOption(xop::VE_OPT_CODEC, xop::VE_OPT_CODEC_H264);
 		qsv_encoder->SetOption(xop::VE_OPT_BITRATE_KBPS, configurations_[i].target_bps / 1000);
 		qsv_encoder->SetOption(xop::VE_OPT_TEXTURE_FORMAT, xop::VE_OPT_FORMAT_NV12);
+		qsv_encoder->SetOption(xop::VE_OPT_ASYNC_DEPTH, async_depth_);
+
 		if (!qsv_encoder->Init()) {
 			Release();
 			ReportError();
 			return WEBRTC_VIDEO_CODEC_ERROR;
 		}
 
-		image_buffer_.reset(new uint8_t[configurations_[i].width * configurations_[i].height * 10]);
-
-		// TODO(pbos): Base init params on these values before submitting.
-		video_format_ = EVideoFormatType::videoFormatI420;
+		encode_pipelines_[i].reset(new EncodePipeline(qsv_encoder, async_depth_,
+			[this, i](const webrtc::EncodedImage& frame_info,
+				rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream) {
+			OnFrameEncoded(i, frame_info, bitstream);
+		}));
+		encode_pipelines_[i]->Start();
 
-		// Initialize encoded image. Default buffer size: size of unencoded data.
-		const size_t new_capacity = webrtc::CalcBufferSize(webrtc::VideoType::kI420,
-			codec_.simulcastStream[idx].width, codec_.simulcastStream[idx].height);
-		encoded_images_[i].SetEncodedData(webrtc::EncodedImageBuffer::Create(new_capacity));
+		// Initialize encoded image. The bitstream comes from the pipeline's pool per frame.
 		encoded_images_[i]._encodedWidth = codec_.simulcastStream[idx].width;
 		encoded_images_[i]._encodedHeight = codec_.simulcastStream[idx].height;
 		encoded_images_[i].set_size(0);
@@ -157,6 +167,9 @@ int32_t QsvEncoder::InitEncode(const webrtc::VideoCodec* inst,
 
 int32_t QsvEncoder::Release()
 {
+	// Delivers the frames still in flight before the backends go away.
+	encode_pipelines_.clear();
+
 	while (!qsv_encoders_.empty())
 	{
 		xop::IntelD3DEncoder* qsv_encoder = reinterpret_cast<xop::IntelD3DEncoder*>(qsv_encoders_.back());
@@ -169,13 +182,20 @@ int32_t QsvEncoder::Release()
 
 	configurations_.clear();
 	encoded_images_.clear();
+	h264_bitstream_parsers_.clear();
 	tl0sync_limit_.clear();
 
+	if (key_frame_governor_) {
+		LogKeyFrameStats("QsvEncoder", *key_frame_governor_);
+		key_frame_governor_.reset();
+	}
+
 	return WEBRTC_VIDEO_CODEC_OK;
 }
 
 int32_t QsvEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback * callback)
 {
+	std::lock_guard<std::mutex> locker(deliver_mutex_);
 	encoded_image_callback_ = callback;
 	return WEBRTC_VIDEO_CODEC_OK;
 }
@@ -249,25 +269,8 @@ int32_t QsvEncoder::Encode(const webrtc::VideoFrame& input_frame,
 	RTC_CHECK(frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kI420 ||
 		frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kI420A);
 
-	bool send_key_frame = false;
-	for (size_t i = 0; i < configurations_.size(); ++i) {
-		if (configurations_[i].key_frame_request && configurations_[i].sending) {
-			send_key_frame = true;
-			break;
-		}
-	}
-
-	if (!send_key_frame && frame_types) {
-		for (size_t i = 0; i < configurations_.size(); ++i) {
-			const size_t simulcast_idx =
-				static_cast<size_t>(configurations_[i].simulcast_idx);
-			if (configurations_[i].sending && simulcast_idx < frame_types->size() &&
-				(*frame_types)[simulcast_idx] == webrtc::VideoFrameType::kVideoFrameKey) {
-				send_key_frame = true;
-				break;
-			}
-		}
-	}
+	KeyFrameGovernor::Decision key_frame = GovernKeyFrame(key_frame_governor_.get(),
+		configurations_, input_frame, frame_types, rtc::TimeMillis());
 
 	RTC_DCHECK_EQ(configurations_[0].width, frame_buffer->width());
 	RTC_DCHECK_EQ(configurations_[0].height, frame_buffer->height());
@@ -285,77 +288,37 @@ int32_t QsvEncoder::Encode(const webrtc::VideoFrame& input_frame,
 			}
 		}
 
-		if (send_key_frame) {
-			if (!qsv_encoders_.empty() && qsv_encoders_[i]) {
-				xop::IntelD3DEncoder* qsv_encoder = reinterpret_cast<xop::IntelD3DEncoder*>(qsv_encoders_[i]);
-				qsv_encoder->SetEvent(xop::VE_EVENT_FORCE_IDR, 1);
-			}
-
+		if (qsv_encoders_[i]) {
+			xop::IntelD3DEncoder* qsv_encoder = reinterpret_cast<xop::IntelD3DEncoder*>(qsv_encoders_[i]);
+			ApplyKeyFrameDecision(qsv_encoder, key_frame, configurations_[i].max_frame_rate);
+		}
+		if (key_frame == KeyFrameGovernor::kKeyFrame) {
 			configurations_[i].key_frame_request = false;
 		}
 
-		// EncodeFrame output.
-		SFrameBSInfo info;
-		memset(&info, 0, sizeof(SFrameBSInfo));
-		std::vector<uint8_t> frame_packet;
+		// Metadata travels with the frame through the pipeline.
+		webrtc::EncodedImage frame_info;
+		frame_info._encodedWidth = configurations_[i].width;
+		frame_info._encodedHeight = configurations_[i].height;
+		frame_info.SetTimestamp(input_frame.timestamp());
+		frame_info.ntp_time_ms_ = input_frame.ntp_time_ms();
+		frame_info.capture_time_ms_ = input_frame.render_time_ms();
+		frame_info.rotation_ = input_frame.rotation();
+		frame_info.SetColorSpace(input_frame.color_space());
+		frame_info.content_type_ = (codec_.mode == webrtc::VideoCodecMode::kScreensharing)
+			? webrtc::VideoContentType::SCREENSHARE
+			: webrtc::VideoContentType::UNSPECIFIED;
+		frame_info.timing_.flags = webrtc::VideoSendTiming::kInvalid;
+		frame_info.SetSpatialIndex(configurations_[i].simulcast_idx);
 
-		bool enc_ret = EncodeFrame((int)i, input_frame, frame_packet);
-		if (!enc_ret) {
+		xop::VideoImage image = ToVideoImage(*frame_buffer);
+		std::shared_ptr<const QpDeltaMap> qp_map = SetQpDeltaMap(input_frame, &image);
+		if (encode_pipelines_[i]->Encode(image, frame_info) < 0) {
 			RTC_LOG(LS_ERROR)
-				<< "OpenH264 frame encoding failed";
+				<< "Qsv frame encoding failed";
 			ReportError();
 			return WEBRTC_VIDEO_CODEC_ERROR;
 		}
-
-		if (frame_packet.size() == 0) {
-			return WEBRTC_VIDEO_CODEC_OK;
-		}
-		else {
-			if ((frame_packet[4] & 0x1f) == 0x07) {
-				// sps + pps + idr
-				info.eFrameType = videoFrameTypeIDR;
-			}
-			else {
-				info.eFrameType = videoFrameTypeP;
-			}
-		}
-
-		encoded_images_[i]._encodedWidth = configurations_[i].width;
-		encoded_images_[i]._encodedHeight = configurations_[i].height;
-		encoded_images_[i].SetTimestamp(input_frame.timestamp());
-		encoded_images_[i].ntp_time_ms_ = input_frame.ntp_time_ms();
-		encoded_images_[i].capture_time_ms_ = input_frame.render_time_ms();
-		encoded_images_[i].rotation_ = input_frame.rotation();
-		encoded_images_[i].SetColorSpace(input_frame.color_space());
-		encoded_images_[i].content_type_ = (codec_.mode == webrtc::VideoCodecMode::kScreensharing)
-			? webrtc::VideoContentType::SCREENSHARE
-			: webrtc::VideoContentType::UNSPECIFIED;
-		encoded_images_[i].timing_.flags = webrtc::VideoSendTiming::kInvalid;
-		encoded_images_[i]._frameType = ConvertToVideoFrameType(info.eFrameType);
-		encoded_images_[i].SetSpatialIndex(configurations_[i].simulcast_idx);
-
-		// Split encoded image up into fragments. This also updates
-		// |encoded_image_|.
-		RtpFragmentize(&encoded_images_[i], frame_packet);
-
-		// Encoder can skip frames to save bandwidth in which case
-		// |encoded_images_[i]._length| == 0.
-		if (encoded_images_[i].size() > 0) {
-			// Parse QP.
-			h264_bitstream_parser_.ParseBitstream(encoded_images_[i]);
-			encoded_images_[i].qp_ =
-				h264_bitstream_parser_.GetLastSliceQp().value_or(-1);
-
-			// Deliver encoded image.
-			webrtc::CodecSpecificInfo codec_specific;
-			codec_specific.codecType = webrtc::kVideoCodecH264;
-			codec_specific.codecSpecific.H264.packetization_mode = packetization_mode_;
-			codec_specific.codecSpecific.H264.temporal_idx = webrtc::kNoTemporalIdx;
-			codec_specific.codecSpecific.H264.idr_frame = (info.eFrameType == videoFrameTypeIDR);
-			codec_specific.codecSpecific.H264.base_layer_sync = false;
-
-			encoded_image_callback_->OnEncodedImage(encoded_images_[i], &codec_specific);
-		}
 	}
 
 	return WEBRTC_VIDEO_CODEC_OK;
@@ -401,60 +364,44 @@ void QsvEncoder::LayerConfig::SetStreamState(bool send_stream)
 	sending = send_stream;
 }
 
-void i420ToNv12(unsigned char* src_i420_data, int width, int height, unsigned char* src_nv12_data)
+void QsvEncoder::OnFrameEncoded(size_t index, const webrtc::EncodedImage& frame_info,
+	rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream)
 {
-	int src_y_size = width * height;
-	int src_u_size = (width >> 1) * (height >> 1);
-
-	unsigned char* src_nv12_y_data = src_nv12_data;
-	unsigned char* src_nv12_uv_data = src_nv12_data + src_y_size;
-
-	unsigned char* src_i420_y_data = src_i420_data;
-	unsigned char* src_i420_u_data = src_i420_data + src_y_size;
-	unsigned char* src_i420_v_data = src_i420_data + src_y_size + src_u_size;
-
-	libyuv::I420ToNV12(
-		(const uint8_t*)src_i420_y_data, width,
-		(const uint8_t*)src_i420_u_data, width >> 1,
-		(const uint8_t*)src_i420_v_data, width >> 1,
-		(uint8_t*)src_nv12_y_data, width,
-		(uint8_t*)src_nv12_uv_data, width,
-		width, height);
-}
+	std::lock_guard<std::mutex> locker(deliver_mutex_);
 
-bool QsvEncoder::EncodeFrame(int index, const webrtc::VideoFrame& input_frame,
-	std::vector<uint8_t>& frame_packet)
-{
-	frame_packet.clear();
-
-	if (qsv_encoders_.empty() || !qsv_encoders_[index]) {
-		return false;
+	SFrameBSInfo info;
+	memset(&info, 0, sizeof(SFrameBSInfo));
+	int qp = -1;
+	if (!ReadFrameInfo(*bitstream, h264_bitstream_parsers_[index].get(), &info.eFrameType, &qp)) {
+		return;
+	}
+	if (info.eFrameType == videoFrameTypeIDR) {
+		key_frame_governor_->OnKeyFrameEncoded(rtc::TimeMillis(), frame_info.Timestamp());
 	}
 
-	int width = input_frame.width();
-	int height = input_frame.height();
+	webrtc::EncodedImage& encoded_image = encoded_images_[index];
+	encoded_image = frame_info;
+	encoded_image._frameType = ConvertToVideoFrameType(info.eFrameType);
 
-	rtc::scoped_refptr<webrtc::I420BufferInterface> i420_buffer =
-		input_frame.video_frame_buffer()->ToI420();
-	int ret = libyuv::ConvertFromI420(
-			i420_buffer->DataY(), i420_buffer->StrideY(), i420_buffer->DataU(),
-			i420_buffer->StrideU(), i420_buffer->DataV(), i420_buffer->StrideV(),
-			image_buffer_.get(), width, input_frame.width(), input_frame.height(),
-			libyuv::FOURCC_NV12);
-	if (ret < 0) {
-		return false;
-	}
+	// Split encoded image up into fragments. This also updates
+	// |encoded_image_|.
+	RtpFragmentize(&encoded_image, bitstream);
 
-	int image_size = width * height * 3 / 2; // nv12
-	xop::IntelD3DEncoder* qsv_encoder = reinterpret_cast<xop::IntelD3DEncoder*>(qsv_encoders_[index]);
-	if (qsv_encoder) {
-		int frame_size = qsv_encoder->Encode(std::vector<uint8_t>(image_buffer_.get(), image_buffer_.get() + image_size), frame_packet);
-		if (frame_size < 0) {
-			return false;
-		}
-	}
+	// Encoder can skip frames to save bandwidth in which case
+	// |encoded_images_[i]._length| == 0.
+	if (encoded_image.size() > 0) {
+		encoded_image.qp_ = qp;
 
-	return true;
+		// Deliver encoded image.
+		webrtc::CodecSpecificInfo codec_specific;
+		codec_specific.codecType = webrtc::kVideoCodecH264;
+		codec_specific.codecSpecific.H264.packetization_mode = packetization_mode_;
+		codec_specific.codecSpecific.H264.temporal_idx = webrtc::kNoTemporalIdx;
+		codec_specific.codecSpecific.H264.idr_frame = (info.eFrameType == videoFrameTypeIDR);
+		codec_specific.codecSpecific.H264.base_layer_sync = false;
+
+		encoded_image_callback_->OnEncodedImage(encoded_image, &codec_specific);
+	}
 }
 
 }  // namespace webrtc
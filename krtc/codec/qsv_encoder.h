@@ -2,6 +2,7 @@
 #define KRTCSDK_KRTC_CODEC_QSV_ENCODER_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string.h>
 
@@ -14,6 +15,9 @@
 #include "modules/video_coding/codecs/h264/include/h264.h"
 #include "modules/video_coding/utility/quality_scaler.h"
 #include "third_party/openh264/src/codec/api/svc/codec_app_def.h"
+#include "encode_pipeline.h"
+#include "encoded_buffer_pool.h"
+#include "key_frame_governor.h"
 #include "encoder/intel_d3d_encoder.h"
 
 namespace krtc {
@@ -38,7 +42,8 @@ public:
 	};
 
 public:
-	explicit QsvEncoder(const cricket::VideoCodec& codec);
+	// async_depth > 1 keeps that many frames in flight on the gpu, see EncodePipeline.
+	explicit QsvEncoder(const cricket::VideoCodec& codec, int async_depth = 1);
 	~QsvEncoder() override;
 
 	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
@@ -63,17 +68,26 @@ public:
 	}
 
 private:
-	webrtc::H264BitstreamParser h264_bitstream_parser_;
 	// Reports statistics with histograms.
 	void ReportInit();
 	void ReportError();
 
-	bool EncodeFrame(int index, const webrtc::VideoFrame& input_frame,
-					 std::vector<uint8_t>& frame_packet);
+	// Called by encode_pipelines_[index], in encode order.
+	void OnFrameEncoded(size_t index, const webrtc::EncodedImage& frame_info,
+						rtc::scoped_refptr<EncodedBitstreamBuffer> bitstream);
 
+	int async_depth_;
 	std::vector<void*> qsv_encoders_;
+	std::vector<std::unique_ptr<EncodePipeline>> encode_pipelines_;
 	std::vector<LayerConfig> configurations_;
+	// Per layer, written by the layer's collector thread.
 	std::vector<webrtc::EncodedImage> encoded_images_;
+	std::vector<std::unique_ptr<webrtc::H264BitstreamParser>> h264_bitstream_parsers_;
+	// Also used by the pipelines' collector threads.
+	std::unique_ptr<KeyFrameGovernor> key_frame_governor_;
+	// One layer at a time hands its frame to encoded_image_callback_, the
+	// collector threads run in parallel.
+	std::mutex deliver_mutex_;
 
 	webrtc::VideoCodec codec_;
 	webrtc::H264PacketizationMode packetization_mode_;
@@ -83,11 +97,8 @@ private:
 
 	bool has_reported_init_;
 	bool has_reported_error_;
-	int video_format_;
 	int num_temporal_layers_;
 	std::vector<uint8_t> tl0sync_limit_;
-
-	std::unique_ptr<uint8_t[]> image_buffer_;
 };
 
 }  // namespace webrtc
@@ -0,0 +1,129 @@
+#include "roi_emulation_encoder.h"
+
+#include <algorithm>
+
+#include "libyuv.h"
+
+namespace krtc {
+
+namespace {
+
+// From this delta on a block keeps a quarter of its resolution, below half.
+const int kStrongQpDelta = 6;
+
+rtc::scoped_refptr<webrtc::I420Buffer> LowPass(const webrtc::I420BufferInterface& buffer,
+	int factor)
+{
+	rtc::scoped_refptr<webrtc::I420Buffer> small = webrtc::I420Buffer::Create(
+		(buffer.width() + factor - 1) / factor, (buffer.height() + factor - 1) / factor);
+	small->ScaleFrom(buffer);
+
+	rtc::scoped_refptr<webrtc::I420Buffer> low_passed =
+		webrtc::I420Buffer::Create(buffer.width(), buffer.height());
+	low_passed->ScaleFrom(*small);
+	return low_passed;
+}
+
+} // namespace
+
+RoiEmulationEncoder::RoiEmulationEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder)
+	: encoder_(std::move(encoder))
+{
+}
+
+RoiEmulationEncoder::~RoiEmulationEncoder() = default;
+
+rtc::scoped_refptr<webrtc::I420Buffer> RoiEmulationEncoder::ApplyQpMap(
+	const webrtc::I420BufferInterface& buffer, const QpDeltaMap& qp_map)
+{
+	if (qp_map.block_size <= 0 || (int)qp_map.deltas.size() < qp_map.width * qp_map.height ||
+		std::none_of(qp_map.deltas.begin(), qp_map.deltas.end(), [](int8_t d) { return d > 0; })) {
+		return nullptr;
+	}
+
+	int width = buffer.width();
+	int height = buffer.height();
+	rtc::scoped_refptr<webrtc::I420Buffer> filtered = webrtc::I420Buffer::Copy(buffer);
+	rtc::scoped_refptr<webrtc::I420Buffer> low_passed[2];
+
+	int block_size = qp_map.block_size;
+	for (int by = 0; by < qp_map.height; by++) {
+		for (int bx = 0; bx < qp_map.width; bx++) {
+			int delta = qp_map.deltas[by * qp_map.width + bx];
+			int x = bx * block_size;
+			int y = by * block_size;
+			if (delta <= 0 || x >= width || y >= height) {
+				continue;
+			}
+
+			int level = delta >= kStrongQpDelta ? 1 : 0;
+			if (!low_passed[level]) {
+				low_passed[level] = LowPass(buffer, level ? 4 : 2);
+			}
+
+			const webrtc::I420Buffer& src = *low_passed[level];
+			int w = std::min(block_size, width - x);
+			int h = std::min(block_size, height - y);
+			libyuv::CopyPlane(src.DataY() + y * src.StrideY() + x, src.StrideY(),
+				filtered->MutableDataY() + y * filtered->StrideY() + x, filtered->StrideY(), w, h);
+			libyuv::CopyPlane(src.DataU() + y / 2 * src.StrideU() + x / 2, src.StrideU(),
+				filtered->MutableDataU() + y / 2 * filtered->StrideU() + x / 2, filtered->StrideU(),
+				(w + 1) / 2, (h + 1) / 2);
+			libyuv::CopyPlane(src.DataV() + y / 2 * src.StrideV() + x / 2, src.StrideV(),
+				filtered->MutableDataV() + y / 2 * filtered->StrideV() + x / 2, filtered->StrideV(),
+				(w + 1) / 2, (h + 1) / 2);
+		}
+	}
+
+	return filtered;
+}
+
+int32_t RoiEmulationEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores,
+	size_t max_payload_size)
+{
+	return encoder_->InitEncode(codec_settings, number_of_cores, max_payload_size);
+}
+
+int32_t RoiEmulationEncoder::Release()
+{
+	return encoder_->Release();
+}
+
+int32_t RoiEmulationEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback)
+{
+	return encoder_->RegisterEncodeCompleteCallback(callback);
+}
+
+void RoiEmulationEncoder::SetRates(const RateControlParameters& parameters)
+{
+	encoder_->SetRates(parameters);
+}
+
+int32_t RoiEmulationEncoder::Encode(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	std::shared_ptr<const QpDeltaMap> qp_map = EncoderHintBuffer::Find(frame.video_frame_buffer().get()).qp_map;
+	if (!qp_map) {
+		return encoder_->Encode(frame, frame_types);
+	}
+
+	rtc::scoped_refptr<webrtc::I420Buffer> filtered =
+		ApplyQpMap(*frame.video_frame_buffer()->ToI420(), *qp_map);
+	if (!filtered) {
+		return encoder_->Encode(frame, frame_types);
+	}
+
+	// The filter follows the map, not the capturer's update_rect.
+	webrtc::VideoFrame filtered_frame = frame;
+	filtered_frame.set_video_frame_buffer(filtered);
+	filtered_frame.set_update_rect(webrtc::VideoFrame::UpdateRect{ 0, 0, frame.width(), frame.height() });
+	return encoder_->Encode(filtered_frame, frame_types);
+}
+
+webrtc::VideoEncoder::EncoderInfo RoiEmulationEncoder::GetEncoderInfo() const
+{
+	return encoder_->GetEncoderInfo();
+}
+
+} // namespace krtc
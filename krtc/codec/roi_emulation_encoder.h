@@ -0,0 +1,45 @@
+#ifndef KRTCSDK_KRTC_CODEC_ROI_EMULATION_ENCODER_H_
+#define KRTCSDK_KRTC_CODEC_ROI_EMULATION_ENCODER_H_
+
+#include <memory>
+#include <vector>
+
+#include "api/video/i420_buffer.h"
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+#include "encoder_hint_buffer.h"
+
+namespace krtc {
+
+// OpenH264 takes no per block qp. Blocks the QpDeltaMap gives a positive delta
+// are low passed before encoding instead, so they cost next to nothing and
+// the rate control spends the bits on the rest. Negative deltas are only
+// honoured that way, relative to the filtered blocks.
+class RoiEmulationEncoder : public webrtc::VideoEncoder {
+public:
+	explicit RoiEmulationEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder);
+	~RoiEmulationEncoder() override;
+
+	// Copy of buffer with the positive delta blocks filtered, nullptr when
+	// the map has none.
+	static rtc::scoped_refptr<webrtc::I420Buffer> ApplyQpMap(
+		const webrtc::I420BufferInterface& buffer, const QpDeltaMap& qp_map);
+
+	// webrtc::VideoEncoder
+	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
+					   int32_t number_of_cores,
+					   size_t max_payload_size) override;
+	int32_t Release() override;
+	int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override;
+	void SetRates(const RateControlParameters& parameters) override;
+	int32_t Encode(const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+private:
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_ROI_EMULATION_ENCODER_H_
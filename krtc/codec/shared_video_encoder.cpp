@@ -0,0 +1,532 @@
+#include "shared_video_encoder.h"
+
+#include "absl/memory/memory.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+
+namespace krtc {
+
+namespace {
+
+// rtp timestamps are 90 kHz.
+const int64_t kRtpTicksPerMs = 90;
+
+// Frames the encoder may hold before their output, async depth plus slack.
+const size_t kMaxInFlightFrames = 16;
+
+uint32_t RtpTicks(int64_t time_ms)
+{
+	return static_cast<uint32_t>(time_ms * kRtpTicksPerMs);
+}
+
+bool IsKeyFrameRequested(const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	if (!frame_types) {
+		return false;
+	}
+	for (webrtc::VideoFrameType frame_type : *frame_types) {
+		if (frame_type == webrtc::VideoFrameType::kVideoFrameKey) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+SharedEncoderGroup::SharedEncoderGroup(CreateCallback create)
+	: create_(create)
+{
+}
+
+SharedEncoderGroup::~SharedEncoderGroup()
+{
+	if (encoder_) {
+		encoder_->Release();
+	}
+}
+
+std::unique_ptr<webrtc::VideoEncoder> SharedEncoderGroup::CreateOutput()
+{
+	return absl::make_unique<SharedVideoEncoder>(shared_from_this());
+}
+
+size_t SharedEncoderGroup::output_count() const
+{
+	std::lock_guard<std::mutex> lock(outputs_mutex_);
+	return outputs_.size();
+}
+
+SharedEncoderGroup::Stats SharedEncoderGroup::stats() const
+{
+	std::lock_guard<std::mutex> lock(outputs_mutex_);
+	return stats_;
+}
+
+bool SharedEncoderGroup::Attach(SharedVideoEncoder* output,
+	webrtc::EncodedImageCallback* callback, const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores, size_t max_payload_size, int32_t* result)
+{
+	std::lock_guard<std::mutex> encode_lock(encode_mutex_);
+
+	bool others = false;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		for (auto& iter : outputs_) {
+			others |= iter.first != output;
+		}
+	}
+
+	// Resolution and frame rate follow the source, the last output to be
+	// reconfigured brings the others along. Layering has to match.
+	if (encoder_ && others &&
+		(codec_settings->codecType != codec_.codecType ||
+		 codec_settings->numberOfSimulcastStreams != codec_.numberOfSimulcastStreams ||
+		 codec_settings->mode != codec_.mode)) {
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		outputs_.erase(output);
+		return false;
+	}
+
+	*result = WEBRTC_VIDEO_CODEC_OK;
+	bool reinit = encoder_ && others;
+	if (!encoder_ || !others ||
+		codec_settings->width != codec_.width ||
+		codec_settings->height != codec_.height ||
+		codec_settings->maxFramerate != codec_.maxFramerate) {
+		if (encoder_) {
+			encoder_->Release();
+		}
+		else {
+			encoder_ = create_();
+			if (!encoder_) {
+				*result = WEBRTC_VIDEO_CODEC_ERROR;
+				return true;
+			}
+			encoder_->RegisterEncodeCompleteCallback(this);
+		}
+
+		webrtc::VideoCodec previous_codec = codec_;
+		codec_ = *codec_settings;
+		last_timestamp_us_ = -1;
+		last_key_frame_ = false;
+		*result = encoder_->InitEncode(&codec_, number_of_cores, max_payload_size);
+		if (*result != WEBRTC_VIDEO_CODEC_OK) {
+			RTC_LOG(LS_WARNING) << "shared video encoder init failed: " << *result;
+			// The outputs already attached keep the settings they had, only
+			// this one goes on alone.
+			if (reinit) {
+				codec_ = previous_codec;
+				if (encoder_->InitEncode(&codec_, number_of_cores_, max_payload_size_) ==
+					WEBRTC_VIDEO_CODEC_OK) {
+					UpdateEncoderInfo();
+					absl::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+					{
+						std::lock_guard<std::mutex> lock(outputs_mutex_);
+						outputs_.erase(output);
+						in_flight_.clear();
+						rates = TargetRatesLocked();
+					}
+					if (rates) {
+						encoder_->SetRates(*rates);
+					}
+					return false;
+				}
+				RTC_LOG(LS_ERROR) << "shared video encoder restore failed";
+			}
+			encoder_->Release();
+			encoder_.reset();
+			return true;
+		}
+		number_of_cores_ = number_of_cores;
+		max_payload_size_ = max_payload_size;
+		UpdateEncoderInfo();
+
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		in_flight_.clear();
+	}
+
+	absl::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		outputs_[output].callback = callback;
+		rates = TargetRatesLocked();
+		RTC_LOG(LS_INFO) << "shared video encoder outputs: " << outputs_.size();
+	}
+	if (rates) {
+		encoder_->SetRates(*rates);
+	}
+	return true;
+}
+
+void SharedEncoderGroup::Detach(SharedVideoEncoder* output)
+{
+	std::lock_guard<std::mutex> encode_lock(encode_mutex_);
+
+	bool empty = false;
+	absl::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		if (!outputs_.erase(output)) {
+			return;
+		}
+		empty = outputs_.empty();
+		rates = TargetRatesLocked();
+	}
+	// Lets a delivery still holding the old callback finish.
+	{
+		std::lock_guard<std::recursive_mutex> deliver_lock(deliver_mutex_);
+	}
+
+	if (!encoder_) {
+		return;
+	}
+
+	if (empty) {
+		// Frames still in flight come out of Release() with nobody to take them.
+		encoder_->Release();
+		encoder_.reset();
+		last_timestamp_us_ = -1;
+		key_frame_pending_ = false;
+		last_key_frame_ = false;
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		in_flight_.clear();
+	}
+	else if (rates) {
+		encoder_->SetRates(*rates);
+	}
+}
+
+void SharedEncoderGroup::SetCallback(SharedVideoEncoder* output,
+	webrtc::EncodedImageCallback* callback)
+{
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		auto iter = outputs_.find(output);
+		if (iter != outputs_.end()) {
+			iter->second.callback = callback;
+		}
+	}
+	std::lock_guard<std::recursive_mutex> deliver_lock(deliver_mutex_);
+}
+
+void SharedEncoderGroup::SetRates(SharedVideoEncoder* output,
+	const webrtc::VideoEncoder::RateControlParameters& parameters)
+{
+	std::lock_guard<std::mutex> encode_lock(encode_mutex_);
+
+	absl::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		auto iter = outputs_.find(output);
+		if (iter == outputs_.end()) {
+			return;
+		}
+		iter->second.rates = parameters;
+		rates = TargetRatesLocked();
+		stats_.rate_updates++;
+	}
+
+	if (encoder_ && rates) {
+		encoder_->SetRates(*rates);
+	}
+}
+
+absl::optional<webrtc::VideoEncoder::RateControlParameters>
+SharedEncoderGroup::TargetRatesLocked() const
+{
+	// A paused output (no bandwidth estimate yet, or muted) does not hold
+	// the others back. All paused pauses the encoder.
+	const webrtc::VideoEncoder::RateControlParameters* target = nullptr;
+	for (const auto& iter : outputs_) {
+		const absl::optional<webrtc::VideoEncoder::RateControlParameters>& rates =
+			iter.second.rates;
+		if (!rates) {
+			continue;
+		}
+		if (!target) {
+			target = &*rates;
+			continue;
+		}
+
+		uint32_t bps = rates->bitrate.get_sum_bps();
+		uint32_t target_bps = target->bitrate.get_sum_bps();
+		if (bps > 0 && (target_bps == 0 || bps < target_bps)) {
+			target = &*rates;
+		}
+	}
+
+	if (!target) {
+		return absl::nullopt;
+	}
+	return *target;
+}
+
+int32_t SharedEncoderGroup::Encode(SharedVideoEncoder* output,
+	const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types, bool* size_differs)
+{
+	std::lock_guard<std::mutex> encode_lock(encode_mutex_);
+	if (!encoder_) {
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+	}
+
+	// Every output adapts its resolution on its own. A frame of another size
+	// than the shared encoder's can neither be encoded by it nor take the
+	// bitstream another output's frame of the same timestamp got.
+	*size_differs = frame.width() != codec_.width || frame.height() != codec_.height;
+	if (*size_differs) {
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	bool key_frame_requested = IsKeyFrameRequested(frame_types);
+
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		// Output starts with the frame after the one it first hands in.
+		bool first_frame = false;
+		auto iter = outputs_.find(output);
+		if (iter != outputs_.end()) {
+			first_frame = !iter->second.rtp_base;
+			iter->second.rtp_base = frame.timestamp() - RtpTicks(frame.render_time_ms());
+		}
+		if (key_frame_requested) {
+			stats_.key_frame_requests++;
+		}
+
+		// Another output got here first, its result is on the way to this one too.
+		if (frame.timestamp_us() <= last_timestamp_us_) {
+			// Asked for the frame that just went out as an idr, nothing to do
+			// unless this output was not there to get it.
+			key_frame_pending_ |= key_frame_requested && (!last_key_frame_ || first_frame);
+			stats_.deduplicated++;
+			return WEBRTC_VIDEO_CODEC_OK;
+		}
+
+		in_flight_.emplace_back(frame.timestamp(), frame.render_time_ms());
+		if (in_flight_.size() > kMaxInFlightFrames) {
+			in_flight_.pop_front();
+		}
+		stats_.encoded++;
+	}
+	last_timestamp_us_ = frame.timestamp_us();
+	last_key_frame_ = key_frame_pending_ || key_frame_requested;
+	key_frame_pending_ = false;
+
+	size_t streams = frame_types && !frame_types->empty() ? frame_types->size() : 1;
+	std::vector<webrtc::VideoFrameType> types(streams, last_key_frame_ ?
+		webrtc::VideoFrameType::kVideoFrameKey : webrtc::VideoFrameType::kVideoFrameDelta);
+
+	int32_t ret = encoder_->Encode(frame, &types);
+	if (ret < 0) {
+		key_frame_pending_ = last_key_frame_;
+		last_key_frame_ = false;
+	}
+	UpdateEncoderInfo();
+	return ret;
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedEncoderGroup::GetEncoderInfo() const
+{
+	std::lock_guard<std::mutex> lock(info_mutex_);
+	return encoder_info_;
+}
+
+void SharedEncoderGroup::UpdateEncoderInfo()
+{
+	// The fallback encoder may have switched backends under us, and
+	// VideoStreamEncoder asks from inside OnEncodedImage.
+	webrtc::VideoEncoder::EncoderInfo info = encoder_->GetEncoderInfo();
+	std::lock_guard<std::mutex> lock(info_mutex_);
+	encoder_info_ = info;
+}
+
+webrtc::EncodedImageCallback::Result SharedEncoderGroup::OnEncodedImage(
+	const webrtc::EncodedImage& encoded_image,
+	const webrtc::CodecSpecificInfo* codec_specific_info)
+{
+	std::lock_guard<std::recursive_mutex> deliver_lock(deliver_mutex_);
+
+	absl::optional<int64_t> render_time_ms;
+	std::vector<Output> outputs;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+
+		// Simulcast layers share a timestamp, keep the entry until a newer frame
+		// comes out.
+		while (!in_flight_.empty()) {
+			if (in_flight_.front().first == encoded_image.Timestamp()) {
+				render_time_ms = in_flight_.front().second;
+				break;
+			}
+			in_flight_.pop_front();
+		}
+
+		for (const auto& iter : outputs_) {
+			if (iter.second.callback && iter.second.rtp_base) {
+				outputs.push_back(iter.second);
+			}
+		}
+	}
+
+	Result result(Result::ERROR_SEND_FAILED);
+	webrtc::EncodedImage image(encoded_image);
+	for (const Output& output : outputs) {
+		// Shares the encoded buffer, only the rtp timestamp is per output.
+		if (render_time_ms) {
+			image.SetTimestamp(*output.rtp_base + RtpTicks(*render_time_ms));
+		}
+		Result output_result = output.callback->OnEncodedImage(image, codec_specific_info);
+		if (output_result.error == Result::OK) {
+			result = output_result;
+		}
+	}
+	return result;
+}
+
+void SharedEncoderGroup::OnDroppedFrame(DropReason reason)
+{
+	std::lock_guard<std::recursive_mutex> deliver_lock(deliver_mutex_);
+
+	std::vector<webrtc::EncodedImageCallback*> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(outputs_mutex_);
+		for (const auto& iter : outputs_) {
+			if (iter.second.callback) {
+				callbacks.push_back(iter.second.callback);
+			}
+		}
+	}
+
+	for (webrtc::EncodedImageCallback* callback : callbacks) {
+		callback->OnDroppedFrame(reason);
+	}
+}
+
+SharedVideoEncoder::SharedVideoEncoder(std::shared_ptr<SharedEncoderGroup> group)
+	: group_(group)
+{
+}
+
+SharedVideoEncoder::~SharedVideoEncoder()
+{
+	Release();
+}
+
+int32_t SharedVideoEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+	int32_t number_of_cores,
+	size_t max_payload_size)
+{
+	if (!codec_settings) {
+		return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+	}
+
+	codec_settings_ = *codec_settings;
+	number_of_cores_ = number_of_cores;
+	max_payload_size_ = max_payload_size;
+
+	int32_t result = WEBRTC_VIDEO_CODEC_OK;
+	if (!own_encoder_ &&
+		group_->Attach(this, callback_, codec_settings, number_of_cores, max_payload_size, &result)) {
+		attached_ = result == WEBRTC_VIDEO_CODEC_OK;
+		return result;
+	}
+
+	attached_ = false;
+	if (!own_encoder_) {
+		RTC_LOG(LS_INFO) << "video settings differ from the shared encoder, encoding separately";
+		own_encoder_ = group_->create_();
+		if (!own_encoder_) {
+			return WEBRTC_VIDEO_CODEC_ERROR;
+		}
+		own_encoder_->RegisterEncodeCompleteCallback(callback_);
+	}
+	return own_encoder_->InitEncode(codec_settings, number_of_cores, max_payload_size);
+}
+
+int32_t SharedVideoEncoder::Release()
+{
+	if (attached_) {
+		group_->Detach(this);
+		attached_ = false;
+	}
+	if (own_encoder_) {
+		own_encoder_->Release();
+		own_encoder_.reset();
+	}
+	rates_.reset();
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t SharedVideoEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback)
+{
+	callback_ = callback;
+	if (own_encoder_) {
+		own_encoder_->RegisterEncodeCompleteCallback(callback);
+	}
+	group_->SetCallback(this, callback);
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void SharedVideoEncoder::SetRates(const RateControlParameters& parameters)
+{
+	rates_ = parameters;
+	if (own_encoder_) {
+		own_encoder_->SetRates(parameters);
+	}
+	else if (attached_) {
+		group_->SetRates(this, parameters);
+	}
+}
+
+int32_t SharedVideoEncoder::Encode(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	if (own_encoder_) {
+		return own_encoder_->Encode(frame, frame_types);
+	}
+	if (!attached_) {
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+	}
+
+	bool size_differs = false;
+	int32_t ret = group_->Encode(this, frame, frame_types, &size_differs);
+	if (!size_differs) {
+		return ret;
+	}
+	return EncodeAlone(frame, frame_types);
+}
+
+int32_t SharedVideoEncoder::EncodeAlone(const webrtc::VideoFrame& frame,
+	const std::vector<webrtc::VideoFrameType>* frame_types)
+{
+	RTC_LOG(LS_INFO) << "frame size differs from the shared encoder, encoding separately: "
+		<< frame.width() << "x" << frame.height();
+	group_->Detach(this);
+	attached_ = false;
+
+	own_encoder_ = group_->create_();
+	if (!own_encoder_) {
+		return WEBRTC_VIDEO_CODEC_ERROR;
+	}
+	own_encoder_->RegisterEncodeCompleteCallback(callback_);
+	int32_t ret = own_encoder_->InitEncode(&codec_settings_, number_of_cores_, max_payload_size_);
+	if (ret != WEBRTC_VIDEO_CODEC_OK) {
+		own_encoder_.reset();
+		return ret;
+	}
+	if (rates_) {
+		own_encoder_->SetRates(*rates_);
+	}
+	return own_encoder_->Encode(frame, frame_types);
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedVideoEncoder::GetEncoderInfo() const
+{
+	if (own_encoder_) {
+		return own_encoder_->GetEncoderInfo();
+	}
+	return group_->GetEncoderInfo();
+}
+
+} // namespace krtc
@@ -0,0 +1,148 @@
+#ifndef KRTCSDK_KRTC_CODEC_SHARED_VIDEO_ENCODER_H_
+#define KRTCSDK_KRTC_CODEC_SHARED_VIDEO_ENCODER_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+
+namespace krtc {
+
+class SharedVideoEncoder;
+
+// One real encoder behind several PeerConnections publishing the same source.
+// Every output hands each captured frame to Encode(), the first one to arrive
+// encodes it and the result goes out on all of them. The encoder runs at the
+// lowest target bitrate any active output asks for and a key frame request
+// from any output is served once for all.
+class SharedEncoderGroup : public webrtc::EncodedImageCallback,
+						   public std::enable_shared_from_this<SharedEncoderGroup> {
+public:
+	typedef std::function<std::unique_ptr<webrtc::VideoEncoder>()> CreateCallback;
+
+	struct Stats {
+		int64_t encoded = 0;		// frames through the real encoder
+		int64_t deduplicated = 0;	// Encode() calls served by an earlier one
+		int64_t key_frame_requests = 0;
+		int64_t rate_updates = 0;
+	};
+
+	explicit SharedEncoderGroup(CreateCallback create);
+	~SharedEncoderGroup() override;
+
+	// A webrtc::VideoEncoder for one more PeerConnection.
+	std::unique_ptr<webrtc::VideoEncoder> CreateOutput();
+
+	size_t output_count() const;
+	Stats stats() const;
+
+	// webrtc::EncodedImageCallback
+	Result OnEncodedImage(const webrtc::EncodedImage& encoded_image,
+						  const webrtc::CodecSpecificInfo* codec_specific_info) override;
+	void OnDroppedFrame(DropReason reason) override;
+
+private:
+	friend class SharedVideoEncoder;
+
+	struct Output {
+		webrtc::EncodedImageCallback* callback = nullptr;
+		absl::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+		// Every VideoStreamEncoder stamps rtp = 90 * (render ms + its own ntp
+		// offset), this is its rtp - 90 * render ms.
+		absl::optional<uint32_t> rtp_base;
+	};
+
+	// False when codec_settings cannot share the running encoder, the output
+	// then encodes on its own.
+	bool Attach(SharedVideoEncoder* output, webrtc::EncodedImageCallback* callback,
+				const webrtc::VideoCodec* codec_settings, int32_t number_of_cores,
+				size_t max_payload_size, int32_t* result);
+	void Detach(SharedVideoEncoder* output);
+	void SetCallback(SharedVideoEncoder* output, webrtc::EncodedImageCallback* callback);
+	void SetRates(SharedVideoEncoder* output,
+				  const webrtc::VideoEncoder::RateControlParameters& parameters);
+	// size_differs: the frame does not fit the shared encoder, nothing was
+	// done and the output has to encode it on its own.
+	int32_t Encode(SharedVideoEncoder* output, const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types, bool* size_differs);
+	webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const;
+
+	// Lowest non zero target of the outputs, called with outputs_mutex_ held.
+	absl::optional<webrtc::VideoEncoder::RateControlParameters> TargetRatesLocked() const;
+	void UpdateEncoderInfo();
+
+	CreateCallback create_;
+
+	// Serializes every call into encoder_.
+	std::mutex encode_mutex_;
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	webrtc::VideoCodec codec_;
+	int32_t number_of_cores_ = 1;
+	size_t max_payload_size_ = 0;
+	int64_t last_timestamp_us_ = -1;
+	bool key_frame_pending_ = false;
+	bool last_key_frame_ = false;
+
+	// Held while the outputs' callbacks run, outside outputs_mutex_ so a
+	// callback may call back in. Detach() and SetCallback() wait for it, no
+	// callback reaches an output after it left.
+	std::recursive_mutex deliver_mutex_;
+
+	// Taken inside encode_mutex_ and from the encoder's callback.
+	mutable std::mutex outputs_mutex_;
+	std::map<SharedVideoEncoder*, Output> outputs_;
+	// rtp timestamp handed to encoder_ -> render time, for the frames in flight.
+	std::deque<std::pair<uint32_t, int64_t>> in_flight_;
+	Stats stats_;
+
+	mutable std::mutex info_mutex_;
+	webrtc::VideoEncoder::EncoderInfo encoder_info_;
+};
+
+// The per PeerConnection end of a SharedEncoderGroup.
+class SharedVideoEncoder : public webrtc::VideoEncoder {
+public:
+	explicit SharedVideoEncoder(std::shared_ptr<SharedEncoderGroup> group);
+	~SharedVideoEncoder() override;
+
+	// webrtc::VideoEncoder
+	int32_t InitEncode(const webrtc::VideoCodec* codec_settings,
+					   int32_t number_of_cores,
+					   size_t max_payload_size) override;
+	int32_t Release() override;
+	int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override;
+	void SetRates(const RateControlParameters& parameters) override;
+	int32_t Encode(const webrtc::VideoFrame& frame,
+				   const std::vector<webrtc::VideoFrameType>* frame_types) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+	bool shared() const { return attached_; }
+
+private:
+	// Leaves the group for a frame its encoder cannot take.
+	int32_t EncodeAlone(const webrtc::VideoFrame& frame,
+						const std::vector<webrtc::VideoFrameType>* frame_types);
+
+	std::shared_ptr<SharedEncoderGroup> group_;
+	webrtc::EncodedImageCallback* callback_ = nullptr;
+	bool attached_ = false;
+
+	// This output's own settings, for encoding on its own later.
+	webrtc::VideoCodec codec_settings_;
+	int32_t number_of_cores_ = 1;
+	size_t max_payload_size_ = 0;
+	absl::optional<RateControlParameters> rates_;
+
+	// Settings the group could not take, encoded here instead.
+	std::unique_ptr<webrtc::VideoEncoder> own_encoder_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_CODEC_SHARED_VIDEO_ENCODER_H_
@@ -15,9 +15,15 @@
 
 namespace krtc {
 
-    static webrtc::DesktopCaptureOptions GetCaptureOption()
+    // A static screen is still sent this often, late joiners and the
+    // encoder's quality ramp need some input.
+    static const int64_t kIdleFrameIntervalMs = 1000;
+
+    static webrtc::DesktopCaptureOptions GetCaptureOption(bool detect_updated_region = false)
     {
         auto capture_options = webrtc::DesktopCaptureOptions::CreateDefault();
+        // Not every capturer reports what changed, let webrtc diff the frames.
+        capture_options.set_detect_updated_region(detect_updated_region);
 #if defined(_WIN32) || defined(_WIN64)
         capture_options.set_allow_directx_capturer(true);
         capture_options.set_allow_use_magnification_api(false);
@@ -39,10 +45,11 @@ namespace krtc {
         return desktop_capturer->GetSourceList(&source_list);
     }
 
-    std::unique_ptr<DesktopCapturer> DesktopCapturer::Create(SourceId source_id, size_t out_width, size_t out_height, size_t target_fps)
+    std::unique_ptr<DesktopCapturer> DesktopCapturer::Create(SourceId source_id, size_t out_width, size_t out_height, size_t target_fps,
+                                                             bool screen_content)
     {
         std::unique_ptr<DesktopCapturer> screen_capture(new DesktopCapturer());
-        if (!screen_capture->Init(source_id, out_width, out_height, target_fps)) {
+        if (!screen_capture->Init(source_id, out_width, out_height, target_fps, screen_content)) {
             RTC_LOG(LS_WARNING) << "Failed to create DesktopCapturer(w = " << out_width
                 << ", h = " << out_height << ", fps = " << target_fps
                 << ")";
@@ -72,7 +79,8 @@ namespace krtc {
         frame_callback_ = frame_callback;
     }
 
-    bool DesktopCapturer::Init(webrtc::DesktopCapturer::SourceId source_id, size_t out_width, size_t out_height, size_t target_fps)
+    bool DesktopCapturer::Init(webrtc::DesktopCapturer::SourceId source_id, size_t out_width, size_t out_height, size_t target_fps,
+                               bool screen_content)
     {
         if (is_capturing_) {
             return false;
@@ -85,6 +93,7 @@ namespace krtc {
         out_width_ = out_width;
         out_height_ = out_height;
         target_fps_ = target_fps;
+        screen_content_ = screen_content;
 
         if (!CreateCapture(source_id)) {
             RTC_LOG(LS_WARNING) << "Failed to found capturer.";
@@ -92,7 +101,7 @@ namespace krtc {
         }
 
         if (is_capture_cursor_) {
-            desktop_capturer_.reset(new webrtc::DesktopAndCursorComposer(std::move(desktop_capturer_), GetCaptureOption()));
+            desktop_capturer_.reset(new webrtc::DesktopAndCursorComposer(std::move(desktop_capturer_), GetCaptureOption(screen_content_)));
         }
 
         if (!desktop_capturer_->SelectSource(source_id_)) {
@@ -146,7 +155,7 @@ namespace krtc {
     {
         bool is_found = false;
         webrtc::DesktopCapturer::SourceList source_list;
-        webrtc::DesktopCaptureOptions options = GetCaptureOption();
+        webrtc::DesktopCaptureOptions options = GetCaptureOption(screen_content_);
 
         source_list.clear();
         desktop_capturer_ = webrtc::DesktopCapturer::CreateScreenCapturer(options);
@@ -223,6 +232,15 @@ namespace krtc {
             return;
         }
 
+        // Nothing changed since the last captured frame, which was either sent
+        // or identical to the one sent before it.
+        int64_t now_ms = rtc::TimeMillis();
+        if (screen_content_ && frame->updated_region().is_empty() &&
+            now_ms - last_frame_ms_ < kIdleFrameIntervalMs) {
+            return;
+        }
+        last_frame_ms_ = now_ms;
+
         int width = frame->size().width();
         int height = frame->size().height();
         rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = webrtc::I420Buffer::Create(width, height);
@@ -234,7 +252,23 @@ namespace krtc {
             i420_buffer->width(), i420_buffer->height(),
             libyuv::kRotate0, libyuv::FOURCC_ARGB);
 
-        auto video_frame = webrtc::VideoFrame(i420_buffer, webrtc::kVideoRotation_0, rtc::TimeMicros());
+        webrtc::VideoFrame::Builder frame_builder = webrtc::VideoFrame::Builder()
+            .set_video_frame_buffer(i420_buffer)
+            .set_rotation(webrtc::kVideoRotation_0)
+            .set_timestamp_us(rtc::TimeMicros());
+        if (screen_content_) {
+            // The encoders only upload the changed part, an empty rect skips
+            // the upload of a refresh frame altogether.
+            webrtc::DesktopRect bounds;
+            for (webrtc::DesktopRegion::Iterator it(frame->updated_region()); !it.IsAtEnd(); it.Advance()) {
+                bounds.UnionWith(it.rect());
+            }
+            bounds.IntersectWith(webrtc::DesktopRect::MakeSize(frame->size()));
+            frame_builder.set_update_rect(webrtc::VideoFrame::UpdateRect{
+                bounds.left(), bounds.top(), bounds.width(), bounds.height() });
+        }
+
+        webrtc::VideoFrame video_frame = frame_builder.build();
         if (frame_callback_) {
             frame_callback_(video_frame);
         }
@@ -30,7 +30,8 @@ public:
 	static bool GetScreenSourceList(webrtc::DesktopCapturer::SourceList& screen_source_list);
 	static bool GetWindowSourceList(webrtc::DesktopCapturer::SourceList& window_source_list);
 
-	static std::unique_ptr<DesktopCapturer> Create(SourceId source_id, size_t out_width = 0, size_t out_height = 0, size_t target_fps = 25);
+	static std::unique_ptr<DesktopCapturer> Create(SourceId source_id, size_t out_width = 0, size_t out_height = 0, size_t target_fps = 25,
+												   bool screen_content = false);
 
 	virtual ~DesktopCapturer();
 
@@ -44,9 +45,11 @@ public:
 	void SetEnableVideo(bool enable) {}
 	void SetEnableAudio(bool enable) {}
 
+	bool screen_content() const { return screen_content_; }
+
 private:
 	DesktopCapturer();
-	bool Init(webrtc::DesktopCapturer::SourceId source_id, size_t target_fps, size_t out_width = 0, size_t out_height = 0);
+	bool Init(webrtc::DesktopCapturer::SourceId source_id, size_t out_width, size_t out_height, size_t target_fps, bool screen_content);
 	
 	bool CreateCapture(webrtc::DesktopCapturer::SourceId source_id);
 	void CaptureThread();
@@ -57,6 +60,11 @@ private:
 	size_t out_width_ = 0;
 	size_t out_height_ = 0;
 	size_t target_fps_ = 25;
+
+	// Screen content: frames go out at target_fps_ while the screen changes,
+	// a static screen is only refreshed every kIdleFrameIntervalMs.
+	bool screen_content_ = false;
+	int64_t last_frame_ms_ = 0;
 	webrtc::DesktopCaptureOptions capture_options_;
 	webrtc::DesktopCapturer::SourceId source_id_;
 	std::unique_ptr<webrtc::DesktopCapturer> desktop_capturer_;
@@ -70,12 +78,13 @@ private:
 class DesktopCapturerTrackSource : public webrtc::VideoTrackSource
 {
 public:
-	static rtc::scoped_refptr<DesktopCapturerTrackSource> Create(const uint32_t& screen_index, size_t target_fps = 30)
+	static rtc::scoped_refptr<DesktopCapturerTrackSource> Create(const uint32_t& screen_index, size_t target_fps = 30,
+																 bool screen_content = false)
 	{
 		webrtc::DesktopCapturer::SourceList source_list;
 		DesktopCapturer::GetScreenSourceList(source_list);
 
-		auto screen_capture = DesktopCapturer::Create(source_list[screen_index].id, target_fps);
+		auto screen_capture = DesktopCapturer::Create(source_list[screen_index].id, 0, 0, target_fps, screen_content);
 		if (screen_capture) {
 			return new rtc::RefCountedObject<DesktopCapturerTrackSource>(std::move(screen_capture));
 		}
@@ -90,6 +99,12 @@ public:
 		capture_->Stop();
 	}
 
+	// Lets webrtc pick the screenshare encoder settings and signal the
+	// screenshare content type.
+	bool is_screencast() const override {
+		return capture_->screen_content();
+	}
+
 protected:
 	explicit DesktopCapturerTrackSource(std::unique_ptr<DesktopCapturer> capture)
 		: VideoTrackSource(false)
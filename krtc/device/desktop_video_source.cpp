@@ -3,8 +3,10 @@
 
 namespace krtc {
 
-DesktopVideoSource::DesktopVideoSource(uint16_t screen_index, uint16_t target_fps) {
-	KRTCGlobal::Instance()->CreateDesktopCapturerSource(screen_index, target_fps);
+DesktopVideoSource::DesktopVideoSource(uint16_t screen_index, uint16_t target_fps,
+	bool screen_content)
+{
+	KRTCGlobal::Instance()->CreateDesktopCapturerSource(screen_index, target_fps, screen_content);
 }
 
 DesktopVideoSource::~DesktopVideoSource() {}
@@ -15,7 +15,8 @@ private:
 	void SetEnableAudio(bool enable) {}
 
 private:
-	DesktopVideoSource(uint16_t screen_index = 0, uint16_t target_fps = 30);
+	DesktopVideoSource(uint16_t screen_index = 0, uint16_t target_fps = 30,
+		bool screen_content = false);
 	~DesktopVideoSource();
 
 	friend class KRTCEngine;
@@ -0,0 +1,69 @@
+#include "krtc/device/device_cache.h"
+
+#include <utility>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+
+namespace krtc {
+
+DeviceCache::DeviceCache(rtc::Thread* thread, EnumerateFunction enumerate) :
+    thread_(thread),
+    enumerate_(std::move(enumerate))
+{
+}
+
+DeviceCache::~DeviceCache() {}
+
+void DeviceCache::Refresh(std::function<void()> done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        started_ = true;
+    }
+
+    thread_->PostTask(webrtc::ToQueuedTask([this, done]() {
+        Enumerate();
+        if (done) {
+            done();
+        }
+    }));
+}
+
+std::shared_ptr<const DeviceCache::Devices> DeviceCache::Get() {
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (devices_) {
+            return devices_;
+        }
+        start = !started_;
+        started_ = true;
+    }
+
+    // Nobody asked for the first enumeration yet. On thread itself a posted
+    // one would never run before the wait below.
+    if (thread_->IsCurrent()) {
+        Enumerate();
+    }
+    else if (start) {
+        Refresh();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return devices_ != nullptr; });
+    return devices_;
+}
+
+void DeviceCache::Enumerate() {
+    std::shared_ptr<const Devices> devices = std::make_shared<const Devices>(enumerate_());
+    RTC_LOG(LS_INFO) << "devices, cameras: " << devices->cameras.size()
+        << ", mics: " << devices->mics.size() << ", screens: " << devices->screens;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        devices_ = devices;
+    }
+    cond_.notify_all();
+}
+
+} // namespace krtc
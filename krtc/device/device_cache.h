@@ -0,0 +1,60 @@
+#ifndef KRTCSDK_KRTC_DEVICE_DEVICE_CACHE_H_
+#define KRTCSDK_KRTC_DEVICE_DEVICE_CACHE_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rtc_base/thread.h>
+
+namespace krtc {
+
+// Cameras, microphones and screens as of the last enumeration, so that the
+// app's device queries never wait for a busy api thread. Enumerated on
+// thread in the background, a read before the first enumeration finished
+// waits for it.
+class DeviceCache {
+public:
+	struct Device {
+		std::string name;
+		std::string id;
+	};
+
+	struct Devices {
+		std::vector<Device> cameras;
+		std::vector<Device> mics;
+		uint32_t screens = 0;
+	};
+
+	typedef std::function<Devices()> EnumerateFunction;
+
+	DeviceCache(rtc::Thread* thread, EnumerateFunction enumerate);
+	~DeviceCache();
+
+	// Any thread, does not wait. Enumerates again on thread, done (optional)
+	// runs there afterwards.
+	void Refresh(std::function<void()> done = nullptr);
+
+	// Any thread.
+	std::shared_ptr<const Devices> Get();
+
+private:
+	void Enumerate();
+
+	rtc::Thread* const thread_;
+	EnumerateFunction enumerate_;
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	bool started_ = false;
+	std::shared_ptr<const Devices> devices_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_DEVICE_DEVICE_CACHE_H_
@@ -0,0 +1,34 @@
+#include "krtc/device/gallery_capturer.h"
+
+#include "krtc/base/krtc_global.h"
+#include "krtc/render/gallery_renderer.h"
+
+namespace krtc {
+
+GalleryCapturer::GalleryCapturer() = default;
+
+GalleryCapturer::~GalleryCapturer() {
+    Stop();
+}
+
+void GalleryCapturer::Start() {
+    if (started_) {
+        return;
+    }
+    KRTCGlobal::Instance()->gallery()->SetOutputSink(this);
+    started_ = true;
+}
+
+void GalleryCapturer::Stop() {
+    if (!started_) {
+        return;
+    }
+    KRTCGlobal::Instance()->gallery()->SetOutputSink(nullptr);
+    started_ = false;
+}
+
+void GalleryCapturer::OnFrame(const webrtc::VideoFrame& frame) {
+    VideoCapturer::OnFrame(frame);
+}
+
+} // namespace krtc
@@ -0,0 +1,64 @@
+#ifndef KRTCSDK_KRTC_DEVICE_GALLERY_CAPTURER_H_
+#define KRTCSDK_KRTC_DEVICE_GALLERY_CAPTURER_H_
+
+#include <memory>
+
+#include <api/scoped_refptr.h>
+#include <pc/video_track_source.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include "krtc/device/video_capturer.h"
+
+namespace krtc {
+
+// The gallery canvas as a capture source: pushers send, and record, the
+// composed pulled streams instead of a camera or a screen.
+class GalleryCapturer : public VideoCapturer,
+						public rtc::VideoSinkInterface<webrtc::VideoFrame>
+{
+public:
+	GalleryCapturer();
+	~GalleryCapturer() override;
+
+	void Start();
+	void Stop();
+
+	// On the render thread.
+	void OnFrame(const webrtc::VideoFrame& frame) override;
+
+private:
+	bool started_ = false;
+};
+
+class GalleryCapturerTrackSource : public webrtc::VideoTrackSource
+{
+public:
+	static rtc::scoped_refptr<GalleryCapturerTrackSource> Create() {
+		return new rtc::RefCountedObject<GalleryCapturerTrackSource>(
+			std::make_unique<GalleryCapturer>());
+	}
+
+	void Start() {
+		capture_->Start();
+	}
+
+	void Stop() {
+		capture_->Stop();
+	}
+
+protected:
+	explicit GalleryCapturerTrackSource(std::unique_ptr<GalleryCapturer> capture)
+		: VideoTrackSource(false)
+		, capture_(std::move(capture)) {}
+
+private:
+	rtc::VideoSourceInterface<webrtc::VideoFrame>* source() override {
+		return capture_.get();
+	}
+
+	std::unique_ptr<GalleryCapturer> capture_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_DEVICE_GALLERY_CAPTURER_H_
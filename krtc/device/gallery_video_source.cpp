@@ -0,0 +1,24 @@
+#include "krtc/device/gallery_video_source.h"
+
+#include "krtc/base/krtc_global.h"
+
+namespace krtc {
+
+GalleryVideoSource::GalleryVideoSource()
+{
+    KRTCGlobal::Instance()->CreateGalleryCapturerSource();
+}
+
+GalleryVideoSource::~GalleryVideoSource() {}
+
+void GalleryVideoSource::Start() {
+    KRTCGlobal::Instance()->StartGalleryCapturerSource();
+}
+
+void GalleryVideoSource::Stop() {
+    KRTCGlobal::Instance()->StopGalleryCapturerSource();
+}
+
+void GalleryVideoSource::Destroy() {}
+
+} // namespace krtc
@@ -0,0 +1,26 @@
+#ifndef KRTCSDK_KRTC_DEVICE_GALLERY_VIDEO_SOURCE_H_
+#define KRTCSDK_KRTC_DEVICE_GALLERY_VIDEO_SOURCE_H_
+
+#include "krtc/krtc.h"
+
+namespace krtc {
+
+class GalleryVideoSource : public IVideoHandler
+{
+public:
+	void Start() override;
+	void Stop() override;
+	void Destroy() override;
+	void SetEnableVideo(bool enable) {}
+	void SetEnableAudio(bool enable) {}
+
+private:
+	GalleryVideoSource();
+	~GalleryVideoSource();
+
+	friend class KRTCEngine;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_DEVICE_GALLERY_VIDEO_SOURCE_H_
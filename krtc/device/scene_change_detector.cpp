@@ -0,0 +1,78 @@
+#include "krtc/device/scene_change_detector.h"
+
+#include <algorithm>
+
+#include <third_party/libyuv/include/libyuv/compare.h>
+#include <third_party/libyuv/include/libyuv/scale.h>
+
+namespace krtc {
+
+namespace {
+
+// Weight of the current frame in the running average.
+const double kAverageWeight = 0.1;
+
+}  // namespace
+
+SceneChangeDetector::SceneChangeDetector() :
+    SceneChangeDetector(Config())
+{
+}
+
+SceneChangeDetector::SceneChangeDetector(const Config& config) :
+    config_(config)
+{
+}
+
+void SceneChangeDetector::Reset() {
+    width_ = 0;
+    height_ = 0;
+    has_previous_ = false;
+    last_mse_ = 0.0;
+    average_mse_ = 0.0;
+    last_cut_ms_ = -1;
+}
+
+bool SceneChangeDetector::Detect(const webrtc::I420BufferInterface& buffer,
+    int64_t timestamp_ms)
+{
+    if (buffer.width() != width_ || buffer.height() != height_) {
+        Reset();
+        width_ = buffer.width();
+        height_ = buffer.height();
+        int thumbnail_width = std::min(config_.thumbnail_width, width_);
+        thumbnail_height_ = std::max(1, height_ * thumbnail_width / std::max(1, width_));
+        thumbnail_.resize(thumbnail_width * thumbnail_height_);
+        previous_.resize(thumbnail_.size());
+    }
+
+    const int thumbnail_width = (int)(thumbnail_.size() / thumbnail_height_);
+    libyuv::ScalePlane(buffer.DataY(), buffer.StrideY(), width_, height_,
+        thumbnail_.data(), thumbnail_width, thumbnail_width, thumbnail_height_,
+        libyuv::kFilterBox);
+
+    bool cut = false;
+    if (has_previous_) {
+        uint64_t sse = libyuv::ComputeSumSquareErrorPlane(thumbnail_.data(), thumbnail_width,
+            previous_.data(), thumbnail_width, thumbnail_width, thumbnail_height_);
+        last_mse_ = (double)sse / thumbnail_.size();
+
+        cut = last_mse_ >= config_.min_mse &&
+            last_mse_ >= config_.mse_ratio * average_mse_ &&
+            (last_cut_ms_ < 0 || timestamp_ms - last_cut_ms_ >= config_.min_cut_interval_ms);
+
+        // A cut is not motion, keep it out of the average.
+        if (cut) {
+            last_cut_ms_ = timestamp_ms;
+        }
+        else {
+            average_mse_ += (last_mse_ - average_mse_) * kAverageWeight;
+        }
+    }
+
+    previous_.swap(thumbnail_);
+    has_previous_ = true;
+    return cut;
+}
+
+}  // namespace krtc
@@ -0,0 +1,54 @@
+#ifndef KRTCSDK_KRTC_DEVICE_SCENE_CHANGE_DETECTOR_H_
+#define KRTCSDK_KRTC_DEVICE_SCENE_CHANGE_DETECTOR_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <api/video/video_frame_buffer.h>
+
+namespace krtc {
+
+// Finds cuts (slide flips, camera switches) by comparing each frame's luma,
+// box filtered down to a thumbnail, with the previous one. A frame is a cut
+// when the difference is large in absolute terms and far above the recent
+// average, so panning and noise do not trigger it.
+class SceneChangeDetector {
+public:
+    struct Config {
+        int thumbnail_width = 64;
+        // Mean squared luma error a cut needs at least, 400 = 20 levels rms.
+        double min_mse = 400.0;
+        // ... and how many times the recent average it needs to be.
+        double mse_ratio = 4.0;
+        int64_t min_cut_interval_ms = 500;
+    };
+
+    SceneChangeDetector();
+    explicit SceneChangeDetector(const Config& config);
+
+    // Returns true when buffer starts a new scene. The first frame and a
+    // size change are not cuts, the encoder starts with a key frame anyway.
+    bool Detect(const webrtc::I420BufferInterface& buffer, int64_t timestamp_ms);
+
+    void Reset();
+
+    double last_mse() const { return last_mse_; }
+    double average_mse() const { return average_mse_; }
+
+private:
+    Config config_;
+    int width_ = 0;
+    int height_ = 0;
+    int thumbnail_height_ = 0;
+    std::vector<uint8_t> thumbnail_;
+    std::vector<uint8_t> previous_;
+    bool has_previous_ = false;
+    double last_mse_ = 0.0;
+    double average_mse_ = 0.0;
+    int64_t last_cut_ms_ = -1;
+};
+
+}  // namespace krtc
+
+#endif  // KRTCSDK_KRTC_DEVICE_SCENE_CHANGE_DETECTOR_H_
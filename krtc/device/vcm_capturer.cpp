@@ -12,6 +12,7 @@
 
 #include "krtc/base/krtc_global.h"
 #include "krtc/media/media_frame.h"
+#include "krtc/codec/encoder_hint_buffer.h"
 
 namespace krtc {
 
@@ -167,7 +168,23 @@ webrtc::VideoFrame VcmFramePreprocessor::Preprocess(const webrtc::VideoFrame& fr
     memcpy((char*)yuv_buffer->MutableDataU(), preprocessed_frame->data[1], preprocessed_frame->data_len[1]);
     memcpy((char*)yuv_buffer->MutableDataV(), preprocessed_frame->data[2], preprocessed_frame->data_len[2]);
 
-    webrtc::VideoFrame video_frame(yuv_buffer, 0, 0, webrtc::kVideoRotation_0);
+    // The hook marked what matters in the frame, the encoders read it back
+    // from the buffer.
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer = yuv_buffer;
+    if (preprocessed_frame->qp_delta_map && preprocessed_frame->qp_map_width > 0 &&
+        preprocessed_frame->qp_map_height > 0)
+    {
+        std::shared_ptr<QpDeltaMap> qp_map = std::make_shared<QpDeltaMap>();
+        qp_map->width = preprocessed_frame->qp_map_width;
+        qp_map->height = preprocessed_frame->qp_map_height;
+        qp_map->deltas.assign(preprocessed_frame->qp_delta_map,
+            preprocessed_frame->qp_delta_map + qp_map->width * qp_map->height);
+        EncoderHints hints;
+        hints.qp_map = qp_map;
+        frame_buffer = EncoderHintBuffer::Create(yuv_buffer, hints);
+    }
+
+    webrtc::VideoFrame video_frame(frame_buffer, 0, 0, webrtc::kVideoRotation_0);
     video_frame.set_timestamp_us(rtc::TimeMicros()); // Ϊǰʱ
     return video_frame;
 }
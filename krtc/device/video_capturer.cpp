@@ -10,6 +10,7 @@
 
 #include "krtc/base/krtc_global.h"
 #include "krtc/media/media_frame.h"
+#include "krtc/codec/encoder_hint_buffer.h"
 
 namespace krtc {
 VideoCapturer::~VideoCapturer() = default;
@@ -33,8 +34,20 @@ void VideoCapturer::OnFrame(const webrtc::VideoFrame& original_frame) {
                 << ", timestamp_us:" << frame.timestamp_us();
 
         // Drop frame in order to respect frame rate constraint.
+        AddDroppedUpdate(frame);
         return;
     }
+    MergeDroppedUpdate(&frame);
+
+    // Compare with the last frame that went on, dropped ones never reach the encoder.
+    rtc::scoped_refptr<webrtc::I420BufferInterface> i420_buffer =
+        frame.video_frame_buffer()->ToI420();
+    EncoderHints hints = EncoderHintBuffer::Find(frame.video_frame_buffer().get());
+    if (scene_change_detector_.Detect(*i420_buffer, frame.timestamp_us() / 1000)) {
+        RTC_LOG(LS_INFO) << "VideoCapturer scene cut, mse:" << scene_change_detector_.last_mse()
+                << ", average mse:" << scene_change_detector_.average_mse();
+        hints.scene_cut = true;
+    }
 
     if (out_height != frame.height() || out_width != frame.width()) {
         // Video adapter has requested a down-scale. Allocate a new buffer and
@@ -42,10 +55,20 @@ void VideoCapturer::OnFrame(const webrtc::VideoFrame& original_frame) {
         // For simplicity, only scale here without cropping.
         rtc::scoped_refptr<webrtc::I420Buffer> scaled_buffer =
             webrtc::I420Buffer::Create(out_width, out_height);
-        scaled_buffer->ScaleFrom(*frame.video_frame_buffer()->ToI420());
+        scaled_buffer->ScaleFrom(*i420_buffer);
+
+        // Keep the hints with the frame.
+        rtc::scoped_refptr<webrtc::VideoFrameBuffer> out_buffer = scaled_buffer;
+        if (hints.qp_map) {
+            hints.qp_map = hints.qp_map->Scale(frame.width(), frame.height(), out_width, out_height);
+        }
+        if (hints.qp_map || hints.scene_cut) {
+            out_buffer = EncoderHintBuffer::Create(scaled_buffer, hints);
+        }
+
         webrtc::VideoFrame::Builder new_frame_builder =
             webrtc::VideoFrame::Builder()
-            .set_video_frame_buffer(scaled_buffer)
+            .set_video_frame_buffer(out_buffer)
             .set_rotation(webrtc::kVideoRotation_0)
             .set_timestamp_us(frame.timestamp_us())
             .set_id(frame.id());
@@ -59,6 +82,10 @@ void VideoCapturer::OnFrame(const webrtc::VideoFrame& original_frame) {
         broadcaster_.OnFrame(new_frame_builder.build());
 
     }
+    else if (hints.scene_cut) {
+        frame.set_video_frame_buffer(EncoderHintBuffer::Create(i420_buffer, hints));
+        broadcaster_.OnFrame(frame);
+    }
     else {
         // No adaptations needed, just return the frame as is.
         broadcaster_.OnFrame(frame);
@@ -105,6 +132,42 @@ void VideoCapturer::UpdateVideoAdapter() {
     video_adapter_.OnSinkWants(broadcaster_.wants());
 }
 
+void VideoCapturer::AddDroppedUpdate(const webrtc::VideoFrame& frame) {
+    // update_rect() is the whole frame when the source did not set one.
+    webrtc::VideoFrame::UpdateRect rect = frame.update_rect();
+    if (dropped_update_) {
+        if (dropped_width_ == frame.width() && dropped_height_ == frame.height()) {
+            rect.Union(*dropped_update_);
+        }
+        else {
+            rect = webrtc::VideoFrame::UpdateRect{ 0, 0, frame.width(), frame.height() };
+        }
+    }
+
+    dropped_update_ = rect;
+    dropped_width_ = frame.width();
+    dropped_height_ = frame.height();
+}
+
+void VideoCapturer::MergeDroppedUpdate(webrtc::VideoFrame* frame) {
+    if (!dropped_update_) {
+        return;
+    }
+
+    if (frame->has_update_rect() &&
+        dropped_width_ == frame->width() && dropped_height_ == frame->height())
+    {
+        webrtc::VideoFrame::UpdateRect rect = frame->update_rect();
+        rect.Union(*dropped_update_);
+        frame->set_update_rect(rect);
+    }
+    else {
+        // No rect on the frame (all of it is new) or the size changed.
+        frame->clear_update_rect();
+    }
+    dropped_update_.reset();
+}
+
 webrtc::VideoFrame VideoCapturer::MaybePreprocess(const webrtc::VideoFrame& frame) {
     if (preprocessor_ != nullptr) {
         return preprocessor_->Preprocess(frame);
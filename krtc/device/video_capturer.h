@@ -6,12 +6,15 @@
 #include <memory>
 #include <atomic>
 
+#include <absl/types/optional.h>
 #include <api/video/video_frame.h>
 #include <api/video/video_source_interface.h>
 #include <media/base/video_adapter.h>
 #include <media/base/video_broadcaster.h>
 #include <rtc_base/synchronization/mutex.h>
 
+#include "krtc/device/scene_change_detector.h"
+
 namespace krtc {
 
 class VideoCapturer : public rtc::VideoSourceInterface<webrtc::VideoFrame> {
@@ -44,10 +47,19 @@ private:
     void UpdateVideoAdapter();
     webrtc::VideoFrame MaybePreprocess(const webrtc::VideoFrame& frame);
 
+    // The encoder uploads only the update rect, relative to the last frame
+    // it got. What changed in dropped frames goes on with the next frame.
+    void AddDroppedUpdate(const webrtc::VideoFrame& frame);
+    void MergeDroppedUpdate(webrtc::VideoFrame* frame);
+
     webrtc::Mutex lock_;
     std::unique_ptr<FramePreprocessor> preprocessor_ RTC_GUARDED_BY(lock_);
     rtc::VideoBroadcaster broadcaster_;
     cricket::VideoAdapter video_adapter_;
+    SceneChangeDetector scene_change_detector_;
+    absl::optional<webrtc::VideoFrame::UpdateRect> dropped_update_;
+    int dropped_width_ = 0;
+    int dropped_height_ = 0;
 
     std::atomic<int> fps_{ 0 };
     std::atomic<int64_t> last_frame_ts_{ 0 };
@@ -1,3 +1,6 @@
+#include <string.h>
+
+#include <future>
 #include <map>
 
 #include <rtc_base/logging.h>
@@ -10,9 +13,11 @@
 #include "krtc/media/krtc_preview.h"
 #include "krtc/device/camera_video_source.h"
 #include "krtc/device/desktop_video_source.h"
+#include "krtc/device/gallery_video_source.h"
 #include "krtc/device/mic_impl.h"
 #include "krtc/base/singleton.h"
 #include "krtc/base/krtc_client.h"
+#include "krtc/render/gallery_renderer.h"
 
 namespace krtc {
 
@@ -39,6 +44,43 @@ KRTCErrStrs KRTCErrStr = {
     {KRTCError::kAudioStartRecordingErr,        "AudioStartRecordingErr"},
 };
 
+namespace {
+
+// Creates the handler on the api thread without waiting for it, the future
+// and done (optional, on the api thread) get it.
+template <typename T>
+std::future<T*> PostCreate(std::function<T*()> create, std::function<void(T*)> done) {
+    std::shared_ptr<std::promise<T*>> promise = std::make_shared<std::promise<T*>>();
+    std::future<T*> future = promise->get_future();
+    KRTCGlobal::Instance()->api_thread()->PostTask(webrtc::ToQueuedTask(
+        [create, done, promise]() {
+            T* handler = create();
+            promise->set_value(handler);
+            if (done) {
+                done(handler);
+            }
+        }));
+    return future;
+}
+
+int32_t CopyDevice(const std::vector<DeviceCache::Device>& devices, int index,
+    char* name, uint32_t name_length, char* id, uint32_t id_length)
+{
+    if (index < 0 || index >= (int)devices.size() || !name || !id ||
+        name_length == 0 || id_length == 0)
+    {
+        return -1;
+    }
+
+    strncpy(name, devices[index].name.c_str(), name_length - 1);
+    name[name_length - 1] = '\0';
+    strncpy(id, devices[index].id.c_str(), id_length - 1);
+    id[id_length - 1] = '\0';
+    return 0;
+}
+
+} // namespace
+
 void KRTCEngine::Init(KRTCEngineObserver* media_observer, KRTCMsgObserver* msg_observer) {
     rtc::LogMessage::LogTimestamps(true);
     rtc::LogMessage::LogThreads(true);
@@ -46,34 +88,74 @@ void KRTCEngine::Init(KRTCEngineObserver* media_observer, KRTCMsgObserver* msg_o
 
     KRTCGlobal::Instance()->RegisterEngineObserver(media_observer);
     KRTCGlobal::Instance()->RegisterMsgObserver(msg_observer);
+
+    // Loads the gpu drivers, keep it off the caller's thread.
+    KRTCGlobal::Instance()->encoder_capabilities()->StartProbe();
 }
 
 const char* KRTCEngine::GetErrString(const KRTCError& err) {
     return KRTCErrStr[err].c_str();
 }
 
+void KRTCEngine::SetHardwareEncoderAsyncDepth(uint32_t depth) {
+    KRTCGlobal::Instance()->SetEncoderAsyncDepth(depth < 1 ? 1 : (int)depth);
+}
+
+void KRTCEngine::SetShareVideoEncoder(bool share) {
+    KRTCGlobal::Instance()->SetShareVideoEncoder(share);
+}
+
+void KRTCEngine::SetEnableEncodedFrameCallback(bool enable) {
+    KRTCGlobal::Instance()->SetEncodedFrameCallback(enable);
+}
+
+bool KRTCEngine::StartGallery(uint32_t width, uint32_t height, uint32_t fps, SubMediaType type) {
+    return KRTCGlobal::Instance()->gallery()->Start((int)width, (int)height, (int)fps, type);
+}
+
+void KRTCEngine::StopGallery() {
+    KRTCGlobal::Instance()->gallery()->Stop();
+}
+
+bool KRTCEngine::SetGalleryOverlay(const uint8_t* bgra, uint32_t width, uint32_t height,
+    uint32_t x, uint32_t y)
+{
+    if (!bgra) {
+        KRTCGlobal::Instance()->gallery()->ClearOverlay();
+        return true;
+    }
+    return KRTCGlobal::Instance()->gallery()->SetOverlay(bgra, (int)width * 4, (int)width,
+        (int)height, (int)x, (int)y);
+}
+
+uint32_t KRTCEngine::GetVideoEncoderCount() {
+    return (uint32_t)KRTCGlobal::Instance()->encoder_capabilities()->Get().size();
+}
+
+int32_t KRTCEngine::GetVideoEncoderCapability(int index, KRTCEncoderCapability* capability) {
+    std::vector<KRTCEncoderCapability> capabilities =
+        KRTCGlobal::Instance()->encoder_capabilities()->Get();
+    if (index < 0 || index >= (int)capabilities.size() || !capability) {
+        return -1;
+    }
+
+    *capability = capabilities[index];
+    return 0;
+}
+
+void KRTCEngine::RefreshDevices(std::function<void()> done) {
+    KRTCGlobal::Instance()->devices()->Refresh(std::move(done));
+}
+
 uint32_t KRTCEngine::GetCameraCount() {
-    return KRTCGlobal::Instance()->api_thread()->Invoke<uint32_t>(RTC_FROM_HERE, [=]() {
-        if (!KRTCGlobal::Instance()->video_device_info()) {
-            return (uint32_t)0;
-        }
-        return KRTCGlobal::Instance()->video_device_info()->NumberOfDevices();
-    });
+    return (uint32_t)KRTCGlobal::Instance()->devices()->Get()->cameras.size();
 }
 
 int32_t KRTCEngine::GetCameraInfo(int index, char* device_name, uint32_t device_name_length,
     char* device_id, uint32_t device_id_length)
 {
-    assert(device_name_length == 128 && device_id_length == 128);
-    return KRTCGlobal::Instance()->api_thread()->Invoke<int32_t>(RTC_FROM_HERE, [&]() {
-        int32_t ret = -1;
-        if (!KRTCGlobal::Instance()->video_device_info()) {
-            return ret;
-        }
-        ret = KRTCGlobal::Instance()->video_device_info()->GetDeviceName(index,
-            device_name, device_name_length, device_id, device_id_length);
-        return ret;
-    });
+    return CopyDevice(KRTCGlobal::Instance()->devices()->Get()->cameras, index,
+        device_name, device_name_length, device_id, device_id_length);
 }
 
 IVideoHandler* KRTCEngine::CreateCameraSource(const char* cam_id) {
@@ -82,43 +164,45 @@ IVideoHandler* KRTCEngine::CreateCameraSource(const char* cam_id) {
     });
 }
 
+std::future<IVideoHandler*> KRTCEngine::CreateCameraSourceAsync(const char* cam_id,
+    std::function<void(IVideoHandler*)> done)
+{
+    std::string id = cam_id ? cam_id : "";
+    return PostCreate<IVideoHandler>([id]() -> IVideoHandler* {
+        return new CameraVideoSource(id.c_str());
+    }, std::move(done));
+}
+
 uint32_t KRTCEngine::GetScreenCount()
 {
-    return KRTCGlobal::Instance()->api_thread()->Invoke<int32_t>(RTC_FROM_HERE, [=]() {
-        int32_t res = KRTCGlobal::Instance()->GetScreenCount();
-        return res;
-    });
+    return KRTCGlobal::Instance()->devices()->Get()->screens;
 }
 
-IVideoHandler* KRTCEngine::CreateScreenSource(const uint32_t& screen_index)
+IVideoHandler* KRTCEngine::CreateScreenSource(const uint32_t& screen_index, bool screen_content)
 {
     return KRTCGlobal::Instance()->api_thread()->Invoke<IVideoHandler*>(RTC_FROM_HERE, [=]() {
-        return new DesktopVideoSource(screen_index);
+        return new DesktopVideoSource(screen_index, 30, screen_content);
     });
 }
 
+std::future<IVideoHandler*> KRTCEngine::CreateScreenSourceAsync(const uint32_t& screen_index,
+    bool screen_content, std::function<void(IVideoHandler*)> done)
+{
+    uint32_t index = screen_index;
+    return PostCreate<IVideoHandler>([index, screen_content]() -> IVideoHandler* {
+        return new DesktopVideoSource(index, 30, screen_content);
+    }, std::move(done));
+}
+
 int16_t KRTCEngine::GetMicCount() {
-    return KRTCGlobal::Instance()->api_thread()->Invoke<uint32_t>(RTC_FROM_HERE, [=]() {
-        if (!KRTCGlobal::Instance()->audio_device()) {
-            return (int16_t)0;
-        }
-        return KRTCGlobal::Instance()->audio_device()->RecordingDevices();
-    });
+    return (int16_t)KRTCGlobal::Instance()->devices()->Get()->mics.size();
 }
 
 int32_t KRTCEngine::GetMicInfo(int index, char* mic_name, uint32_t mic_name_length,
     char* mic_guid, uint32_t mic_guid_length) 
 {
-    assert(mic_name_length == 128 && mic_guid_length == 128);
-    return KRTCGlobal::Instance()->api_thread()->Invoke<int32_t>(RTC_FROM_HERE, [&]() {
-        int32_t ret = -1;
-        if (!KRTCGlobal::Instance()->audio_device()) {
-            return ret;
-        }
-        ret = KRTCGlobal::Instance()->audio_device()->RecordingDeviceName(
-            index, mic_name, mic_guid);
-        return ret;
-    });
+    return CopyDevice(KRTCGlobal::Instance()->devices()->Get()->mics, index,
+        mic_name, mic_name_length, mic_guid, mic_guid_length);
 }
 
 IAudioHandler* KRTCEngine::CreateMicSource(const char* mic_id) {
@@ -127,6 +211,22 @@ IAudioHandler* KRTCEngine::CreateMicSource(const char* mic_id) {
     });
 }
 
+std::future<IAudioHandler*> KRTCEngine::CreateMicSourceAsync(const char* mic_id,
+    std::function<void(IAudioHandler*)> done)
+{
+    std::string id = mic_id ? mic_id : "";
+    return PostCreate<IAudioHandler>([id]() -> IAudioHandler* {
+        return new MicImpl(id.c_str());
+    }, std::move(done));
+}
+
+IVideoHandler* KRTCEngine::CreateGallerySource()
+{
+    return KRTCGlobal::Instance()->api_thread()->Invoke<IVideoHandler*>(RTC_FROM_HERE, [=]() {
+        return new GalleryVideoSource();
+    });
+}
+
 IMediaHandler* KRTCEngine::CreatePreview(const unsigned int& hwnd) {
    return KRTCGlobal::Instance()->api_thread()->Invoke<IMediaHandler*>(RTC_FROM_HERE, [=]() {
         return new KRTCPreview(hwnd);
@@ -145,6 +245,37 @@ IMediaHandler* KRTCEngine::CreatePuller(const char* server_addr, const char* pul
     });
 }
 
+std::future<IMediaHandler*> KRTCEngine::CreatePreviewAsync(const unsigned int& hwnd,
+    std::function<void(IMediaHandler*)> done)
+{
+    unsigned int window = hwnd;
+    return PostCreate<IMediaHandler>([window]() -> IMediaHandler* {
+        return new KRTCPreview(window);
+    }, std::move(done));
+}
+
+std::future<IMediaHandler*> KRTCEngine::CreatePusherAsync(const char* server_addr,
+    const char* push_channel, std::function<void(IMediaHandler*)> done)
+{
+    std::string server = server_addr ? server_addr : "";
+    std::string channel = push_channel ? push_channel : "";
+    return PostCreate<IMediaHandler>([server, channel]() -> IMediaHandler* {
+        return new KRTCPusher(server, channel);
+    }, std::move(done));
+}
+
+std::future<IMediaHandler*> KRTCEngine::CreatePullerAsync(const char* server_addr,
+    const char* pull_channel, const unsigned int& hwnd,
+    std::function<void(IMediaHandler*)> done)
+{
+    std::string server = server_addr ? server_addr : "";
+    std::string channel = pull_channel ? pull_channel : "";
+    unsigned int window = hwnd;
+    return PostCreate<IMediaHandler>([server, channel, window]() -> IMediaHandler* {
+        return new KRTCPuller(server, channel, window);
+    }, std::move(done));
+}
+
 bool KRTCEngine::JoinRoom(const std::string& server_addr, 
     const std::string& room_id, 
     const std::string& uid)
@@ -152,6 +283,14 @@ bool KRTCEngine::JoinRoom(const std::string& server_addr,
     return KRTCClient::Instance()->JoinRoom(server_addr, room_id, uid);
 }
 
+void KRTCEngine::JoinRoomAsync(const std::string& server_addr,
+    const std::string& room_id,
+    const std::string& uid,
+    std::function<void(bool success)> done)
+{
+    KRTCClient::Instance()->JoinRoomAsync(server_addr, room_id, uid, std::move(done));
+}
+
 void KRTCEngine::LeaveRoom() {
     KRTCClient::Instance()->LeaveRoom();
 }
@@ -19,6 +19,8 @@
 #endif
 #endif
 
+#include <functional>
+#include <future>
 #include <memory>
 #include <vector>
 #include <string>
@@ -27,6 +29,7 @@
 namespace krtc {
  
 class MediaFrame;
+enum class SubMediaType;
 class KRTCRender;
 class KRTCPreview;
 class KRTCPusher;
@@ -55,6 +58,16 @@ enum class KRTCError {
     kAudioStartRecordingErr
 };
 
+// One video encoder backend found on this machine.
+struct KRTCEncoderCapability {
+    char name[32];
+    bool hardware;
+    bool h264;
+    bool h265;
+    uint32_t max_width;     // 0: not reported
+    uint32_t max_height;
+};
+
 class IMediaHandler {
 public:
     virtual ~IMediaHandler() {}
@@ -65,6 +78,39 @@ public:
 
     virtual void SetEnableVideo(bool enable) = 0;
     virtual void SetEnableAudio(bool enable) = 0;
+
+    // Pushers and pullers: writes the H.264 and Opus frames as sent or
+    // received to a fragmented mp4, without encoding them again. The file
+    // plays up to the last fragment written even if the process dies.
+    virtual bool StartRecording(const char* file_path) { return false; }
+    virtual void StopRecording() {}
+
+    // Pullers: OnPullVideoFrame runs on an sdk render thread and only ever
+    // gets the newest frame, frames decoded while the app was busy are
+    // dropped instead of queued.
+    virtual bool GetRenderStats(uint64_t* delivered_frames, uint64_t* dropped_frames) {
+        return false;
+    }
+
+    // Pullers: pixel format of OnPullVideoFrame, kSubTypeI420 (default),
+    // kSubTypeNV12, kSubTypeARGB or kSubTypeRGBA. With a size the frames are
+    // scaled down to fit into it, keeping the aspect ratio, 0 keeps the
+    // stream size. Converted once in the sdk into pooled buffers.
+    virtual bool SetPullVideoFormat(SubMediaType type, int max_width = 0, int max_height = 0) {
+        return false;
+    }
+
+    // Pullers: frames wait for a small playout delay that follows the
+    // network jitter and are handed out on refresh_hz boundaries in capture
+    // order, an even cadence instead of the network's. A frame is never held
+    // longer than max_delay_ms. interval_stddev_ms is the spread of the
+    // intervals between the frames handed out, 0 for a perfectly even one.
+    virtual bool SetPresentationSmoothing(bool enable, int refresh_hz = 60, int max_delay_ms = 50) {
+        return false;
+    }
+    virtual bool GetPresentationStats(double* interval_stddev_ms, int* delay_ms) {
+        return false;
+    }
 };
 
 class IAudioHandler : public IMediaHandler {
@@ -87,9 +133,13 @@ public:
     virtual void OnPullSuccess() {}
     virtual void OnPullFailed(KRTCError) {}
     virtual void OnPullVideoFrame(std::shared_ptr<krtc::MediaFrame> video_frame) {}
+    // Every pulled stream composed into one frame, see StartGallery.
+    virtual void OnGalleryVideoFrame(std::shared_ptr<krtc::MediaFrame> video_frame) {}
 
     virtual void OnPushNetworkInfo(uint64_t rtt_ms, uint64_t packets_lost, double fraction_lost) {}
     virtual void OnVideoCaptureFps(uint32_t fps) {}
+    // The running video encoder failed or fell behind, "to" took over.
+    virtual void OnVideoEncoderSwitched(const char* from, const char* to, const char* reason) {}
     virtual void OnEncodedVideoFrame(std::shared_ptr<MediaFrame> video_frame) {}
     virtual void OnPureAudioFrame(std::shared_ptr<MediaFrame> audio_frame) {}
     virtual void OnMixedAudioFrame(std::shared_ptr<MediaFrame> audio_frame) {}
@@ -120,18 +170,80 @@ public:
     static void Init(KRTCEngineObserver* media_observer, KRTCMsgObserver* msg_observer);
     static const char* GetErrString(const KRTCError& err);
 
+    // Frames kept in flight by the hardware encoder, 1 (default) encodes
+    // synchronously. A larger depth raises throughput at high resolutions at
+    // the cost of depth - 1 frames of latency. Applies to encoders created
+    // after the call.
+    static void SetHardwareEncoderAsyncDepth(uint32_t depth);
+
+    // Pushers created after the call share one video encoder instead of
+    // encoding the source once each. The encoder follows the lowest target
+    // bitrate of the pushers and serves a key frame request from any of them.
+    static void SetShareVideoEncoder(bool share);
+
+    // Pushers started after the call hand every encoded frame, H.264 and
+    // Opus as sent, to OnEncodedVideoFrame / OnEncodedAudioFrame on the
+    // encoder thread. Video frames reference the encoder's output buffer,
+    // which is not reused while the frame is held; audio frames hold a copy.
+    // Frames may be kept.
+    static void SetEnableEncodedFrameCallback(bool enable);
+
+    // Composes the video of every puller into one width x height frame, a
+    // grid of equal tiles with each stream scaled to fit its tile, handed
+    // to OnGalleryVideoFrame up to fps times a second on the render thread
+    // and only when a stream sent a new frame. Pullers whose video starts
+    // while the gallery runs join it, leaving frees their tile.
+    static bool StartGallery(uint32_t width, uint32_t height, uint32_t fps, SubMediaType type);
+    static void StopGallery();
+    // A watermark or caption blended over the running gallery at x, y:
+    // 32 bit BGRA pixels (kSubTypeARGB order) with straight alpha. Null
+    // removes it.
+    static bool SetGalleryOverlay(const uint8_t* bgra, uint32_t width, uint32_t height,
+        uint32_t x, uint32_t y);
+
+    // Encoder backends, best first. Probed once in the background by Init(),
+    // these wait for the probe if it has not finished yet.
+    static uint32_t GetVideoEncoderCount();
+    static int32_t GetVideoEncoderCapability(int index, KRTCEncoderCapability* capability);
+
+    // The device queries read a list enumerated in the background and
+    // return without waiting for the sdk's threads, except for the very
+    // first one if the list is not ready yet. The list is not updated by
+    // itself: after a device was plugged in or removed, RefreshDevices
+    // enumerates again and runs done (optional) on the api thread when the
+    // queries see the new list.
+    static void RefreshDevices(std::function<void()> done = nullptr);
+
+    // The Create* calls wait for the sdk's api thread, which may be busy
+    // with signaling. The *Async variants return right away; the handler is
+    // created on the api thread and handed to the future and to done
+    // (optional), which runs on that thread.
+
     static uint32_t GetCameraCount();
     static int32_t GetCameraInfo(int index, char *device_name, uint32_t device_name_length,
         char* device_id, uint32_t device_id_length);
     static IVideoHandler* CreateCameraSource(const char* cam_id);
+    static std::future<IVideoHandler*> CreateCameraSourceAsync(const char* cam_id,
+        std::function<void(IVideoHandler*)> done = nullptr);
 
     static uint32_t GetScreenCount();
-    static IVideoHandler* CreateScreenSource(const uint32_t& screen_index = 0);
+    // screen_content: tune for slides and text instead of motion, keep the
+    // resolution and send frames only while the screen changes.
+    static IVideoHandler* CreateScreenSource(const uint32_t& screen_index = 0,
+                                             bool screen_content = false);
+    static std::future<IVideoHandler*> CreateScreenSourceAsync(const uint32_t& screen_index = 0,
+        bool screen_content = false, std::function<void(IVideoHandler*)> done = nullptr);
+
+    // The gallery canvas as the video of the pushers, to send or record the
+    // mix of the pulled streams. Needs StartGallery.
+    static IVideoHandler* CreateGallerySource();
    
     static int16_t GetMicCount();
     static int32_t GetMicInfo(int index, char* mic_name, uint32_t mic_name_length,
         char* mic_guid, uint32_t mic_guid_length);
     static IAudioHandler* CreateMicSource(const char* mic_id);
+    static std::future<IAudioHandler*> CreateMicSourceAsync(const char* mic_id,
+        std::function<void(IAudioHandler*)> done = nullptr);
 
     static IMediaHandler* CreatePreview(const unsigned int& hwnd = 0);
     static IMediaHandler* CreatePusher(const char* server_addr, 
@@ -139,11 +251,25 @@ public:
     static IMediaHandler* CreatePuller(const char* server_addr, 
                                         const char* pull_channel = "livestream",
                                         const unsigned int& hwnd = 0);
+    static std::future<IMediaHandler*> CreatePreviewAsync(const unsigned int& hwnd = 0,
+        std::function<void(IMediaHandler*)> done = nullptr);
+    static std::future<IMediaHandler*> CreatePusherAsync(const char* server_addr,
+        const char* push_channel = "livestream",
+        std::function<void(IMediaHandler*)> done = nullptr);
+    static std::future<IMediaHandler*> CreatePullerAsync(const char* server_addr,
+        const char* pull_channel = "livestream", const unsigned int& hwnd = 0,
+        std::function<void(IMediaHandler*)> done = nullptr);
 
 
     static bool JoinRoom(const std::string& server_addr,
         const std::string& room_id,
         const std::string& uid);
+    // Returns right away, done runs once on the sdk's websocket thread when
+    // the server answered the join or it failed.
+    static void JoinRoomAsync(const std::string& server_addr,
+        const std::string& room_id,
+        const std::string& uid,
+        std::function<void(bool success)> done);
 
     static void LeaveRoom();
 };
@@ -0,0 +1,195 @@
+#include "krtc/media/encoded_frame_tap.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "krtc/media/media_frame.h"
+
+namespace krtc {
+
+namespace {
+
+thread_local const webrtc::EncodedImage* current_encoded_image = nullptr;
+
+// Samples per channel at 48 kHz from the TOC byte and frame count (RFC 6716
+// 3.1 / 3.2), 0 when the packet is malformed.
+size_t OpusSamplesPerChannel(rtc::ArrayView<const uint8_t> packet) {
+    if (packet.empty()) {
+        return 0;
+    }
+
+    uint8_t config = packet[0] >> 3;
+    size_t frame_samples;
+    if (config < 12) {
+        // SILK: 10, 20, 40, 60 ms.
+        const size_t kSilk[] = { 480, 960, 1920, 2880 };
+        frame_samples = kSilk[config & 3];
+    }
+    else if (config < 16) {
+        // Hybrid: 10, 20 ms.
+        frame_samples = (config & 1) ? 960 : 480;
+    }
+    else {
+        // CELT: 2.5, 5, 10, 20 ms.
+        frame_samples = 120 << (config & 3);
+    }
+
+    switch (packet[0] & 3) {
+    case 0:
+        return frame_samples;
+    case 1:
+    case 2:
+        return frame_samples * 2;
+    default:
+        return packet.size() > 1 ? frame_samples * (packet[1] & 0x3f) : 0;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<MediaFrame> WrapEncodedFrame(const TappedFrame& frame, int64_t capture_time_ms) {
+    std::shared_ptr<MediaFrame> media_frame = std::make_shared<MediaFrame>((int)frame.data.size());
+    if (frame.buffer) {
+        media_frame->data[0] = (char*)frame.data.data();
+        media_frame->external_data = true;
+        media_frame->external_data_owner =
+            std::make_shared<rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>>(frame.buffer);
+    }
+    else {
+        // Only valid during the call.
+        media_frame->data[0] = new char[frame.data.size()];
+        memcpy(media_frame->data[0], frame.data.data(), frame.data.size());
+    }
+    media_frame->data_len[0] = (int)frame.data.size();
+    media_frame->ts = frame.rtp_timestamp;
+    media_frame->capture_time_ms = capture_time_ms;
+
+    if (frame.video) {
+        media_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
+        media_frame->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeH264;
+        media_frame->fmt.sub_fmt.video_fmt.width = frame.width;
+        media_frame->fmt.sub_fmt.video_fmt.height = frame.height;
+        media_frame->fmt.sub_fmt.video_fmt.idr = frame.key_frame;
+    }
+    else {
+        media_frame->fmt.media_type = MainMediaType::kMainTypeAudio;
+        AudioFormat& audio_fmt = media_frame->fmt.sub_fmt.audio_fmt;
+        audio_fmt.type = SubMediaType::kSubTypeOpus;
+        audio_fmt.nbytes_per_sample = 0;
+        audio_fmt.samples_per_channel = OpusSamplesPerChannel(frame.data);
+        audio_fmt.channels = (!frame.data.empty() && (frame.data[0] & 0x04)) ? 2 : 1;
+        audio_fmt.samples_per_sec = 48000;
+        audio_fmt.total_delay_ms = 0;
+        audio_fmt.key_pressed = false;
+    }
+    return media_frame;
+}
+
+ScopedEncodedImage::ScopedEncodedImage(const webrtc::EncodedImage& image) :
+    previous_(current_encoded_image)
+{
+    current_encoded_image = &image;
+}
+
+ScopedEncodedImage::~ScopedEncodedImage() {
+    current_encoded_image = previous_;
+}
+
+const webrtc::EncodedImage* ScopedEncodedImage::Current() {
+    return current_encoded_image;
+}
+
+EncodedFrameTap::EncodedFrameTap(bool video) :
+    video_(video)
+{
+}
+
+EncodedFrameTap::~EncodedFrameTap() = default;
+
+void EncodedFrameTap::AddObserver(EncodedFrameObserver* observer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::find(observers_.begin(), observers_.end(), observer) == observers_.end()) {
+        observers_.push_back(observer);
+    }
+}
+
+void EncodedFrameTap::RemoveObserver(EncodedFrameObserver* observer) {
+    // Waits for a frame being shown to the observer, it may go away after.
+    std::lock_guard<std::mutex> lock(mutex_);
+    observers_.erase(std::remove(observers_.begin(), observers_.end(), observer),
+        observers_.end());
+}
+
+void EncodedFrameTap::Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) {
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!observers_.empty()) {
+            TappedFrame tapped;
+            tapped.video = video_;
+            tapped.rtp_timestamp = frame->GetTimestamp();
+            tapped.ssrc = frame->GetSsrc();
+            tapped.data = frame->GetData();
+            // Audio frames are all independent.
+            tapped.key_frame = true;
+            if (video_) {
+                auto* video_frame =
+                    static_cast<webrtc::TransformableVideoFrameInterface*>(frame.get());
+                webrtc::VideoFrameMetadata metadata = video_frame->GetMetadata();
+                tapped.key_frame = video_frame->IsKeyFrame();
+                tapped.width = metadata.GetWidth();
+                tapped.height = metadata.GetHeight();
+
+                const webrtc::EncodedImage* encoded_image = ScopedEncodedImage::Current();
+                if (encoded_image) {
+                    tapped.capture_time_ms = encoded_image->capture_time_ms_;
+                    // The packetizer's frame shares the encoder's buffer.
+                    rtc::scoped_refptr<webrtc::EncodedImageBufferInterface> buffer =
+                        encoded_image->GetEncodedData();
+                    if (buffer && tapped.data.data() >= buffer->data() &&
+                        tapped.data.data() + tapped.data.size() <= buffer->data() + buffer->size()) {
+                        tapped.buffer = buffer;
+                    }
+                }
+            }
+            for (EncodedFrameObserver* observer : observers_) {
+                observer->OnEncodedFrame(tapped);
+            }
+        }
+
+        auto iter = sink_callbacks_.find(frame->GetSsrc());
+        callback = iter != sink_callbacks_.end() ? iter->second : callback_;
+    }
+
+    if (callback) {
+        callback->OnTransformedFrame(std::move(frame));
+    }
+}
+
+void EncodedFrameTap::RegisterTransformedFrameCallback(
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+}
+
+void EncodedFrameTap::RegisterTransformedFrameSinkCallback(
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+    uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    sink_callbacks_[ssrc] = callback;
+}
+
+void EncodedFrameTap::UnregisterTransformedFrameCallback() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = nullptr;
+}
+
+void EncodedFrameTap::UnregisterTransformedFrameSinkCallback(uint32_t ssrc) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sink_callbacks_.erase(ssrc);
+}
+
+} // namespace krtc
@@ -0,0 +1,97 @@
+#ifndef KRTCSDK_KRTC_MEDIA_ENCODED_FRAME_TAP_H_
+#define KRTCSDK_KRTC_MEDIA_ENCODED_FRAME_TAP_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <api/array_view.h>
+#include <api/frame_transformer_interface.h>
+#include <api/scoped_refptr.h>
+#include <api/video/encoded_image.h>
+
+namespace krtc {
+
+// One encoded frame as it passes between encoder and packetizer, or
+// depacketizer and decoder. data is only valid during the call.
+struct TappedFrame {
+    bool video = false;
+    bool key_frame = false;
+    uint32_t rtp_timestamp = 0;
+    uint32_t ssrc = 0;
+    int width = 0;           // video
+    int height = 0;
+    // Sender side video, from the encoder. -1 when not known: rtp_timestamp
+    // has the sender's random start offset added and tells nothing.
+    int64_t capture_time_ms = -1;
+    rtc::ArrayView<const uint8_t> data;
+    // Sender side video, the encoder's buffer data lies in. A reference keeps
+    // data valid past the call, the encoders' pools reuse a buffer only once
+    // nobody else holds it.
+    rtc::scoped_refptr<webrtc::EncodedImageBufferInterface> buffer;
+};
+
+class MediaFrame;
+
+// H.264 / Opus MediaFrame the app may keep. References frame.buffer when
+// set, otherwise (audio, receive side) holds a copy of frame.data.
+std::shared_ptr<MediaFrame> WrapEncodedFrame(const TappedFrame& frame, int64_t capture_time_ms);
+
+// The packetizer runs the sender's frame transformer from inside the
+// encoder's encoded image callback, on the same thread. The encoder side
+// opens this scope around the callback so the tap can tell the capture time
+// and the buffer of the frame it sees.
+class ScopedEncodedImage {
+public:
+    explicit ScopedEncodedImage(const webrtc::EncodedImage& image);
+    ~ScopedEncodedImage();
+
+    // Null outside a scope.
+    static const webrtc::EncodedImage* Current();
+
+private:
+    const webrtc::EncodedImage* previous_;
+};
+
+class EncodedFrameObserver {
+public:
+    virtual ~EncodedFrameObserver() {}
+
+    // On the encoder or decoder thread, keep it short.
+    virtual void OnEncodedFrame(const TappedFrame& frame) = 0;
+};
+
+// Frame transformer that changes nothing, it shows every frame to its
+// observers and hands it straight back. One per sender or receiver, the
+// media kind cannot be told from the frame without rtti.
+class EncodedFrameTap : public webrtc::FrameTransformerInterface {
+public:
+    explicit EncodedFrameTap(bool video);
+    ~EncodedFrameTap() override;
+
+    void AddObserver(EncodedFrameObserver* observer);
+    void RemoveObserver(EncodedFrameObserver* observer);
+
+    // webrtc::FrameTransformerInterface
+    void Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) override;
+    void RegisterTransformedFrameCallback(
+        rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) override;
+    void RegisterTransformedFrameSinkCallback(
+        rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+        uint32_t ssrc) override;
+    void UnregisterTransformedFrameCallback() override;
+    void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override;
+
+private:
+    const bool video_;
+
+    std::mutex mutex_;
+    std::vector<EncodedFrameObserver*> observers_;
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback_;
+    std::map<uint32_t, rtc::scoped_refptr<webrtc::TransformedFrameCallback>> sink_callbacks_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_MEDIA_ENCODED_FRAME_TAP_H_
@@ -0,0 +1,646 @@
+#include "krtc/media/fmp4_muxer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <common_video/h264/sps_parser.h>
+
+namespace krtc {
+
+namespace {
+
+const uint32_t kVideoTrackId = 1;
+const uint32_t kAudioTrackId = 2;
+const uint32_t kVideoTimescale = 90000;
+const uint32_t kOpusTimescale = 48000;
+
+// Used for the last frame of a track when it is also the only one.
+const int64_t kDefaultVideoDuration = 3000;  // 30 fps
+const int64_t kDefaultAudioDuration = 960;   // 20 ms
+
+// Decoder delay of libopus at 48 kHz, what Chrome's MediaRecorder writes.
+const uint16_t kOpusPreSkip = 312;
+
+// trun sample_flags.
+const uint32_t kSyncSampleFlags = 0x02000000;      // depends on nothing
+const uint32_t kNonSyncSampleFlags = 0x01010000;   // depends on others, non sync
+
+const uint32_t kUnityMatrix[9] = {
+    0x00010000, 0, 0,
+    0, 0x00010000, 0,
+    0, 0, 0x40000000,
+};
+
+} // namespace
+
+Fmp4Muxer::Fmp4Muxer() : Fmp4Muxer(Config()) {}
+
+Fmp4Muxer::Fmp4Muxer(const Config& config) :
+    config_(config)
+{
+    video_.id = kVideoTrackId;
+    video_.timescale = kVideoTimescale;
+    audio_.id = kAudioTrackId;
+    audio_.timescale = kOpusTimescale;
+}
+
+Fmp4Muxer::~Fmp4Muxer() = default;
+
+void Fmp4Muxer::AddVideoFrame(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+    bool key_frame, int64_t arrival_ms)
+{
+    if (!config_.video || (started_ && !video_.enabled)) {
+        return;
+    }
+
+    nal_units_.Build(data, size);
+    if (!nal_units_.has_picture()) {
+        return;
+    }
+    key_frame |= nal_units_.is_idr();
+
+    if (key_frame) {
+        for (const NalUnitIndex::NalUnit& unit : nal_units_.units()) {
+            const uint8_t* payload = data + unit.payload_offset;
+            if (unit.type == NalUnitIndex::kSps && unit.payload_size > 4) {
+                sps_.assign(payload, payload + unit.payload_size);
+                absl::optional<webrtc::SpsParser::SpsState> sps =
+                    webrtc::SpsParser::ParseSps(payload + 1, unit.payload_size - 1);
+                if (sps) {
+                    width_ = (int)sps->width;
+                    height_ = (int)sps->height;
+                }
+            }
+            else if (unit.type == NalUnitIndex::kPps && unit.payload_size > 1) {
+                pps_.assign(payload, payload + unit.payload_size);
+            }
+        }
+    }
+
+    // Nothing decodes before the first key frame and its parameter sets.
+    if (!started_ && (!key_frame || sps_.empty())) {
+        stats_.dropped_frames++;
+        return;
+    }
+
+    int64_t time = UnwrapTime(&video_, rtp_timestamp);
+    bool fragment_due = started_ && FragmentDue(video_, time, key_frame);
+
+    Sample sample;
+    sample.offset = video_.data.size();
+    AppendAvcc(data);
+    sample.size = (uint32_t)(video_.data.size() - sample.offset);
+    sample.time = time;
+    sample.arrival_ms = arrival_ms;
+    sample.key_frame = key_frame;
+    if (started_ && video_.samples.empty() && video_.origin == std::numeric_limits<int64_t>::min()) {
+        video_.origin = time - (arrival_ms - start_arrival_ms_) * video_.timescale / 1000;
+    }
+    video_.samples.push_back(sample);
+    stats_.video_frames++;
+
+    if (fragment_due) {
+        WriteFragment(false);
+    }
+    if (!started_ && ReadyToStart()) {
+        Start();
+    }
+}
+
+void Fmp4Muxer::AddAudioFrame(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+    int64_t arrival_ms)
+{
+    if (!config_.audio || size == 0) {
+        return;
+    }
+
+    if (!started_ && audio_.samples.empty()) {
+        // Stereo flag of the TOC byte, webrtc sends stereo only when asked to.
+        audio_channels_ = (data[0] & 0x04) ? 2 : 1;
+    }
+
+    int64_t time = UnwrapTime(&audio_, rtp_timestamp);
+    // With video the fragments follow its key frames, audio only cuts when
+    // video stalls (camera muted).
+    bool fragment_due = started_ && FragmentDue(audio_, time, !video_.enabled);
+
+    Sample sample;
+    sample.offset = audio_.data.size();
+    audio_.data.insert(audio_.data.end(), data, data + size);
+    sample.size = (uint32_t)size;
+    sample.time = time;
+    sample.arrival_ms = arrival_ms;
+    sample.key_frame = true;
+    if (started_ && audio_.samples.empty() && audio_.origin == std::numeric_limits<int64_t>::min()) {
+        audio_.origin = time - (arrival_ms - start_arrival_ms_) * audio_.timescale / 1000;
+    }
+    audio_.samples.push_back(sample);
+    stats_.audio_frames++;
+
+    if (fragment_due) {
+        WriteFragment(false);
+    }
+    if (!started_) {
+        TrimPreroll();
+        if (ReadyToStart()) {
+            Start();
+        }
+    }
+}
+
+void Fmp4Muxer::Finish() {
+    if (!started_) {
+        if (video_.samples.empty() && audio_.samples.empty()) {
+            return;
+        }
+        Start();
+    }
+    WriteFragment(true);
+}
+
+int64_t Fmp4Muxer::UnwrapTime(Track* track, uint32_t rtp_timestamp) {
+    if (!track->has_time) {
+        track->has_time = true;
+        track->last_rtp_timestamp = rtp_timestamp;
+        track->last_time = 0;
+        return 0;
+    }
+
+    track->last_time += (int32_t)(rtp_timestamp - track->last_rtp_timestamp);
+    track->last_rtp_timestamp = rtp_timestamp;
+    return track->last_time;
+}
+
+void Fmp4Muxer::AppendAvcc(const uint8_t* data) {
+    // Length prefixed NAL units. Parameter sets stay in band (avc3), the
+    // resolution may change mid recording.
+    for (const NalUnitIndex::NalUnit& unit : nal_units_.units()) {
+        if (unit.type == NalUnitIndex::kAud || unit.payload_size == 0) {
+            continue;
+        }
+        uint32_t length = (uint32_t)unit.payload_size;
+        uint8_t prefix[4] = { (uint8_t)(length >> 24), (uint8_t)(length >> 16),
+            (uint8_t)(length >> 8), (uint8_t)length };
+        video_.data.insert(video_.data.end(), prefix, prefix + 4);
+        video_.data.insert(video_.data.end(), data + unit.payload_offset,
+            data + unit.payload_offset + unit.payload_size);
+    }
+}
+
+void Fmp4Muxer::TrimPreroll() {
+    if (audio_.samples.empty()) {
+        return;
+    }
+
+    int64_t max_preroll = (int64_t)config_.max_preroll_ms * audio_.timescale / 1000;
+    size_t trimmed = 0;
+    while (trimmed < audio_.samples.size() &&
+        audio_.samples.back().time - audio_.samples[trimmed].time > max_preroll)
+    {
+        trimmed++;
+    }
+    if (trimmed == 0) {
+        return;
+    }
+
+    size_t bytes = audio_.samples[trimmed].offset;
+    audio_.data.erase(audio_.data.begin(), audio_.data.begin() + bytes);
+    audio_.samples.erase(audio_.samples.begin(), audio_.samples.begin() + trimmed);
+    for (Sample& sample : audio_.samples) {
+        sample.offset -= bytes;
+    }
+    stats_.dropped_frames += trimmed;
+}
+
+bool Fmp4Muxer::ReadyToStart() const {
+    if (config_.video) {
+        return !video_.samples.empty();
+    }
+    return !audio_.samples.empty();
+}
+
+void Fmp4Muxer::Start() {
+    started_ = true;
+    video_.enabled = config_.video && !sps_.empty();
+    audio_.enabled = config_.audio;
+
+    // Decode time 0 is the first frame of either track, the other starts
+    // as much later as it arrived later.
+    start_arrival_ms_ = std::numeric_limits<int64_t>::max();
+    for (Track* track : { &video_, &audio_ }) {
+        if (!track->samples.empty()) {
+            start_arrival_ms_ = std::min(start_arrival_ms_, track->samples[0].arrival_ms);
+        }
+    }
+    for (Track* track : { &video_, &audio_ }) {
+        if (track->samples.empty()) {
+            track->origin = std::numeric_limits<int64_t>::min();
+            continue;
+        }
+        const Sample& first = track->samples[0];
+        track->origin = first.time -
+            (first.arrival_ms - start_arrival_ms_) * track->timescale / 1000;
+    }
+
+    if (!video_.enabled) {
+        stats_.dropped_frames += video_.samples.size();
+        video_.samples.clear();
+        video_.data.clear();
+    }
+
+    WriteInitSegment();
+}
+
+bool Fmp4Muxer::FragmentDue(const Track& track, int64_t time, bool key_frame) const {
+    if (track.samples.empty()) {
+        return false;
+    }
+    int64_t elapsed_ms = (time - track.samples.front().time) * 1000 / track.timescale;
+    int64_t duration_ms = config_.fragment_duration_ms;
+    return (key_frame && elapsed_ms >= duration_ms) || elapsed_ms >= 4 * duration_ms;
+}
+
+void Fmp4Muxer::WriteFragment(bool final) {
+    Track* tracks[2] = { &video_, &audio_ };
+    size_t counts[2] = { 0, 0 };
+    for (int i = 0; i < 2; ++i) {
+        // The last frame's duration comes with the next one.
+        size_t queued = tracks[i]->samples.size();
+        counts[i] = final ? queued : (queued > 0 ? queued - 1 : 0);
+    }
+    if (counts[0] + counts[1] == 0) {
+        return;
+    }
+
+    size_t moof = BeginBox("moof");
+    size_t mfhd = BeginFullBox("mfhd", 0, 0);
+    Write32(++sequence_number_);
+    EndBox(mfhd);
+
+    size_t data_offset_fields[2] = { 0, 0 };
+    for (int i = 0; i < 2; ++i) {
+        Track& track = *tracks[i];
+        size_t count = counts[i];
+        if (count == 0) {
+            continue;
+        }
+
+        size_t traf = BeginBox("traf");
+        size_t tfhd = BeginFullBox("tfhd", 0, 0x020000);  // default-base-is-moof
+        Write32(track.id);
+        EndBox(tfhd);
+
+        size_t tfdt = BeginFullBox("tfdt", 1, 0);
+        Write64((uint64_t)std::max<int64_t>(0, track.samples[0].time - track.origin));
+        EndBox(tfdt);
+
+        // data-offset, sample-duration, sample-size, sample-flags present.
+        size_t trun = BeginFullBox("trun", 0, 0x000701);
+        Write32((uint32_t)count);
+        data_offset_fields[i] = output_.size();
+        Write32(0);
+        for (size_t n = 0; n < count; ++n) {
+            const Sample& sample = track.samples[n];
+            int64_t duration = track.last_duration;
+            if (n + 1 < track.samples.size()) {
+                duration = std::max<int64_t>(1, track.samples[n + 1].time - sample.time);
+            }
+            else if (duration <= 0) {
+                duration = track.id == kVideoTrackId ? kDefaultVideoDuration : kDefaultAudioDuration;
+            }
+            track.last_duration = duration;
+
+            Write32((uint32_t)duration);
+            Write32(sample.size);
+            Write32(sample.key_frame ? kSyncSampleFlags : kNonSyncSampleFlags);
+        }
+        EndBox(trun);
+        EndBox(traf);
+    }
+    EndBox(moof);
+
+    size_t mdat = BeginBox("mdat");
+    for (int i = 0; i < 2; ++i) {
+        Track& track = *tracks[i];
+        size_t count = counts[i];
+        if (count == 0) {
+            continue;
+        }
+
+        Patch32(data_offset_fields[i], (uint32_t)(output_.size() - moof));
+        size_t bytes = track.samples[count - 1].offset + track.samples[count - 1].size;
+        WriteBytes(track.data.data(), bytes);
+
+        track.data.erase(track.data.begin(), track.data.begin() + bytes);
+        track.samples.erase(track.samples.begin(), track.samples.begin() + count);
+        for (Sample& sample : track.samples) {
+            sample.offset -= bytes;
+        }
+    }
+    EndBox(mdat);
+
+    stats_.fragments++;
+}
+
+void Fmp4Muxer::WriteInitSegment() {
+    size_t ftyp = BeginBox("ftyp");
+    WriteBytes("iso6", 4);
+    Write32(0);
+    WriteBytes("iso6", 4);
+    WriteBytes("isom", 4);
+    WriteBytes("mp41", 4);
+    EndBox(ftyp);
+
+    size_t moov = BeginBox("moov");
+
+    size_t mvhd = BeginFullBox("mvhd", 0, 0);
+    Write32(0);             // creation_time
+    Write32(0);             // modification_time
+    Write32(1000);          // timescale
+    Write32(0);             // duration, unknown for fragmented files
+    Write32(0x00010000);    // rate 1.0
+    Write16(0x0100);        // volume 1.0
+    WriteZeros(2 + 8);
+    for (uint32_t value : kUnityMatrix) {
+        Write32(value);
+    }
+    WriteZeros(6 * 4);
+    Write32(kAudioTrackId + 1);  // next_track_ID
+    EndBox(mvhd);
+
+    if (video_.enabled) {
+        WriteVideoTrack();
+    }
+    if (audio_.enabled) {
+        WriteAudioTrack();
+    }
+
+    size_t mvex = BeginBox("mvex");
+    for (Track* track : { &video_, &audio_ }) {
+        if (!track->enabled) {
+            continue;
+        }
+        size_t trex = BeginFullBox("trex", 0, 0);
+        Write32(track->id);
+        Write32(1);         // default_sample_description_index
+        Write32(0);
+        Write32(0);
+        Write32(0);
+        EndBox(trex);
+    }
+    EndBox(mvex);
+
+    EndBox(moov);
+}
+
+void Fmp4Muxer::WriteVideoTrack() {
+    size_t trak = BeginBox("trak");
+
+    size_t tkhd = BeginFullBox("tkhd", 0, 0x000003);  // enabled, in movie
+    Write32(0);
+    Write32(0);
+    Write32(video_.id);
+    Write32(0);
+    Write32(0);             // duration
+    WriteZeros(8);
+    Write16(0);             // layer
+    Write16(0);             // alternate_group
+    Write16(0);             // volume
+    Write16(0);
+    for (uint32_t value : kUnityMatrix) {
+        Write32(value);
+    }
+    Write32((uint32_t)width_ << 16);
+    Write32((uint32_t)height_ << 16);
+    EndBox(tkhd);
+
+    size_t mdia = BeginBox("mdia");
+    size_t mdhd = BeginFullBox("mdhd", 0, 0);
+    Write32(0);
+    Write32(0);
+    Write32(video_.timescale);
+    Write32(0);
+    Write16(0x55c4);        // "und"
+    Write16(0);
+    EndBox(mdhd);
+
+    size_t hdlr = BeginFullBox("hdlr", 0, 0);
+    Write32(0);
+    WriteBytes("vide", 4);
+    WriteZeros(12);
+    WriteBytes("VideoHandler", 13);
+    EndBox(hdlr);
+
+    size_t minf = BeginBox("minf");
+    size_t vmhd = BeginFullBox("vmhd", 0, 1);
+    WriteZeros(8);
+    EndBox(vmhd);
+
+    size_t dinf = BeginBox("dinf");
+    size_t dref = BeginFullBox("dref", 0, 0);
+    Write32(1);
+    EndBox(BeginFullBox("url ", 0, 1));  // media in this file
+    EndBox(dref);
+    EndBox(dinf);
+
+    size_t stbl = BeginBox("stbl");
+    size_t stsd = BeginFullBox("stsd", 0, 0);
+    Write32(1);
+
+    size_t avc3 = BeginBox("avc3");
+    WriteZeros(6);
+    Write16(1);             // data_reference_index
+    WriteZeros(16);
+    Write16((uint16_t)width_);
+    Write16((uint16_t)height_);
+    Write32(0x00480000);    // 72 dpi
+    Write32(0x00480000);
+    Write32(0);
+    Write16(1);             // frame_count
+    WriteZeros(32);         // compressorname
+    Write16(0x0018);        // depth
+    Write16(0xffff);
+
+    size_t avcc = BeginBox("avcC");
+    Write8(1);
+    Write8(sps_[1]);        // profile_idc
+    Write8(sps_[2]);        // constraint flags
+    Write8(sps_[3]);        // level_idc
+    Write8(0xff);           // 4 byte NAL unit lengths
+    Write8(0xe1);           // one sps
+    Write16((uint16_t)sps_.size());
+    WriteBytes(sps_.data(), sps_.size());
+    Write8(pps_.empty() ? 0 : 1);
+    if (!pps_.empty()) {
+        Write16((uint16_t)pps_.size());
+        WriteBytes(pps_.data(), pps_.size());
+    }
+    EndBox(avcc);
+    EndBox(avc3);
+    EndBox(stsd);
+
+    // Samples are all in the fragments.
+    for (const char* type : { "stts", "stsc", "stco" }) {
+        size_t box = BeginFullBox(type, 0, 0);
+        Write32(0);
+        EndBox(box);
+    }
+    size_t stsz = BeginFullBox("stsz", 0, 0);
+    Write32(0);
+    Write32(0);
+    EndBox(stsz);
+    EndBox(stbl);
+
+    EndBox(minf);
+    EndBox(mdia);
+    EndBox(trak);
+}
+
+void Fmp4Muxer::WriteAudioTrack() {
+    size_t trak = BeginBox("trak");
+
+    size_t tkhd = BeginFullBox("tkhd", 0, 0x000003);
+    Write32(0);
+    Write32(0);
+    Write32(audio_.id);
+    Write32(0);
+    Write32(0);
+    WriteZeros(8);
+    Write16(0);
+    Write16(1);             // alternate_group
+    Write16(0x0100);        // volume 1.0
+    Write16(0);
+    for (uint32_t value : kUnityMatrix) {
+        Write32(value);
+    }
+    Write32(0);
+    Write32(0);
+    EndBox(tkhd);
+
+    size_t mdia = BeginBox("mdia");
+    size_t mdhd = BeginFullBox("mdhd", 0, 0);
+    Write32(0);
+    Write32(0);
+    Write32(audio_.timescale);
+    Write32(0);
+    Write16(0x55c4);
+    Write16(0);
+    EndBox(mdhd);
+
+    size_t hdlr = BeginFullBox("hdlr", 0, 0);
+    Write32(0);
+    WriteBytes("soun", 4);
+    WriteZeros(12);
+    WriteBytes("SoundHandler", 13);
+    EndBox(hdlr);
+
+    size_t minf = BeginBox("minf");
+    size_t smhd = BeginFullBox("smhd", 0, 0);
+    Write16(0);             // balance
+    Write16(0);
+    EndBox(smhd);
+
+    size_t dinf = BeginBox("dinf");
+    size_t dref = BeginFullBox("dref", 0, 0);
+    Write32(1);
+    EndBox(BeginFullBox("url ", 0, 1));
+    EndBox(dref);
+    EndBox(dinf);
+
+    size_t stbl = BeginBox("stbl");
+    size_t stsd = BeginFullBox("stsd", 0, 0);
+    Write32(1);
+
+    size_t opus = BeginBox("Opus");
+    WriteZeros(6);
+    Write16(1);             // data_reference_index
+    WriteZeros(8);
+    Write16(audio_channels_);
+    Write16(16);            // samplesize
+    Write16(0);
+    Write16(0);
+    Write32(kOpusTimescale << 16);
+
+    size_t dops = BeginBox("dOps");
+    Write8(0);              // version
+    Write8(audio_channels_);
+    Write16(kOpusPreSkip);
+    Write32(kOpusTimescale);  // input sample rate
+    Write16(0);             // output gain
+    Write8(0);              // channel mapping family
+    EndBox(dops);
+    EndBox(opus);
+    EndBox(stsd);
+
+    for (const char* type : { "stts", "stsc", "stco" }) {
+        size_t box = BeginFullBox(type, 0, 0);
+        Write32(0);
+        EndBox(box);
+    }
+    size_t stsz = BeginFullBox("stsz", 0, 0);
+    Write32(0);
+    Write32(0);
+    EndBox(stsz);
+    EndBox(stbl);
+
+    EndBox(minf);
+    EndBox(mdia);
+    EndBox(trak);
+}
+
+size_t Fmp4Muxer::BeginBox(const char* type) {
+    size_t offset = output_.size();
+    Write32(0);
+    WriteBytes(type, 4);
+    return offset;
+}
+
+size_t Fmp4Muxer::BeginFullBox(const char* type, uint8_t version, uint32_t flags) {
+    size_t offset = BeginBox(type);
+    Write32(((uint32_t)version << 24) | (flags & 0xffffff));
+    return offset;
+}
+
+void Fmp4Muxer::EndBox(size_t offset) {
+    Patch32(offset, (uint32_t)(output_.size() - offset));
+}
+
+void Fmp4Muxer::Write8(uint8_t value) {
+    output_.push_back(value);
+}
+
+void Fmp4Muxer::Write16(uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+    output_.insert(output_.end(), bytes, bytes + 2);
+}
+
+void Fmp4Muxer::Write32(uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16),
+        (uint8_t)(value >> 8), (uint8_t)value };
+    output_.insert(output_.end(), bytes, bytes + 4);
+}
+
+void Fmp4Muxer::Write64(uint64_t value) {
+    Write32((uint32_t)(value >> 32));
+    Write32((uint32_t)value);
+}
+
+void Fmp4Muxer::WriteBytes(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    output_.insert(output_.end(), bytes, bytes + size);
+}
+
+void Fmp4Muxer::WriteZeros(size_t size) {
+    output_.insert(output_.end(), size, 0);
+}
+
+void Fmp4Muxer::Patch32(size_t offset, uint32_t value) {
+    output_[offset] = (uint8_t)(value >> 24);
+    output_[offset + 1] = (uint8_t)(value >> 16);
+    output_[offset + 2] = (uint8_t)(value >> 8);
+    output_[offset + 3] = (uint8_t)value;
+}
+
+} // namespace krtc
@@ -0,0 +1,130 @@
+#ifndef KRTCSDK_KRTC_MEDIA_FMP4_MUXER_H_
+#define KRTCSDK_KRTC_MEDIA_FMP4_MUXER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "krtc/codec/nal_unit_index.h"
+
+namespace krtc {
+
+// Fragmented mp4 (ISO BMFF) of one H.264 and one Opus track, from the
+// encoded frames as they go to or come from the rtp layer. Only complete
+// boxes are ever put in output(): the init segment, then one moof + mdat
+// per fragment, so a file cut off by a crash plays up to its last fragment.
+// Does no IO and is not thread safe.
+class Fmp4Muxer {
+public:
+    struct Config {
+        bool video = true;
+        bool audio = true;
+        // A fragment ends at the first video key frame after this, or at 4
+        // times this without one. Audio only fragments end at this.
+        uint32_t fragment_duration_ms = 1000;
+        // Audio kept while waiting for the first video key frame.
+        uint32_t max_preroll_ms = 2000;
+    };
+
+    struct Stats {
+        int64_t video_frames = 0;
+        int64_t audio_frames = 0;
+        int64_t dropped_frames = 0;  // video before the first key frame, audio past the preroll
+        int64_t fragments = 0;
+    };
+
+    Fmp4Muxer();
+    explicit Fmp4Muxer(const Config& config);
+    ~Fmp4Muxer();
+
+    // H.264 Annex B access unit, rtp clock (90 kHz). arrival_ms lines the
+    // tracks up against each other.
+    void AddVideoFrame(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+        bool key_frame, int64_t arrival_ms);
+    // One Opus packet, rtp clock (48 kHz).
+    void AddAudioFrame(const uint8_t* data, size_t size, uint32_t rtp_timestamp,
+        int64_t arrival_ms);
+
+    // Writes out what is left, the last frame of each track lasts as long
+    // as the one before it.
+    void Finish();
+
+    // Complete boxes made so far. Append to the file and clear.
+    std::vector<uint8_t>* output() { return &output_; }
+
+    bool started() const { return started_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Sample {
+        size_t offset = 0;
+        uint32_t size = 0;
+        int64_t time = 0;        // rtp, unwrapped
+        int64_t arrival_ms = 0;
+        bool key_frame = false;
+    };
+
+    struct Track {
+        uint32_t id = 0;
+        uint32_t timescale = 0;
+        bool enabled = false;
+        bool has_time = false;
+        uint32_t last_rtp_timestamp = 0;
+        int64_t last_time = 0;
+        int64_t origin = 0;      // decode time 0 in the unwrapped rtp clock
+        int64_t last_duration = 0;
+        std::vector<Sample> samples;
+        std::vector<uint8_t> data;
+    };
+
+    int64_t UnwrapTime(Track* track, uint32_t rtp_timestamp);
+    void AppendAvcc(const uint8_t* data);
+    void TrimPreroll();
+    bool ReadyToStart() const;
+    void Start();
+    // Ends the fragment at a frame of track at time, false when it is not
+    // time to.
+    bool FragmentDue(const Track& track, int64_t time, bool key_frame) const;
+    // Writes the samples of both tracks with a known duration. final: the
+    // last ones too.
+    void WriteFragment(bool final);
+
+    void WriteInitSegment();
+    void WriteVideoTrack();
+    void WriteAudioTrack();
+
+    // Big endian box writing into output_.
+    size_t BeginBox(const char* type);
+    size_t BeginFullBox(const char* type, uint8_t version, uint32_t flags);
+    void EndBox(size_t offset);
+    void Write8(uint8_t value);
+    void Write16(uint16_t value);
+    void Write32(uint32_t value);
+    void Write64(uint64_t value);
+    void WriteBytes(const void* data, size_t size);
+    void WriteZeros(size_t size);
+    void Patch32(size_t offset, uint32_t value);
+
+    Config config_;
+    Track video_;
+    Track audio_;
+    NalUnitIndex nal_units_;
+
+    std::vector<uint8_t> sps_;
+    std::vector<uint8_t> pps_;
+    int width_ = 0;
+    int height_ = 0;
+    uint8_t audio_channels_ = 2;
+
+    bool started_ = false;
+    int64_t start_arrival_ms_ = 0;
+    uint32_t sequence_number_ = 0;
+
+    Stats stats_;
+    std::vector<uint8_t> output_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_MEDIA_FMP4_MUXER_H_
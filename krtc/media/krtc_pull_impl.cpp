@@ -32,6 +32,9 @@
 #include <rtc_base/strings/json.h>
 
 #include "krtc/media/default.h"
+#include "krtc/media/media_frame.h"
+#include "krtc/render/video_frame_converter.h"
+#include "krtc/render/gallery_renderer.h"
 #include "krtc/media/krtc_pull_impl.h"
 #include "krtc/base/krtc_global.h"
 
@@ -61,7 +64,8 @@ KRTCPullImpl::KRTCPullImpl(
     const std::string& server_addr,
     const std::string& pull_channel,
     const int& hwnd) :
-    KRTCMediaBase(CONTROL_TYPE::PULL, server_addr, pull_channel, hwnd)
+    KRTCMediaBase(CONTROL_TYPE::PULL, server_addr, pull_channel, hwnd),
+    video_type_(SubMediaType::kSubTypeI420)
 {
     KRTCGlobal::Instance()->http_manager()->AddObject(this);
 }
@@ -102,9 +106,109 @@ void KRTCPullImpl::Start() {
 void KRTCPullImpl::Stop() {
     RTC_LOG(LS_INFO) << "KRTCPullImpl Stop";
 
+    StopRecording();
+    audio_receiver_ = nullptr;
+    video_receiver_ = nullptr;
+
     peer_connection_ = nullptr;
     peer_connection_factory_ = nullptr;
     remote_renderer_ = nullptr;
+    gallery_sink_ = nullptr;
+}
+
+bool KRTCPullImpl::StartRecording(const std::string& file_path) {
+    if (!peer_connection_ || recorder_) {
+        return false;
+    }
+
+    // Before the answer the tracks are not known yet, expect both.
+    MediaRecorder::Config config;
+    if (audio_receiver_ || video_receiver_) {
+        config.muxer.video = video_receiver_ != nullptr;
+        config.muxer.audio = audio_receiver_ != nullptr;
+    }
+    recorder_ = MediaRecorder::Create(file_path, config);
+    if (!recorder_) {
+        return false;
+    }
+
+    if (video_receiver_) {
+        TapReceiver(video_receiver_);
+    }
+    if (audio_receiver_) {
+        TapReceiver(audio_receiver_);
+    }
+    return true;
+}
+
+void KRTCPullImpl::StopRecording() {
+    if (!recorder_) {
+        return;
+    }
+
+    if (video_tap_) {
+        video_tap_->RemoveObserver(recorder_.get());
+    }
+    if (audio_tap_) {
+        audio_tap_->RemoveObserver(recorder_.get());
+    }
+    recorder_->Stop();
+    recorder_ = nullptr;
+}
+
+bool KRTCPullImpl::GetRenderStats(uint64_t* delivered_frames, uint64_t* dropped_frames) {
+    if (!remote_renderer_) {
+        return false;
+    }
+
+    remote_renderer_->GetStats(delivered_frames, dropped_frames);
+    return true;
+}
+
+bool KRTCPullImpl::SetVideoFormat(SubMediaType type, int max_width, int max_height) {
+    if (!VideoFrameConverter::IsSupportedOutput(type, max_width, max_height)) {
+        return false;
+    }
+    if (remote_renderer_ && !remote_renderer_->SetOutputFormat(type, max_width, max_height)) {
+        return false;
+    }
+
+    video_type_ = type;
+    video_max_width_ = max_width;
+    video_max_height_ = max_height;
+    return true;
+}
+
+bool KRTCPullImpl::SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms) {
+    if (enable && (refresh_hz < 1 || refresh_hz > 240 || max_delay_ms < 0 || max_delay_ms > 500)) {
+        return false;
+    }
+    if (remote_renderer_ &&
+        !remote_renderer_->SetPresentationSmoothing(enable, refresh_hz, max_delay_ms))
+    {
+        return false;
+    }
+
+    smoothing_ = enable;
+    refresh_hz_ = refresh_hz;
+    max_delay_ms_ = max_delay_ms;
+    return true;
+}
+
+bool KRTCPullImpl::GetPresentationStats(double* interval_stddev_ms, int* delay_ms) {
+    return remote_renderer_ && remote_renderer_->GetPresentationStats(interval_stddev_ms, delay_ms);
+}
+
+void KRTCPullImpl::TapReceiver(webrtc::RtpReceiverInterface* receiver) {
+    // Installed with the first recording and kept, without observers the
+    // tap passes frames on untouched.
+    bool video = receiver->media_type() == cricket::MediaType::MEDIA_TYPE_VIDEO;
+    rtc::scoped_refptr<EncodedFrameTap>& tap = video ? video_tap_ : audio_tap_;
+    if (!tap) {
+        tap = new rtc::RefCountedObject<EncodedFrameTap>(video);
+        receiver->SetDepacketizerToDecoderFrameTransformer(tap);
+    }
+    tap->AddObserver(recorder_.get());
 }
 
 void KRTCPullImpl::GetRtcStats() {
@@ -129,7 +233,23 @@ void KRTCPullImpl::OnAddTrack(
         auto* video_track = static_cast<webrtc::VideoTrackInterface*>(track);
 
         remote_renderer_ = VideoRenderer::Create(CONTROL_TYPE::PULL, hwnd_, 1, 1);
+        remote_renderer_->SetOutputFormat(video_type_, video_max_width_, video_max_height_);
+        if (smoothing_) {
+            remote_renderer_->SetPresentationSmoothing(true, refresh_hz_, max_delay_ms_);
+        }
         video_track->AddOrUpdateSink(remote_renderer_.get(), rtc::VideoSinkWants());
+        gallery_sink_ = KRTCGlobal::Instance()->gallery()->CreateStreamSink();
+        if (gallery_sink_) {
+            video_track->AddOrUpdateSink(gallery_sink_.get(), rtc::VideoSinkWants());
+        }
+        video_receiver_ = receiver;
+    }
+    else {
+        audio_receiver_ = receiver;
+    }
+
+    if (recorder_) {
+        TapReceiver(receiver);
     }
 
     track->Release();
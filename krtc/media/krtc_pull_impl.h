@@ -14,6 +14,8 @@
 #include "krtc/render/video_renderer.h"
 #include "krtc/media/krtc_media_base.h"
 #include "krtc/base/krtc_http.h"
+#include "krtc/media/encoded_frame_tap.h"
+#include "krtc/media/media_recorder.h"
 
 namespace krtc {
 
@@ -36,8 +38,17 @@ public:
     void Start();
     void Stop();
 
+    bool StartRecording(const std::string& file_path);
+    void StopRecording();
+
+    bool GetRenderStats(uint64_t* delivered_frames, uint64_t* dropped_frames);
+    bool SetVideoFormat(SubMediaType type, int max_width, int max_height);
+    bool SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms);
+    bool GetPresentationStats(double* interval_stddev_ms, int* delay_ms);
+
 private:
     void GetRtcStats();
+    void TapReceiver(webrtc::RtpReceiverInterface* receiver);
 
     // PeerConnectionObserver implementation.
     void OnSignalingChange(
@@ -69,7 +80,21 @@ private:
 private:
     rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>peer_connection_factory_;
     std::unique_ptr<VideoRenderer> remote_renderer_;
-
+    // The tile of this stream while the gallery runs.
+    std::unique_ptr<rtc::VideoSinkInterface<webrtc::VideoFrame>> gallery_sink_;
+    // Kept for a renderer created after the call.
+    SubMediaType video_type_;
+    int video_max_width_ = 0;
+    int video_max_height_ = 0;
+    bool smoothing_ = false;
+    int refresh_hz_ = 60;
+    int max_delay_ms_ = 50;
+
+    rtc::scoped_refptr<webrtc::RtpReceiverInterface> audio_receiver_;
+    rtc::scoped_refptr<webrtc::RtpReceiverInterface> video_receiver_;
+    rtc::scoped_refptr<EncodedFrameTap> audio_tap_;
+    rtc::scoped_refptr<EncodedFrameTap> video_tap_;
+    std::shared_ptr<MediaRecorder> recorder_;
 };
 
 } // namespace krtc
@@ -42,4 +42,47 @@ void KRTCPuller::Destroy() {
     delete this;
 }
 
+bool KRTCPuller::StartRecording(const char* file_path) {
+    RTC_LOG(LS_INFO) << "KRTCPuller StartRecording";
+
+    // The receivers come and go on the api thread.
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return pull_impl_ && pull_impl_->StartRecording(file_path);
+    });
+}
+
+void KRTCPuller::StopRecording() {
+    RTC_LOG(LS_INFO) << "KRTCPuller StopRecording";
+
+    KRTCGlobal::Instance()->api_thread()->Invoke<void>(RTC_FROM_HERE, [&]() {
+        if (pull_impl_) {
+            pull_impl_->StopRecording();
+        }
+    });
+}
+
+bool KRTCPuller::GetRenderStats(uint64_t* delivered_frames, uint64_t* dropped_frames) {
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return pull_impl_ && pull_impl_->GetRenderStats(delivered_frames, dropped_frames);
+    });
+}
+
+bool KRTCPuller::SetPullVideoFormat(SubMediaType type, int max_width, int max_height) {
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return pull_impl_ && pull_impl_->SetVideoFormat(type, max_width, max_height);
+    });
+}
+
+bool KRTCPuller::SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms) {
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return pull_impl_ && pull_impl_->SetPresentationSmoothing(enable, refresh_hz, max_delay_ms);
+    });
+}
+
+bool KRTCPuller::GetPresentationStats(double* interval_stddev_ms, int* delay_ms) {
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return pull_impl_ && pull_impl_->GetPresentationStats(interval_stddev_ms, delay_ms);
+    });
+}
+
 } // namespace krtc
@@ -17,6 +17,14 @@ private:
     void SetEnableVideo(bool enable) {}
     void SetEnableAudio(bool enable) {}
 
+    bool StartRecording(const char* file_path);
+    void StopRecording();
+
+    bool GetRenderStats(uint64_t* delivered_frames, uint64_t* dropped_frames);
+    bool SetPullVideoFormat(SubMediaType type, int max_width, int max_height);
+    bool SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms);
+    bool GetPresentationStats(double* interval_stddev_ms, int* delay_ms);
+
 private:
     explicit KRTCPuller(const std::string& server_addr, const std::string& push_channel = "livestream", int hwnd = 0);
     ~KRTCPuller();
@@ -30,6 +30,7 @@
 #include <rtc_base/logging.h>
 #include <rtc_base/ref_counted_object.h>
 #include <rtc_base/strings/json.h>
+#include <rtc_base/time_utils.h>
 
 #include "krtc/media/default.h"
 #include "krtc/device/vcm_capturer.h"
@@ -79,6 +80,9 @@ void KRTCPushImpl::Start() {
         RTC_LOG(LS_ERROR) << "Failed to add audio track to PeerConnection: "
             << add_audio_track_result.error().message();
     }
+    else {
+        audio_sender_ = add_audio_track_result.value();
+    }
 
     video_track_ = peer_connection_factory->CreateVideoTrack(
         kVideoLabel, KRTCGlobal::Instance()->current_video_source());
@@ -88,19 +92,67 @@ void KRTCPushImpl::Start() {
             << add_video_track_result.error().message();
 
     }
+    else {
+        video_sender_ = add_video_track_result.value();
+        if (KRTCGlobal::Instance()->current_video_source() &&
+            KRTCGlobal::Instance()->current_video_source()->is_screencast())
+        {
+            ConfigureScreenContent(video_sender_);
+        }
+    }
 
     if (!add_audio_track_result.ok() && !add_video_track_result.ok()) {
         PushFailure(KRTCError::kAddTrackErr);
         return;
     }
 
+    // Before the offer, the send streams start with the taps in place.
+    if (KRTCGlobal::Instance()->encoded_frame_callback()) {
+        InstallFrameTaps();
+        if (video_tap_) {
+            video_tap_->AddObserver(this);
+        }
+        if (audio_tap_) {
+            audio_tap_->AddObserver(this);
+        }
+        encoded_frame_callback_ = true;
+    }
+
     peer_connection_->CreateOffer(
         this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
 
 }
 
+void KRTCPushImpl::ConfigureScreenContent(
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> sender)
+{
+    // Text has to stay sharp: keep the resolution and give up frame rate
+    // when the bandwidth drops.
+    video_track_->set_content_hint(webrtc::VideoTrackInterface::ContentHint::kText);
+
+    webrtc::RtpParameters parameters = sender->GetParameters();
+    parameters.degradation_preference = webrtc::DegradationPreference::MAINTAIN_RESOLUTION;
+    webrtc::RTCError error = sender->SetParameters(parameters);
+    if (!error.ok()) {
+        RTC_LOG(LS_WARNING) << "Failed to set screen content parameters: "
+            << error.message();
+    }
+}
+
 void KRTCPushImpl::Stop()
 {
+    StopRecording();
+
+    if (encoded_frame_callback_) {
+        if (video_tap_) {
+            video_tap_->RemoveObserver(this);
+        }
+        if (audio_tap_) {
+            audio_tap_->RemoveObserver(this);
+        }
+        encoded_frame_callback_ = false;
+    }
+
     if (stats_timer_) {
         stats_timer_->Stop();
         stats_timer_ = nullptr;
@@ -109,6 +161,82 @@ void KRTCPushImpl::Stop()
     if (peer_connection_) {
         peer_connection_ = nullptr;
     }
+    audio_sender_ = nullptr;
+    video_sender_ = nullptr;
+}
+
+bool KRTCPushImpl::StartRecording(const std::string& file_path)
+{
+    if (!peer_connection_ || recorder_) {
+        return false;
+    }
+
+    MediaRecorder::Config config;
+    config.muxer.video = video_sender_ != nullptr;
+    config.muxer.audio = audio_sender_ != nullptr;
+    recorder_ = MediaRecorder::Create(file_path, config);
+    if (!recorder_) {
+        return false;
+    }
+
+    // Setting a transformer restarts the video send stream, the recording
+    // starts with a key frame.
+    InstallFrameTaps();
+    if (video_tap_) {
+        video_tap_->AddObserver(recorder_.get());
+    }
+    if (audio_tap_) {
+        audio_tap_->AddObserver(recorder_.get());
+    }
+    return true;
+}
+
+void KRTCPushImpl::InstallFrameTaps()
+{
+    if (video_sender_ && !video_tap_) {
+        video_tap_ = new rtc::RefCountedObject<EncodedFrameTap>(true);
+        video_sender_->SetEncoderToPacketizerFrameTransformer(video_tap_);
+    }
+    if (audio_sender_ && !audio_tap_) {
+        audio_tap_ = new rtc::RefCountedObject<EncodedFrameTap>(false);
+        audio_sender_->SetEncoderToPacketizerFrameTransformer(audio_tap_);
+    }
+}
+
+void KRTCPushImpl::OnEncodedFrame(const TappedFrame& frame)
+{
+    KRTCEngineObserver* observer = KRTCGlobal::Instance()->engine_observer();
+    if (!observer) {
+        return;
+    }
+
+    // Video carries the capture time from the encoder. Audio is encoded
+    // right after it is captured.
+    int64_t capture_time_ms = frame.capture_time_ms >= 0 ? frame.capture_time_ms : rtc::TimeMillis();
+
+    std::shared_ptr<MediaFrame> media_frame = WrapEncodedFrame(frame, capture_time_ms);
+    if (frame.video) {
+        observer->OnEncodedVideoFrame(media_frame);
+    }
+    else {
+        observer->OnEncodedAudioFrame(media_frame);
+    }
+}
+
+void KRTCPushImpl::StopRecording()
+{
+    if (!recorder_) {
+        return;
+    }
+
+    if (video_tap_) {
+        video_tap_->RemoveObserver(recorder_.get());
+    }
+    if (audio_tap_) {
+        audio_tap_->RemoveObserver(recorder_.get());
+    }
+    recorder_->Stop();
+    recorder_ = nullptr;
 }
 
 void KRTCPushImpl::GetRtcStats() {
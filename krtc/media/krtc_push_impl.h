@@ -9,8 +9,11 @@
 #include <vector>
 
 #include <api/media_stream_interface.h>
+#include <api/rtp_sender_interface.h>
 
 #include "krtc/media/krtc_media_base.h"
+#include "krtc/media/encoded_frame_tap.h"
+#include "krtc/media/media_recorder.h"
 #include "krtc/media/stats_collector.h"
 #include "krtc/base/krtc_http.h"
 
@@ -21,7 +24,8 @@ namespace krtc {
 class KRTCPushImpl : public KRTCMediaBase,
                      public webrtc::PeerConnectionObserver,
                      public webrtc::CreateSessionDescriptionObserver,
-                     public StatsObserver
+                     public StatsObserver,
+                     public EncodedFrameObserver
 {
 public:
     explicit KRTCPushImpl(const std::string& server_addr, const std::string& push_channel = "");
@@ -34,6 +38,9 @@ public:
     void SetEnableVideo(bool enable = true);
     void SetEnableAudio(bool enable = true);
 
+    bool StartRecording(const std::string& file_path);
+    void StopRecording();
+
 private:
     // PeerConnectionObserver implementation.
     void OnSignalingChange(
@@ -57,14 +64,29 @@ private:
 
     void handleHttpPushResponse(const HttpReply& reply);
 
+    // EncodedFrameObserver implementation, feeds OnEncodedVideoFrame /
+    // OnEncodedAudioFrame.
+    void OnEncodedFrame(const TappedFrame& frame) override;
+
 private:
     void PushFailure(const KRTCError& err);
+    void ConfigureScreenContent(rtc::scoped_refptr<webrtc::RtpSenderInterface> sender);
+    void InstallFrameTaps();
 
     rtc::scoped_refptr<CRtcStatsCollector> stats_;
     std::unique_ptr<CTimer> stats_timer_;
 
     rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track_;
     rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track_;
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> audio_sender_;
+    rtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
+
+    // Installed with the first recording or encoded frame callback and
+    // kept, without observers they pass frames on untouched.
+    rtc::scoped_refptr<EncodedFrameTap> audio_tap_;
+    rtc::scoped_refptr<EncodedFrameTap> video_tap_;
+    std::shared_ptr<MediaRecorder> recorder_;
+    bool encoded_frame_callback_ = false;
 };
 
 } // namespace krtc
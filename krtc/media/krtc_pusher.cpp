@@ -55,4 +55,24 @@ void KRTCPusher::SetEnableAudio(bool enable)
     }
 }
 
+bool KRTCPusher::StartRecording(const char* file_path)
+{
+    RTC_LOG(LS_INFO) << "KRTCPusher StartRecording";
+
+    return KRTCGlobal::Instance()->api_thread()->Invoke<bool>(RTC_FROM_HERE, [&]() {
+        return push_impl_ && push_impl_->StartRecording(file_path);
+    });
+}
+
+void KRTCPusher::StopRecording()
+{
+    RTC_LOG(LS_INFO) << "KRTCPusher StopRecording";
+
+    KRTCGlobal::Instance()->api_thread()->Invoke<void>(RTC_FROM_HERE, [&]() {
+        if (push_impl_) {
+            push_impl_->StopRecording();
+        }
+    });
+}
+
 } // namespace krtc
@@ -17,6 +17,9 @@ private:
     void SetEnableVideo(bool enable = true);
     void SetEnableAudio(bool enable = true);
 
+    bool StartRecording(const char* file_path);
+    void StopRecording();
+
 private:
     explicit KRTCPusher(const std::string& server_addr, const std::string& push_channel = "livestream");
     ~KRTCPusher();
@@ -18,6 +18,9 @@ enum class SubMediaType {
     kSubTypeH264,
     kSubTypePcm,
     kSubTypeOpus,
+    kSubTypeNV12,
+    kSubTypeARGB,   // libyuv ARGB，内存中按B G R A排列
+    kSubTypeRGBA,   // 内存中按R G B A排列
 };
 
 struct AudioFormat {
@@ -55,17 +58,17 @@ public:
     }
 
     ~MediaFrame() {
-        if (data[0]) {
-            delete[] data[0];
-            data[0] = nullptr;
+        if (!external_data) {
+            for (int i = 0; i < 3; ++i) {
+                if (data[i]) {
+                    delete[] data[i];
+                    data[i] = nullptr;
+                }
+            }
         }
-        if (data[1]) {
-            delete[] data[1];
-            data[1] = nullptr;
-        }
-        if (data[2]) {
-            delete[] data[2];
-            data[2] = nullptr;
+        if (qp_delta_map) {
+            delete[] qp_delta_map;
+            qp_delta_map = nullptr;
         }
     }
 
@@ -77,6 +80,18 @@ public:
     int stride[4];               // 每一行的大小
     uint32_t ts = 0;             // 帧的时间戳
     int64_t capture_time_ms = 0; // 采集时间
+
+    // 可选，由OnPreprocessVideoFrame填写（new[]分配，随帧释放）。
+    // 每个16x16宏块一个QP偏移，按行存储，负值让编码器在该区域（如人脸）多花码率。
+    int8_t* qp_delta_map = nullptr;
+    int qp_map_width = 0;        // 每行宏块数
+    int qp_map_height = 0;       // 宏块行数
+
+    // data指向外部内存（如编码器输出的码流），不随帧释放。没有
+    // external_data_owner时只在回调期间有效，回调之后还要用的话请自行拷贝。
+    bool external_data = false;
+    // 持有data所在的内存（如缓冲池里的图像），帧释放时归还。
+    std::shared_ptr<void> external_data_owner;
 };
 
 } // namespace krtc
@@ -0,0 +1,247 @@
+#include "krtc/media/media_recorder.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/time_utils.h>
+
+namespace krtc {
+
+namespace {
+
+// How often the writer looks at every recording. Bounds what a crash can
+// take with it, together with the fragment duration.
+const int kWriteIntervalMs = 200;
+
+} // namespace
+
+// One thread for all recordings: each round swaps every recorder's queue
+// out and writes it with one fwrite.
+class MediaRecorder::Writer {
+public:
+    static Writer* Instance() {
+        static Writer writer;
+        return &writer;
+    }
+
+    void Add(const std::shared_ptr<MediaRecorder>& recorder) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recorders_.emplace_back(recorder.get(), recorder);
+        if (!thread_.joinable()) {
+            thread_ = std::thread([this]() { Run(); });
+        }
+    }
+
+    void Remove(MediaRecorder* recorder) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recorders_.erase(std::remove_if(recorders_.begin(), recorders_.end(),
+            [recorder](const Entry& entry) { return entry.first == recorder; }),
+            recorders_.end());
+    }
+
+    void Wake() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_ = true;
+        }
+        cond_.notify_one();
+    }
+
+private:
+    typedef std::pair<MediaRecorder*, std::weak_ptr<MediaRecorder>> Entry;
+
+    ~Writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void Run() {
+        std::vector<Entry> recorders;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!quit_) {
+            cond_.wait_for(lock, std::chrono::milliseconds(kWriteIntervalMs),
+                [this]() { return wake_ || quit_; });
+            wake_ = false;
+            recorders = recorders_;
+            lock.unlock();
+
+            for (const Entry& entry : recorders) {
+                // Keeps the recorder alive while it is written.
+                std::shared_ptr<MediaRecorder> recorder = entry.second.lock();
+                if (recorder) {
+                    recorder->WriteBatch(false);
+                }
+            }
+            recorders.clear();
+
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Entry> recorders_;
+    bool wake_ = false;
+    bool quit_ = false;
+    std::thread thread_;
+};
+
+std::shared_ptr<MediaRecorder> MediaRecorder::Create(const std::string& file_path,
+    const Config& config)
+{
+    FILE* file = fopen(file_path.c_str(), "wb");
+    if (!file) {
+        RTC_LOG(LS_WARNING) << "recorder cannot create " << file_path;
+        return nullptr;
+    }
+
+    std::shared_ptr<MediaRecorder> recorder(new MediaRecorder(file_path, config, file));
+    Writer::Instance()->Add(recorder);
+    RTC_LOG(LS_INFO) << "recording to " << file_path;
+    return recorder;
+}
+
+MediaRecorder::MediaRecorder(const std::string& file_path, const Config& config, FILE* file) :
+    file_path_(file_path),
+    config_(config),
+    muxer_(config.muxer),
+    file_(file)
+{
+}
+
+MediaRecorder::~MediaRecorder() {
+    Stop();
+}
+
+void MediaRecorder::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (stopped_) {
+            return;
+        }
+        stopped_ = true;
+    }
+
+    Writer::Instance()->Remove(this);
+    WriteBatch(true);
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    Stats stats = this->stats();
+    RTC_LOG(LS_INFO) << "recording " << file_path_ << " stopped, frames: " << stats.frames
+        << ", dropped: " << stats.dropped_frames << ", bytes: " << stats.bytes_written
+        << ", fragments: " << stats.fragments;
+}
+
+MediaRecorder::Stats MediaRecorder::stats() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return stats_;
+}
+
+void MediaRecorder::OnEncodedFrame(const TappedFrame& frame) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (stopped_) {
+            return;
+        }
+
+        // A delta frame after a gap would not decode.
+        if (frame.video && waiting_for_key_frame_ && !frame.key_frame) {
+            stats_.dropped_frames++;
+            return;
+        }
+        if (queued_.data.size() + frame.data.size() > config_.max_queued_bytes) {
+            stats_.dropped_frames++;
+            waiting_for_key_frame_ |= frame.video;
+            return;
+        }
+        if (frame.video) {
+            waiting_for_key_frame_ = false;
+        }
+
+        QueuedFrame queued;
+        queued.offset = queued_.data.size();
+        queued.size = (uint32_t)frame.data.size();
+        queued.rtp_timestamp = frame.rtp_timestamp;
+        queued.arrival_ms = rtc::TimeMillis();
+        queued.video = frame.video;
+        queued.key_frame = frame.key_frame;
+        queued_.data.insert(queued_.data.end(), frame.data.begin(), frame.data.end());
+        queued_.frames.push_back(queued);
+        stats_.frames++;
+
+        wake = queued_.data.size() >= config_.batch_bytes;
+    }
+
+    if (wake) {
+        Writer::Instance()->Wake();
+    }
+}
+
+void MediaRecorder::WriteBatch(bool final) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    if (!file_) {
+        return;
+    }
+
+    {
+        // Both buffers keep their capacity, nothing is allocated once the
+        // recording runs.
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        std::swap(queued_, writing_);
+    }
+
+    for (const QueuedFrame& frame : writing_.frames) {
+        const uint8_t* data = writing_.data.data() + frame.offset;
+        if (frame.video) {
+            muxer_.AddVideoFrame(data, frame.size, frame.rtp_timestamp, frame.key_frame,
+                frame.arrival_ms);
+        }
+        else {
+            muxer_.AddAudioFrame(data, frame.size, frame.rtp_timestamp, frame.arrival_ms);
+        }
+    }
+    writing_.data.clear();
+    writing_.frames.clear();
+
+    if (final) {
+        muxer_.Finish();
+    }
+
+    std::vector<uint8_t>* output = muxer_.output();
+    if (output->empty()) {
+        return;
+    }
+
+    // Whole fragments only, flushed right away: after a crash the file
+    // plays up to the last one.
+    size_t written = fwrite(output->data(), 1, output->size(), file_);
+    fflush(file_);
+    bool failed = written != output->size();
+    output->clear();
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (failed && !stats_.write_failed) {
+        RTC_LOG(LS_ERROR) << "recording " << file_path_ << " write failed";
+    }
+    stats_.write_failed |= failed;
+    stats_.bytes_written += written;
+    stats_.batches++;
+    stats_.fragments = muxer_.stats().fragments;
+}
+
+} // namespace krtc
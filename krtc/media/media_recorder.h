@@ -0,0 +1,98 @@
+#ifndef KRTCSDK_KRTC_MEDIA_MEDIA_RECORDER_H_
+#define KRTCSDK_KRTC_MEDIA_MEDIA_RECORDER_H_
+
+#include <stdio.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "krtc/media/encoded_frame_tap.h"
+#include "krtc/media/fmp4_muxer.h"
+
+namespace krtc {
+
+// Records the encoded frames of an EncodedFrameTap to a fragmented mp4,
+// nothing is decoded or encoded again. The media threads only copy frames
+// into a bounded queue, muxing and file writes happen in batches on one
+// writer thread shared by all recordings.
+class MediaRecorder : public EncodedFrameObserver,
+                      public std::enable_shared_from_this<MediaRecorder>
+{
+public:
+    struct Config {
+        Fmp4Muxer::Config muxer;
+        // Frames waiting for the writer. Past this video is dropped up to
+        // the next key frame, audio frame by frame.
+        size_t max_queued_bytes = 8 * 1024 * 1024;
+        // Queued bytes that wake the writer before its next round.
+        size_t batch_bytes = 256 * 1024;
+    };
+
+    struct Stats {
+        int64_t frames = 0;
+        int64_t dropped_frames = 0;     // queue full
+        int64_t bytes_written = 0;
+        int64_t batches = 0;
+        int64_t fragments = 0;
+        bool write_failed = false;
+    };
+
+    // nullptr when the file cannot be created.
+    static std::shared_ptr<MediaRecorder> Create(const std::string& file_path,
+        const Config& config);
+    ~MediaRecorder() override;
+
+    // Writes what is queued, the last fragment and closes the file. Remove
+    // the recorder from its taps first.
+    void Stop();
+
+    Stats stats() const;
+    const std::string& file_path() const { return file_path_; }
+
+    // EncodedFrameObserver
+    void OnEncodedFrame(const TappedFrame& frame) override;
+
+private:
+    class Writer;
+
+    struct QueuedFrame {
+        size_t offset;
+        uint32_t size;
+        uint32_t rtp_timestamp;
+        int64_t arrival_ms;
+        bool video;
+        bool key_frame;
+    };
+
+    struct Batch {
+        std::vector<uint8_t> data;
+        std::vector<QueuedFrame> frames;
+    };
+
+    MediaRecorder(const std::string& file_path, const Config& config, FILE* file);
+
+    // On the writer thread, or from Stop().
+    void WriteBatch(bool final);
+
+    const std::string file_path_;
+    const Config config_;
+
+    // Filled by the media threads, swapped with writing_ by the writer.
+    mutable std::mutex queue_mutex_;
+    Batch queued_;
+    bool waiting_for_key_frame_ = false;
+    bool stopped_ = false;
+    Stats stats_;
+
+    // Held while muxing and writing.
+    std::mutex write_mutex_;
+    Batch writing_;
+    Fmp4Muxer muxer_;
+    FILE* file_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_MEDIA_MEDIA_RECORDER_H_
@@ -0,0 +1,161 @@
+#include "krtc/render/gallery_renderer.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include <rtc_base/logging.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include "krtc/base/krtc_global.h"
+#include "krtc/media/media_frame.h"
+
+namespace krtc {
+
+namespace {
+
+// Tiles are drawn in parallel, a few threads are enough for a 1080p canvas.
+const int kMaxComposeThreads = 4;
+
+// On the decoder thread of its stream, only swaps the frame reference.
+class GalleryStreamSink : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
+public:
+    GalleryStreamSink(std::shared_ptr<VideoCompositor> compositor, int stream_id) :
+        compositor_(std::move(compositor)),
+        stream_id_(stream_id)
+    {
+        compositor_->AddStream(stream_id_);
+    }
+
+    ~GalleryStreamSink() override {
+        compositor_->RemoveStream(stream_id_);
+    }
+
+    void OnFrame(const webrtc::VideoFrame& frame) override {
+        compositor_->UpdateFrame(stream_id_, frame.video_frame_buffer());
+    }
+
+private:
+    std::shared_ptr<VideoCompositor> compositor_;
+    int stream_id_;
+};
+
+} // namespace
+
+GalleryRenderer::GalleryRenderer(rtc::Thread* render_thread) :
+    render_thread_(render_thread)
+{
+}
+
+GalleryRenderer::~GalleryRenderer() = default;
+
+bool GalleryRenderer::Start(int width, int height, int fps, SubMediaType type) {
+    if (width < 2 || height < 2 || fps <= 0 || fps > 60 ||
+        !VideoFrameConverter::IsSupportedOutput(type, 0, 0))
+    {
+        return false;
+    }
+
+    render_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+        // Streams in the last gallery keep feeding it, unseen.
+        int threads = std::min(kMaxComposeThreads,
+            std::max(1, (int)std::thread::hardware_concurrency() / 2));
+        compositor_ = std::make_shared<VideoCompositor>(width, height, threads);
+        converter_.SetOutput(type, 0, 0);
+        fps_ = fps;
+        start_ms_ = rtc::TimeMillis();
+        frame_count_ = 0;
+        int generation = ++generation_;
+        render_thread_->PostTask(webrtc::ToQueuedTask([this, generation]() {
+            ComposeNext(generation);
+        }));
+    });
+
+    RTC_LOG(LS_INFO) << "gallery started, " << width << "x" << height << "@" << fps;
+    return true;
+}
+
+void GalleryRenderer::Stop() {
+    render_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+        ++generation_;
+        compositor_ = nullptr;
+    });
+}
+
+bool GalleryRenderer::SetOverlay(const uint8_t* argb, int stride, int width, int height,
+    int x, int y)
+{
+    std::shared_ptr<VideoCompositor> compositor = render_thread_->Invoke<
+        std::shared_ptr<VideoCompositor>>(RTC_FROM_HERE, [&]() { return compositor_; });
+    // Converted on the caller's thread, the render thread only blends.
+    return compositor && compositor->SetOverlay(argb, stride, width, height, x, y);
+}
+
+void GalleryRenderer::ClearOverlay() {
+    render_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+        if (compositor_) {
+            compositor_->ClearOverlay();
+        }
+    });
+}
+
+void GalleryRenderer::SetOutputSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) {
+    render_thread_->Invoke<void>(RTC_FROM_HERE, [&]() {
+        output_sink_ = sink;
+    });
+}
+
+std::unique_ptr<rtc::VideoSinkInterface<webrtc::VideoFrame>> GalleryRenderer::CreateStreamSink() {
+    return render_thread_->Invoke<std::unique_ptr<rtc::VideoSinkInterface<webrtc::VideoFrame>>>(
+        RTC_FROM_HERE, [&]() -> std::unique_ptr<rtc::VideoSinkInterface<webrtc::VideoFrame>> {
+            if (!compositor_) {
+                return nullptr;
+            }
+            return std::make_unique<GalleryStreamSink>(compositor_, next_stream_id_++);
+        });
+}
+
+void GalleryRenderer::ComposeNext(int generation) {
+    if (generation != generation_) {
+        return;
+    }
+
+    // Nothing new since the last canvas, the app keeps showing that one.
+    KRTCEngineObserver* observer = KRTCGlobal::Instance()->engine_observer();
+    rtc::scoped_refptr<webrtc::I420Buffer> canvas;
+    if (observer || output_sink_) {
+        canvas = compositor_->Compose();
+    }
+    if (canvas) {
+        int64_t now_ms = rtc::TimeMillis();
+        webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+            .set_video_frame_buffer(canvas)
+            .set_timestamp_rtp((uint32_t)(now_ms * 90))
+            .set_timestamp_ms(now_ms)
+            .build();
+        if (output_sink_) {
+            output_sink_->OnFrame(frame);
+        }
+        std::shared_ptr<MediaFrame> media_frame = observer ? converter_.Convert(frame) : nullptr;
+        if (media_frame) {
+            observer->OnGalleryVideoFrame(media_frame);
+        }
+    }
+
+    // The app may have stopped or restarted the gallery from the callback.
+    if (generation != generation_) {
+        return;
+    }
+
+    // Deadlines from the start time, late frames do not push back the rest.
+    // After a stall the missed frames are skipped, not composed in a burst.
+    int64_t now_ms = rtc::TimeMillis();
+    frame_count_ = std::max(frame_count_ + 1, (now_ms - start_ms_) * fps_ / 1000);
+    int64_t next_ms = start_ms_ + (frame_count_ * 1000 + fps_ - 1) / fps_;
+    render_thread_->PostDelayedTask(webrtc::ToQueuedTask([this, generation]() {
+        ComposeNext(generation);
+    }), (uint32_t)std::max<int64_t>(0, next_ms - now_ms));
+}
+
+} // namespace krtc
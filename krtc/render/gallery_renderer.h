@@ -0,0 +1,63 @@
+#ifndef KRTCSDK_KRTC_RENDER_GALLERY_RENDERER_H_
+#define KRTCSDK_KRTC_RENDER_GALLERY_RENDERER_H_
+
+#include <stdint.h>
+
+#include <memory>
+
+#include <api/video/video_frame.h>
+#include <api/video/video_sink_interface.h>
+#include <rtc_base/thread.h>
+
+#include "krtc/render/video_compositor.h"
+#include "krtc/render/video_frame_converter.h"
+
+namespace krtc {
+
+// Every pulled stream in one picture: the pullers' decoded frames go into a
+// VideoCompositor and the canvas is handed to OnGalleryVideoFrame at a fixed
+// rate on the render thread. One callback, one upload and one draw for the
+// app instead of one per participant. The canvas can also feed a pusher, to
+// send or record the mix.
+class GalleryRenderer {
+public:
+    explicit GalleryRenderer(rtc::Thread* render_thread);
+    ~GalleryRenderer();
+
+    // Any thread. Starting again restarts with the new size and rate.
+    bool Start(int width, int height, int fps, SubMediaType type);
+    // No canvas is delivered after this returns.
+    void Stop();
+
+    // Alpha blended over the running gallery, see VideoCompositor::SetOverlay.
+    bool SetOverlay(const uint8_t* argb, int stride, int width, int height, int x, int y);
+    void ClearOverlay();
+
+    // Gets every canvas as well, on the render thread. Null removes it, no
+    // canvas reaches the old sink after this returns.
+    void SetOutputSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink);
+
+    // A sink for one pulled stream, drawn in its own tile until the sink is
+    // destroyed. Null when the gallery is not running.
+    std::unique_ptr<rtc::VideoSinkInterface<webrtc::VideoFrame>> CreateStreamSink();
+
+private:
+    // On the render thread.
+    void ComposeNext(int generation);
+
+    rtc::Thread* const render_thread_;
+
+    // Render thread only.
+    std::shared_ptr<VideoCompositor> compositor_;
+    rtc::VideoSinkInterface<webrtc::VideoFrame>* output_sink_ = nullptr;
+    VideoFrameConverter converter_;
+    int generation_ = 0;
+    int fps_ = 0;
+    int64_t start_ms_ = 0;
+    int64_t frame_count_ = 0;
+    int next_stream_id_ = 0;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_RENDER_GALLERY_RENDERER_H_
@@ -0,0 +1,236 @@
+#include "krtc/render/presentation_scheduler.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+namespace krtc {
+
+namespace {
+
+const size_t kTransitWindow = 120;       // 4 s at 30 fps
+const size_t kIntervalWindow = 120;
+const size_t kMaxPendingFrames = 8;
+// The stream restarted or the sender's clock jumped, start over.
+const int64_t kTransitResetMs = 3000;
+// A pause in the stream, not jitter.
+const int64_t kMaxIntervalMs = 1000;
+// Keeps a jitter free stream off the refresh boundaries, where ms rounding
+// would flip its frames between two refreshes.
+const int64_t kMinDelayMs = 2;
+
+} // namespace
+
+PresentationScheduler::PresentationScheduler(rtc::Thread* render_thread, const Config& config,
+    DeliverCallback deliver) :
+    render_thread_(render_thread),
+    config_(config),
+    period_us_(1000000 / std::max(1, config.refresh_hz)),
+    deliver_(std::move(deliver))
+{
+}
+
+PresentationScheduler::~PresentationScheduler() {
+    Stop();
+}
+
+void PresentationScheduler::Push(const webrtc::VideoFrame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+    }
+
+    Insert(frame, rtc::TimeMillis());
+
+    // Ticks only while frames wait, an idle stream costs no wakeups.
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start = !ticking_;
+        ticking_ = true;
+    }
+    if (start) {
+        ScheduleTick();
+    }
+}
+
+void PresentationScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        pending_.clear();
+    }
+
+    // Stopped from the app's own callback, the delivery ends when it returns.
+    if (render_thread_ && !render_thread_->IsCurrent()) {
+        std::lock_guard<std::mutex> deliver_lock(deliver_mutex_);
+    }
+}
+
+PresentationScheduler::Stats PresentationScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.delay_ms = delay_ms_;
+    if (intervals_.size() > 1) {
+        double sum = 0;
+        for (int64_t interval : intervals_) {
+            sum += (double)interval;
+        }
+        double mean = sum / intervals_.size();
+        double variance = 0;
+        for (int64_t interval : intervals_) {
+            variance += (interval - mean) * (interval - mean);
+        }
+        stats.interval_stddev_ms = sqrt(variance / intervals_.size());
+    }
+    return stats;
+}
+
+void PresentationScheduler::Insert(const webrtc::VideoFrame& frame, int64_t arrival_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint32_t rtp = frame.timestamp();
+    int64_t jump_ms = 0;
+    if (has_rtp_) {
+        int32_t diff = (int32_t)(rtp - last_rtp_);
+        unwrapped_rtp_ += diff;
+        jump_ms = diff / 90;
+    }
+    else {
+        unwrapped_rtp_ = rtp;
+        has_rtp_ = true;
+    }
+    last_rtp_ = rtp;
+
+    int64_t rtp_ms = unwrapped_rtp_ / 90;
+    int64_t transit_ms = arrival_ms - rtp_ms;
+    if (std::abs(jump_ms) > kTransitResetMs ||
+        (!transits_.empty() && std::abs(transit_ms - base_transit_ms_) > kTransitResetMs)) {
+        Restart();
+    }
+    UpdateDelay(transit_ms);
+    if (rtp_ms <= last_present_rtp_ms_) {
+        // Older than what is on screen already.
+        stats_.dropped_frames++;
+        return;
+    }
+
+    Pending pending;
+    pending.rtp_ms = rtp_ms;
+    pending.due_ms = std::min(rtp_ms + base_transit_ms_ + delay_ms_,
+        arrival_ms + config_.max_delay_ms);
+    pending.frame = frame;
+
+    auto it = pending_.end();
+    while (it != pending_.begin() && std::prev(it)->rtp_ms > rtp_ms) {
+        --it;
+    }
+    pending_.insert(it, std::move(pending));
+
+    while (pending_.size() > kMaxPendingFrames) {
+        pending_.pop_front();
+        stats_.dropped_frames++;
+    }
+}
+
+absl::optional<webrtc::VideoFrame> PresentationScheduler::Take(int64_t vsync_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Shown on the first refresh at or after its due time, the newest of
+    // several due ones.
+    absl::optional<webrtc::VideoFrame> frame;
+    while (!pending_.empty() && pending_.front().due_ms <= vsync_ms) {
+        if (frame) {
+            stats_.dropped_frames++;
+        }
+        frame = std::move(pending_.front().frame);
+        last_present_rtp_ms_ = pending_.front().rtp_ms;
+        pending_.pop_front();
+    }
+    if (!frame) {
+        return frame;
+    }
+
+    stats_.presented_frames++;
+    if (last_present_ms_ >= 0 && vsync_ms - last_present_ms_ <= kMaxIntervalMs) {
+        intervals_.push_back(vsync_ms - last_present_ms_);
+        if (intervals_.size() > kIntervalWindow) {
+            intervals_.pop_front();
+        }
+    }
+    last_present_ms_ = vsync_ms;
+    return frame;
+}
+
+void PresentationScheduler::Restart() {
+    // The old timeline means nothing to the new one: a backwards jump would
+    // otherwise drop every frame until it caught up with what was shown.
+    transits_.clear();
+    stats_.dropped_frames += pending_.size();
+    pending_.clear();
+    last_present_rtp_ms_ = INT64_MIN;
+}
+
+void PresentationScheduler::UpdateDelay(int64_t transit_ms) {
+    transits_.push_back(transit_ms);
+    if (transits_.size() > kTransitWindow) {
+        transits_.pop_front();
+    }
+
+    // Delay to absorb 95% of the jitter seen lately.
+    std::vector<int64_t> sorted(transits_.begin(), transits_.end());
+    size_t k = (sorted.size() - 1) * 95 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    base_transit_ms_ = *std::min_element(transits_.begin(), transits_.end());
+    delay_ms_ = (int)std::min<int64_t>(sorted[k] - base_transit_ms_ + kMinDelayMs,
+        config_.max_delay_ms);
+}
+
+void PresentationScheduler::ScheduleTick() {
+    int64_t now_us = rtc::TimeMicros();
+    int64_t vsync_us = (now_us / period_us_ + 1) * period_us_;
+
+    std::weak_ptr<PresentationScheduler> weak_this = shared_from_this();
+    render_thread_->PostDelayedTask(webrtc::ToQueuedTask([weak_this, vsync_us]() {
+        std::shared_ptr<PresentationScheduler> scheduler = weak_this.lock();
+        if (scheduler) {
+            scheduler->OnTick(vsync_us);
+        }
+    }), (uint32_t)((vsync_us - now_us + 999) / 1000));
+}
+
+void PresentationScheduler::OnTick(int64_t vsync_us) {
+    std::lock_guard<std::mutex> deliver_lock(deliver_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            ticking_ = false;
+            return;
+        }
+    }
+
+    absl::optional<webrtc::VideoFrame> frame = Take(vsync_us / 1000);
+    if (frame) {
+        deliver_(*frame);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_ || pending_.empty()) {
+            ticking_ = false;
+            return;
+        }
+    }
+    ScheduleTick();
+}
+
+} // namespace krtc
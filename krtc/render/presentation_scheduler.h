@@ -0,0 +1,106 @@
+#ifndef KRTCSDK_KRTC_RENDER_PRESENTATION_SCHEDULER_H_
+#define KRTCSDK_KRTC_RENDER_PRESENTATION_SCHEDULER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <absl/types/optional.h>
+#include <api/video/video_frame.h>
+#include <rtc_base/thread.h>
+
+namespace krtc {
+
+// Evens out the cadence of pulled frames: decoded frames wait in a small
+// buffer ordered by RTP timestamp and are released on display refresh
+// boundaries, each at its capture time plus a playout delay. The delay
+// follows the measured arrival jitter and never exceeds max_delay_ms, a
+// frame is released on the first refresh after arrival + max_delay_ms at
+// the latest.
+//
+// Without a display vsync in the sdk the refresh boundaries are multiples
+// of the refresh period on the render thread's clock.
+class PresentationScheduler : public std::enable_shared_from_this<PresentationScheduler> {
+public:
+    typedef std::function<void(const webrtc::VideoFrame& frame)> DeliverCallback;
+
+    struct Config {
+        int refresh_hz = 60;
+        int max_delay_ms = 50;
+    };
+
+    struct Stats {
+        uint64_t presented_frames = 0;
+        uint64_t dropped_frames = 0;         // skipped at release or buffer overflow
+        int delay_ms = 0;                    // current playout delay
+        double interval_stddev_ms = 0;       // of the last presentation intervals
+    };
+
+    PresentationScheduler(rtc::Thread* render_thread, const Config& config,
+        DeliverCallback deliver);
+    ~PresentationScheduler();
+
+    // Any thread, does not wait.
+    void Push(const webrtc::VideoFrame& frame);
+
+    // Nothing is delivered after this returns. Waits for a delivery in
+    // progress unless called from inside it.
+    void Stop();
+
+    Stats stats() const;
+
+    // The buffer alone, the time passed in. Push and the render thread
+    // ticks use these; used alone, render_thread and deliver may be null.
+    void Insert(const webrtc::VideoFrame& frame, int64_t arrival_ms);
+    // The frame to show at the refresh boundary vsync_ms, if one is due.
+    absl::optional<webrtc::VideoFrame> Take(int64_t vsync_ms);
+
+private:
+    struct Pending {
+        int64_t rtp_ms = 0;
+        int64_t due_ms = 0;
+        webrtc::VideoFrame frame;
+    };
+
+    // Starts the timeline over: transits, waiting frames and what was shown.
+    void Restart();
+    void UpdateDelay(int64_t transit_ms);
+    void ScheduleTick();
+    void OnTick(int64_t vsync_us);
+
+    rtc::Thread* const render_thread_;
+    const Config config_;
+    const int64_t period_us_;
+    const DeliverCallback deliver_;
+
+    mutable std::mutex mutex_;
+    std::deque<Pending> pending_;
+    bool ticking_ = false;
+    bool stopped_ = false;
+
+    // RTP timestamps unwrapped, in ms.
+    bool has_rtp_ = false;
+    uint32_t last_rtp_ = 0;
+    int64_t unwrapped_rtp_ = 0;
+
+    // Arrival minus capture time of the last frames; the smallest one is
+    // the no-jitter path, the spread above it the jitter to absorb.
+    std::deque<int64_t> transits_;
+    int64_t base_transit_ms_ = 0;
+    int delay_ms_ = 0;
+
+    int64_t last_present_ms_ = -1;
+    int64_t last_present_rtp_ms_ = INT64_MIN;
+    std::deque<int64_t> intervals_;
+    Stats stats_;
+
+    // Held while the app has a frame.
+    std::mutex deliver_mutex_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_RENDER_PRESENTATION_SCHEDULER_H_
@@ -0,0 +1,85 @@
+#include "krtc/render/render_queue.h"
+
+#include <utility>
+
+#include <rtc_base/task_utils/to_queued_task.h>
+
+namespace krtc {
+
+RenderQueue::RenderQueue(rtc::Thread* render_thread, DeliverCallback deliver) :
+    render_thread_(render_thread),
+    deliver_(std::move(deliver))
+{
+}
+
+RenderQueue::~RenderQueue() {
+    Stop();
+}
+
+void RenderQueue::Push(const webrtc::VideoFrame& frame) {
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+        if (pending_) {
+            stats_.dropped_frames++;
+        }
+        // Takes a reference to the decoded buffer, no pixels are copied here.
+        pending_ = frame;
+        post = !scheduled_;
+        scheduled_ = true;
+    }
+
+    if (post) {
+        std::weak_ptr<RenderQueue> weak_this = shared_from_this();
+        render_thread_->PostTask(webrtc::ToQueuedTask([weak_this]() {
+            std::shared_ptr<RenderQueue> queue = weak_this.lock();
+            if (queue) {
+                queue->Deliver();
+            }
+        }));
+    }
+}
+
+void RenderQueue::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        pending_.reset();
+    }
+
+    // Stopped from the app's own callback, the delivery ends when it returns.
+    if (!render_thread_->IsCurrent()) {
+        std::lock_guard<std::mutex> deliver_lock(deliver_mutex_);
+    }
+}
+
+RenderQueue::Stats RenderQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void RenderQueue::Deliver() {
+    std::lock_guard<std::mutex> deliver_lock(deliver_mutex_);
+
+    absl::optional<webrtc::VideoFrame> frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A frame pushed from here on schedules the next delivery.
+        scheduled_ = false;
+        if (stopped_ || !pending_) {
+            return;
+        }
+        frame = std::move(pending_);
+        pending_.reset();
+    }
+
+    deliver_(*frame);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.delivered_frames++;
+}
+
+} // namespace krtc
@@ -0,0 +1,59 @@
+#ifndef KRTCSDK_KRTC_RENDER_RENDER_QUEUE_H_
+#define KRTCSDK_KRTC_RENDER_RENDER_QUEUE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <absl/types/optional.h>
+#include <api/video/video_frame.h>
+#include <rtc_base/thread.h>
+
+namespace krtc {
+
+// Depth one queue between a decoder and the app: the decoder thread only
+// swaps the newest frame in, the render thread takes it out and delivers it.
+// A frame the app had no time for is replaced by the next one, frames never
+// back up and decoding never waits for the app.
+class RenderQueue : public std::enable_shared_from_this<RenderQueue> {
+public:
+    typedef std::function<void(const webrtc::VideoFrame& frame)> DeliverCallback;
+
+    struct Stats {
+        uint64_t delivered_frames = 0;
+        uint64_t dropped_frames = 0;    // replaced before the render thread got to them
+    };
+
+    RenderQueue(rtc::Thread* render_thread, DeliverCallback deliver);
+    ~RenderQueue();
+
+    // Any thread, does not wait.
+    void Push(const webrtc::VideoFrame& frame);
+
+    // Nothing is delivered after this returns. Waits for a delivery in
+    // progress unless called from inside it.
+    void Stop();
+
+    Stats stats() const;
+
+private:
+    void Deliver();
+
+    rtc::Thread* const render_thread_;
+    const DeliverCallback deliver_;
+
+    mutable std::mutex mutex_;
+    absl::optional<webrtc::VideoFrame> pending_;
+    bool scheduled_ = false;
+    bool stopped_ = false;
+    Stats stats_;
+
+    // Held while the app has a frame.
+    std::mutex deliver_mutex_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_RENDER_RENDER_QUEUE_H_
@@ -0,0 +1,304 @@
+#include "krtc/render/video_compositor.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <third_party/libyuv/include/libyuv/convert.h>
+#include <third_party/libyuv/include/libyuv/planar_functions.h>
+#include <third_party/libyuv/include/libyuv/scale.h>
+
+namespace krtc {
+
+namespace {
+
+const size_t kMaxCanvases = 4;
+
+void DrawTile(webrtc::I420Buffer* canvas, const VideoCompositor::Tile& tile,
+    const webrtc::I420BufferInterface& src)
+{
+    VideoCompositor::Tile rect = VideoCompositor::FitInTile(tile, src.width(), src.height());
+    libyuv::I420Scale(src.DataY(), src.StrideY(), src.DataU(), src.StrideU(),
+        src.DataV(), src.StrideV(), src.width(), src.height(),
+        canvas->MutableDataY() + rect.y * canvas->StrideY() + rect.x, canvas->StrideY(),
+        canvas->MutableDataU() + rect.y / 2 * canvas->StrideU() + rect.x / 2, canvas->StrideU(),
+        canvas->MutableDataV() + rect.y / 2 * canvas->StrideV() + rect.x / 2, canvas->StrideV(),
+        rect.width, rect.height, libyuv::kFilterBox);
+}
+
+} // namespace
+
+VideoCompositor::VideoCompositor(int width, int height, int threads) :
+    width_(std::max(2, width & ~1)),
+    height_(std::max(2, height & ~1))
+{
+    for (int i = 1; i < threads; ++i) {
+        workers_.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+VideoCompositor::~VideoCompositor() {
+    {
+        std::lock_guard<std::mutex> lock(work_mutex_);
+        quit_ = true;
+    }
+    work_cond_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::vector<VideoCompositor::Tile> VideoCompositor::GridLayout(int count, int width, int height) {
+    std::vector<Tile> tiles;
+    if (count <= 0 || width < 2 || height < 2) {
+        return tiles;
+    }
+
+    // Width of a 16:9 stream fitted into a cell, the wider grid on a tie.
+    int cols = 1;
+    int best_width = -1;
+    for (int c = 1; c <= count; ++c) {
+        int r = (count + c - 1) / c;
+        int fitted_width = std::min(width / c, height / r * 16 / 9);
+        if (fitted_width >= best_width) {
+            best_width = fitted_width;
+            cols = c;
+        }
+    }
+    int rows = (count + cols - 1) / cols;
+
+    int cell_width = (width / cols) & ~1;
+    int cell_height = (height / rows) & ~1;
+    int x0 = ((width - cell_width * cols) / 2) & ~1;
+    int y0 = ((height - cell_height * rows) / 2) & ~1;
+    int last_row = count - (rows - 1) * cols;
+
+    for (int i = 0; i < count; ++i) {
+        int row = i / cols;
+        int col = i % cols;
+        Tile tile;
+        tile.x = x0 + col * cell_width;
+        tile.y = y0 + row * cell_height;
+        if (row == rows - 1) {
+            tile.x += ((cols - last_row) * cell_width / 2) & ~1;
+        }
+        tile.width = cell_width;
+        tile.height = cell_height;
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+VideoCompositor::Tile VideoCompositor::FitInTile(const Tile& tile, int width, int height) {
+    Tile rect = tile;
+    if (width <= 0 || height <= 0) {
+        return rect;
+    }
+
+    if ((int64_t)tile.width * height <= (int64_t)tile.height * width) {
+        rect.height = std::max(2, (int)((int64_t)tile.width * height / width) & ~1);
+    }
+    else {
+        rect.width = std::max(2, (int)((int64_t)tile.height * width / height) & ~1);
+    }
+    rect.x = tile.x + (((tile.width - rect.width) / 2) & ~1);
+    rect.y = tile.y + (((tile.height - rect.height) / 2) & ~1);
+    return rect;
+}
+
+void VideoCompositor::AddStream(int stream_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stream stream;
+    stream.id = stream_id;
+    streams_.push_back(stream);
+    UpdateLayout();
+}
+
+void VideoCompositor::RemoveStream(int stream_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(std::remove_if(streams_.begin(), streams_.end(),
+        [stream_id](const Stream& stream) { return stream.id == stream_id; }),
+        streams_.end());
+    UpdateLayout();
+}
+
+void VideoCompositor::UpdateFrame(int stream_id,
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Stream& stream : streams_) {
+        if (stream.id == stream_id) {
+            // Only a reference, the pixels are read when the canvas is drawn.
+            stream.buffer = std::move(buffer);
+            changed_ = true;
+            return;
+        }
+    }
+}
+
+bool VideoCompositor::GetTile(int stream_id, Tile* tile) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Stream& stream : streams_) {
+        if (stream.id == stream_id) {
+            *tile = stream.tile;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VideoCompositor::SetOverlay(const uint8_t* argb, int stride, int width, int height,
+    int x, int y)
+{
+    x &= ~1;
+    y &= ~1;
+    if (!argb || x < 0 || y < 0 || x >= width_ || y >= height_) {
+        return false;
+    }
+    int clipped_width = std::min(width, width_ - x) & ~1;
+    int clipped_height = std::min(height, height_ - y) & ~1;
+    if (clipped_width <= 0 || clipped_height <= 0) {
+        return false;
+    }
+
+    std::shared_ptr<Overlay> overlay = std::make_shared<Overlay>();
+    overlay->image = webrtc::I420Buffer::Create(clipped_width, clipped_height);
+    libyuv::ARGBToI420(argb, stride,
+        overlay->image->MutableDataY(), overlay->image->StrideY(),
+        overlay->image->MutableDataU(), overlay->image->StrideU(),
+        overlay->image->MutableDataV(), overlay->image->StrideV(),
+        clipped_width, clipped_height);
+    overlay->alpha.resize((size_t)clipped_width * clipped_height);
+    libyuv::ARGBExtractAlpha(argb, stride, overlay->alpha.data(), clipped_width,
+        clipped_width, clipped_height);
+    overlay->x = x;
+    overlay->y = y;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    overlay_ = overlay;
+    changed_ = true;
+    return true;
+}
+
+void VideoCompositor::ClearOverlay() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    overlay_ = nullptr;
+    changed_ = true;
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> VideoCompositor::Compose() {
+    std::vector<Stream> streams;
+    std::shared_ptr<const Overlay> overlay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!changed_) {
+            return nullptr;
+        }
+        changed_ = false;
+        for (const Stream& stream : streams_) {
+            if (stream.buffer) {
+                streams.push_back(stream);
+            }
+        }
+        overlay = overlay_;
+    }
+
+    rtc::scoped_refptr<webrtc::I420Buffer> canvas = AcquireCanvas();
+    webrtc::I420Buffer::SetBlack(canvas.get());
+
+    // Tiles do not overlap, each one is written by one thread only.
+    {
+        std::lock_guard<std::mutex> lock(work_mutex_);
+        work_canvas_ = canvas;
+        work_ = std::move(streams);
+        next_work_ = 0;
+        pending_work_ = work_.size();
+        work_round_++;
+    }
+    work_cond_.notify_all();
+    DrawTiles();
+    {
+        std::unique_lock<std::mutex> lock(work_mutex_);
+        done_cond_.wait(lock, [this]() { return pending_work_ == 0; });
+        work_canvas_ = nullptr;
+        work_.clear();
+    }
+
+    if (overlay) {
+        const webrtc::I420Buffer& image = *overlay->image;
+        uint8_t* dst_y = canvas->MutableDataY() + overlay->y * canvas->StrideY() + overlay->x;
+        uint8_t* dst_u = canvas->MutableDataU() + overlay->y / 2 * canvas->StrideU() + overlay->x / 2;
+        uint8_t* dst_v = canvas->MutableDataV() + overlay->y / 2 * canvas->StrideV() + overlay->x / 2;
+        libyuv::I420Blend(image.DataY(), image.StrideY(), image.DataU(), image.StrideU(),
+            image.DataV(), image.StrideV(),
+            dst_y, canvas->StrideY(), dst_u, canvas->StrideU(), dst_v, canvas->StrideV(),
+            overlay->alpha.data(), image.width(),
+            dst_y, canvas->StrideY(), dst_u, canvas->StrideU(), dst_v, canvas->StrideV(),
+            image.width(), image.height());
+    }
+    return canvas;
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> VideoCompositor::AcquireCanvas() {
+    for (const auto& canvas : canvases_) {
+        // Only the pool holds it, whoever got it last is done with it.
+        if (canvas->HasOneRef()) {
+            return canvas;
+        }
+    }
+
+    rtc::scoped_refptr<PooledCanvas> canvas(new PooledCanvas(width_, height_));
+    if (canvases_.size() < kMaxCanvases) {
+        canvases_.push_back(canvas);
+    }
+    return canvas;
+}
+
+void VideoCompositor::DrawTiles() {
+    while (true) {
+        Stream stream;
+        rtc::scoped_refptr<webrtc::I420Buffer> canvas;
+        {
+            std::lock_guard<std::mutex> lock(work_mutex_);
+            if (next_work_ >= work_.size()) {
+                return;
+            }
+            stream = work_[next_work_++];
+            canvas = work_canvas_;
+        }
+
+        rtc::scoped_refptr<webrtc::I420BufferInterface> i420 = stream.buffer->ToI420();
+        if (i420) {
+            DrawTile(canvas.get(), stream.tile, *i420);
+        }
+
+        std::lock_guard<std::mutex> lock(work_mutex_);
+        if (--pending_work_ == 0) {
+            done_cond_.notify_all();
+        }
+    }
+}
+
+void VideoCompositor::WorkerLoop() {
+    uint64_t round = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(work_mutex_);
+            work_cond_.wait(lock, [&]() { return quit_ || work_round_ != round; });
+            if (quit_) {
+                return;
+            }
+            round = work_round_;
+        }
+        DrawTiles();
+    }
+}
+
+void VideoCompositor::UpdateLayout() {
+    std::vector<Tile> tiles = GridLayout((int)streams_.size(), width_, height_);
+    for (size_t i = 0; i < streams_.size(); ++i) {
+        streams_[i].tile = tiles[i];
+    }
+    changed_ = true;
+}
+
+} // namespace krtc
@@ -0,0 +1,117 @@
+#ifndef KRTCSDK_KRTC_RENDER_VIDEO_COMPOSITOR_H_
+#define KRTCSDK_KRTC_RENDER_VIDEO_COMPOSITOR_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <api/scoped_refptr.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame_buffer.h>
+#include <rtc_base/ref_counted_object.h>
+
+namespace krtc {
+
+// Draws the newest frame of every stream into its own tile of one I420
+// canvas, scaled straight from the decoded buffer into the canvas with
+// libyuv. The app gets one frame to upload and draw however many streams
+// there are. Tiles are drawn in parallel on up to threads threads, the
+// calling one included, into canvases recycled once nobody holds them.
+class VideoCompositor {
+public:
+    struct Tile {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    VideoCompositor(int width, int height, int threads = 1);
+    ~VideoCompositor();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // count tiles in rows and columns, picking the grid that shows 16:9
+    // streams the largest. A short last row is centered. Positions and
+    // sizes are even so the chroma planes line up.
+    static std::vector<Tile> GridLayout(int count, int width, int height);
+
+    // The largest even rect with the aspect ratio of width x height,
+    // centered in tile.
+    static Tile FitInTile(const Tile& tile, int width, int height);
+
+    // Any thread. Streams are laid out in the order they were added.
+    void AddStream(int stream_id);
+    void RemoveStream(int stream_id);
+    void UpdateFrame(int stream_id, rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer);
+
+    // Where stream_id is drawn, false when it is not in the layout.
+    bool GetTile(int stream_id, Tile* tile) const;
+
+    // Any thread. A watermark or caption alpha blended over the tiles at
+    // x, y: libyuv ARGB (B G R A in memory), straight alpha, clipped to the
+    // canvas. Converted to I420 once here, not per canvas.
+    bool SetOverlay(const uint8_t* argb, int stride, int width, int height, int x, int y);
+    void ClearOverlay();
+
+    // One canvas with every stream that has a frame, null when no frame
+    // came in and nothing else changed since the last call. On one thread
+    // at a time.
+    rtc::scoped_refptr<webrtc::I420Buffer> Compose();
+
+private:
+    struct Stream {
+        int id = 0;
+        Tile tile;
+        rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer;
+    };
+
+    struct Overlay {
+        rtc::scoped_refptr<webrtc::I420Buffer> image;
+        std::vector<uint8_t> alpha;
+        int x = 0;
+        int y = 0;
+    };
+
+    typedef rtc::RefCountedObject<webrtc::I420Buffer> PooledCanvas;
+
+    void UpdateLayout();
+    rtc::scoped_refptr<webrtc::I420Buffer> AcquireCanvas();
+
+    // Draws the tiles of the current canvas until none is left, on the
+    // calling thread and on every worker.
+    void DrawTiles();
+    void WorkerLoop();
+
+    const int width_;
+    const int height_;
+
+    mutable std::mutex mutex_;
+    std::vector<Stream> streams_;
+    std::shared_ptr<const Overlay> overlay_;
+    bool changed_ = true;
+
+    // Compose thread only.
+    std::vector<rtc::scoped_refptr<PooledCanvas>> canvases_;
+
+    // Tiles of the canvas being drawn, handed out one at a time.
+    std::mutex work_mutex_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    rtc::scoped_refptr<webrtc::I420Buffer> work_canvas_;
+    std::vector<Stream> work_;
+    size_t next_work_ = 0;
+    size_t pending_work_ = 0;
+    uint64_t work_round_ = 0;
+    bool quit_ = false;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_RENDER_VIDEO_COMPOSITOR_H_
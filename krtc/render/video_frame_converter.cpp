@@ -0,0 +1,218 @@
+#include "krtc/render/video_frame_converter.h"
+
+#include <algorithm>
+
+#include <rtc_base/logging.h>
+#include <third_party/libyuv/include/libyuv/convert_argb.h>
+#include <third_party/libyuv/include/libyuv/convert_from.h>
+#include <third_party/libyuv/include/libyuv/scale.h>
+
+namespace krtc {
+
+namespace {
+
+// Keeps the buffer alive as long as the MediaFrame.
+template <typename T>
+std::shared_ptr<void> HoldBuffer(const rtc::scoped_refptr<T>& buffer) {
+    return std::shared_ptr<void>(buffer.get(), [buffer](void*) {});
+}
+
+} // namespace
+
+PixelBufferPool::PixelBufferPool(size_t max_buffers) :
+    max_buffers_(max_buffers)
+{
+}
+
+rtc::scoped_refptr<PixelBuffer> PixelBufferPool::Acquire(size_t size) {
+    for (auto& buffer : buffers_) {
+        // Only the pool holds it, the app is done with the frame.
+        if (buffer->HasOneRef()) {
+            buffer->data().resize(size);
+            return buffer;
+        }
+    }
+
+    rtc::scoped_refptr<rtc::RefCountedObject<PixelBuffer>> buffer(
+        new rtc::RefCountedObject<PixelBuffer>());
+    buffer->data().resize(size);
+    if (buffers_.size() < max_buffers_) {
+        buffers_.push_back(buffer);
+    }
+    else {
+        RTC_LOG(LS_VERBOSE) << "pixel buffer pool exhausted, size: " << buffers_.size();
+    }
+    return buffer;
+}
+
+VideoFrameConverter::VideoFrameConverter() = default;
+
+VideoFrameConverter::~VideoFrameConverter() = default;
+
+bool VideoFrameConverter::IsSupportedOutput(SubMediaType type, int max_width, int max_height) {
+    if (type != SubMediaType::kSubTypeI420 && type != SubMediaType::kSubTypeNV12 &&
+        type != SubMediaType::kSubTypeARGB && type != SubMediaType::kSubTypeRGBA)
+    {
+        return false;
+    }
+    return max_width >= 0 && max_height >= 0;
+}
+
+bool VideoFrameConverter::SetOutput(SubMediaType type, int max_width, int max_height) {
+    if (!IsSupportedOutput(type, max_width, max_height)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    type_ = type;
+    max_width_ = max_width;
+    max_height_ = max_height;
+    return true;
+}
+
+void VideoFrameConverter::FitSize(int width, int height, int max_width, int max_height,
+    int* out_width, int* out_height)
+{
+    *out_width = width;
+    *out_height = height;
+    if (max_width <= 0 && max_height <= 0) {
+        return;
+    }
+
+    // Scale by the tighter of the two limits, 0 leaves that side free.
+    int64_t num = 1;
+    int64_t den = 1;
+    if (max_width > 0 && max_width < width) {
+        num = max_width;
+        den = width;
+    }
+    if (max_height > 0 && (int64_t)max_height * den < (int64_t)height * num) {
+        num = max_height;
+        den = height;
+    }
+    if (num == den) {
+        return;
+    }
+
+    *out_width = std::max(2, (int)(width * num / den) & ~1);
+    *out_height = std::max(2, (int)(height * num / den) & ~1);
+}
+
+std::shared_ptr<MediaFrame> VideoFrameConverter::Convert(const webrtc::VideoFrame& frame) {
+    SubMediaType type;
+    int max_width;
+    int max_height;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        type = type_;
+        max_width = max_width_;
+        max_height = max_height_;
+    }
+
+    rtc::scoped_refptr<webrtc::I420BufferInterface> i420 = frame.video_frame_buffer()->ToI420();
+    if (!i420) {
+        return nullptr;
+    }
+
+    int width;
+    int height;
+    FitSize(i420->width(), i420->height(), max_width, max_height, &width, &height);
+
+    // Source planes of the output conversion: the decoded frame, or a
+    // pooled copy scaled down first, the conversion then touches the
+    // smaller frame only.
+    const uint8_t* src_y = i420->DataY();
+    const uint8_t* src_u = i420->DataU();
+    const uint8_t* src_v = i420->DataV();
+    int src_stride_y = i420->StrideY();
+    int src_stride_u = i420->StrideU();
+    int src_stride_v = i420->StrideV();
+    std::shared_ptr<void> src_owner = HoldBuffer(i420);
+
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    if (width != i420->width() || height != i420->height()) {
+        rtc::scoped_refptr<PixelBuffer> scaled = scaled_pool_.Acquire(
+            (size_t)width * height + (size_t)chroma_width * chroma_height * 2);
+        uint8_t* dst_y = scaled->data().data();
+        uint8_t* dst_u = dst_y + (size_t)width * height;
+        uint8_t* dst_v = dst_u + (size_t)chroma_width * chroma_height;
+        libyuv::I420Scale(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+            i420->width(), i420->height(),
+            dst_y, width, dst_u, chroma_width, dst_v, chroma_width,
+            width, height, libyuv::kFilterBox);
+
+        src_y = dst_y;
+        src_u = dst_u;
+        src_v = dst_v;
+        src_stride_y = width;
+        src_stride_u = chroma_width;
+        src_stride_v = chroma_width;
+        src_owner = HoldBuffer(scaled);
+    }
+
+    std::shared_ptr<MediaFrame> media_frame;
+    if (type == SubMediaType::kSubTypeI420) {
+        media_frame = std::make_shared<MediaFrame>(
+            src_stride_y * height + (src_stride_u + src_stride_v) * chroma_height);
+        media_frame->data[0] = (char*)src_y;
+        media_frame->data[1] = (char*)src_u;
+        media_frame->data[2] = (char*)src_v;
+        media_frame->stride[0] = src_stride_y;
+        media_frame->stride[1] = src_stride_u;
+        media_frame->stride[2] = src_stride_v;
+        media_frame->data_len[0] = src_stride_y * height;
+        media_frame->data_len[1] = src_stride_u * chroma_height;
+        media_frame->data_len[2] = src_stride_v * chroma_height;
+        media_frame->external_data_owner = src_owner;
+    }
+    else if (type == SubMediaType::kSubTypeNV12) {
+        int stride_uv = chroma_width * 2;
+        rtc::scoped_refptr<PixelBuffer> output = output_pool_.Acquire(
+            (size_t)width * height + (size_t)stride_uv * chroma_height);
+        uint8_t* dst_y = output->data().data();
+        uint8_t* dst_uv = dst_y + (size_t)width * height;
+        libyuv::I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+            dst_y, width, dst_uv, stride_uv, width, height);
+
+        media_frame = std::make_shared<MediaFrame>((int)output->data().size());
+        media_frame->data[0] = (char*)dst_y;
+        media_frame->data[1] = (char*)dst_uv;
+        media_frame->stride[0] = width;
+        media_frame->stride[1] = stride_uv;
+        media_frame->data_len[0] = width * height;
+        media_frame->data_len[1] = stride_uv * chroma_height;
+        media_frame->external_data_owner = HoldBuffer(output);
+    }
+    else {
+        int stride = width * 4;
+        rtc::scoped_refptr<PixelBuffer> output = output_pool_.Acquire((size_t)stride * height);
+        uint8_t* dst = output->data().data();
+        // libyuv names the word order, ABGR is R G B A in memory.
+        if (type == SubMediaType::kSubTypeARGB) {
+            libyuv::I420ToARGB(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+                dst, stride, width, height);
+        }
+        else {
+            libyuv::I420ToABGR(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
+                dst, stride, width, height);
+        }
+
+        media_frame = std::make_shared<MediaFrame>((int)output->data().size());
+        media_frame->data[0] = (char*)dst;
+        media_frame->stride[0] = stride;
+        media_frame->data_len[0] = stride * height;
+        media_frame->external_data_owner = HoldBuffer(output);
+    }
+
+    media_frame->external_data = true;
+    media_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
+    media_frame->fmt.sub_fmt.video_fmt.type = type;
+    media_frame->fmt.sub_fmt.video_fmt.width = width;
+    media_frame->fmt.sub_fmt.video_fmt.height = height;
+    media_frame->fmt.sub_fmt.video_fmt.idr = false;
+    media_frame->ts = frame.timestamp();
+    return media_frame;
+}
+
+} // namespace krtc
@@ -0,0 +1,79 @@
+#ifndef KRTCSDK_KRTC_RENDER_VIDEO_FRAME_CONVERTER_H_
+#define KRTCSDK_KRTC_RENDER_VIDEO_FRAME_CONVERTER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <api/scoped_refptr.h>
+#include <api/video/video_frame.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include "krtc/media/media_frame.h"
+
+namespace krtc {
+
+// Pixels of one converted frame, recycled by PixelBufferPool once the app
+// has dropped its MediaFrame.
+class PixelBuffer : public rtc::RefCountInterface {
+public:
+    std::vector<uint8_t>& data() { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+class PixelBufferPool {
+public:
+    explicit PixelBufferPool(size_t max_buffers = kDefaultMaxBuffers);
+
+    // A buffer of size bytes nobody else holds. Falls back to a non pooled
+    // one when all max_buffers are still in use.
+    rtc::scoped_refptr<PixelBuffer> Acquire(size_t size);
+
+    size_t pooled_buffers() const { return buffers_.size(); }
+
+private:
+    static const size_t kDefaultMaxBuffers = 4;
+
+    size_t max_buffers_;
+    std::vector<rtc::scoped_refptr<rtc::RefCountedObject<PixelBuffer>>> buffers_;
+};
+
+// Turns decoded frames into the MediaFrames OnPullVideoFrame hands out, in
+// the format and size the app asked for: one libyuv pass in the sdk instead
+// of one per consumer. Unscaled I420 references the decoded buffer, nothing
+// is copied.
+class VideoFrameConverter {
+public:
+    VideoFrameConverter();
+    ~VideoFrameConverter();
+
+    static bool IsSupportedOutput(SubMediaType type, int max_width, int max_height);
+
+    // Any thread, applies from the next frame.
+    bool SetOutput(SubMediaType type, int max_width, int max_height);
+
+    // On one thread at a time.
+    std::shared_ptr<MediaFrame> Convert(const webrtc::VideoFrame& frame);
+
+private:
+    // The largest even size inside max_width x max_height with the aspect
+    // ratio of width x height, never larger than it.
+    static void FitSize(int width, int height, int max_width, int max_height,
+        int* out_width, int* out_height);
+
+    std::mutex mutex_;
+    SubMediaType type_ = SubMediaType::kSubTypeI420;
+    int max_width_ = 0;
+    int max_height_ = 0;
+
+    PixelBufferPool scaled_pool_;
+    PixelBufferPool output_pool_;
+};
+
+} // namespace krtc
+
+#endif // KRTCSDK_KRTC_RENDER_VIDEO_FRAME_CONVERTER_H_
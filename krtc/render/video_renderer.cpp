@@ -1,6 +1,12 @@
 // H:\webrtc\webrtc-checkout\src\test\video_renderer.cc
 
 #include "krtc/render/video_renderer.h"
+
+#include <mutex>
+
+#include "krtc/render/presentation_scheduler.h"
+#include "krtc/render/render_queue.h"
+#include "krtc/render/video_frame_converter.h"
 #include "krtc/media/media_frame.h"
 #include "krtc/base/krtc_global.h"
 
@@ -9,48 +15,122 @@ namespace krtc {
 class NullRenderer : public VideoRenderer {
 public:
     NullRenderer(CONTROL_TYPE type):
-        type_(type){}
+        type_(type)
+    {
+        if (type_ == CONTROL_TYPE::PULL) {
+            queue_ = std::make_shared<RenderQueue>(KRTCGlobal::Instance()->render_thread(),
+                [this](const webrtc::VideoFrame& video_frame) { Deliver(video_frame); });
+        }
+    }
+
+    ~NullRenderer() override {
+        if (queue_) {
+            queue_->Stop();
+        }
+        SetPresentationSmoothing(false, 0, 0);
+    }
+
+    void GetStats(uint64_t* delivered_frames, uint64_t* dropped_frames) const override {
+        RenderQueue::Stats stats = queue_ ? queue_->stats() : RenderQueue::Stats();
+        *delivered_frames = stats.delivered_frames;
+        *dropped_frames = stats.dropped_frames;
+
+        std::shared_ptr<PresentationScheduler> scheduler = scheduler_ptr();
+        if (scheduler) {
+            PresentationScheduler::Stats scheduler_stats = scheduler->stats();
+            *delivered_frames += scheduler_stats.presented_frames;
+            *dropped_frames += scheduler_stats.dropped_frames;
+        }
+    }
+
+    bool SetOutputFormat(SubMediaType type, int max_width, int max_height) override {
+        return converter_.SetOutput(type, max_width, max_height);
+    }
+
+    bool SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms) override {
+        if (type_ != CONTROL_TYPE::PULL) {
+            return false;
+        }
+
+        std::shared_ptr<PresentationScheduler> scheduler;
+        if (enable) {
+            PresentationScheduler::Config config;
+            config.refresh_hz = refresh_hz;
+            config.max_delay_ms = max_delay_ms;
+            scheduler = std::make_shared<PresentationScheduler>(
+                KRTCGlobal::Instance()->render_thread(), config,
+                [this](const webrtc::VideoFrame& video_frame) { Deliver(video_frame); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(scheduler_mutex_);
+            scheduler.swap(scheduler_);
+        }
+        // The old one, frames still in it are dropped.
+        if (scheduler) {
+            scheduler->Stop();
+        }
+        return true;
+    }
+
+    bool GetPresentationStats(double* interval_stddev_ms, int* delay_ms) const override {
+        std::shared_ptr<PresentationScheduler> scheduler = scheduler_ptr();
+        if (!scheduler) {
+            return false;
+        }
+
+        PresentationScheduler::Stats stats = scheduler->stats();
+        *interval_stddev_ms = stats.interval_stddev_ms;
+        *delay_ms = stats.delay_ms;
+        return true;
+    }
 
 private:
+    // On the decoder thread: hands the frame over and returns, the conversion
+    // into a MediaFrame and the app's callback run on the render thread.
     void OnFrame(const webrtc::VideoFrame& video_frame) override {
         if (type_ == CONTROL_TYPE::PUSH) {
             return;
         }
 
-        if (KRTCGlobal::Instance()->engine_observer()) {
-            rtc::scoped_refptr<webrtc::VideoFrameBuffer> vfb = video_frame.video_frame_buffer();
-            int src_width = video_frame.width();
-            int src_height = video_frame.height();
-
-            int strideY = vfb.get()->GetI420()->StrideY();
-            int strideU = vfb.get()->GetI420()->StrideU();
-            int strideV = vfb.get()->GetI420()->StrideV();
-
-            int size = strideY * src_height + (strideU + strideV) * ((src_height + 1) / 2);
-            std::shared_ptr<MediaFrame> media_frame = std::make_shared<MediaFrame>(size);
-            media_frame->fmt.media_type = MainMediaType::kMainTypeVideo;
-            media_frame->fmt.sub_fmt.video_fmt.type = SubMediaType::kSubTypeI420;
-            media_frame->fmt.sub_fmt.video_fmt.width = src_width;
-            media_frame->fmt.sub_fmt.video_fmt.height = src_height;
-            media_frame->stride[0] = strideY;
-            media_frame->stride[1] = strideU;
-            media_frame->stride[2] = strideV;
-            media_frame->data_len[0] = strideY * src_height;
-            media_frame->data_len[1] = strideU * ((src_height + 1) / 2);
-            media_frame->data_len[2] = strideV * ((src_height + 1) / 2);
-            media_frame->data[0] = new char[media_frame->data_len[0]];
-            media_frame->data[1] = new char[media_frame->data_len[1]];
-            media_frame->data[2] = new char[media_frame->data_len[2]];
-            memcpy(media_frame->data[0], video_frame.video_frame_buffer()->GetI420()->DataY(), media_frame->data_len[0]);
-            memcpy(media_frame->data[1], video_frame.video_frame_buffer()->GetI420()->DataU(), media_frame->data_len[1]);
-            memcpy(media_frame->data[2], video_frame.video_frame_buffer()->GetI420()->DataV(), media_frame->data_len[2]);
-
-            KRTCGlobal::Instance()->engine_observer()->OnPullVideoFrame(media_frame);
+        if (!KRTCGlobal::Instance()->engine_observer()) {
+            return;
+        }
+
+        std::shared_ptr<PresentationScheduler> scheduler = scheduler_ptr();
+        if (scheduler) {
+            scheduler->Push(video_frame);
+        }
+        else {
+            queue_->Push(video_frame);
+        }
+    }
+
+    std::shared_ptr<PresentationScheduler> scheduler_ptr() const {
+        std::lock_guard<std::mutex> lock(scheduler_mutex_);
+        return scheduler_;
+    }
+
+    // On the render thread.
+    void Deliver(const webrtc::VideoFrame& video_frame) {
+        KRTCEngineObserver* observer = KRTCGlobal::Instance()->engine_observer();
+        if (!observer) {
+            return;
+        }
+
+        std::shared_ptr<MediaFrame> media_frame = converter_.Convert(video_frame);
+        if (media_frame) {
+            observer->OnPullVideoFrame(media_frame);
         }
     }
 
 private:
     CONTROL_TYPE type_;
+    VideoFrameConverter converter_;
+    std::shared_ptr<RenderQueue> queue_;
+    // Set while smoothing is on, used instead of queue_.
+    mutable std::mutex scheduler_mutex_;
+    std::shared_ptr<PresentationScheduler> scheduler_;
 };
 
 std::unique_ptr<VideoRenderer> VideoRenderer::Create(CONTROL_TYPE type, int hwnd, size_t width, size_t height)
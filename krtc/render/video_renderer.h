@@ -35,6 +35,27 @@ namespace krtc {
 
     virtual ~VideoRenderer() {}
 
+    // Frames handed to OnPullVideoFrame and dropped because the app was
+    // still busy with an earlier one.
+    virtual void GetStats(uint64_t* delivered_frames, uint64_t* dropped_frames) const {
+        *delivered_frames = 0;
+        *dropped_frames = 0;
+    }
+
+    // Format and size of the frames handed to OnPullVideoFrame.
+    virtual bool SetOutputFormat(SubMediaType type, int max_width, int max_height) {
+        return false;
+    }
+
+    // Frames released on refresh boundaries by a PresentationScheduler
+    // instead of as soon as they are decoded.
+    virtual bool SetPresentationSmoothing(bool enable, int refresh_hz, int max_delay_ms) {
+        return false;
+    }
+    virtual bool GetPresentationStats(double* interval_stddev_ms, int* delay_ms) const {
+        return false;
+    }
+
 protected:
     VideoRenderer() {}
 
@@ -1,66 +1,213 @@
 #include "timer.h"
 
-CTimer::CTimer(unsigned int milliseconds, bool repeat, CTimer::OnTask func) :
-	milliseconds_(milliseconds),
-	repeat_(repeat),
-	func_(func) {
+#include <chrono>
+
+TimerService* TimerService::Instance()
+{
+	static TimerService* const instance = new TimerService();
+	return instance;
 }
 
-CTimer::~CTimer() {}
+TimerService::TimerService()
+{
+	thread_ = std::thread(std::bind(&TimerService::Run, this));
+}
 
-// 启动函数
-void CTimer::Start()
+TimerService::~TimerService()
 {
-	if (milliseconds_ == 0 || milliseconds_ == static_cast<unsigned int>(-1)) // 间隔时间为0或默认无效值，直接返回
+	// 单例不会被析构
+}
+
+int64_t TimerService::NowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TimerService::TimerId TimerService::Schedule(unsigned int milliseconds, bool repeat, OnTask func)
+{
+	if (milliseconds == 0 || milliseconds == static_cast<unsigned int>(-1) || !func)
 	{
-		return;
+		return 0;
 	}
-	exit_.store(false);
-	immediately_run_.store(false);
-	thread_ = std::thread(std::bind(&CTimer::Run, this));
+
+	std::shared_ptr<Timer> timer = std::make_shared<Timer>();
+	timer->milliseconds = milliseconds;
+	timer->repeat = repeat;
+	timer->func = std::move(func);
+
+	int64_t now_ms = NowMs();
+	int64_t deadline_ms = now_ms + milliseconds;
+	if (repeat)
+	{
+		// 对齐到周期网格，同周期的定时器落在同一时刻
+		deadline_ms = (now_ms + milliseconds / 2) / milliseconds * milliseconds + milliseconds;
+	}
+
+	std::lock_guard<std::mutex> locker(mutex_);
+	TimerId id = next_id_++;
+	timers_[id] = timer;
+	Queue(id, deadline_ms);
+	return id;
 }
 
-void CTimer::Stop()
+void TimerService::Cancel(TimerId id)
 {
-	exit_.store(true);
-	cond_.notify_all(); // 唤醒线程
-	if (thread_.joinable())
+	if (id == 0)
 	{
-		thread_.join();
+		return;
+	}
+
+	std::unique_lock<std::mutex> locker(mutex_);
+	auto it = timers_.find(id);
+	if (it != timers_.end())
+	{
+		auto deadline = deadlines_.find(it->second->deadline_ms);
+		if (deadline != deadlines_.end())
+		{
+			std::vector<TimerId>& ids = deadline->second;
+			for (auto id_it = ids.begin(); id_it != ids.end(); ++id_it)
+			{
+				if (*id_it == id)
+				{
+					ids.erase(id_it);
+					break;
+				}
+			}
+			if (ids.empty())
+			{
+				deadlines_.erase(deadline);
+			}
+		}
+		timers_.erase(it);
+	}
+
+	if (std::this_thread::get_id() != thread_.get_id())
+	{
+		done_cond_.wait(locker, [this, id]() { return running_id_ != id; });
 	}
 }
 
-void CTimer::SetExit(bool b_exit)
+TimerService::Stats TimerService::stats() const
 {
-	exit_.store(b_exit);
+	std::lock_guard<std::mutex> locker(mutex_);
+	return stats_;
 }
 
-void CTimer::Run()
+void TimerService::Queue(TimerId id, int64_t deadline_ms)
 {
-	while (!exit_.load())
+	timers_[id]->deadline_ms = deadline_ms;
+	deadlines_[deadline_ms].push_back(id);
+	if (deadlines_.begin()->first == deadline_ms)
 	{
-		{
-			std::unique_lock<std::mutex> locker(mutex_);
+		cond_.notify_one(); // 最早的到期时间变了
+	}
+}
 
-			// 如果是被唤醒的，需要判断先条件确定是不是虚假唤醒
-			// wait_for是等待第三个参数满足条件，当不满足时，超时后继续往下执行
-			cond_.wait_for(locker, std::chrono::milliseconds(milliseconds_), [this]()
-				{ return exit_.load(); }
-			);
+void TimerService::Run()
+{
+	std::unique_lock<std::mutex> locker(mutex_);
+	while (true)
+	{
+		if (deadlines_.empty())
+		{
+			cond_.wait(locker);
+			continue;
 		}
 
-		if (exit_.load()) // 再校验下退出标识
+		int64_t deadline_ms = deadlines_.begin()->first;
+		int64_t now_ms = NowMs();
+		if (deadline_ms > now_ms)
 		{
-			return;
+			cond_.wait_for(locker, std::chrono::milliseconds(deadline_ms - now_ms));
+			continue;
 		}
 
-		if (func_)
+		stats_.wakeups++;
+		std::vector<TimerId> ids = std::move(deadlines_.begin()->second);
+		deadlines_.erase(deadlines_.begin());
+
+		for (TimerId id : ids)
 		{
-			func_();
+			auto it = timers_.find(id);
+			if (it == timers_.end())
+			{
+				continue; // 同一批中先执行的回调取消了它
+			}
+			std::shared_ptr<Timer> timer = it->second;
+
+			running_id_ = id;
+			stats_.runs++;
+			locker.unlock();
+			timer->func();
+			locker.lock();
+			running_id_ = 0;
+			done_cond_.notify_all();
 
-			if (!repeat_) {
-				SetExit(true);
+			if (timers_.find(id) == timers_.end())
+			{
+				continue; // 回调内被取消
 			}
+			if (!timer->repeat)
+			{
+				timers_.erase(id);
+				continue;
+			}
+
+			// 从到期时间累加，回调耗时不会推迟后面的周期
+			int64_t period_ms = timer->milliseconds;
+			int64_t next_ms = deadline_ms + period_ms;
+			now_ms = NowMs();
+			if (next_ms <= now_ms)
+			{
+				next_ms += (now_ms - next_ms) / period_ms * period_ms + period_ms;
+			}
+			Queue(id, next_ms);
 		}
 	}
 }
+
+CTimer::CTimer(unsigned int milliseconds, bool repeat, CTimer::OnTask func) :
+	milliseconds_(milliseconds),
+	repeat_(repeat),
+	func_(func) {
+}
+
+CTimer::~CTimer()
+{
+	Stop();
+}
+
+// 启动函数
+void CTimer::Start()
+{
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (timer_id_ != 0)
+	{
+		return;
+	}
+	// 间隔时间为0或默认无效值时不会启动
+	timer_id_ = TimerService::Instance()->Schedule(milliseconds_, repeat_, func_);
+}
+
+void CTimer::Stop()
+{
+	TimerService::TimerId timer_id = 0;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		timer_id = timer_id_;
+		timer_id_ = 0;
+	}
+	if (timer_id != 0)
+	{
+		TimerService::Instance()->Cancel(timer_id);
+	}
+}
+
+void CTimer::SetExit(bool b_exit)
+{
+	if (b_exit)
+	{
+		Stop();
+	}
+}
@@ -1,20 +1,74 @@
 #ifndef KRTCSDK_KRTC_TOOLS_TIMER_H_
 #define KRTCSDK_KRTC_TOOLS_TIMER_H_
 
-#include <iostream>
-#include <string>
-#include <thread>
-#include <chrono>
-#include <atomic>
+#include <stdint.h>
+
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <condition_variable>
 #include <functional>
 
-class CTimer
+// 进程内所有定时器共用的一个线程，定时器再多线程数也不变。
+// 重复定时器按周期对齐到同一时间网格上，周期相同的定时器在同一次唤醒中执行；
+// 下次到期时间由上次到期时间累加，不随回调耗时漂移，错过的周期直接跳过。
+class TimerService
 {
 public:
+	typedef uint64_t TimerId;
 	typedef std::function<void()> OnTask;
 
+	struct Stats {
+		uint64_t wakeups = 0;    // 线程被到期唤醒的次数
+		uint64_t runs = 0;       // 回调执行次数
+	};
+
+	static TimerService* Instance();
+
+	// 单次定时器在 milliseconds 后执行一次；重复定时器第一次在
+	// [milliseconds / 2, milliseconds * 3 / 2) 内的网格点执行，之后每个周期一次。
+	TimerId Schedule(unsigned int milliseconds, bool repeat, OnTask func);
+
+	// 返回后回调不会再执行；回调正在执行时等待其结束，在回调内调用则不等待。
+	void Cancel(TimerId id);
+
+	Stats stats() const;
+
+private:
+	struct Timer {
+		unsigned int milliseconds = 0;
+		bool repeat = false;
+		OnTask func;
+		int64_t deadline_ms = 0;
+	};
+
+	TimerService();
+	~TimerService();
+
+	void Run();
+	void Queue(TimerId id, int64_t deadline_ms);
+
+	static int64_t NowMs();
+
+	mutable std::mutex mutex_;
+	std::condition_variable cond_;
+	std::condition_variable done_cond_;
+	std::map<TimerId, std::shared_ptr<Timer>> timers_;
+	// 到期时间 -> 定时器，同一时刻到期的定时器一起执行
+	std::map<int64_t, std::vector<TimerId>> deadlines_;
+	TimerId next_id_ = 1;
+	TimerId running_id_ = 0;
+	Stats stats_;
+	std::thread thread_;
+};
+
+class CTimer
+{
+public:
+	typedef TimerService::OnTask OnTask;
+
 	CTimer(unsigned int milliseconds, bool repeat, OnTask func);
 
 	virtual ~CTimer();
@@ -23,19 +77,13 @@ public:
 	void Stop();
 	void SetExit(bool b_exit);
 
-private:
-	void Run();
-
 private: 
 	unsigned int milliseconds_ = 1000;
 	bool repeat_ = false;
 	OnTask func_;
 
-    std::atomic_bool immediately_run_{false}; // 是否立即执行
-    std::atomic_bool exit_{false};
-	std::thread thread_;
 	std::mutex mutex_;
-	std::condition_variable cond_;
+	TimerService::TimerId timer_id_ = 0;
 };
 
 #endif // KRTCSDK_KRTC_TOOLS_TIMER_H_